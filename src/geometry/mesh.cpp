@@ -5,6 +5,9 @@
 // =============================================================================
 
 #include "geometry/mesh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 // Construye la malla copiando todos los datos de geometra (vrtices, ndices,
 // descripciones de layout). til cuando el origen necesita conservar sus datos.
@@ -23,4 +26,197 @@ void Mesh::setData(const GeometryData& data) {
 // Reemplaza los datos de geometra moviendo desde el origen.
 void Mesh::setData(GeometryData&& data) {
     this->data = std::move(data);
-}
\ No newline at end of file
+}
+
+// Extrae los datos movindolos fuera de la malla. Los vectores quedan vacos
+// y la malla puede volver a rellenarse con setData.
+GeometryData Mesh::releaseData() {
+    GeometryData released = std::move(data);
+    data = GeometryData{};
+    return released;
+}
+
+// Esfera envolvente en dos pasadas: la primera obtiene la caja alineada a los
+// ejes, cuyo centro se toma como centro de la esfera; la segunda, la mayor
+// distancia a ese centro. No es la esfera mnima, pero es barata y estable.
+glm::vec4 computeBoundingSphere(const uint8_t* vertexData, uint32_t vertexCount, uint32_t stride, uint32_t positionOffset) {
+    if (vertexData == nullptr || vertexCount == 0) {
+        return glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+    }
+
+    auto position = [&](uint32_t i) {
+        glm::vec3 p;
+        std::memcpy(&p, vertexData + static_cast<size_t>(i) * stride + positionOffset, sizeof(p));
+        return p;
+    };
+
+    glm::vec3 minPos = position(0);
+    glm::vec3 maxPos = minPos;
+    for (uint32_t i = 1; i < vertexCount; i++) {
+        glm::vec3 p = position(i);
+        minPos = glm::min(minPos, p);
+        maxPos = glm::max(maxPos, p);
+    }
+
+    glm::vec3 center = (minPos + maxPos) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        glm::vec3 d = position(i) - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+    }
+
+    return glm::vec4(center, std::sqrt(radiusSquared));
+}
+
+// Mismo esquema en dos pasadas que computeBoundingSphere, sobre las esferas
+// de las instancias: el centro es el de la caja de sus centros y el radio la
+// mayor distancia a l ms el radio de cada una.
+glm::vec4 computeInstancedBoundingSphere(const glm::vec4& meshSphere, const uint8_t* instanceData, uint32_t instanceCount) {
+    if (meshSphere.w < 0.0f || instanceData == nullptr || instanceCount == 0) {
+        return meshSphere;
+    }
+
+    auto instanceSphere = [&](uint32_t i) {
+        glm::mat4 m;
+        std::memcpy(&m, instanceData + static_cast<size_t>(i) * sizeof(glm::mat4), sizeof(m));
+        float scale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+        return glm::vec4(glm::vec3(m * glm::vec4(glm::vec3(meshSphere), 1.0f)), meshSphere.w * scale);
+    };
+
+    glm::vec4 first = instanceSphere(0);
+    glm::vec3 minPos = glm::vec3(first);
+    glm::vec3 maxPos = minPos;
+    for (uint32_t i = 1; i < instanceCount; i++) {
+        glm::vec3 c = glm::vec3(instanceSphere(i));
+        minPos = glm::min(minPos, c);
+        maxPos = glm::max(maxPos, c);
+    }
+
+    glm::vec3 center = (minPos + maxPos) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < instanceCount; i++) {
+        glm::vec4 sphere = instanceSphere(i);
+        radius = std::max(radius, glm::length(glm::vec3(sphere) - center) + sphere.w);
+    }
+
+    return glm::vec4(center, radius);
+}
+
+// Busca el atributo de posicin (location 0) y comprueba que sea legible
+// como tres floats antes de delegar en la versin de bajo nivel. Las
+// posiciones snorm se decodifican antes a un array temporal de vec3.
+glm::vec4 computeBoundingSphere(const GeometryData& data) {
+    const uint32_t stride = data.bindingDescription.stride;
+    if (stride == 0 || data.vertexData.size() < static_cast<size_t>(data.vertexCount) * stride) {
+        return glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+    }
+
+    for (const auto& attribute : data.attributeDescriptions) {
+        if (attribute.location != 0) {
+            continue;
+        }
+        glm::vec4 sphere;
+        std::vector<glm::vec3> decoded;
+        if (attribute.format == VK_FORMAT_R16G16B16A16_SNORM && decodePositions(data, decoded)) {
+            sphere = computeBoundingSphere(reinterpret_cast<const uint8_t*>(decoded.data()), data.vertexCount,
+                sizeof(glm::vec3), 0);
+        }
+        else if ((attribute.format == VK_FORMAT_R32G32B32_SFLOAT || attribute.format == VK_FORMAT_R32G32B32A32_SFLOAT) &&
+            attribute.offset + sizeof(glm::vec3) <= stride) {
+            sphere = computeBoundingSphere(data.vertexData.data(), data.vertexCount, stride, attribute.offset);
+        }
+        else {
+            break;
+        }
+        if (data.instanceCount > 0 && data.instanceData.size() >= data.instanceCount * sizeof(glm::mat4)) {
+            sphere = computeInstancedBoundingSphere(sphere, data.instanceData.data(), data.instanceCount);
+        }
+        return sphere;
+    }
+
+    return glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+}
+
+// Las posiciones snorm se expanden a [-1, 1] (-32768 satura a -1, como en el
+// vertex fetch) antes de aplicar positionScale y positionOffset.
+bool decodePositions(const GeometryData& data, std::vector<glm::vec3>& outPositions) {
+    const uint32_t stride = data.bindingDescription.stride;
+    if (stride == 0 || data.vertexData.size() < static_cast<size_t>(data.vertexCount) * stride) {
+        return false;
+    }
+
+    for (const auto& attribute : data.attributeDescriptions) {
+        if (attribute.location != 0) {
+            continue;
+        }
+        const uint8_t* base = data.vertexData.data() + attribute.offset;
+        if (attribute.format == VK_FORMAT_R16G16B16A16_SNORM && attribute.offset + 4 * sizeof(int16_t) <= stride) {
+            outPositions.resize(data.vertexCount);
+            for (uint32_t i = 0; i < data.vertexCount; i++) {
+                int16_t q[3];
+                std::memcpy(q, base + static_cast<size_t>(i) * stride, sizeof(q));
+                glm::vec3 normalized = glm::max(glm::vec3(q[0], q[1], q[2]) / 32767.0f, glm::vec3(-1.0f));
+                outPositions[i] = normalized * data.positionScale + data.positionOffset;
+            }
+            return true;
+        }
+        if ((attribute.format == VK_FORMAT_R32G32B32_SFLOAT || attribute.format == VK_FORMAT_R32G32B32A32_SFLOAT) &&
+            attribute.offset + sizeof(glm::vec3) <= stride) {
+            outPositions.resize(data.vertexCount);
+            for (uint32_t i = 0; i < data.vertexCount; i++) {
+                std::memcpy(&outPositions[i], base + static_cast<size_t>(i) * stride, sizeof(glm::vec3));
+            }
+            return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+// Cuantiza cada eje por separado contra la caja de las posiciones. Un eje
+// plano (extensin 0) usa escala 1 para no dividir por cero; todos sus
+// vrtices se codifican como 0 y se decodifican al centro.
+GeometryData quantizeVertices(const std::vector<Vertex>& vertices) {
+    GeometryData data{};
+    data.bindingDescription = QuantizedVertex::getBindingDescription();
+    auto attributes = QuantizedVertex::getAttributeDescriptions();
+    data.attributeDescriptions.assign(attributes.begin(), attributes.end());
+    data.vertexCount = static_cast<uint32_t>(vertices.size());
+    if (vertices.empty()) {
+        return data;
+    }
+
+    glm::vec3 minPos = vertices[0].pos;
+    glm::vec3 maxPos = minPos;
+    for (const Vertex& vertex : vertices) {
+        minPos = glm::min(minPos, vertex.pos);
+        maxPos = glm::max(maxPos, vertex.pos);
+    }
+
+    glm::vec3 halfExtent = (maxPos - minPos) * 0.5f;
+    for (int axis = 0; axis < 3; axis++) {
+        if (halfExtent[axis] <= 0.0f) {
+            halfExtent[axis] = 1.0f;
+        }
+    }
+    data.positionScale = halfExtent;
+    data.positionOffset = (minPos + maxPos) * 0.5f;
+
+    data.vertexData.resize(vertices.size() * sizeof(QuantizedVertex));
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const glm::vec3 normalized = glm::clamp((vertices[i].pos - data.positionOffset) / data.positionScale, -1.0f, 1.0f);
+        const glm::vec3 color = glm::clamp(vertices[i].color, 0.0f, 1.0f);
+
+        QuantizedVertex q{};
+        for (int axis = 0; axis < 3; axis++) {
+            q.pos[axis] = static_cast<int16_t>(std::lround(normalized[axis] * 32767.0f));
+            q.color[axis] = static_cast<uint8_t>(std::lround(color[axis] * 255.0f));
+        }
+        q.color[3] = 255;
+        std::memcpy(data.vertexData.data() + i * sizeof(QuantizedVertex), &q, sizeof(q));
+    }
+
+    data.boundingSphere = computeBoundingSphere(reinterpret_cast<const uint8_t*>(vertices.data()),
+        data.vertexCount, sizeof(Vertex), offsetof(Vertex, pos));
+    return data;
+}
@@ -5,11 +5,18 @@
 // Vertex: estructura de vrtice con posicin (vec3) y color (vec3), incluyendo
 // mtodos estticos para generar las descripciones de Vulkan del layout.
 //
+// QuantizedVertex: la misma informacin en 12 bytes en lugar de 24, con
+// posicin snorm de 16 bits y color unorm de 8 bits, que el vertex fetch de
+// Vulkan convierte a float sin coste en el shader.
+//
 // GeometryData: contenedor genrico que almacena datos de geometra en formato
 // crudo (bytes), junto con la descripcin del layout de vrtices, topologa,
 // datos de ndices y sus conteos. Esto permite transportar cualquier formato
 // de vrtice sin acoplarse a una estructura concreta.
 //
+// GeometryDirtyRange: rango de bytes de un flujo (vrtices, ndices o
+// instancias) que cambia en una actualizacin parcial.
+//
 // Mesh: envoltorio simple sobre GeometryData que proporciona semntica de
 // copia y movimiento para pasar geometra al renderer.
 // =============================================================================
@@ -61,6 +68,46 @@ struct Vertex {
     }
 };
 
+// Vrtice cuantizado: posicin en 16 bits snorm por componente (la cuarta es
+// relleno para alinear a 8 bytes) y color RGBA en 8 bits unorm. El vertex
+// fetch entrega la posicin en [-1, 1]; la posicin local es
+// pos  positionScale + positionOffset de su GeometryData (ver
+// quantizeVertices), decodificado en el vertex shader.
+struct QuantizedVertex {
+    int16_t pos[4];
+    uint8_t color[4];
+
+    // Un solo binding (0) con stride igual al tamao de QuantizedVertex.
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(QuantizedVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+
+    // Mismas locations que Vertex, con formatos normalizados:
+    //   - Location 0: posicin (R16G16B16A16_SNORM; el shader lee xyz)
+    //   - Location 1: color (R8G8B8A8_UNORM; el shader lee rgb)
+    // Ambos formatos son de soporte obligatorio como vertex buffer.
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+        attributeDescriptions[0].offset = offsetof(QuantizedVertex, pos);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attributeDescriptions[1].offset = offsetof(QuantizedVertex, color);
+
+        return attributeDescriptions;
+    }
+};
+static_assert(sizeof(QuantizedVertex) == 12, "QuantizedVertex must stay tightly packed");
+
 // Contenedor genrico de geometra que almacena los datos de vrtices e ndices
 // como vectores de bytes crudos, junto con toda la metadata necesaria para
 // configurar el pipeline de Vulkan.
@@ -96,11 +143,82 @@ struct GeometryData {
 
     // Nmero de ndices, calculado como indexData.size() / sizeof(tipo_indice).
     uint32_t indexCount = 0;
+
+    // Transformaciones por instancia en formato crudo: instanceCount matrices
+    // mat4 de 16 floats por columnas (glm::mat4), aplicadas tras la matriz de
+    // modelo del objeto. Si est vaco, la malla se dibuja una sola vez.
+    std::vector<uint8_t> instanceData;
+
+    // Nmero de instancias, calculado como instanceData.size() / sizeof(glm::mat4).
+    // 0 indica una malla sin instancias (una sola copia, sin transformacin extra).
+    uint32_t instanceCount = 0;
+
+    // Esfera envolvente en espacio local: xyz = centro, w = radio. Con
+    // instancias, envuelve todas las copias. Un radio negativo indica que se
+    // desconoce; el renderer la calcula al subir la geometra si tiene los
+    // datos en CPU y, si no, nunca la descarta en el frustum culling.
+    glm::vec4 boundingSphere{ 0.0f, 0.0f, 0.0f, -1.0f };
+
+    // Decodificacin de la posicin (location 0): el vertex shader calcula la
+    // posicin local como atributo  positionScale + positionOffset. Con
+    // posiciones float es la identidad; con posiciones normalizadas
+    // (QuantizedVertex) devuelve el rango [-1, 1] a la caja original.
+    // boundingSphere est siempre en la posicin ya decodificada.
+    glm::vec3 positionScale{ 1.0f };
+    glm::vec3 positionOffset{ 0.0f };
+};
+
+// Flujo de una geometra al que se refiere un rango sucio.
+enum class GeometryStream : uint32_t {
+    Vertex = 0,
+    Index = 1,
+    Instance = 2
 };
 
+// Rango de bytes modificado dentro de un flujo de una geometra ya subida.
+// Una actualizacin parcial lista sus rangos y trae solo esos bytes,
+// empaquetados por flujo en el orden de la lista (el primer rango de
+// vrtices empieza en el byte 0 de los datos de vrtices, el siguiente a
+// continuacin, etc.). Los rangos de un mismo flujo no se solapan.
+struct GeometryDirtyRange {
+    GeometryStream stream = GeometryStream::Vertex;
+    uint64_t offset = 0;  // Offset en el flujo, en bytes
+    uint64_t size = 0;
+};
+
+// Calcula una esfera envolvente (centro de la caja alineada a los ejes y
+// distancia mxima a l) a partir de posiciones float de 3 componentes
+// situadas a positionOffset bytes del inicio de cada vrtice.
+glm::vec4 computeBoundingSphere(const uint8_t* vertexData, uint32_t vertexCount, uint32_t stride, uint32_t positionOffset);
+
+// Ampla la esfera de una malla para que envuelva todas sus instancias:
+// transforma la esfera con cada matriz (escalando el radio por su mayor
+// factor de escala) y envuelve las esferas resultantes.
+glm::vec4 computeInstancedBoundingSphere(const glm::vec4& meshSphere, const uint8_t* instanceData, uint32_t instanceCount);
+
+// Como la anterior, localizando la posicin en el atributo de location 0 y
+// ampliando el resultado a las instancias, si las hay. Devuelve un radio
+// negativo si no hay vrtices en CPU o si ese atributo no es
+// R32G32B32_SFLOAT / R32G32B32A32_SFLOAT / R16G16B16A16_SNORM (esta ltima
+// decodificada con positionScale y positionOffset).
+glm::vec4 computeBoundingSphere(const GeometryData& data);
+
+// Decodifica la posicin local de cada vrtice (atributo de location 0, en
+// los mismos formatos que computeBoundingSphere). Devuelve false si no hay
+// vrtices en CPU o si el formato no es legible como posicin.
+bool decodePositions(const GeometryData& data, std::vector<glm::vec3>& outPositions);
+
+// Convierte vrtices float a QuantizedVertex: positionScale y positionOffset
+// son la semiextensin y el centro de la caja de las posiciones, de modo que
+// cada eje aprovecha todo el rango de 16 bits (el error mximo es la
+// semiextensin / 32767). Los colores se saturan a [0, 1]. La esfera
+// envolvente se calcula con las posiciones originales.
+GeometryData quantizeVertices(const std::vector<Vertex>& vertices);
+
 // Envoltorio sobre GeometryData que proporciona semntica de valor con
 // copia y movimiento. El renderer recibe objetos Mesh y extrae su
-// GeometryData para crear los buffers de GPU.
+// GeometryData para subirlo a la GPU (por movimiento si la malla se le
+// entrega como rvalue).
 class Mesh {
 public:
     Mesh() = default;
@@ -121,6 +239,10 @@ public:
     // Acceso de solo lectura a los datos de geometra almacenados.
     const GeometryData& getData() const { return data; }
 
+    // Extrae los datos de geometra por movimiento, dejando la malla vaca.
+    // Permite entregar los vectores al renderer sin copiarlos.
+    GeometryData releaseData();
+
 private:
     GeometryData data;
 };
\ No newline at end of file
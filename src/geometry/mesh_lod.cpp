@@ -0,0 +1,188 @@
+﻿// =============================================================================
+// mesh_lod.cpp
+// Implementación de la simplificación por agrupamiento de vértices
+// (buildLodChain).
+// =============================================================================
+
+#include "geometry/mesh_lod.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+// Índices mínimos de un nivel para que merezca la pena simplificarlo más: por
+// debajo, otro nivel apenas ahorra trabajo a la GPU.
+constexpr size_t LodMinIndexCount = 256;
+
+// Celdas por eje como máximo: cada coordenada de celda cabe en 21 bits y las
+// tres se empaquetan en una clave de 64.
+constexpr uint32_t LodMaxGridCells = 1u << 20;
+
+// -----------------------------------------------------------------------------
+// supportsLodTopology: solo las listas conservan su significado al remapear
+// cada primitiva por separado.
+// -----------------------------------------------------------------------------
+bool supportsLodTopology(VkPrimitiveTopology topology) {
+    return topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST || topology == VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+}
+
+// -----------------------------------------------------------------------------
+// clusterVertices: agrupa los vértices referenciados en celdas de lado
+// cellSize y devuelve en remap, para cada uno, el representante de su celda
+// (el vértice más cercano al centroide). clusters recibe los representantes
+// en orden de aparición de las celdas.
+// -----------------------------------------------------------------------------
+static void clusterVertices(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& referenced,
+    const glm::vec3& minCorner, float cellSize, uint32_t cells,
+    std::vector<uint32_t>& remap, std::vector<uint32_t>& clusters) {
+    std::unordered_map<uint64_t, uint32_t> cellClusters;
+    cellClusters.reserve(referenced.size() / 4);
+    std::vector<uint32_t> clusterOf(referenced.size());
+    std::vector<glm::dvec3> sums;
+    std::vector<uint32_t> counts;
+
+    for (size_t k = 0; k < referenced.size(); k++) {
+        const glm::vec3 cell = (positions[referenced[k]] - minCorner) / cellSize;
+        const uint64_t x = std::min(static_cast<uint32_t>(std::max(cell.x, 0.0f)), cells - 1);
+        const uint64_t y = std::min(static_cast<uint32_t>(std::max(cell.y, 0.0f)), cells - 1);
+        const uint64_t z = std::min(static_cast<uint32_t>(std::max(cell.z, 0.0f)), cells - 1);
+        const uint64_t key = (x << 42) | (y << 21) | z;
+
+        auto [it, inserted] = cellClusters.try_emplace(key, static_cast<uint32_t>(sums.size()));
+        if (inserted) {
+            sums.emplace_back(0.0);
+            counts.push_back(0);
+        }
+        clusterOf[k] = it->second;
+        sums[it->second] += glm::dvec3(positions[referenced[k]]);
+        counts[it->second]++;
+    }
+
+    clusters.assign(sums.size(), UINT32_MAX);
+    std::vector<float> bestDistance(sums.size(), INFINITY);
+    for (size_t k = 0; k < referenced.size(); k++) {
+        const uint32_t cluster = clusterOf[k];
+        const glm::vec3 centroid = glm::vec3(sums[cluster] / static_cast<double>(counts[cluster]));
+        const glm::vec3 delta = positions[referenced[k]] - centroid;
+        const float distance = glm::dot(delta, delta);
+        if (distance < bestDistance[cluster]) {
+            bestDistance[cluster] = distance;
+            clusters[cluster] = referenced[k];
+        }
+    }
+
+    for (size_t k = 0; k < referenced.size(); k++) {
+        remap[referenced[k]] = clusters[clusterOf[k]];
+    }
+}
+
+// -----------------------------------------------------------------------------
+// remapTriangles: aplica remap a cada triángulo, descarta los degenerados y
+// elimina los repetidos. Cada triángulo se rota para empezar por su menor
+// índice, lo que conserva el sentido de giro (y por tanto la cara visible)
+// y hace comparables los repetidos.
+// -----------------------------------------------------------------------------
+static void remapTriangles(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& remap,
+    std::vector<uint32_t>& outIndices) {
+    std::vector<std::array<uint32_t, 3>> triangles;
+    triangles.reserve(indices.size() / 3);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        std::array<uint32_t, 3> triangle = { remap[indices[t]], remap[indices[t + 1]], remap[indices[t + 2]] };
+        if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) {
+            continue;
+        }
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.push_back(triangle);
+    }
+
+    std::sort(triangles.begin(), triangles.end());
+    triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+    outIndices.clear();
+    outIndices.reserve(triangles.size() * 3);
+    for (const auto& triangle : triangles) {
+        outIndices.insert(outIndices.end(), triangle.begin(), triangle.end());
+    }
+}
+
+// -----------------------------------------------------------------------------
+// buildLodChain: la primera rejilla tiene sqrt(n) / 2 celdas por eje, con n
+// los vértices referenciados: en una superficie densa con vértices
+// uniformes eso dobla su separación y divide los elementos entre cuatro.
+// Cada nivel siguiente divide las celdas por eje entre dos. Si una rejilla
+// no reduce lo bastante (vértices agrupados en pocas celdas), se prueba la
+// siguiente sin emitir nivel.
+// -----------------------------------------------------------------------------
+LodChain buildLodChain(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+    VkPrimitiveTopology topology, size_t maxIndices) {
+    LodChain chain;
+    if (!supportsLodTopology(topology) || indices.size() < LodMinIndexCount) {
+        return chain;
+    }
+
+    std::vector<uint32_t> referenced;
+    referenced.reserve(indices.size());
+    for (uint32_t index : indices) {
+        if (index >= positions.size()) {
+            return chain;
+        }
+        referenced.push_back(index);
+    }
+    std::sort(referenced.begin(), referenced.end());
+    referenced.erase(std::unique(referenced.begin(), referenced.end()), referenced.end());
+
+    glm::vec3 minCorner(INFINITY);
+    glm::vec3 maxCorner(-INFINITY);
+    for (uint32_t vertex : referenced) {
+        minCorner = glm::min(minCorner, positions[vertex]);
+        maxCorner = glm::max(maxCorner, positions[vertex]);
+    }
+    const glm::vec3 size = maxCorner - minCorner;
+    const float extent = std::max({ size.x, size.y, size.z });
+    if (!(extent > 0.0f) || !std::isfinite(extent)) {
+        return chain;
+    }
+
+    uint32_t cells = static_cast<uint32_t>(std::sqrt(static_cast<double>(referenced.size())) / 2.0);
+    cells = std::min(cells, LodMaxGridCells);
+
+    std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+    std::vector<uint32_t> clusters;
+    std::vector<uint32_t> levelIndices;
+    size_t previousCount = indices.size();
+    while (chain.levels.size() < MaxLodLevels && cells >= 2) {
+        const float cellSize = extent / static_cast<float>(cells);
+        clusterVertices(positions, referenced, minCorner, cellSize, cells, remap, clusters);
+        if (topology == VK_PRIMITIVE_TOPOLOGY_POINT_LIST) {
+            levelIndices = clusters;
+        }
+        else {
+            remapTriangles(indices, remap, levelIndices);
+        }
+        cells /= 2;
+
+        if (levelIndices.empty()) {
+            break;
+        }
+        if (levelIndices.size() * 4 > previousCount * 3) {
+            continue;
+        }
+        if (chain.indices.size() + levelIndices.size() > maxIndices) {
+            break;
+        }
+
+        LodLevel level{};
+        level.firstIndex = static_cast<uint32_t>(chain.indices.size());
+        level.indexCount = static_cast<uint32_t>(levelIndices.size());
+        level.cellSize = cellSize;
+        chain.levels.push_back(level);
+        chain.indices.insert(chain.indices.end(), levelIndices.begin(), levelIndices.end());
+
+        previousCount = levelIndices.size();
+        if (previousCount < LodMinIndexCount) {
+            break;
+        }
+    }
+
+    return chain;
+}
@@ -0,0 +1,51 @@
+﻿// =============================================================================
+// mesh_lod.hpp
+// Simplificación de mallas para niveles de detalle (LOD) por agrupamiento de
+// vértices: el espacio de la malla se divide en una rejilla y los vértices de
+// cada celda se sustituyen por uno solo de ellos, el más cercano al centroide
+// de la celda. Los niveles son índices nuevos sobre los mismos vértices, así
+// que se dibujan con el vertex buffer de la malla original.
+//   - Triángulos: cada triángulo se remapea a los representantes de sus
+//     vértices; los que degeneran (dos vértices en la misma celda) y los
+//     repetidos se descartan.
+//   - Puntos: cada celda deja un único punto.
+// Cada rejilla se aplica a la malla original (no al nivel anterior), de modo
+// que el error de un nivel está acotado por su tamaño de celda.
+// =============================================================================
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Máximo de niveles simplificados por malla (sin contar la original).
+constexpr uint32_t MaxLodLevels = 4;
+
+// Nivel de detalle dentro de una cadena de índices simplificados.
+struct LodLevel {
+    uint32_t firstIndex = 0;   // Primer índice del nivel dentro de la cadena
+    uint32_t indexCount = 0;
+    float cellSize = 0.0f;     // Lado de la celda, en unidades locales: error máximo por eje
+};
+
+// Niveles simplificados de una malla, del más detallado al más simple, con
+// los índices de todos ellos consecutivos en indices.
+struct LodChain {
+    std::vector<LodLevel> levels;
+    std::vector<uint32_t> indices;
+};
+
+// true si la topología admite niveles por agrupamiento (listas de triángulos
+// o de puntos). Las tiras y abanicos no se pueden remapear triángulo a triángulo.
+bool supportsLodTopology(VkPrimitiveTopology topology);
+
+// Construye los niveles de una malla indexada a partir de sus posiciones
+// locales y sus índices. Cada nivel reduce los elementos al menos a 3/4 del
+// anterior; la cadena termina al llegar a MaxLodLevels, a una malla de muy
+// pocos elementos o a maxIndices índices en total. Devuelve una cadena vacía
+// si la malla es demasiado pequeña para simplificarla.
+LodChain buildLodChain(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+    VkPrimitiveTopology topology, size_t maxIndices);
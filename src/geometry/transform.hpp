@@ -3,8 +3,9 @@
 // Estructura que agrupa las tres matrices de transformacin 4x4 necesarias
 // para posicionar y proyectar la geometra en el espacio de la pantalla.
 //
-// Estas matrices se copian al Uniform Buffer Object (UBO) cada frame y son
-// ledas por el vertex shader para transformar cada vrtice:
+// La vista y la proyeccin se copian al Uniform Buffer Object (UBO) solo
+// cuando cambian, y el modelo al buffer de objetos de cada frame; el vertex
+// shader las combina para transformar cada vrtice:
 //   gl_Position = proj * view * model * vec4(posicin, 1.0)
 // =============================================================================
 
@@ -0,0 +1,261 @@
+﻿// =============================================================================
+// ingest_worker.cpp
+// Implementación del hilo de ingesta (IngestWorker): lectura del anillo IPC
+// en slots propios y traspaso lock-free al hilo de render.
+// =============================================================================
+
+#include "ipc/ingest_worker.hpp"
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+// -----------------------------------------------------------------------------
+// Destructor: detiene el hilo para que no escriba en la memoria de los slots
+// después de que el llamador la libere.
+// -----------------------------------------------------------------------------
+IngestWorker::~IngestWorker() {
+    stop();
+}
+
+// -----------------------------------------------------------------------------
+// setSlotMemory: registra la memoria de un slot. Con el hilo en marcha, el
+// llamador es el dueño del slot, así que el worker no lo toca hasta
+// recibirlo por el anillo de retorno, cuyo release publica los cambios.
+// -----------------------------------------------------------------------------
+void IngestWorker::setSlotMemory(uint32_t index, uint8_t* data, size_t capacity) {
+    if (index >= IngestWorkerSlotCount || data == nullptr || capacity == 0 || capacity < slots[index].requiredBytes) {
+        throw std::runtime_error("Invalid ingest slot memory!");
+    }
+
+    slots[index].data = data;
+    slots[index].capacity = capacity;
+}
+
+// -----------------------------------------------------------------------------
+// start: reinicia los estados de los slots (todos libres) y lanza el hilo.
+// -----------------------------------------------------------------------------
+void IngestWorker::start() {
+    if (running.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < IngestWorkerSlotCount; i++) {
+        if (slots[i].data == nullptr) {
+            throw std::runtime_error("Ingest worker started without memory for every slot!");
+        }
+        freeSlots[i] = static_cast<int32_t>(i);
+    }
+    freeSlotCount = IngestWorkerSlotCount;
+    growingSlot = -1;
+    publishHead.store(0, std::memory_order_relaxed);
+    publishTail.store(0, std::memory_order_relaxed);
+    returnHead.store(0, std::memory_order_relaxed);
+    returnTail.store(0, std::memory_order_relaxed);
+
+    running.store(true, std::memory_order_release);
+    thread = std::thread(&IngestWorker::run, this);
+}
+
+// -----------------------------------------------------------------------------
+// stop: pide al hilo que termine y espera a que salga. Como mucho tarda un
+// WaitTimeoutMs (o un OpenRetryMs mientras no hay escritor).
+// -----------------------------------------------------------------------------
+void IngestWorker::stop() {
+    running.store(false, std::memory_order_release);
+    if (thread.joinable()) {
+        thread.join();
+    }
+    reader.close();
+}
+
+// -----------------------------------------------------------------------------
+// takeUpdates: vacía la cola de publicación. El acquire de tail hace visibles
+// las escrituras del worker en los slots, publicadas con su release. Una
+// petición de crecimiento bloquea la ingesta hasta volver, así que siempre es
+// la última de la cola y nunca queda por delante de un frame completo.
+// -----------------------------------------------------------------------------
+uint32_t IngestWorker::takeUpdates(int32_t* outSlots) {
+    const uint64_t tail = publishTail.load(std::memory_order_acquire);
+    uint64_t head = publishHead.load(std::memory_order_relaxed);
+
+    uint64_t first = head;
+    for (uint64_t i = head; i != tail; i++) {
+        const IngestSlot& slot = slots[publishRing[i % IngestWorkerSlotCount]];
+        if (slot.requiredBytes == 0 && slot.dirtyRanges.empty()) {
+            first = i;
+        }
+    }
+
+    uint32_t count = 0;
+    for (; head != tail; head++) {
+        const int32_t index = publishRing[head % IngestWorkerSlotCount];
+        if (head < first) {
+            releaseSlot(index);
+        }
+        else {
+            outSlots[count++] = index;
+        }
+    }
+    publishHead.store(head, std::memory_order_release);
+    return count;
+}
+
+// -----------------------------------------------------------------------------
+// releaseSlot: encola el slot en el anillo de retorno. Solo lo llama el hilo
+// de render, así que tail tiene un único escritor.
+// -----------------------------------------------------------------------------
+void IngestWorker::releaseSlot(int32_t index) {
+    const uint64_t tail = returnTail.load(std::memory_order_relaxed);
+    returnRing[tail % IngestWorkerSlotCount] = index;
+    returnTail.store(tail + 1, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------
+// publishLatency: se llama como mucho una vez por frame, así que el mutex no
+// tiene contención apreciable.
+// -----------------------------------------------------------------------------
+void IngestWorker::publishLatency(const SharedGeometryLatency& latency) {
+    std::lock_guard<std::mutex> lock(latencyMutex);
+    pendingLatency = latency;
+    latencyPending = true;
+}
+
+// -----------------------------------------------------------------------------
+// run: bucle del hilo. Se conecta al escritor (reintentando), recoge los
+// slots devueltos y lee frames mientras haya; cuando no queda nada, o no hay
+// slot libre, se bloquea en el evento de notificación del escritor.
+// -----------------------------------------------------------------------------
+void IngestWorker::run() {
+    reader.setReadMode(SharedGeometryReadMode::Latest);
+
+    while (running.load(std::memory_order_acquire)) {
+        if (!reader.open()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(OpenRetryMs));
+            continue;
+        }
+
+        reclaimReturnedSlots();
+        forwardLatency();
+        if (!ingestOnce()) {
+            reader.waitForUpdate(WaitTimeoutMs);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// reclaimReturnedSlots: pasa a la lista libre los slots que el hilo de render
+// ha devuelto desde la última vez. Si vuelve el slot de una petición de
+// crecimiento, ya tiene su memoria nueva y la ingesta se reanuda.
+// -----------------------------------------------------------------------------
+void IngestWorker::reclaimReturnedSlots() {
+    const uint64_t tail = returnTail.load(std::memory_order_acquire);
+    uint64_t head = returnHead.load(std::memory_order_relaxed);
+    while (head != tail) {
+        const int32_t index = returnRing[head % IngestWorkerSlotCount];
+        if (index == growingSlot) {
+            slots[index].requiredBytes = 0;
+            growingSlot = -1;
+        }
+        freeSlots[freeSlotCount++] = index;
+        head++;
+    }
+    returnHead.store(head, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------
+// forwardLatency: copia el recorrido fuera del mutex para no retener al hilo
+// de render mientras se escribe en la memoria compartida. Como el worker
+// espera como mucho WaitTimeoutMs, el escritor lo recibe con ese retraso.
+// -----------------------------------------------------------------------------
+void IngestWorker::forwardLatency() {
+    SharedGeometryLatency latency;
+    {
+        std::lock_guard<std::mutex> lock(latencyMutex);
+        if (!latencyPending) {
+            return;
+        }
+        latency = pendingLatency;
+        latencyPending = false;
+    }
+    reader.publishLatency(latency);
+}
+
+// -----------------------------------------------------------------------------
+// ingestOnce: lee los frames pendientes directamente en el slot libre más
+// grande y lo publica en la cola. Un frame parcial deja en el slot solo sus
+// rangos (ver SharedGeometryReader::tryRead). Los flujos se empaquetan uno tras otro
+// (ver IngestWorkerStreamAlignment). Sin slot libre no se lee nada: los
+// frames siguen en el anillo compartido y el escritor nota la contrapresión
+// por ahí. Si el frame no cabe, el slot se publica como petición de
+// crecimiento en lugar de con datos. Tras publicar se avisa a
+// publishNotifier, si hay.
+// -----------------------------------------------------------------------------
+bool IngestWorker::ingestOnce() {
+    if (freeSlotCount == 0 || growingSlot >= 0) {
+        return false;
+    }
+
+    uint32_t chosen = 0;
+    for (uint32_t i = 1; i < freeSlotCount; i++) {
+        if (slots[freeSlots[i]].capacity > slots[freeSlots[chosen]].capacity) {
+            chosen = i;
+        }
+    }
+    std::swap(freeSlots[chosen], freeSlots[freeSlotCount - 1]);
+
+    auto alignUp = [](size_t value) {
+        return (value + IngestWorkerStreamAlignment - 1) & ~(IngestWorkerStreamAlignment - 1);
+    };
+
+    IngestSlot& slot = slots[freeSlots[freeSlotCount - 1]];
+    size_t requiredBytes = 0;
+    auto destination = [&slot, &requiredBytes, &alignUp](size_t vertexBytes, size_t indexBytes, size_t instanceBytes,
+        uint8_t*& vertexDst, uint8_t*& indexDst, uint8_t*& instanceDst) {
+        const size_t indexOffset = alignUp(vertexBytes);
+        const size_t instanceOffset = alignUp(indexOffset + indexBytes);
+        if (instanceOffset + instanceBytes > slot.capacity) {
+            requiredBytes = instanceOffset + instanceBytes;
+            return false;
+        }
+
+        slot.vertexBytes = vertexBytes;
+        slot.indexOffset = indexOffset;
+        slot.indexBytes = indexBytes;
+        slot.instanceOffset = instanceOffset;
+        slot.instanceBytes = instanceBytes;
+        vertexDst = slot.data;
+        indexDst = slot.data + indexOffset;
+        instanceDst = slot.data + instanceOffset;
+        return true;
+    };
+
+    const auto readBegin = std::chrono::steady_clock::now();
+    const bool read = reader.tryRead(update, destination);
+    if (!read && requiredBytes == 0) {
+        return false;
+    }
+
+    const int32_t index = freeSlots[--freeSlotCount];
+    if (read) {
+        slot.readMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - readBegin).count();
+        std::swap(slot.layout, update.geometry);
+        std::swap(slot.dirtyRanges, update.dirtyRanges);
+        slot.sequence = update.sequence;
+        slot.publishTimeNs = update.publishTimeNs;
+        slot.readTimeNs = FrameProfiler::timestampNanoseconds();
+    }
+    else {
+        slot.requiredBytes = requiredBytes;
+        growingSlot = index;
+    }
+
+    // Solo este hilo escribe tail. El slot estaba libre, así que no está ya
+    // en la cola y hay hueco para él.
+    const uint64_t tail = publishTail.load(std::memory_order_relaxed);
+    publishRing[tail % IngestWorkerSlotCount] = index;
+    publishTail.store(tail + 1, std::memory_order_release);
+    if (publishNotifier) {
+        publishNotifier();
+    }
+    return true;
+}
@@ -0,0 +1,180 @@
+﻿// =============================================================================
+// ingest_worker.hpp
+// Hilo de ingesta de geometría IPC. Saca del hilo de render todo el trabajo
+// proporcional al tamaño de la malla: la validación del slot compartido, la
+// reconstrucción de atributos y la copia de varios megabytes desde la memoria
+// compartida. El hilo de render solo recoge la actualización ya preparada.
+//
+// Reparto de memoria
+// ──────────────────
+// El worker rellena IngestWorkerSlotCount slots cuya memoria aporta el
+// llamador (en la aplicación, buffers de staging externos del renderer), así
+// que los bytes quedan listos para vkCmdCopyBuffer sin que el hilo de render
+// los toque. Cada slot tiene un único dueño en cada momento:
+//   - libre: del worker, que puede escribir en él;
+//   - publicado: en la cola de publicación, a la espera del hilo de render;
+//   - tomado: del hilo de render, hasta que la GPU termina de copiarlo;
+//   - devuelto: en la cola de retorno, a la espera de que el worker lo
+//     recoja como libre.
+//
+// Crecimiento de los slots
+// ────────────────────────
+// Los frames del anillo no tienen un tamaño máximo fijo, así que los slots
+// empiezan en IngestWorkerInitialSlotBytes y crecen bajo demanda. Si el
+// frame más reciente no cabe en ningún slot libre, el worker no lo consume:
+// publica el slot libre más grande con requiredBytes > 0, y el
+// hilo de render le asigna memoria mayor con setSlotMemory y lo devuelve.
+// Mientras tanto, el frame sigue esperando en el anillo compartido.
+//
+// Traspaso lock-free
+// ──────────────────
+//   - Worker → render: anillo SPSC de índices (cola de publicación). Un
+//     frame parcial solo tiene sentido sobre los anteriores, así que no se
+//     sustituye nada al publicar: es takeUpdates quien descarta, al tomar,
+//     todo lo anterior al último frame completo.
+//   - Render → worker: anillo SPSC de índices con contadores head/tail.
+//   - Latencias render → escritor: el último recorrido medido se deja bajo
+//     un mutex y el worker lo copia al bloque de control en su bucle; así
+//     solo el hilo que abre y cierra el lector toca la memoria compartida.
+// =============================================================================
+
+#pragma once
+
+#include "ipc/shared_geometry.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Número de slots de ingesta. Cubre uno publicado, uno o dos esperando a
+// que la GPU termine su copia y al menos uno libre para el worker.
+constexpr uint32_t IngestWorkerSlotCount = 4;
+
+// Bytes iniciales por slot. Cubren las mallas habituales sin reservar de
+// entrada el máximo del protocolo; los slots crecen si llega algo mayor.
+constexpr size_t IngestWorkerInitialSlotBytes = 4 * 1024 * 1024;
+
+// Alineación de los flujos dentro de un slot: los vértices empiezan en 0 y
+// los índices y las instancias, tras el flujo anterior redondeado a ella.
+constexpr size_t IngestWorkerStreamAlignment = 16;
+
+// Actualización preparada por el worker dentro de un slot.
+struct IngestSlot {
+    uint8_t* data = nullptr;     // Memoria del slot (aportada por el llamador)
+    size_t capacity = 0;
+    GeometryData layout;         // Metadata y conteos; sin vectores de datos
+    size_t vertexBytes = 0;      // Vértices en [0, vertexBytes)
+    size_t indexOffset = 0;
+    size_t indexBytes = 0;       // Índices en [indexOffset, indexOffset + indexBytes)
+    size_t instanceOffset = 0;
+    size_t instanceBytes = 0;    // Instancias en [instanceOffset, instanceOffset + instanceBytes)
+    size_t requiredBytes = 0;    // > 0: petición de crecimiento, sin datos (ver setSlotMemory)
+    std::vector<GeometryDirtyRange> dirtyRanges; // No vacío: frame parcial, con los rangos
+                                                 // empaquetados en los flujos del slot
+    uint64_t sequence = 0;       // Frames consumidos del anillo tras esta lectura
+    double readMilliseconds = 0; // Duración de la lectura y copia desde el anillo
+    uint64_t publishTimeNs = 0;  // Instante en que el escritor publicó el frame
+    uint64_t readTimeNs = 0;     // Instante en que terminó la lectura (mismo reloj)
+};
+
+// Worker de ingesta. open/read del lector ocurren en su propio hilo; el
+// resto de la API está pensada para un único hilo consumidor (el de render).
+class IngestWorker {
+public:
+    IngestWorker() = default;
+
+    // Detiene el hilo si sigue en marcha.
+    ~IngestWorker();
+
+    IngestWorker(const IngestWorker&) = delete;
+    IngestWorker& operator=(const IngestWorker&) = delete;
+
+    // Asigna la memoria de un slot. Debe llamarse para todos los slots antes
+    // de start(). Con el hilo en marcha, solo para un slot tomado con
+    // takeUpdates y aún no devuelto: así se atiende una petición de
+    // crecimiento (requiredBytes > 0), que exige capacity >= requiredBytes.
+    // La memoria anterior deja de usarse en cuanto se llama.
+    void setSlotMemory(uint32_t index, uint8_t* data, size_t capacity);
+
+    // Fija una función que el worker llama, desde su hilo, cada vez que deja
+    // una actualización en la cola de publicación; por ejemplo, para despertar un bucle que
+    // solo dibuja bajo demanda. Debe fijarse antes de start().
+    void setPublishNotifier(std::function<void()> notifier) { publishNotifier = std::move(notifier); }
+
+    // Arranca y detiene el hilo de ingesta. El worker se conecta a la memoria
+    // compartida por su cuenta y reintenta mientras el escritor no exista.
+    void start();
+    void stop();
+
+    // Vacía la cola de publicación y escribe en outSlots, en orden, los slots
+    // que hay que aplicar: desde el último frame completo (o todos, si solo
+    // hay parciales) hasta el más reciente. Los anteriores ya no hacen falta
+    // y vuelven al worker sin pasar por el llamador. Devuelve cuántos slots
+    // escribió (como mucho IngestWorkerSlotCount); cada uno pertenece al
+    // llamador hasta releaseSlot.
+    uint32_t takeUpdates(int32_t* outSlots);
+
+    // Acceso de solo lectura a un slot tomado con takeUpdates.
+    const IngestSlot& getSlot(int32_t index) const { return slots[index]; }
+
+    // Devuelve al worker un slot tomado, cuando su memoria ya puede
+    // reescribirse (la GPU terminó de copiarla).
+    void releaseSlot(int32_t index);
+
+    // Entrega el recorrido medido de un frame para que el worker lo devuelva
+    // al escritor. Si el worker aún no envió el anterior, lo sustituye.
+    void publishLatency(const SharedGeometryLatency& latency);
+
+private:
+    // Intervalo de reintento de open() y tope de espera por notificación:
+    // también acota cuánto tarda el worker en ver un slot devuelto.
+    static constexpr uint32_t OpenRetryMs = 100;
+    static constexpr uint32_t WaitTimeoutMs = 16;
+
+    // Bucle del hilo de ingesta.
+    void run();
+
+    // Recoge los slots devueltos por el hilo de render.
+    void reclaimReturnedSlots();
+
+    // Intenta leer un frame en un slot libre y publicarlo, o pedir un slot
+    // mayor si no cabe. Devuelve true si publicó algo.
+    bool ingestOnce();
+
+    // Copia al bloque de control el último recorrido entregado, si lo hay.
+    void forwardLatency();
+
+    IngestSlot slots[IngestWorkerSlotCount];
+    SharedGeometryReader reader;
+    SharedGeometryUpdate update{};
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::function<void()> publishNotifier;
+
+    // Slots libres, solo accedidos por el worker.
+    int32_t freeSlots[IngestWorkerSlotCount] = {};
+    uint32_t freeSlotCount = 0;
+
+    // Slot enviado como petición de crecimiento (-1 = ninguno). Hasta que
+    // vuelve no se lee nada: el frame que no cabía sigue en el anillo.
+    int32_t growingSlot = -1;
+
+    // Anillo SPSC de publicación (worker → render). Como el de retorno, cada
+    // slot está como mucho una vez en él.
+    int32_t publishRing[IngestWorkerSlotCount] = {};
+    alignas(64) std::atomic<uint64_t> publishHead{ 0 }; // Consumidos (render)
+    alignas(64) std::atomic<uint64_t> publishTail{ 0 }; // Producidos (worker)
+
+    // Anillo SPSC de retorno (render → worker). Cada slot está como mucho una
+    // vez en el anillo, así que IngestWorkerSlotCount entradas bastan.
+    int32_t returnRing[IngestWorkerSlotCount] = {};
+    alignas(64) std::atomic<uint64_t> returnHead{ 0 }; // Consumidos (worker)
+    alignas(64) std::atomic<uint64_t> returnTail{ 0 }; // Producidos (render)
+
+    // Último recorrido pendiente de devolver al escritor (render → worker).
+    std::mutex latencyMutex;
+    SharedGeometryLatency pendingLatency{};
+    bool latencyPending = false;
+};
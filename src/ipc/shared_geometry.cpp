@@ -1,13 +1,17 @@
 ﻿// =============================================================================
 // shared_geometry.cpp
 // Implementación del lector de memoria compartida (SharedGeometryReader).
-// Usa el protocolo seqlock para leer datos de forma lock-free desde la
-// memoria compartida escrita por el proceso geometry_writer.
+// Consume frames del anillo SPSC de forma lock-free desde la memoria
+// compartida escrita por el proceso geometry_writer, mapeando bajo demanda
+// el segmento de datos de cada slot.
 // =============================================================================
 
 #include "ipc/shared_geometry.hpp"
-#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstring>
+#include <thread>
 
 // -----------------------------------------------------------------------------
 // Destructor: cierra la conexión a la memoria compartida si está abierta.
@@ -18,191 +22,488 @@ SharedGeometryReader::~SharedGeometryReader() {
 
 // -----------------------------------------------------------------------------
 // open: abre la memoria compartida creada por el proceso escritor.
-// Usa OpenFileMappingW con permisos de lectura y escritura (la escritura es
-// necesaria para actualizar consumerSequence, que confirma al escritor que
-// la geometría fue procesada).
-// Si la memoria aún no existe (el escritor no se ha iniciado), retorna false.
+// El mapeo principal se abre con permisos de lectura y escritura (la
+// escritura es necesaria para avanzar readIndex, que devuelve los slots al
+// escritor). Si la memoria aún no existe (el escritor no se ha iniciado),
+// retorna false. Si no existe el evento de notificación, el lector funciona
+// igual por sondeo.
 // -----------------------------------------------------------------------------
-bool SharedGeometryReader::open(const wchar_t* name) {
-    if (buffer) {
+bool SharedGeometryReader::open(const char* name, const char* eventName) {
+    if (region) {
         return true;
     }
 
-    mappingHandle = OpenFileMappingW(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, name);
-    if (!mappingHandle) {
+    if (!mapping.open(name, sizeof(SharedGeometryRegion), true)) {
         return false;
     }
+    region = reinterpret_cast<SharedGeometryRegion*>(mapping.data());
+    mappingName = name;
 
-    buffer = static_cast<SharedGeometryBuffer*>(MapViewOfFile(mappingHandle, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(SharedGeometryBuffer)));
-    if (!buffer) {
-        CloseHandle(mappingHandle);
-        mappingHandle = nullptr;
-        return false;
+    if (eventName) {
+        updateEvent.open(eventName);
     }
 
     return true;
 }
 
 // -----------------------------------------------------------------------------
-// close: desmapea la vista de la memoria compartida y cierra el handle del
-// objeto de mapeo de Windows. Después de llamar a close(), tryRead() retornará
-// false hasta que se llame a open() de nuevo.
+// close: desmapea las vistas de la memoria compartida y cierra el evento.
+// Después de llamar a close(), tryRead() retornará false hasta que se llame a
+// open() de nuevo.
 // -----------------------------------------------------------------------------
 void SharedGeometryReader::close() {
-    if (buffer) {
-        UnmapViewOfFile(buffer);
-        buffer = nullptr;
+    for (MappedSegment& segment : segments) {
+        unmapSegment(segment);
     }
-    if (mappingHandle) {
-        CloseHandle(mappingHandle);
-        mappingHandle = nullptr;
+    region = nullptr;
+    mapping.close();
+    updateEvent.close();
+}
+
+// -----------------------------------------------------------------------------
+// waitForUpdate: espera en el evento de notificación. Es auto-reset, así que
+// cada publicación despierta una sola espera; varias publicaciones seguidas
+// pueden colapsar en un único despertar, lo que es correcto porque tryRead
+// consume todos los frames pendientes según el modo de lectura.
+// -----------------------------------------------------------------------------
+bool SharedGeometryReader::waitForUpdate(uint32_t timeoutMs) {
+    if (!updateEvent.isOpen()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return true;
     }
+    return updateEvent.wait(timeoutMs);
 }
 
 // -----------------------------------------------------------------------------
-// tryRead: intenta leer una actualización consistente desde la memoria compartida.
-//
-// Protocolo seqlock:
-//   1. Leer la secuencia (seq1). Si es igual a la última leída o es impar
-//      (escritura en curso), abortar.
-//   2. Copiar la cabecera completa a una variable local.
-//   3. Releer la secuencia (seq2). Si seq1 != seq2 o seq2 es impar, la
-//      escritura ocurrió durante la lectura → datos inconsistentes, abortar.
-//   4. Validar magic y version para asegurar compatibilidad.
-//
-// Reconstrucción de datos:
-//   - Si hasGeometry: reconstruir un GeometryData con el binding description,
-//     attribute descriptions, topología, tipo de índice y los datos crudos
-//     de vértices e índices copiados desde la memoria compartida.
-//   - Si hasTransform: reconstruir un TransformData convirtiendo los arrays
-//     de 16 floats a matrices mat4 con glm::make_mat4.
-//
-// Confirmación:
-//   Tras una lectura exitosa, escribe la secuencia en consumerSequence con
-//   un MemoryBarrier para asegurar visibilidad. El escritor usa este valor
-//   para saber que la geometría fue procesada y puede dejar de reenviarla.
+// unmapSegment: desmapea la vista de un segmento. El mapeo desaparece cuando
+// el escritor también lo haya cerrado.
 // -----------------------------------------------------------------------------
-bool SharedGeometryReader::tryRead(SharedGeometryUpdate& outUpdate) {
-    if (!buffer) {
-        return false;
+void SharedGeometryReader::unmapSegment(MappedSegment& segment) {
+    segment.mapping.close();
+    segment.generation = 0;
+    segment.capacity = 0;
+}
+
+// -----------------------------------------------------------------------------
+// mapSegment: la tabla se lee después del load-acquire de writeIndex, así que
+// refleja el segmento con el que se escribió el frame del slot. Solo se
+// mapea la capacidad anunciada; si el mapeo real es menor, la apertura
+// falla y el frame se descarta como inválido. El segmento anterior del slot
+// se desmapea aquí: ningún frame pendiente puede seguir usándolo, porque el
+// escritor solo lo sustituye con el slot libre.
+// -----------------------------------------------------------------------------
+const SharedGeometryReader::MappedSegment* SharedGeometryReader::mapSegment(uint32_t slot) {
+    const SharedGeometrySegment& entry = region->segments[slot];
+    MappedSegment& segment = segments[slot];
+    if (segment.mapping.isOpen() && segment.generation == entry.generation && segment.capacity == entry.capacity) {
+        return &segment;
     }
 
-    // Paso 1: leer la secuencia inicial
-    uint32_t seq1 = buffer->header.sequence;
+    unmapSegment(segment);
+    if (entry.generation == 0 || entry.capacity == 0 || entry.capacity > SharedGeometryMaxSegmentBytes) {
+        return nullptr;
+    }
 
-    // Si no ha cambiado o la escritura está en curso (impar), no hay datos nuevos
-    if (seq1 == lastSequence || (seq1 & 1u) != 0) {
-        return false;
+    const std::string name = sharedGeometrySegmentName(mappingName.c_str(), slot, entry.generation);
+    if (!segment.mapping.open(name.c_str(), static_cast<size_t>(entry.capacity), false)) {
+        return nullptr;
     }
+    segment.generation = entry.generation;
+    segment.capacity = entry.capacity;
+    return &segment;
+}
 
-    // Paso 2: copiar la cabecera a memoria local para lectura atómica
-    const SharedGeometryHeader header = buffer->header;
+// -----------------------------------------------------------------------------
+// Resultado de extraer la geometría de los frames consumidos.
+// -----------------------------------------------------------------------------
+enum class GeometryReadResult {
+    Read,      // Geometría copiada al destino
+    Invalid,   // Alguna cabecera describe una geometría fuera de los límites
+    Deferred   // El destino no tiene espacio; reintentar más tarde
+};
 
-    // Paso 3: verificar que la secuencia no cambió durante la copia
-    uint32_t seq2 = buffer->header.sequence;
-    if (seq1 != seq2 || (seq2 & 1u) != 0) {
+// -----------------------------------------------------------------------------
+// Frame consumido por una lectura: su cabecera y su segmento ya mapeado.
+// -----------------------------------------------------------------------------
+struct FrameView {
+    const SharedGeometryHeader* header = nullptr;
+    const uint8_t* data = nullptr;
+    uint64_t capacity = 0;
+};
+
+// Bytes de cada flujo de la geometría completa, indexados por GeometryStream.
+using StreamBytes = std::array<size_t, 3>;
+
+// Tope de rangos de una lectura parcial: todos los de los frames consumidos.
+constexpr uint32_t MaxReadDirtyRanges = SharedGeometrySlotCount * SharedGeometryMaxDirtyRanges;
+
+// -----------------------------------------------------------------------------
+// fitsInSegment: true si [offset, offset + bytes) cae dentro de capacity
+// bytes. Escrito para que un offset corrupto no desborde la suma.
+// -----------------------------------------------------------------------------
+static bool fitsInSegment(uint64_t offset, uint64_t bytes, uint64_t capacity) {
+    return offset <= capacity && bytes <= capacity - offset;
+}
+
+// -----------------------------------------------------------------------------
+// frameStreamBytes: valida el layout de la cabecera y calcula los bytes de
+// cada flujo de la geometría completa que describe. Devuelve false si el
+// layout es inválido.
+// -----------------------------------------------------------------------------
+static bool frameStreamBytes(const SharedGeometryHeader& header, StreamBytes& bytes) {
+    // Validar que el número de atributos esté dentro del rango permitido
+    if (header.attributeCount == 0 || header.attributeCount > SharedGeometryMaxAttributes) {
         return false;
     }
 
-    // Paso 4: validar magic y versión del protocolo
-    if (header.magic != SharedGeometryMagic || header.version != SharedGeometryVersion) {
+    // Calcular y validar el tamaño de los datos de vértices
+    bytes[0] = static_cast<size_t>(header.vertexCount) * header.vertexStride;
+    if (bytes[0] == 0) {
         return false;
     }
 
-    const bool hasGeometry = header.hasGeometry != 0;
-    const bool hasTransform = header.hasTransform != 0;
+    // Tamaño de los datos de índices y de las transformaciones por instancia
+    bytes[1] = 0;
+    if (header.indexCount > 0) {
+        const uint32_t indexStride = (header.indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
+        bytes[1] = static_cast<size_t>(header.indexCount) * indexStride;
+    }
+    bytes[2] = static_cast<size_t>(header.instanceCount) * sizeof(glm::mat4);
+    return true;
+}
 
-    // Si no hay ni geometría ni transformación, no hay nada útil que procesar
-    if (!hasGeometry && !hasTransform) {
+// -----------------------------------------------------------------------------
+// sameGeometry: un frame parcial solo puede aplicarse sobre una geometría con
+// los mismos flujos (mismos conteos, stride y tipo de índice).
+// -----------------------------------------------------------------------------
+static bool sameGeometry(const SharedGeometryHeader& a, const SharedGeometryHeader& b) {
+    return a.vertexStride == b.vertexStride && a.vertexCount == b.vertexCount &&
+        a.indexCount == b.indexCount && a.indexType == b.indexType && a.instanceCount == b.instanceCount;
+}
+
+// -----------------------------------------------------------------------------
+// validDirtyRanges: cada rango de un frame parcial debe caer dentro de su
+// flujo y sus bytes, dentro del segmento del frame.
+// -----------------------------------------------------------------------------
+static bool validDirtyRanges(const FrameView& frame, const StreamBytes& bytes) {
+    const SharedGeometryHeader& header = *frame.header;
+    if (header.dirtyRangeCount == 0 || header.dirtyRangeCount > SharedGeometryMaxDirtyRanges) {
         return false;
     }
 
-    // --- Reconstrucción de la geometría ---
-    if (hasGeometry) {
-        // Validar que el número de atributos esté dentro del rango permitido
-        if (header.attributeCount == 0 || header.attributeCount > SharedGeometryMaxAttributes) {
+    for (uint32_t i = 0; i < header.dirtyRangeCount; i++) {
+        const SharedDirtyRange& range = header.dirtyRanges[i];
+        if (range.stream > static_cast<uint32_t>(GeometryStream::Instance) || range.size == 0 ||
+            !fitsInSegment(range.offset, range.size, bytes[range.stream]) ||
+            !fitsInSegment(range.dataOffset, range.size, frame.capacity)) {
             return false;
         }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// fillLayout: reconstruye en geometry el binding description, attribute
+// descriptions, topología, tipo de índice, conteos, esfera envolvente y
+// decodificación de la posición. Los vectores de datos no se tocan.
+// -----------------------------------------------------------------------------
+static void fillLayout(const SharedGeometryHeader& header, const StreamBytes& bytes, GeometryData& geometry) {
+    geometry.bindingDescription.binding = header.bindingDescription.binding;
+    geometry.bindingDescription.stride = header.bindingDescription.stride;
+    geometry.bindingDescription.inputRate = static_cast<VkVertexInputRate>(header.bindingDescription.inputRate);
+    geometry.topology = static_cast<VkPrimitiveTopology>(header.topology);
+    geometry.indexType = static_cast<VkIndexType>(header.indexType);
+
+    // Convertir los atributos serializados (uint32_t planos) a
+    // VkVertexInputAttributeDescription (con enums de Vulkan correctos)
+    geometry.attributeDescriptions.clear();
+    geometry.attributeDescriptions.reserve(header.attributeCount);
+    for (uint32_t i = 0; i < header.attributeCount; i++) {
+        VkVertexInputAttributeDescription attr{};
+        attr.location = header.attributes[i].location;
+        attr.binding = header.attributes[i].binding;
+        attr.format = static_cast<VkFormat>(header.attributes[i].format);
+        attr.offset = header.attributes[i].offset;
+        geometry.attributeDescriptions.push_back(attr);
+    }
+
+    geometry.vertexCount = header.vertexCount;
+    geometry.indexCount = (bytes[1] > 0) ? header.indexCount : 0;
+    geometry.instanceCount = header.instanceCount;
+    geometry.boundingSphere = glm::vec4(header.boundingSphere[0], header.boundingSphere[1],
+        header.boundingSphere[2], header.boundingSphere[3]);
+    geometry.positionScale = glm::vec3(header.positionScale[0], header.positionScale[1], header.positionScale[2]);
+    geometry.positionOffset = glm::vec3(header.positionOffset[0], header.positionOffset[1], header.positionOffset[2]);
+}
+
+// -----------------------------------------------------------------------------
+// readFullFrames: frames[0] es un frame completo y los siguientes, parciales
+// sobre él. Copia la geometría completa a la memoria que proporciona
+// destination (una única copia en la CPU), aplica encima los rangos de los
+// parciales en orden y toma la metadata del más reciente.
+// -----------------------------------------------------------------------------
+static GeometryReadResult readFullFrames(const FrameView* frames, uint32_t frameCount, GeometryData& geometry,
+    const SharedGeometryDestination& destination) {
+    const SharedGeometryHeader& base = *frames[0].header;
+    StreamBytes bytes;
+    if (!frameStreamBytes(base, bytes)) {
+        return GeometryReadResult::Invalid;
+    }
+
+    const uint64_t offsets[3] = { base.vertexOffset, base.indexOffset, base.instanceOffset };
+    for (uint32_t stream = 0; stream < 3; stream++) {
+        if (bytes[stream] > 0 && !fitsInSegment(offsets[stream], bytes[stream], frames[0].capacity)) {
+            return GeometryReadResult::Invalid;
+        }
+    }
+    for (uint32_t i = 1; i < frameCount; i++) {
+        if (!sameGeometry(base, *frames[i].header) || !validDirtyRanges(frames[i], bytes)) {
+            return GeometryReadResult::Invalid;
+        }
+    }
+
+    // Pedir la memoria destino y copiar en ella los datos crudos
+    uint8_t* dst[3] = {};
+    if (!destination(bytes[0], bytes[1], bytes[2], dst[0], dst[1], dst[2])) {
+        return GeometryReadResult::Deferred;
+    }
+    for (uint32_t stream = 0; stream < 3; stream++) {
+        if (bytes[stream] > 0) {
+            std::memcpy(dst[stream], frames[0].data + offsets[stream], bytes[stream]);
+        }
+    }
+    for (uint32_t i = 1; i < frameCount; i++) {
+        const SharedGeometryHeader& header = *frames[i].header;
+        for (uint32_t r = 0; r < header.dirtyRangeCount; r++) {
+            const SharedDirtyRange& range = header.dirtyRanges[r];
+            std::memcpy(dst[range.stream] + range.offset, frames[i].data + range.dataOffset, range.size);
+        }
+    }
+
+    fillLayout(*frames[frameCount - 1].header, bytes, geometry);
+    return GeometryReadResult::Read;
+}
+
+// -----------------------------------------------------------------------------
+// readDirtyFrames: todos los frames son parciales. Une sus rangos por flujo
+// (ordenados por offset, un rango que toca o solapa al anterior lo amplía),
+// pide a destination los bytes empaquetados de cada flujo y copia en ellos
+// los rangos de cada frame en orden, así que donde dos se solapan queda el
+// más reciente. Cada byte unido proviene de algún frame, porque los rangos
+// unidos son exactamente la unión de los originales.
+// -----------------------------------------------------------------------------
+static GeometryReadResult readDirtyFrames(const FrameView* frames, uint32_t frameCount, SharedGeometryUpdate& outUpdate,
+    const SharedGeometryDestination& destination) {
+    const SharedGeometryHeader& latest = *frames[frameCount - 1].header;
+    StreamBytes bytes;
+    if (!frameStreamBytes(latest, bytes)) {
+        return GeometryReadResult::Invalid;
+    }
+
+    std::array<GeometryDirtyRange, MaxReadDirtyRanges> ranges;
+    uint32_t rangeCount = 0;
+    for (uint32_t i = 0; i < frameCount; i++) {
+        const SharedGeometryHeader& header = *frames[i].header;
+        if (!sameGeometry(latest, header) || !validDirtyRanges(frames[i], bytes)) {
+            return GeometryReadResult::Invalid;
+        }
+        for (uint32_t r = 0; r < header.dirtyRangeCount; r++) {
+            const SharedDirtyRange& range = header.dirtyRanges[r];
+            ranges[rangeCount++] = { static_cast<GeometryStream>(range.stream), range.offset, range.size };
+        }
+    }
+
+    auto rangeOrder = [](const GeometryDirtyRange& a, const GeometryDirtyRange& b) {
+        return (a.stream != b.stream) ? a.stream < b.stream : a.offset < b.offset;
+    };
+    std::sort(ranges.begin(), ranges.begin() + rangeCount, rangeOrder);
+
+    std::vector<GeometryDirtyRange>& merged = outUpdate.dirtyRanges;
+    merged.clear();
+    for (uint32_t i = 0; i < rangeCount; i++) {
+        const GeometryDirtyRange& range = ranges[i];
+        if (!merged.empty() && merged.back().stream == range.stream && range.offset <= merged.back().offset + merged.back().size) {
+            GeometryDirtyRange& last = merged.back();
+            last.size = std::max(last.offset + last.size, range.offset + range.size) - last.offset;
+        }
+        else {
+            merged.push_back(range);
+        }
+    }
+
+    // Posición de cada rango unido dentro de los bytes empaquetados de su flujo
+    std::array<uint64_t, MaxReadDirtyRanges> packedOffsets;
+    StreamBytes packedBytes{};
+    for (size_t i = 0; i < merged.size(); i++) {
+        const uint32_t stream = static_cast<uint32_t>(merged[i].stream);
+        packedOffsets[i] = packedBytes[stream];
+        packedBytes[stream] += static_cast<size_t>(merged[i].size);
+    }
+
+    uint8_t* dst[3] = {};
+    if (!destination(packedBytes[0], packedBytes[1], packedBytes[2], dst[0], dst[1], dst[2])) {
+        merged.clear();
+        return GeometryReadResult::Deferred;
+    }
+
+    for (uint32_t i = 0; i < frameCount; i++) {
+        const SharedGeometryHeader& header = *frames[i].header;
+        for (uint32_t r = 0; r < header.dirtyRangeCount; r++) {
+            const SharedDirtyRange& range = header.dirtyRanges[r];
+            const GeometryDirtyRange key{ static_cast<GeometryStream>(range.stream), range.offset, range.size };
+            const size_t target = static_cast<size_t>(std::upper_bound(merged.begin(), merged.end(), key, rangeOrder) - merged.begin()) - 1;
+            std::memcpy(dst[range.stream] + packedOffsets[target] + (range.offset - merged[target].offset),
+                frames[i].data + range.dataOffset, range.size);
+        }
+    }
+
+    fillLayout(latest, bytes, outUpdate.geometry);
+    return GeometryReadResult::Read;
+}
 
-        // Calcular y validar el tamaño de los datos de vértices
-        const size_t vertexBytes = static_cast<size_t>(header.vertexCount) * header.vertexStride;
-        if (vertexBytes == 0 || vertexBytes > SharedGeometryMaxVertexBytes) {
+// -----------------------------------------------------------------------------
+// tryRead: intenta consumir frames pendientes del anillo compartido.
+//
+// Protocolo:
+//   1. Validar magic, versión y número de slots del bloque de control.
+//   2. Leer readIndex (solo lo escribe este lector) y writeIndex con
+//      semántica acquire: todo lo que el escritor escribió en los slots
+//      antes de publicar es visible a partir de aquí.
+//   3. Elegir los frames a consumir: el más antiguo en modo Sequential, o
+//      todos los pendientes en modo Latest.
+//   4. Buscar hacia atrás, desde el último, el frame completo más reciente
+//      (o el primero consumido, si todos son parciales), comprobando que la
+//      secuencia de cada slot corresponde al frame esperado (detecta un
+//      escritor de otra versión o una memoria corrupta).
+//   5. Mapear los segmentos de esos frames (si su generación cambió) y
+//      extraer la geometría: la completa con los parciales posteriores
+//      aplicados, o la unión de los parciales.
+//   6. Devolver los slots al escritor con un store-release de readIndex.
+//
+// Si destination no puede aceptar la geometría, no se consume nada y los
+// mismos frames se vuelven a ofrecer en la siguiente llamada. Una geometría
+// inválida, o cuyo segmento no se puede mapear, se descarta, pero sus frames
+// se consumen igualmente para no bloquear el anillo.
+// -----------------------------------------------------------------------------
+bool SharedGeometryReader::tryRead(SharedGeometryUpdate& outUpdate, const SharedGeometryDestination& destination) {
+    if (!region) {
+        return false;
+    }
+
+    // Paso 1: validar el bloque de control
+    SharedGeometryControl& control = region->control;
+    if (control.magic != SharedGeometryMagic || control.version != SharedGeometryVersion ||
+        control.slotCount != SharedGeometrySlotCount) {
+        return false;
+    }
+
+    // Paso 2: leer los contadores del anillo
+    const uint64_t readIndex = control.readIndex.load(std::memory_order_relaxed);
+    const uint64_t writeIndex = control.writeIndex.load(std::memory_order_acquire);
+    if (writeIndex == readIndex) {
+        return false;
+    }
+    if (writeIndex < readIndex || writeIndex - readIndex > SharedGeometrySlotCount) {
+        // Contadores incoherentes (p. ej. el escritor se reinició): descartar
+        // lo pendiente y sincronizarse con el escritor.
+        control.readIndex.store(writeIndex, std::memory_order_release);
+        return false;
+    }
+
+    // Paso 3: rango de frames [readIndex, lastFrame] que consume esta lectura
+    const uint64_t lastFrame = (readMode == SharedGeometryReadMode::Latest) ? writeIndex - 1 : readIndex;
+
+    // Paso 4: primer frame que hay que extraer y secuencias de los slots
+    uint64_t firstFrame = lastFrame;
+    while (true) {
+        const SharedGeometryHeader& header = region->headers[firstFrame % SharedGeometrySlotCount];
+        if (header.sequence.load(std::memory_order_acquire) != firstFrame + 1) {
+            control.readIndex.store(writeIndex, std::memory_order_release);
             return false;
         }
+        if (header.dirtyRangeCount == 0 || firstFrame == readIndex) {
+            break;
+        }
+        firstFrame--;
+    }
 
-        // Calcular y validar el tamaño de los datos de índices
-        size_t indexBytes = 0;
-        if (header.indexCount > 0) {
-            const uint32_t indexStride = (header.indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
-            indexBytes = static_cast<size_t>(header.indexCount) * indexStride;
-            if (indexBytes > SharedGeometryMaxIndexBytes) {
-                return false;
-            }
-        }
-
-        // Reconstruir GeometryData a partir de los datos serializados
-        GeometryData geometry{};
-        geometry.bindingDescription.binding = header.bindingDescription.binding;
-        geometry.bindingDescription.stride = header.bindingDescription.stride;
-        geometry.bindingDescription.inputRate = static_cast<VkVertexInputRate>(header.bindingDescription.inputRate);
-        geometry.topology = static_cast<VkPrimitiveTopology>(header.topology);
-        geometry.indexType = static_cast<VkIndexType>(header.indexType);
-
-        // Convertir los atributos serializados (uint32_t planos) a
-        // VkVertexInputAttributeDescription (con enums de Vulkan correctos)
-        geometry.attributeDescriptions.clear();
-        geometry.attributeDescriptions.reserve(header.attributeCount);
-        for (uint32_t i = 0; i < header.attributeCount; i++) {
-            VkVertexInputAttributeDescription attr{};
-            attr.location = header.attributes[i].location;
-            attr.binding = header.attributes[i].binding;
-            attr.format = static_cast<VkFormat>(header.attributes[i].format);
-            attr.offset = header.attributes[i].offset;
-            geometry.attributeDescriptions.push_back(attr);
-        }
-
-        // Copiar los datos crudos de vértices desde la memoria compartida
-        geometry.vertexData.resize(vertexBytes);
-        std::memcpy(geometry.vertexData.data(), buffer->vertexData, vertexBytes);
-        geometry.vertexCount = header.vertexCount;
-
-        // Copiar los datos crudos de índices (si existen)
-        if (indexBytes > 0) {
-            geometry.indexData.resize(indexBytes);
-            std::memcpy(geometry.indexData.data(), buffer->indexData, indexBytes);
-            geometry.indexCount = header.indexCount;
-        }
-
-        outUpdate.geometry = std::move(geometry);
-        outUpdate.hasGeometry = true;
-    }
-    else {
-        outUpdate.hasGeometry = false;
-    }
-
-    // --- Reconstrucción de la transformación ---
-    if (hasTransform) {
-        // Convertir arrays de 16 floats (column-major) a matrices mat4 de GLM
-        TransformData transform{};
-        transform.model = glm::make_mat4(header.model);
-        transform.view = glm::make_mat4(header.view);
-        transform.proj = glm::make_mat4(header.proj);
-        outUpdate.transform = transform;
-        outUpdate.hasTransform = true;
-    }
-    else {
-        outUpdate.hasTransform = false;
-    }
-
-    // Registrar la secuencia leída para no reprocesar los mismos datos
-    outUpdate.sequence = seq1;
-    lastSequence = seq1;
-
-    // Confirmar al escritor que la geometría fue procesada.
-    // MemoryBarrier asegura que la escritura de consumerSequence sea visible
-    // para el otro proceso antes de que éste lea el valor.
-    MemoryBarrier();
-    buffer->header.consumerSequence = seq1;
+    // Paso 5: mapeo de los segmentos y reconstrucción de la geometría
+    FrameView frames[SharedGeometrySlotCount];
+    const uint32_t frameCount = static_cast<uint32_t>(lastFrame - firstFrame + 1);
+    GeometryReadResult result = GeometryReadResult::Read;
+    for (uint32_t i = 0; i < frameCount && result == GeometryReadResult::Read; i++) {
+        const uint32_t slot = static_cast<uint32_t>((firstFrame + i) % SharedGeometrySlotCount);
+        const MappedSegment* segment = mapSegment(slot);
+        if (segment) {
+            frames[i] = { &region->headers[slot], segment->mapping.data(), segment->capacity };
+        }
+        else {
+            result = GeometryReadResult::Invalid;
+        }
+    }
+    if (result == GeometryReadResult::Read) {
+        if (frames[0].header->dirtyRangeCount == 0) {
+            outUpdate.dirtyRanges.clear();
+            result = readFullFrames(frames, frameCount, outUpdate.geometry, destination);
+        }
+        else {
+            result = readDirtyFrames(frames, frameCount, outUpdate, destination);
+        }
+    }
+    if (result == GeometryReadResult::Deferred) {
+        return false;
+    }
+    outUpdate.hasGeometry = result == GeometryReadResult::Read;
+    outUpdate.mergedFrames = outUpdate.hasGeometry ? frameCount - 1 : 0;
+    outUpdate.publishTimeNs = region->headers[lastFrame % SharedGeometrySlotCount].publishTimeNs;
 
-    return true;
-}
\ No newline at end of file
+    // Paso 6: liberar los slots consumidos. El release garantiza que las
+    // lecturas anteriores terminan antes de que el escritor los reutilice.
+    outUpdate.sequence = lastFrame + 1;
+    control.readIndex.store(lastFrame + 1, std::memory_order_release);
+
+    return outUpdate.hasGeometry;
+}
+
+// -----------------------------------------------------------------------------
+// tryRead: variante que copia los datos crudos a los vectores de
+// outUpdate.geometry, redimensionándolos al tamaño de la actualización (en
+// una lectura parcial, al de sus rangos empaquetados).
+// -----------------------------------------------------------------------------
+bool SharedGeometryReader::tryRead(SharedGeometryUpdate& outUpdate) {
+    return tryRead(outUpdate, [&outUpdate](size_t vertexBytes, size_t indexBytes, size_t instanceBytes,
+        uint8_t*& vertexDst, uint8_t*& indexDst, uint8_t*& instanceDst) {
+        outUpdate.geometry.vertexData.resize(vertexBytes);
+        outUpdate.geometry.indexData.resize(indexBytes);
+        outUpdate.geometry.instanceData.resize(instanceBytes);
+        vertexDst = outUpdate.geometry.vertexData.data();
+        indexDst = outUpdate.geometry.indexData.data();
+        instanceDst = outUpdate.geometry.instanceData.data();
+        return true;
+    });
+}
+
+// -----------------------------------------------------------------------------
+// publishLatency: escribe el recorrido entre una secuencia impar y la
+// siguiente par. Solo este lector escribe latencySequence, así que basta un
+// load relaxed; la barrera release impide que el payload se adelante a la
+// marca de escritura en curso.
+// -----------------------------------------------------------------------------
+void SharedGeometryReader::publishLatency(const SharedGeometryLatency& latency) {
+    if (!region) {
+        return;
+    }
+
+    SharedGeometryControl& control = region->control;
+    if (control.magic != SharedGeometryMagic || control.version != SharedGeometryVersion) {
+        return;
+    }
+
+    const uint64_t seq = control.latencySequence.load(std::memory_order_relaxed);
+    control.latencySequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    control.latency = latency;
+
+    control.latencySequence.store(seq + 2, std::memory_order_release);
+}
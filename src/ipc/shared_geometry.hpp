@@ -1,37 +1,106 @@
 ﻿// =============================================================================
 // shared_geometry.hpp
 // Sistema de comunicación inter-proceso (IPC) basado en memoria compartida
-// para transferir geometría y transformaciones entre el proceso escritor
-// (geometry_writer) y el proceso lector (la aplicación Vulkan).
+// para transferir geometría entre el proceso escritor (geometry_writer) y el
+// proceso lector (la aplicación Vulkan). Las transformaciones viajan por un
+// canal propio (shared_transforms.hpp), de modo que esta región solo se
+// toca cuando se publica geometría nueva.
 //
-// Protocolo de sincronización: Seqlock
-// ────────────────────────────────────
-// El escritor incrementa un número de secuencia a un valor impar antes de
-// escribir, y a un valor par cuando termina. El lector verifica que la
-// secuencia sea par y no haya cambiado durante la lectura, garantizando
-// consistencia sin mutex (lock-free).
+// Protocolo de sincronización: anillo SPSC (versión 9)
+// ────────────────────────────────────────────────────
+// El anillo tiene SharedGeometrySlotCount slots. Cada slot es una cabecera
+// en el mapeo principal que apunta a su propio segmento, donde están los
+// datos crudos del frame; la cabecera no los lleva en línea (ver Segmentos
+// de datos). Un bloque de control lleva dos contadores de 64 bits que nunca
+// se reinician: writeIndex (frames publicados) y readIndex (frames
+// consumidos). El frame n vive en el slot n % SharedGeometrySlotCount.
+//   - El escritor solo escribe en un slot libre (writeIndex - readIndex <
+//     SharedGeometrySlotCount), fija su secuencia a n + 1 y publica con un
+//     store-release de writeIndex = n + 1.
+//   - El lector hace load-acquire de writeIndex, lee los frames pendientes y
+//     los devuelve al escritor con un store-release de readIndex.
+// Como el escritor nunca toca un slot que el lector no ha liberado, no hay
+// lecturas rotas ni reintentos: el lector puede consumir todos los frames en
+// orden o saltar directamente al más reciente.
+//
+// Latencia de extremo a extremo (desde la versión 6)
+// ──────────────────────────────────────────────────
+// El escritor sella cada frame con su instante de publicación
+// (publishTimeNs, en el reloj de FrameProfiler::timestampNanoseconds, común
+// a todos los procesos). El renderer mide contra él cuándo leyó el frame,
+// cuándo terminó su subida a la GPU y cuándo se presentó, y devuelve esas
+// latencias en el bloque de control con un seqlock (latencySequence), para
+// que el productor pueda adaptar su ritmo de envío.
+//
+// Atributos cuantizados (desde la versión 7)
+// ──────────────────────────────────────────
+// Los atributos pueden usar cualquier formato que la GPU acepte como vertex
+// buffer, incluidos los normalizados (p. ej. QuantizedVertex: posición
+// R16G16B16A16_SNORM y color R8G8B8A8_UNORM, 12 bytes por vértice en lugar
+// de 24). La cabecera lleva la escala y el offset con que el vertex shader
+// devuelve la posición normalizada a espacio local; con posiciones float son
+// (1, 1, 1) y (0, 0, 0). En el mismo espacio caben el doble de vértices.
+//
+// Segmentos de datos (desde la versión 8)
+// ───────────────────────────────────────
+// El mapeo principal solo contiene el bloque de control, la tabla de
+// segmentos y las cabeceras de los slots (unos pocos KB). Los datos crudos
+// de cada slot viven en un mapeo propio, su segmento, cuyo nombre deriva del
+// mapeo principal, del slot y de una generación (ver
+// sharedGeometrySegmentName). El escritor dimensiona cada segmento según la
+// geometría que publica: si un frame no cabe, crea un segmento mayor con la
+// generación siguiente y actualiza la tabla antes de publicarlo. El lector
+// compara la generación de la tabla con la del segmento que tiene mapeado y
+// vuelve a mapear si cambió. Como el escritor solo toca (y solo hace crecer)
+// slots ya liberados, el lector nunca pierde un segmento que esté leyendo.
+// Una malla pequeña mapea poco; una grande solo está limitada por
+// SharedGeometryMaxSegmentBytes, que es un tope de validación y no un tamaño
+// reservado.
+//
+// Frames parciales (desde la versión 9)
+// ─────────────────────────────────────
+// Un frame puede traer solo los rangos de bytes que cambiaron respecto al
+// anterior (dirtyRangeCount > 0): su cabecera repite el layout y los conteos
+// de la geometría completa, y cada rango indica su flujo, su offset en él y
+// dónde están sus bytes en el segmento. Un frame parcial se aplica sobre la
+// geometría que dejó el anterior, así que el lector nunca lo descarta: en
+// modo Latest, si consume varios frames, funde los parciales posteriores al
+// último completo sobre este, o, si no hay ninguno completo, une sus rangos
+// en un único frame parcial (el más reciente gana donde se solapen).
 //
 // Estructura de la memoria compartida:
+//   Mapeo principal (SharedGeometryMappingName)
 //   ┌──────────────────────────────────┐
-//   │ SharedGeometryHeader             │  Metadata + matrices de transformación
+//   │ SharedGeometryControl            │  magic, versión, writeIndex, readIndex,
+//   │                                  │  latencias devueltas por el lector
 //   ├──────────────────────────────────┤
-//   │ vertexData[4 MB]                 │  Datos crudos de vértices
+//   │ segments[N]                      │  Generación y capacidad del segmento
+//   │                                  │  de cada slot
 //   ├──────────────────────────────────┤
-//   │ indexData[2 MB]                  │  Datos crudos de índices
+//   │ headers[N]                       │  Layout, instancias, esfera
+//   │                                  │  envolvente y offsets en el segmento
+//   └──────────────────────────────────┘
+//   Segmento de un slot (<nombre>.Segment<slot>.<generación>)
+//   ┌──────────────────────────────────┐
+//   │ vértices | índices | instancias  │  Datos crudos, cada flujo alineado a
+//   │                                  │  SharedGeometrySegmentAlignment
 //   └──────────────────────────────────┘
 //
 // Límites:
 //   - Máximo 8 atributos de vértice por malla
-//   - Máximo 4 MB de datos de vértices
-//   - Máximo 2 MB de datos de índices
+//   - Máximo 1 GB por segmento (vértices + índices + instancias de un frame)
 // =============================================================================
 
 #pragma once
 
 #include "geometry/mesh.hpp"
-#include "geometry/transform.hpp"
-#include <windows.h>
+#include "ipc/shared_memory.hpp"
+#include "profiling/frame_profiler.hpp"
 #include <cstdint>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
 
 // Constante mágica "GEOM" (en little-endian) para validar que la memoria
 // compartida contiene datos válidos y no basura.
@@ -39,16 +108,41 @@ constexpr uint32_t SharedGeometryMagic = 0x4D4F4547;
 
 // Versión del protocolo. Si el escritor y el lector tienen versiones
 // diferentes, el lector descarta los datos para evitar incompatibilidades.
-constexpr uint32_t SharedGeometryVersion = 1;
+constexpr uint32_t SharedGeometryVersion = 9;
+
+// Número de slots del anillo. Permite absorber ráfagas del productor sin
+// perder frames mientras el renderer está ocupado.
+constexpr uint32_t SharedGeometrySlotCount = 4;
 
-// Límites de capacidad de la memoria compartida.
+// Límites de la memoria compartida. El tope de un segmento solo protege al
+// lector de una tabla corrupta: cada segmento mide lo que pide el escritor.
 constexpr size_t SharedGeometryMaxAttributes = 8;
-constexpr size_t SharedGeometryMaxVertexBytes = 4 * 1024 * 1024;
-constexpr size_t SharedGeometryMaxIndexBytes = 2 * 1024 * 1024;
+constexpr uint64_t SharedGeometryMaxSegmentBytes = uint64_t(1) << 30;
+
+// Alineación de cada flujo (vértices, índices, instancias) dentro de un
+// segmento. Basta para cualquier formato de atributo o índice.
+constexpr uint64_t SharedGeometrySegmentAlignment = 16;
+
+// Máximo de rangos sucios de un frame parcial. Un productor con más cambios
+// puede unir rangos cercanos o enviar un frame completo.
+constexpr uint32_t SharedGeometryMaxDirtyRanges = 32;
+
+// Nombre del mapeo de memoria compartida (shared_memory.hpp le añade el
+// prefijo de cada sistema). Ambos procesos deben usar el mismo nombre.
+constexpr char SharedGeometryMappingName[] = "VulkanSharedGeometry";
 
-// Nombre del mapeo de memoria compartida en el espacio de nombres local
-// de la sesión de Windows. Ambos procesos deben usar el mismo nombre.
-constexpr wchar_t SharedGeometryMappingName[] = L"Local\\VulkanSharedGeometry";
+// Nombre del evento de notificación (auto-reset) que el escritor señaliza
+// cada vez que publica algo, ya sea un frame de geometría o un cambio en el
+// canal de transformaciones. Permite al lector bloquearse en lugar de sondear.
+constexpr char SharedGeometryEventName[] = "VulkanSharedGeometryEvent";
+
+// Nombre del segmento de datos de un slot en una generación dada. Una
+// generación nueva es un mapeo nuevo: el anterior desaparece cuando ambos
+// procesos lo cierran (en POSIX, el escritor lo desvincula al sustituirlo),
+// sin que el lector tenga que coordinarse con nadie.
+inline std::string sharedGeometrySegmentName(const char* mappingName, uint32_t slot, uint64_t generation) {
+    return std::string(mappingName) + ".Segment" + std::to_string(slot) + "." + std::to_string(generation);
+}
 
 // Versión serializable de VkVertexInputBindingDescription, usando uint32_t
 // planos para evitar dependencias de tipos de Vulkan en la estructura compartida.
@@ -66,80 +160,210 @@ struct SharedAttributeDescription {
     uint32_t offset;   // Offset en bytes dentro del vértice
 };
 
-// Cabecera de la memoria compartida. Contiene toda la metadata necesaria
-// para reconstruir un GeometryData y un TransformData en el lado del lector.
+// Rango sucio de un frame parcial.
+struct SharedDirtyRange {
+    uint32_t stream;      // GeometryStream: 0 = vértices, 1 = índices, 2 = instancias
+    uint32_t padding;
+    uint64_t offset;      // Offset en el flujo de la geometría completa
+    uint64_t size;        // Bytes del rango
+    uint64_t dataOffset;  // Posición de sus bytes en el segmento del slot
+};
+
+// Los contadores se comparten entre procesos, así que deben ser atómicos
+// sin lock (un lock interno viviría en la memoria de un solo proceso).
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "IPC ring counters must be lock-free");
+
+// Cabecera de un slot. Contiene toda la metadata necesaria para reconstruir
+// un GeometryData en el lado del lector.
 struct SharedGeometryHeader {
-    uint32_t magic;           // Debe ser SharedGeometryMagic para ser válido
-    uint32_t version;         // Versión del protocolo
-    uint32_t sequence;        // Número de secuencia del seqlock (par = estable)
-    uint32_t hasGeometry;     // 1 si esta actualización incluye geometría nueva
-    uint32_t hasTransform;    // 1 si esta actualización incluye transformación
+    std::atomic<uint64_t> sequence; // Frame publicado en el slot + 1 (0 = nunca usado)
     uint32_t vertexStride;    // Bytes por vértice
     uint32_t vertexCount;     // Número de vértices
     uint32_t indexCount;      // Número de índices (0 = sin índices)
     uint32_t indexType;       // VK_INDEX_TYPE_UINT16 o VK_INDEX_TYPE_UINT32
     uint32_t topology;        // VkPrimitiveTopology (ej: TRIANGLE_LIST)
     uint32_t attributeCount;  // Número de atributos de vértice (máx 8)
+    uint32_t instanceCount;   // Matrices mat4 por instancia (0 = sin instancias)
+    uint64_t publishTimeNs;   // Instante de publicación (FrameProfiler::timestampNanoseconds)
+
+    // Posición de cada flujo dentro del segmento del slot, en bytes. Los
+    // tamaños se deducen de los conteos y del stride.
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t instanceOffset;
+
+    // Frame parcial: rangos que cambian respecto al frame anterior. Con
+    // dirtyRangeCount = 0 el frame es completo y los offsets de arriba
+    // describen la geometría entera; si no, se ignoran.
+    uint32_t dirtyRangeCount;
+    uint32_t dirtyPadding;
+    SharedDirtyRange dirtyRanges[SharedGeometryMaxDirtyRanges];
 
     // Descripción del layout de vértices
     SharedBindingDescription bindingDescription;
     SharedAttributeDescription attributes[SharedGeometryMaxAttributes];
 
-    // Matrices de transformación almacenadas como arrays de 16 floats
-    // en orden column-major (compatible con GLM).
-    float model[16];
-    float view[16];
-    float proj[16];
+    // Esfera envolvente en espacio local (x, y, z, radio), que cubre todas
+    // las instancias. El escritor ya tiene los datos en CPU, así que la
+    // calcula él; el lector copia los datos directamente a staging y no
+    // vuelve a recorrerlos. Radio negativo = desconocida (el renderer no
+    // descarta el objeto en el culling).
+    float boundingSphere[4];
 
-    // Secuencia confirmada por el consumidor. El escritor la compara con
-    // su propia secuencia para saber si el lector ya procesó la geometría,
-    // y así dejar de reenviarla en cada frame.
-    uint32_t consumerSequence;
+    // Decodificación de la posición (location 0): posición local =
+    // atributo × positionScale + positionOffset. Ver GeometryData.
+    float positionScale[3];
+    float positionOffset[3];
 };
 
-// Estructura completa de la memoria compartida: cabecera + datos crudos.
-struct SharedGeometryBuffer {
-    SharedGeometryHeader header;
-    uint8_t vertexData[SharedGeometryMaxVertexBytes]; // Vértices en formato crudo
-    uint8_t indexData[SharedGeometryMaxIndexBytes];    // Índices en formato crudo
+// Entrada de la tabla de segmentos: el mapeo que contiene los datos crudos
+// de un slot. Solo cambia mientras el slot está libre, antes del
+// store-release de writeIndex que publica el frame que lo usa.
+struct SharedGeometrySegment {
+    uint64_t generation;      // Generación del mapeo (0 = el slot aún no tiene segmento)
+    uint64_t capacity;        // Bytes mapeables del segmento
+};
+
+// Recorrido de un frame publicado, medido por el lector. Las latencias se
+// cuentan desde publishTimeNs; 0 = etapa aún no alcanzada.
+struct SharedGeometryLatency {
+    uint64_t sequence;          // Secuencia del frame medido (su sequence de cabecera)
+    uint64_t readLatencyNs;     // Publicación → lectura del slot
+    uint64_t uploadLatencyNs;   // Publicación → fin de la subida a la GPU
+    uint64_t presentLatencyNs;  // Publicación → presentación (motion-to-photon)
+};
+
+// Bloque de control del anillo. Cada contador ocupa su propia línea de caché
+// para que el escritor y el lector no se disputen la misma línea.
+// latency va en sentido inverso: la escribe el lector y la lee el escritor,
+// con el mismo seqlock que shared_transforms.hpp (latencySequence impar
+// durante la escritura).
+struct SharedGeometryControl {
+    uint32_t magic;           // Debe ser SharedGeometryMagic para ser válido
+    uint32_t version;         // Versión del protocolo
+    uint32_t slotCount;       // Debe coincidir con SharedGeometrySlotCount
+    alignas(64) std::atomic<uint64_t> writeIndex; // Frames publicados (escritor)
+    alignas(64) std::atomic<uint64_t> readIndex;  // Frames consumidos (lector)
+    alignas(64) std::atomic<uint64_t> latencySequence; // Seqlock de latency (lector)
+    SharedGeometryLatency latency;                // Último frame presentado
+};
+
+// Mapeo principal: control + tabla de segmentos + cabeceras de los slots.
+// El frame n usa segments[n % SharedGeometrySlotCount] y la cabecera del
+// mismo índice.
+struct SharedGeometryRegion {
+    SharedGeometryControl control;
+    alignas(64) SharedGeometrySegment segments[SharedGeometrySlotCount];
+    alignas(64) SharedGeometryHeader headers[SharedGeometrySlotCount];
 };
 
 // Resultado de una lectura exitosa desde la memoria compartida.
-// Contiene la geometría y/o transformación extraída, junto con banderas
-// que indican cuáles de los dos están presentes.
+// Pensado para reutilizarse entre lecturas: tryRead solo redimensiona los
+// vectores de geometry, que conservan su capacidad de una actualización a
+// la siguiente (salvo que el llamador los mueva fuera).
 struct SharedGeometryUpdate {
     GeometryData geometry;       // Datos de geometría reconstruidos
-    TransformData transform;     // Matrices de transformación reconstruidas
-    bool hasGeometry = false;    // true si esta actualización incluye geometría
-    bool hasTransform = false;   // true si esta actualización incluye transformación
-    uint32_t sequence = 0;       // Secuencia de la lectura para tracking
+    std::vector<GeometryDirtyRange> dirtyRanges; // Vacío = geometría completa
+    bool hasGeometry = false;    // true si la lectura trajo una geometría válida
+    uint64_t sequence = 0;       // Número de frames consumidos tras esta lectura
+    uint32_t mergedFrames = 0;   // Frames parciales consumidos y fundidos en este (modo Latest)
+    uint64_t publishTimeNs = 0;  // Instante de publicación del frame leído
+};
+
+// Proporciona la memoria destino de los datos crudos de una lectura. Recibe
+// los tamaños de vértices, índices e instancias y devuelve en vertexDst,
+// indexDst e instanceDst dónde copiarlos (los dos últimos se ignoran si su
+// tamaño es 0). En una lectura parcial, los tamaños son los de los rangos
+// sucios de cada flujo, empaquetados (ver GeometryDirtyRange). Permite al llamador
+// recibir los bytes directamente en su memoria final, como el staging del
+// renderer. Si devuelve false, la lectura se pospone sin consumir la
+// actualización.
+using SharedGeometryDestination = std::function<bool(size_t vertexBytes, size_t indexBytes, size_t instanceBytes,
+    uint8_t*& vertexDst, uint8_t*& indexDst, uint8_t*& instanceDst)>;
+
+// Modo de consumo del anillo:
+//   - Sequential: cada lectura consume exactamente un frame, en orden, sin
+//     perder ninguno.
+//   - Latest: cada lectura consume todos los frames pendientes y devuelve
+//     solo el más reciente; los anteriores ya han sido sustituidos (los
+//     parciales, fundidos en él).
+enum class SharedGeometryReadMode {
+    Sequential,
+    Latest
 };
 
 // Lector de geometría compartida. Abre la memoria compartida creada por
-// el proceso escritor y lee actualizaciones de forma lock-free usando seqlock.
+// el proceso escritor y consume frames del anillo de forma lock-free.
 class SharedGeometryReader {
 public:
     SharedGeometryReader() = default;
 
+    // Fija el modo de consumo (por defecto, Sequential).
+    void setReadMode(SharedGeometryReadMode mode) { readMode = mode; }
+
     // Cierra la conexión a la memoria compartida al destruir el lector.
     ~SharedGeometryReader();
 
     // Abre la memoria compartida por nombre. Devuelve true si la conexión
     // se estableció correctamente. Si el escritor aún no la ha creado,
     // devuelve false (se puede reintentar más tarde).
-    bool open(const wchar_t* name = SharedGeometryMappingName);
+    // También abre el evento de notificación, si el escritor lo creó; sin él,
+    // el lector sigue funcionando por sondeo.
+    bool open(const char* name = SharedGeometryMappingName, const char* eventName = SharedGeometryEventName);
 
-    // Cierra la vista de la memoria compartida y el handle del mapeo.
+    // Cierra las vistas de la memoria compartida (mapeo principal y
+    // segmentos) y el evento de notificación.
     void close();
 
+    // Bloquea hasta que el escritor publique algo o pase timeoutMs. Devuelve
+    // true si hubo notificación (hay que sondear los canales) y false si
+    // expiró el timeout. Sin evento de notificación, espera el timeout y
+    // devuelve true, degradando a un sondeo periódico.
+    bool waitForUpdate(uint32_t timeoutMs);
+
+    // true si el escritor ofrece evento de notificación.
+    bool hasUpdateEvent() const { return updateEvent.isOpen(); }
+
     // Intenta leer una actualización de la memoria compartida.
     // Devuelve true si se leyeron datos nuevos y consistentes.
-    // Devuelve false si no hay datos nuevos, la escritura está en curso
-    // (secuencia impar), o los datos son inválidos.
+    // Devuelve false si no hay frames pendientes, si la memoria no contiene
+    // un anillo válido de esta versión, o si los frames consumidos no traían
+    // nada utilizable.
+    // Los datos crudos se copian a los vectores de outUpdate.geometry. Si
+    // outUpdate.dirtyRanges no queda vacío, la lectura es parcial: los
+    // vectores traen solo los bytes de esos rangos y los conteos son los de
+    // la geometría completa a la que se aplican.
     bool tryRead(SharedGeometryUpdate& outUpdate);
 
+    // Como tryRead, pero copiando los datos crudos a la memoria que devuelve
+    // destination; outUpdate.geometry solo recibe la metadata y los conteos.
+    // Si destination rechaza la lectura, los frames no se consumen y se
+    // vuelven a ofrecer en la siguiente llamada.
+    bool tryRead(SharedGeometryUpdate& outUpdate, const SharedGeometryDestination& destination);
+
+    // Devuelve al escritor el recorrido medido de un frame. No hace nada si
+    // la memoria no está abierta o no es un anillo válido de esta versión.
+    void publishLatency(const SharedGeometryLatency& latency);
+
 private:
-    HANDLE mappingHandle = nullptr;           // Handle del mapeo de memoria de Windows
-    SharedGeometryBuffer* buffer = nullptr;   // Puntero al buffer mapeado
-    uint32_t lastSequence = 0;                // Última secuencia leída exitosamente
+    // Segmento de un slot tal como lo tiene mapeado este lector.
+    struct MappedSegment {
+        SharedMemoryMapping mapping;
+        uint64_t generation = 0;
+        uint64_t capacity = 0;
+    };
+
+    // Devuelve el segmento del slot con la generación que indica la tabla,
+    // volviendo a mapearlo si cambió. nullptr si no se puede mapear.
+    const MappedSegment* mapSegment(uint32_t slot);
+
+    // Desmapea el segmento de un slot.
+    void unmapSegment(MappedSegment& segment);
+
+    SharedMemoryMapping mapping;              // Mapeo principal
+    SharedEvent updateEvent;                  // Evento de notificación (opcional)
+    SharedGeometryRegion* region = nullptr;   // Puntero al mapeo principal
+    std::string mappingName;                  // Base de los nombres de los segmentos
+    MappedSegment segments[SharedGeometrySlotCount];
+    SharedGeometryReadMode readMode = SharedGeometryReadMode::Sequential;
 };
\ No newline at end of file
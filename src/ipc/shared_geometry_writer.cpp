@@ -0,0 +1,331 @@
+﻿// =============================================================================
+// shared_geometry_writer.cpp
+// Implementación del escritor del anillo de geometría compartida
+// (SharedGeometryWriter): segmentos por slot, frames completos y parciales y
+// lectura de las latencias devueltas por el lector.
+// =============================================================================
+
+#include "ipc/shared_geometry_writer.hpp"
+#include <algorithm>
+#include <cstring>
+
+// Capacidad mínima de un segmento: una malla pequeña no mapea más que esto.
+// Los segmentos se redondean a este tamaño al crecer.
+constexpr uint64_t MinSegmentBytes = 64 * 1024;
+
+// A partir de este tamaño (una página grande de x86-64), los segmentos se
+// crean pidiendo páginas grandes: menos fallos de TLB al copiar mallas de
+// cientos de MB. Por debajo, el redondeo a páginas grandes desperdiciaría
+// más memoria de la que ahorra.
+constexpr uint64_t HugePageSegmentBytes = 2 * 1024 * 1024;
+
+// Redondea al alineamiento de los flujos dentro de un segmento.
+static uint64_t alignToSegment(uint64_t value) {
+    return (value + SharedGeometrySegmentAlignment - 1) & ~(SharedGeometrySegmentAlignment - 1);
+}
+
+// -----------------------------------------------------------------------------
+// Destructor: cierra la memoria compartida si está abierta.
+// -----------------------------------------------------------------------------
+SharedGeometryWriter::~SharedGeometryWriter() {
+    close();
+}
+
+// -----------------------------------------------------------------------------
+// open: solo se mapea la región de control; los segmentos se crean al
+// publicar. El control se inicializa vacío y magic se escribe al final, tras
+// una barrera, para que el lector nunca vea un control a medio inicializar.
+// La tabla de segmentos queda a cero: ningún slot tiene segmento aún.
+// -----------------------------------------------------------------------------
+bool SharedGeometryWriter::open(const char* name, const char* eventName) {
+    close();
+
+    if (mapping.create(name, sizeof(SharedGeometryRegion)) != SharedMemoryStatus::Created) {
+        return false;
+    }
+    if (!updateEvent.create(eventName)) {
+        mapping.close();
+        return false;
+    }
+    region = reinterpret_cast<SharedGeometryRegion*>(mapping.data());
+    mappingName = name;
+    lastLatencySequence = 0;
+
+    std::memset(static_cast<void*>(region), 0, sizeof(SharedGeometryRegion));
+    region->control.version = SharedGeometryVersion;
+    region->control.slotCount = SharedGeometrySlotCount;
+    std::atomic_thread_fence(std::memory_order_release);
+    region->control.magic = SharedGeometryMagic;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// close: los segmentos se crearon exclusivos, así que al cerrarlos este
+// proceso los desvincula (en POSIX); un lector que aún los tenga mapeados
+// los sigue viendo hasta que cambie de generación.
+// -----------------------------------------------------------------------------
+void SharedGeometryWriter::close() {
+    for (auto& segment : segments) {
+        segment.mapping.close();
+        segment.generation = 0;
+        segment.capacity = 0;
+    }
+    region = nullptr;
+    mapping.close();
+    updateEvent.close();
+}
+
+// -----------------------------------------------------------------------------
+// ensureSegment: si el segmento del slot no tiene requiredBytes, crea uno con
+// la generación siguiente y el doble de capacidad (o lo que haga falta),
+// sustituye al anterior y lo anota en la tabla; el lector lo descubre con el
+// frame que se publique a continuación. Solo se llama con el slot libre, así
+// que el lector no puede estar leyendo el segmento que se cierra. Si ya
+// existe un mapeo con ese nombre (un lector que aún retiene el de un
+// escritor anterior, o en POSIX el que dejó un escritor que no llegó a
+// desvincularlo), se salta a la generación siguiente: reutilizarlo mezclaría
+// datos de dos escritores.
+// Devuelve false si requiredBytes supera el tope del protocolo o si el mapeo
+// no se pudo crear.
+// -----------------------------------------------------------------------------
+bool SharedGeometryWriter::ensureSegment(uint32_t slot, uint64_t requiredBytes) {
+    WriterSegment& segment = segments[slot];
+    if (segment.mapping.isOpen() && segment.capacity >= requiredBytes) {
+        return true;
+    }
+    if (requiredBytes > SharedGeometryMaxSegmentBytes) {
+        return false;
+    }
+
+    uint64_t capacity = std::max({ requiredBytes, 2 * segment.capacity, MinSegmentBytes });
+    capacity = std::min((capacity + MinSegmentBytes - 1) / MinSegmentBytes * MinSegmentBytes, SharedGeometryMaxSegmentBytes);
+
+    WriterSegment grown;
+    grown.generation = segment.generation;
+    SharedMemoryStatus status = SharedMemoryStatus::AlreadyExists;
+    while (status == SharedMemoryStatus::AlreadyExists) {
+        grown.generation++;
+        const std::string name = sharedGeometrySegmentName(mappingName.c_str(), slot, grown.generation);
+        status = grown.mapping.create(name.c_str(), static_cast<size_t>(capacity), true, capacity >= HugePageSegmentBytes);
+    }
+    if (status != SharedMemoryStatus::Created) {
+        return false;
+    }
+    grown.capacity = capacity;
+
+    segment = std::move(grown);
+
+    region->segments[slot].generation = segment.generation;
+    region->segments[slot].capacity = segment.capacity;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// fillHeader: los conteos se deducen de los tamaños de los flujos, así que
+// una geometría recién construida no necesita tenerlos al día. Es común a
+// los frames completos y a los parciales, que repiten la misma metadata.
+// -----------------------------------------------------------------------------
+void SharedGeometryWriter::fillHeader(SharedGeometryHeader& header, const GeometryData& geometry) {
+    const uint32_t stride = geometry.bindingDescription.stride;
+    const size_t indexSize = (geometry.indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
+    header.vertexStride = stride;
+    header.vertexCount = static_cast<uint32_t>(geometry.vertexData.size() / stride);
+    header.indexCount = static_cast<uint32_t>(geometry.indexData.size() / indexSize);
+    header.indexType = geometry.indexType;
+    header.topology = geometry.topology;
+    header.instanceCount = static_cast<uint32_t>(geometry.instanceData.size() / sizeof(glm::mat4));
+
+    // Descripción del binding y de los atributos, tal como los define la malla
+    header.attributeCount = static_cast<uint32_t>(geometry.attributeDescriptions.size());
+    header.bindingDescription.binding = geometry.bindingDescription.binding;
+    header.bindingDescription.stride = stride;
+    header.bindingDescription.inputRate = geometry.bindingDescription.inputRate;
+    for (uint32_t i = 0; i < header.attributeCount; i++) {
+        const VkVertexInputAttributeDescription& attribute = geometry.attributeDescriptions[i];
+        header.attributes[i].location = attribute.location;
+        header.attributes[i].binding = attribute.binding;
+        header.attributes[i].format = attribute.format;
+        header.attributes[i].offset = attribute.offset;
+    }
+
+    // Decodificación de la posición (identidad salvo con vértices cuantizados)
+    for (int axis = 0; axis < 3; axis++) {
+        header.positionScale[axis] = geometry.positionScale[axis];
+        header.positionOffset[axis] = geometry.positionOffset[axis];
+    }
+
+    // Esfera envolvente para el frustum culling del renderer
+    header.boundingSphere[0] = geometry.boundingSphere.x;
+    header.boundingSphere[1] = geometry.boundingSphere.y;
+    header.boundingSphere[2] = geometry.boundingSphere.z;
+    header.boundingSphere[3] = geometry.boundingSphere.w;
+}
+
+// -----------------------------------------------------------------------------
+// acquireSlot: solo este proceso escribe writeIndex; readIndex se lee con
+// acquire para que el lector haya terminado con el slot antes de
+// sobrescribirlo.
+// -----------------------------------------------------------------------------
+bool SharedGeometryWriter::acquireSlot(uint32_t& slot, uint64_t& writeIndex) const {
+    writeIndex = region->control.writeIndex.load(std::memory_order_relaxed);
+    const uint64_t readIndex = region->control.readIndex.load(std::memory_order_acquire);
+    if (writeIndex - readIndex >= SharedGeometrySlotCount) {
+        return false;
+    }
+    slot = static_cast<uint32_t>(writeIndex % SharedGeometrySlotCount);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// publish: el instante de publicación se sella lo más tarde posible, para
+// que la latencia medida no incluya la preparación del payload. El release
+// de writeIndex hace visible al lector todo el payload anterior.
+// -----------------------------------------------------------------------------
+void SharedGeometryWriter::publish(uint32_t slot, uint64_t writeIndex) {
+    SharedGeometryHeader& header = region->headers[slot];
+    header.publishTimeNs = FrameProfiler::timestampNanoseconds();
+    header.sequence.store(writeIndex + 1, std::memory_order_release);
+    region->control.writeIndex.store(writeIndex + 1, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------
+// write: los flujos se empaquetan en el segmento del slot, cada uno alineado
+// a SharedGeometrySegmentAlignment, haciéndolo crecer si hace falta.
+// -----------------------------------------------------------------------------
+bool SharedGeometryWriter::write(const GeometryData& geometry) {
+    if (!region || geometry.bindingDescription.stride == 0 ||
+        geometry.attributeDescriptions.size() > SharedGeometryMaxAttributes) {
+        return false;
+    }
+
+    uint32_t slot = 0;
+    uint64_t writeIndex = 0;
+    if (!acquireSlot(slot, writeIndex)) {
+        return false;
+    }
+
+    // Posición de cada flujo en el segmento y tamaño total del frame
+    const uint64_t vertexBytes = geometry.vertexData.size();
+    const uint64_t indexBytes = geometry.indexData.size();
+    const uint64_t instanceBytes = geometry.instanceData.size();
+    const uint64_t indexOffset = alignToSegment(vertexBytes);
+    const uint64_t instanceOffset = alignToSegment(indexOffset + indexBytes);
+    if (!ensureSegment(slot, instanceOffset + instanceBytes)) {
+        return false;
+    }
+    uint8_t* segmentData = segments[slot].mapping.data();
+    SharedGeometryHeader& header = region->headers[slot];
+
+    fillHeader(header, geometry);
+    header.vertexOffset = 0;
+    header.indexOffset = indexOffset;
+    header.instanceOffset = instanceOffset;
+    header.dirtyRangeCount = 0;
+
+    // Copiar datos crudos de vértices, índices e instancias al segmento
+    std::memcpy(segmentData, geometry.vertexData.data(), vertexBytes);
+    if (indexBytes > 0) {
+        std::memcpy(segmentData + indexOffset, geometry.indexData.data(), indexBytes);
+    }
+    if (instanceBytes > 0) {
+        std::memcpy(segmentData + instanceOffset, geometry.instanceData.data(), instanceBytes);
+    }
+
+    publish(slot, writeIndex);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// writeRanges: los rangos se empaquetan en el segmento del slot, cada uno
+// alineado a SharedGeometrySegmentAlignment. Un rango vacío o fuera de su
+// flujo no se publica: el lector lo rechazaría igualmente.
+// -----------------------------------------------------------------------------
+bool SharedGeometryWriter::writeRanges(const GeometryData& geometry, const std::vector<GeometryDirtyRange>& ranges) {
+    if (!region || geometry.bindingDescription.stride == 0 ||
+        geometry.attributeDescriptions.size() > SharedGeometryMaxAttributes ||
+        ranges.empty() || ranges.size() > SharedGeometryMaxDirtyRanges) {
+        return false;
+    }
+
+    // Bytes completos de cada flujo, indexados por GeometryStream
+    const std::vector<uint8_t>* streams[3] = { &geometry.vertexData, &geometry.indexData, &geometry.instanceData };
+
+    uint64_t requiredBytes = 0;
+    for (const GeometryDirtyRange& range : ranges) {
+        const uint32_t stream = static_cast<uint32_t>(range.stream);
+        if (stream > 2 || range.size == 0 || range.offset > streams[stream]->size() ||
+            range.size > streams[stream]->size() - range.offset) {
+            return false;
+        }
+        requiredBytes = alignToSegment(requiredBytes) + range.size;
+    }
+
+    uint32_t slot = 0;
+    uint64_t writeIndex = 0;
+    if (!acquireSlot(slot, writeIndex) || !ensureSegment(slot, requiredBytes)) {
+        return false;
+    }
+    uint8_t* segmentData = segments[slot].mapping.data();
+    SharedGeometryHeader& header = region->headers[slot];
+
+    fillHeader(header, geometry);
+    header.vertexOffset = 0;
+    header.indexOffset = 0;
+    header.instanceOffset = 0;
+    header.dirtyRangeCount = static_cast<uint32_t>(ranges.size());
+
+    uint64_t dataOffset = 0;
+    for (uint32_t i = 0; i < header.dirtyRangeCount; i++) {
+        const GeometryDirtyRange& range = ranges[i];
+        dataOffset = alignToSegment(dataOffset);
+        SharedDirtyRange& dirty = header.dirtyRanges[i];
+        dirty.stream = static_cast<uint32_t>(range.stream);
+        dirty.offset = range.offset;
+        dirty.size = range.size;
+        dirty.dataOffset = dataOffset;
+        std::memcpy(segmentData + dataOffset, streams[dirty.stream]->data() + range.offset, static_cast<size_t>(range.size));
+        dataOffset += range.size;
+    }
+
+    publish(slot, writeIndex);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// readLatency: copia el recorrido entre dos lecturas de latencySequence; si
+// era impar o cambió, el lector lo estaba reescribiendo.
+// -----------------------------------------------------------------------------
+bool SharedGeometryWriter::readLatency(SharedGeometryLatency& outLatency) {
+    if (!region) {
+        return false;
+    }
+
+    SharedGeometryControl& control = region->control;
+    const uint64_t seq1 = control.latencySequence.load(std::memory_order_acquire);
+    if (seq1 == lastLatencySequence || (seq1 & 1u) != 0) {
+        return false;
+    }
+
+    SharedGeometryLatency latency = control.latency;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (control.latencySequence.load(std::memory_order_relaxed) != seq1) {
+        return false;
+    }
+
+    outLatency = latency;
+    lastLatencySequence = seq1;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// getPendingFrames: readIndex solo avanza, así que la diferencia nunca es
+// negativa.
+// -----------------------------------------------------------------------------
+uint64_t SharedGeometryWriter::getPendingFrames() const {
+    if (!region) {
+        return 0;
+    }
+    return region->control.writeIndex.load(std::memory_order_relaxed) -
+        region->control.readIndex.load(std::memory_order_acquire);
+}
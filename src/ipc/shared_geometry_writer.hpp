@@ -0,0 +1,106 @@
+﻿// =============================================================================
+// shared_geometry_writer.hpp
+// Lado escritor del anillo de geometría compartida (ver shared_geometry.hpp),
+// común a los productores del repositorio: geometry_writer y el benchmark de
+// IPC.
+//
+// Publicación de un frame:
+//   - Solo se escribe en el slot writeIndex % SharedGeometrySlotCount si el
+//     lector ya lo liberó (writeIndex - readIndex < SharedGeometrySlotCount);
+//     si el anillo está lleno, el frame no se publica y el productor decide
+//     si lo reintenta o lo sustituye por uno más reciente.
+//   - Los datos crudos van al segmento del slot. Si el frame no cabe, se crea
+//     un segmento mayor con la generación siguiente y se anota en la tabla
+//     de segmentos antes de publicar.
+//   - Tras escribir el payload se fija la secuencia del slot y se publica el
+//     frame con un store-release de writeIndex; el lector lo ve completo o
+//     no lo ve.
+//   - Cada frame lleva su instante de publicación; el lector devuelve contra
+//     él las latencias de lectura, subida y presentación (readLatency).
+// =============================================================================
+
+#pragma once
+
+#include "ipc/shared_geometry.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Escritor del anillo de geometría. Crea la memoria compartida y el evento de
+// notificación; los segmentos de datos se crean al publicar, del tamaño que
+// pida la geometría.
+class SharedGeometryWriter {
+public:
+    SharedGeometryWriter() = default;
+
+    // Cierra la memoria compartida al destruir el escritor.
+    ~SharedGeometryWriter();
+
+    SharedGeometryWriter(const SharedGeometryWriter&) = delete;
+    SharedGeometryWriter& operator=(const SharedGeometryWriter&) = delete;
+
+    // Crea el mapeo principal (o lo reabre si ya existe, para que un lector
+    // que sigue conectado vea al nuevo escritor sin reabrirlo) y el evento de
+    // notificación, y deja el anillo vacío. Devuelve false si alguno falla.
+    bool open(const char* name = SharedGeometryMappingName, const char* eventName = SharedGeometryEventName);
+
+    // Cierra los segmentos, el mapeo principal y el evento.
+    void close();
+
+    bool isOpen() const { return region != nullptr; }
+
+    // Publica un frame completo con los flujos de geometry (vértices,
+    // índices e instancias) y su metadata. boundingSphere debe envolver ya
+    // todas las instancias, como en cualquier GeometryData. Devuelve false
+    // sin publicar nada si el anillo está lleno, si el layout no cabe en una
+    // cabecera o si el frame no cabe en un segmento.
+    bool write(const GeometryData& geometry);
+
+    // Publica un frame parcial con solo los bytes de ranges, tomados de los
+    // flujos completos de geometry. La cabecera repite la metadata completa,
+    // que el lector compara con la de la geometría sobre la que los aplica.
+    // Devuelve false sin publicar nada en los mismos casos que write, o si
+    // ranges está vacío o supera SharedGeometryMaxDirtyRanges.
+    bool writeRanges(const GeometryData& geometry, const std::vector<GeometryDirtyRange>& ranges);
+
+    // Despierta al lector que esté esperando en waitForUpdate. Varias
+    // señales sin espera intermedia cuentan como una.
+    void notify() { updateEvent.signal(); }
+
+    // Lee con el seqlock el último recorrido que devolvió el lector. Devuelve
+    // false si no hay ninguno nuevo desde la última lectura o si la copia no
+    // es consistente (basta con reintentar más tarde).
+    bool readLatency(SharedGeometryLatency& outLatency);
+
+    // Frames publicados que el lector aún no ha consumido.
+    uint64_t getPendingFrames() const;
+
+private:
+    // Segmento de datos de un slot, tal como lo tiene creado el escritor.
+    struct WriterSegment {
+        SharedMemoryMapping mapping;
+        uint64_t generation = 0;
+        uint64_t capacity = 0;
+    };
+
+    // Garantiza que el segmento del slot tenga al menos requiredBytes.
+    bool ensureSegment(uint32_t slot, uint64_t requiredBytes);
+
+    // Escribe en la cabecera el layout, los conteos, la decodificación de la
+    // posición y la esfera envolvente de geometry.
+    static void fillHeader(SharedGeometryHeader& header, const GeometryData& geometry);
+
+    // Devuelve en slot y writeIndex el slot libre en el que publicar el
+    // siguiente frame, o false si el anillo está lleno.
+    bool acquireSlot(uint32_t& slot, uint64_t& writeIndex) const;
+
+    // Sella el instante de publicación y publica el frame writeIndex.
+    void publish(uint32_t slot, uint64_t writeIndex);
+
+    SharedMemoryMapping mapping;              // Mapeo principal
+    SharedEvent updateEvent;                  // Evento de notificación
+    SharedGeometryRegion* region = nullptr;   // Puntero al mapeo principal
+    std::string mappingName;                  // Base de los nombres de los segmentos
+    WriterSegment segments[SharedGeometrySlotCount];
+    uint64_t lastLatencySequence = 0;         // Última secuencia del seqlock de latencias leída
+};
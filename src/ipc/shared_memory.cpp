@@ -0,0 +1,331 @@
+﻿// =============================================================================
+// shared_memory.cpp
+// Backends de la capa de memoria compartida: Win32 (mapeos de archivo y
+// eventos con nombre) y POSIX (shm_open/mmap y semáforos con nombre).
+// =============================================================================
+
+#include "ipc/shared_memory.hpp"
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// -----------------------------------------------------------------------------
+// backendName: traduce un nombre portable al espacio de nombres del backend.
+// Los nombres son ASCII, así que en Windows basta con ensanchar cada carácter.
+// -----------------------------------------------------------------------------
+#ifdef _WIN32
+static std::wstring backendName(const char* name) {
+    std::wstring result = L"Local\\";
+    for (const char* c = name; *c; c++) {
+        result.push_back(static_cast<wchar_t>(*c));
+    }
+    return result;
+}
+#else
+static std::string backendName(const char* name) {
+    return std::string("/") + name;
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Destructor y movimiento: el objeto movido queda cerrado, sin nada que
+// desmapear ni desvincular.
+// -----------------------------------------------------------------------------
+SharedMemoryMapping::~SharedMemoryMapping() {
+    close();
+}
+
+SharedMemoryMapping::SharedMemoryMapping(SharedMemoryMapping&& other) noexcept
+    : view(std::exchange(other.view, nullptr)),
+      viewSize(std::exchange(other.viewSize, 0)),
+      handle(std::exchange(other.handle, nullptr)),
+      unlinkName(std::move(other.unlinkName)) {
+    other.unlinkName.clear();
+}
+
+SharedMemoryMapping& SharedMemoryMapping::operator=(SharedMemoryMapping&& other) noexcept {
+    if (this != &other) {
+        close();
+        view = std::exchange(other.view, nullptr);
+        viewSize = std::exchange(other.viewSize, 0);
+        handle = std::exchange(other.handle, nullptr);
+        unlinkName = std::move(other.unlinkName);
+        other.unlinkName.clear();
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+// =============================================================================
+// Backend Win32
+// =============================================================================
+
+// -----------------------------------------------------------------------------
+// create: con exclusive, un mapeo que ya existía (GetLastError tras un
+// CreateFileMappingW correcto) se cierra sin mapearlo. Windows no ofrece
+// páginas grandes en mapeos compartidos sin SeLockMemoryPrivilege, así que
+// hugePages se ignora.
+// -----------------------------------------------------------------------------
+SharedMemoryStatus SharedMemoryMapping::create(const char* name, size_t size, bool exclusive, [[maybe_unused]] bool hugePages) {
+    close();
+
+    const uint64_t mappingSize = size;
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize & 0xFFFFFFFFu), backendName(name).c_str());
+    if (!mapping) {
+        return SharedMemoryStatus::Failed;
+    }
+    if (exclusive && GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mapping);
+        return SharedMemoryStatus::AlreadyExists;
+    }
+
+    view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size)));
+    if (!view) {
+        CloseHandle(mapping);
+        return SharedMemoryStatus::Failed;
+    }
+    handle = mapping;
+    viewSize = size;
+    return SharedMemoryStatus::Created;
+}
+
+// -----------------------------------------------------------------------------
+// open: si el mapeo es menor que size, MapViewOfFile falla.
+// -----------------------------------------------------------------------------
+bool SharedMemoryMapping::open(const char* name, size_t size, bool writable) {
+    close();
+
+    const DWORD access = writable ? (FILE_MAP_READ | FILE_MAP_WRITE) : FILE_MAP_READ;
+    HANDLE mapping = OpenFileMappingW(access, FALSE, backendName(name).c_str());
+    if (!mapping) {
+        return false;
+    }
+
+    view = static_cast<uint8_t*>(MapViewOfFile(mapping, access, 0, 0, static_cast<SIZE_T>(size)));
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    handle = mapping;
+    viewSize = size;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// close: el mapeo desaparece cuando el último proceso cierra su handle.
+// -----------------------------------------------------------------------------
+void SharedMemoryMapping::close() {
+    if (view) {
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+    if (handle) {
+        CloseHandle(static_cast<HANDLE>(handle));
+        handle = nullptr;
+    }
+    viewSize = 0;
+}
+
+// -----------------------------------------------------------------------------
+// SharedEvent (Win32): evento auto-reset con nombre.
+// -----------------------------------------------------------------------------
+bool SharedEvent::create(const char* name) {
+    close();
+    handle = CreateEventW(nullptr, FALSE, FALSE, backendName(name).c_str());
+    return handle != nullptr;
+}
+
+bool SharedEvent::open(const char* name) {
+    close();
+    handle = OpenEventW(SYNCHRONIZE | EVENT_MODIFY_STATE, FALSE, backendName(name).c_str());
+    return handle != nullptr;
+}
+
+void SharedEvent::close() {
+    if (handle) {
+        CloseHandle(static_cast<HANDLE>(handle));
+        handle = nullptr;
+    }
+}
+
+void SharedEvent::signal() {
+    if (handle) {
+        SetEvent(static_cast<HANDLE>(handle));
+    }
+}
+
+bool SharedEvent::wait(uint32_t timeoutMs) {
+    return handle && WaitForSingleObject(static_cast<HANDLE>(handle), timeoutMs) == WAIT_OBJECT_0;
+}
+
+#else
+
+// =============================================================================
+// Backend POSIX
+// =============================================================================
+
+// -----------------------------------------------------------------------------
+// create: el descriptor solo hace falta para dimensionar y mapear; el mapeo
+// sigue siendo válido tras cerrarlo. Un mapeo existente solo se amplía, nunca
+// se reduce: otro proceso podría tener mapeada la parte que se recortaría.
+// -----------------------------------------------------------------------------
+SharedMemoryStatus SharedMemoryMapping::create(const char* name, size_t size, bool exclusive, bool hugePages) {
+    close();
+
+    const std::string path = backendName(name);
+    const int fd = shm_open(path.c_str(), O_CREAT | O_RDWR | (exclusive ? O_EXCL : 0), 0600);
+    if (fd < 0) {
+        return (exclusive && errno == EEXIST) ? SharedMemoryStatus::AlreadyExists : SharedMemoryStatus::Failed;
+    }
+
+    struct stat info {};
+    bool sized = fstat(fd, &info) == 0;
+    if (sized && static_cast<uint64_t>(info.st_size) < size) {
+        sized = ftruncate(fd, static_cast<off_t>(size)) == 0;
+    }
+    void* mapped = sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        if (exclusive) {
+            shm_unlink(path.c_str());
+        }
+        return SharedMemoryStatus::Failed;
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (hugePages) {
+        madvise(mapped, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    view = static_cast<uint8_t*>(mapped);
+    viewSize = size;
+    if (exclusive) {
+        unlinkName = path;
+    }
+    return SharedMemoryStatus::Created;
+}
+
+// -----------------------------------------------------------------------------
+// open: mapear más allá del final del objeto no falla, pero el primer acceso
+// a esa parte provocaría SIGBUS, así que el tamaño se comprueba antes.
+// -----------------------------------------------------------------------------
+bool SharedMemoryMapping::open(const char* name, size_t size, bool writable) {
+    close();
+
+    const int fd = shm_open(backendName(name).c_str(), writable ? O_RDWR : O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info {};
+    void* mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<uint64_t>(info.st_size) >= size) {
+        mapped = mmap(nullptr, size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    view = static_cast<uint8_t*>(mapped);
+    viewSize = size;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// close: desvincular el nombre no afecta a los procesos que ya lo tienen
+// mapeado; la memoria se libera cuando el último lo desmapea.
+// -----------------------------------------------------------------------------
+void SharedMemoryMapping::close() {
+    if (view) {
+        munmap(view, viewSize);
+        view = nullptr;
+    }
+    if (!unlinkName.empty()) {
+        shm_unlink(unlinkName.c_str());
+        unlinkName.clear();
+    }
+    viewSize = 0;
+}
+
+// -----------------------------------------------------------------------------
+// SharedEvent (POSIX): semáforo con nombre. signal no incrementa un semáforo
+// ya señalizado y wait lo vacía tras despertar, como un evento auto-reset;
+// la carrera entre sem_getvalue y sem_post solo puede dejar un despertar de
+// más, que el lector trata como un sondeo sin novedades.
+// -----------------------------------------------------------------------------
+bool SharedEvent::create(const char* name) {
+    close();
+    sem_t* semaphore = sem_open(backendName(name).c_str(), O_CREAT, 0600, 0);
+    handle = (semaphore != SEM_FAILED) ? semaphore : nullptr;
+    return handle != nullptr;
+}
+
+bool SharedEvent::open(const char* name) {
+    close();
+    sem_t* semaphore = sem_open(backendName(name).c_str(), 0);
+    handle = (semaphore != SEM_FAILED) ? semaphore : nullptr;
+    return handle != nullptr;
+}
+
+void SharedEvent::close() {
+    if (handle) {
+        sem_close(static_cast<sem_t*>(handle));
+        handle = nullptr;
+    }
+}
+
+void SharedEvent::signal() {
+    sem_t* semaphore = static_cast<sem_t*>(handle);
+    int value = 0;
+    if (semaphore && (sem_getvalue(semaphore, &value) != 0 || value == 0)) {
+        sem_post(semaphore);
+    }
+}
+
+bool SharedEvent::wait(uint32_t timeoutMs) {
+    sem_t* semaphore = static_cast<sem_t*>(handle);
+    if (!semaphore) {
+        return false;
+    }
+
+    timespec deadline{};
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += static_cast<long>(timeoutMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    while (sem_timedwait(semaphore, &deadline) != 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    while (sem_trywait(semaphore) == 0) {
+    }
+    return true;
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+// Destructor de SharedEvent: común a los dos backends.
+// -----------------------------------------------------------------------------
+SharedEvent::~SharedEvent() {
+    close();
+}
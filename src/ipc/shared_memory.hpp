@@ -0,0 +1,106 @@
+﻿// =============================================================================
+// shared_memory.hpp
+// Capa de memoria compartida con nombre, común a los canales IPC y al proceso
+// geometry_writer. Aísla las llamadas del sistema operativo para que el
+// protocolo (anillos, seqlocks, segmentos) sea el mismo en todas partes:
+//   - Windows: CreateFileMappingW / OpenFileMappingW + MapViewOfFile, en el
+//     espacio de nombres local de la sesión ("Local\<nombre>").
+//   - POSIX: shm_open + ftruncate + mmap ("/<nombre>", en Linux bajo
+//     /dev/shm). Con hugePages, el mapeo pide páginas grandes transparentes
+//     (madvise MADV_HUGEPAGE); el kernel las usa si shmem_enabled lo permite.
+//
+// Los nombres son ASCII, sin separadores de ruta; cada backend les añade su
+// prefijo. Un mapeo de Windows desaparece al cerrarlo todos los procesos; uno
+// POSIX persiste hasta que se desvincula, así que el creador exclusivo de un
+// mapeo lo desvincula al cerrarlo (los procesos que ya lo tienen mapeado lo
+// siguen viendo) y los mapeos compartidos (creados sin exclusive) se dejan
+// para que el siguiente proceso los reabra, como en Windows.
+//
+// Eventos de notificación: auto-reset con nombre en Windows; semáforo con
+// nombre (sem_open) en POSIX, que signal solo incrementa si está a cero para
+// que varias señales seguidas colapsen en un único despertar.
+// =============================================================================
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Las estructuras compartidas sincronizan los dos procesos con std::atomic
+// sobre la propia memoria mapeada. Solo es válido si los atómicos no usan un
+// lock interno, que no sería visible para el otro proceso.
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory atomics must be lock-free");
+static_assert(std::atomic<int32_t>::is_always_lock_free, "Shared memory atomics must be lock-free");
+
+// Resultado de crear un mapeo.
+enum class SharedMemoryStatus {
+    Created,       // Mapeo creado (o abierto, si no era exclusivo) y mapeado
+    AlreadyExists, // Con exclusive, ya existía un mapeo con ese nombre
+    Failed         // No se pudo crear o mapear
+};
+
+// Vista de un mapeo de memoria compartida con nombre. Se cierra al destruirse.
+class SharedMemoryMapping {
+public:
+    SharedMemoryMapping() = default;
+    ~SharedMemoryMapping();
+
+    SharedMemoryMapping(const SharedMemoryMapping&) = delete;
+    SharedMemoryMapping& operator=(const SharedMemoryMapping&) = delete;
+    SharedMemoryMapping(SharedMemoryMapping&& other) noexcept;
+    SharedMemoryMapping& operator=(SharedMemoryMapping&& other) noexcept;
+
+    // Crea el mapeo con al menos size bytes y lo mapea para lectura y
+    // escritura. Sin exclusive, si ya existe se abre (y se amplía en POSIX
+    // si es menor); con exclusive, devuelve AlreadyExists sin tocarlo.
+    SharedMemoryStatus create(const char* name, size_t size, bool exclusive = false, bool hugePages = false);
+
+    // Abre un mapeo existente y mapea sus primeros size bytes. Devuelve false
+    // si no existe o es menor que size.
+    bool open(const char* name, size_t size, bool writable);
+
+    // Desmapea la vista y cierra el mapeo (desvinculándolo en POSIX si este
+    // objeto lo creó con exclusive).
+    void close();
+
+    uint8_t* data() const { return view; }
+    size_t size() const { return viewSize; }
+    bool isOpen() const { return view != nullptr; }
+
+private:
+    uint8_t* view = nullptr;
+    size_t viewSize = 0;
+    void* handle = nullptr;   // HANDLE del mapeo (solo Windows)
+    std::string unlinkName;   // Nombre a desvincular al cerrar (solo POSIX)
+};
+
+// Evento de notificación con nombre entre procesos. Se cierra al destruirse.
+class SharedEvent {
+public:
+    SharedEvent() = default;
+    ~SharedEvent();
+
+    SharedEvent(const SharedEvent&) = delete;
+    SharedEvent& operator=(const SharedEvent&) = delete;
+
+    // Crea el evento (o abre el existente) para señalizarlo.
+    bool create(const char* name);
+
+    // Abre un evento existente para esperarlo. false si no existe.
+    bool open(const char* name);
+
+    void close();
+    bool isOpen() const { return handle != nullptr; }
+
+    // Despierta a una espera. Varias señales sin espera intermedia cuentan
+    // como una sola.
+    void signal();
+
+    // Bloquea hasta la siguiente señal o timeoutMs. false si expiró.
+    bool wait(uint32_t timeoutMs);
+
+private:
+    void* handle = nullptr;   // HANDLE del evento (Windows) o sem_t* (POSIX)
+};
@@ -0,0 +1,152 @@
+﻿// =============================================================================
+// shared_profiler.cpp
+// Implementación del canal del perfilador: escritor (SharedProfilerWriter)
+// y lector (SharedProfilerReader) sincronizados con un seqlock.
+// =============================================================================
+
+#include "ipc/shared_profiler.hpp"
+#include <algorithm>
+
+// -----------------------------------------------------------------------------
+// Destructor: cierra el canal si está abierto.
+// -----------------------------------------------------------------------------
+SharedProfilerWriter::~SharedProfilerWriter() {
+    close();
+}
+
+// -----------------------------------------------------------------------------
+// open: crea el mapeo con permisos de escritura e inicializa la cabecera. Si
+// el mapeo ya existía (un renderer anterior), se reutiliza y la secuencia
+// continúa desde su valor actual, de modo que un monitor ya conectado sigue
+// viendo secuencias crecientes.
+// -----------------------------------------------------------------------------
+bool SharedProfilerWriter::open(const char* name) {
+    if (channel) {
+        return true;
+    }
+
+    if (mapping.create(name, sizeof(SharedProfilerChannel)) != SharedMemoryStatus::Created) {
+        return false;
+    }
+    channel = reinterpret_cast<SharedProfilerChannel*>(mapping.data());
+
+    // Una secuencia impar solo puede venir de un escritor que terminó a
+    // mitad de publicar; se normaliza a par.
+    const uint64_t seq = channel->sequence.load(std::memory_order_relaxed);
+    channel->sequence.store(seq + (seq & 1u), std::memory_order_relaxed);
+    channel->magic = SharedProfilerMagic;
+    channel->version = SharedProfilerVersion;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// close: desmapea la vista del canal y cierra el mapeo.
+// -----------------------------------------------------------------------------
+void SharedProfilerWriter::close() {
+    channel = nullptr;
+    mapping.close();
+}
+
+// -----------------------------------------------------------------------------
+// publish: escribe el snapshot entre una secuencia impar y la siguiente par.
+// La barrera release impide que las escrituras se adelanten a la marca de
+// escritura en curso.
+// -----------------------------------------------------------------------------
+void SharedProfilerWriter::publish(const ProfileSnapshot& snapshot) {
+    if (!channel) {
+        return;
+    }
+
+    const uint64_t seq = channel->sequence.load(std::memory_order_relaxed);
+    channel->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    channel->frameCount = snapshot.frameCount;
+    channel->uploadMegabytesPerSecond = snapshot.uploadMegabytesPerSecond;
+    channel->metricCount = ProfileMetricCount;
+    for (uint32_t i = 0; i < ProfileMetricCount; i++) {
+        const ProfileMetricStats& stats = snapshot.metrics[i];
+        SharedProfilerMetric& metric = channel->metrics[i];
+        metric.p50 = stats.p50;
+        metric.p99 = stats.p99;
+        metric.mean = stats.mean;
+        metric.max = stats.max;
+        metric.sampleCount = stats.sampleCount;
+        metric.padding = 0;
+    }
+
+    channel->sequence.store(seq + 2, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------
+// Destructor: cierra la conexión al canal si está abierta.
+// -----------------------------------------------------------------------------
+SharedProfilerReader::~SharedProfilerReader() {
+    close();
+}
+
+// -----------------------------------------------------------------------------
+// open: abre el canal creado por el renderer con permisos de solo lectura.
+// -----------------------------------------------------------------------------
+bool SharedProfilerReader::open(const char* name) {
+    if (channel) {
+        return true;
+    }
+
+    if (!mapping.open(name, sizeof(SharedProfilerChannel), false)) {
+        return false;
+    }
+    channel = reinterpret_cast<SharedProfilerChannel*>(mapping.data());
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// close: desmapea la vista del canal y cierra el mapeo.
+// -----------------------------------------------------------------------------
+void SharedProfilerReader::close() {
+    channel = nullptr;
+    mapping.close();
+}
+
+// -----------------------------------------------------------------------------
+// tryRead: lee el snapshot con el protocolo seqlock (ver
+// SharedTransformReader::tryRead). Las métricas que el escritor no publique
+// (un escritor con menos métricas) quedan a cero.
+// -----------------------------------------------------------------------------
+bool SharedProfilerReader::tryRead(ProfileSnapshot& outSnapshot) {
+    if (!channel) {
+        return false;
+    }
+
+    const uint64_t seq1 = channel->sequence.load(std::memory_order_acquire);
+    if (seq1 == lastSequence || (seq1 & 1u) != 0) {
+        return false;
+    }
+
+    if (channel->magic != SharedProfilerMagic || channel->version != SharedProfilerVersion) {
+        return false;
+    }
+
+    ProfileSnapshot snapshot{};
+    snapshot.frameCount = channel->frameCount;
+    snapshot.uploadMegabytesPerSecond = channel->uploadMegabytesPerSecond;
+    const uint32_t metricCount = std::min(channel->metricCount, ProfileMetricCount);
+    for (uint32_t i = 0; i < metricCount; i++) {
+        const SharedProfilerMetric& metric = channel->metrics[i];
+        ProfileMetricStats& stats = snapshot.metrics[i];
+        stats.p50 = metric.p50;
+        stats.p99 = metric.p99;
+        stats.mean = metric.mean;
+        stats.max = metric.max;
+        stats.sampleCount = metric.sampleCount;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (channel->sequence.load(std::memory_order_relaxed) != seq1) {
+        return false;
+    }
+
+    outSnapshot = snapshot;
+    lastSequence = seq1;
+    return true;
+}
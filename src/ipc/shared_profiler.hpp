@@ -0,0 +1,116 @@
+﻿// =============================================================================
+// shared_profiler.hpp
+// Canal IPC de estadísticas del perfilador: el renderer publica cada cierto
+// tiempo un ProfileSnapshot en memoria compartida para que un proceso de
+// monitorización lo lea sin adjuntar un depurador.
+//
+// El sentido es el inverso al de los otros canales: aquí el renderer es el
+// escritor (crea el mapeo) y el monitor es el lector. Como solo interesa el
+// estado más reciente, se usa el mismo seqlock que shared_transforms.hpp:
+// sequence impar durante la escritura y par al terminar; el lector descarta
+// la copia si la secuencia era impar o cambió mientras copiaba.
+//
+// Estructura de la memoria compartida (alineada a líneas de 64 bytes):
+//   ┌──────────────────────────────────────────┐
+//   │ magic, version                           │
+//   │ sequence (línea propia)                  │
+//   ├──────────────────────────────────────────┤
+//   │ frameCount, uploadMegabytesPerSecond,    │
+//   │ metricCount                              │
+//   │ metrics[ProfileMetricCount]              │  p50/p99/media/máx en ms
+//   └──────────────────────────────────────────┘
+// El orden de metrics es el de ProfileMetric.
+// =============================================================================
+
+#pragma once
+
+#include "ipc/shared_memory.hpp"
+#include "profiling/frame_profiler.hpp"
+#include <atomic>
+#include <cstdint>
+
+// Constante mágica "PROF" (en little-endian) para validar el canal.
+constexpr uint32_t SharedProfilerMagic = 0x464F5250;
+
+// Versión del protocolo del canal del perfilador. La 2 añade las latencias
+// de extremo a extremo de la geometría IPC y la 3, PresentWait.
+constexpr uint32_t SharedProfilerVersion = 3;
+
+// Nombre del mapeo del canal del perfilador.
+constexpr char SharedProfilerMappingName[] = "VulkanSharedProfiler";
+
+// Estadísticas de una métrica tal como viajan por el canal.
+struct SharedProfilerMetric {
+    double p50;
+    double p99;
+    double mean;
+    double max;
+    uint32_t sampleCount;
+    uint32_t padding;
+};
+
+// Región compartida del canal.
+struct SharedProfilerChannel {
+    uint32_t magic;                             // Debe ser SharedProfilerMagic
+    uint32_t version;                           // Versión del protocolo
+    alignas(64) std::atomic<uint64_t> sequence; // Seqlock: impar = escritura en curso
+    alignas(64) uint64_t frameCount;
+    double uploadMegabytesPerSecond;
+    uint32_t metricCount;                       // Entradas válidas en metrics
+    uint32_t padding;
+    SharedProfilerMetric metrics[ProfileMetricCount];
+};
+
+// Escritor del canal (lado del renderer).
+class SharedProfilerWriter {
+public:
+    SharedProfilerWriter() = default;
+
+    // Cierra el canal al destruir el escritor.
+    ~SharedProfilerWriter();
+
+    SharedProfilerWriter(const SharedProfilerWriter&) = delete;
+    SharedProfilerWriter& operator=(const SharedProfilerWriter&) = delete;
+
+    // Crea (o abre, si ya existe) el mapeo del canal. Devuelve false si no
+    // se pudo crear; el renderer sigue funcionando sin publicar.
+    bool open(const char* name = SharedProfilerMappingName);
+
+    // Desmapea la vista y cierra el mapeo.
+    void close();
+
+    // Publica el snapshot. No hace nada si el canal no está abierto.
+    void publish(const ProfileSnapshot& snapshot);
+
+private:
+    SharedMemoryMapping mapping;
+    SharedProfilerChannel* channel = nullptr;
+};
+
+// Lector del canal (lado del monitor).
+class SharedProfilerReader {
+public:
+    SharedProfilerReader() = default;
+
+    // Cierra la conexión al canal al destruir el lector.
+    ~SharedProfilerReader();
+
+    SharedProfilerReader(const SharedProfilerReader&) = delete;
+    SharedProfilerReader& operator=(const SharedProfilerReader&) = delete;
+
+    // Abre el canal por nombre. Devuelve false si el renderer aún no lo ha
+    // creado (se puede reintentar más tarde).
+    bool open(const char* name = SharedProfilerMappingName);
+
+    // Desmapea la vista y cierra el mapeo.
+    void close();
+
+    // Intenta leer el snapshot más reciente. Devuelve true solo si la
+    // secuencia cambió desde la última lectura y la copia es consistente.
+    bool tryRead(ProfileSnapshot& outSnapshot);
+
+private:
+    SharedMemoryMapping mapping;
+    SharedProfilerChannel* channel = nullptr;
+    uint64_t lastSequence = 0;
+};
@@ -0,0 +1,163 @@
+﻿// =============================================================================
+// shared_transforms.cpp
+// Implementación del lector y del escritor del canal de transformaciones
+// (SharedTransformReader, SharedTransformWriter), sincronizados con un
+// seqlock sobre atómicos.
+// =============================================================================
+
+#include "ipc/shared_transforms.hpp"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
+
+// -----------------------------------------------------------------------------
+// Destructor: cierra la conexión al canal si está abierta.
+// -----------------------------------------------------------------------------
+SharedTransformReader::~SharedTransformReader() {
+    close();
+}
+
+// -----------------------------------------------------------------------------
+// open: abre el canal creado por el proceso escritor. Solo necesita permisos
+// de lectura: el lector no publica nada en el canal.
+// -----------------------------------------------------------------------------
+bool SharedTransformReader::open(const char* name) {
+    if (channel) {
+        return true;
+    }
+
+    if (!mapping.open(name, sizeof(SharedTransformChannel), false)) {
+        return false;
+    }
+    channel = reinterpret_cast<SharedTransformChannel*>(mapping.data());
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// close: desmapea la vista del canal y cierra el mapeo.
+// -----------------------------------------------------------------------------
+void SharedTransformReader::close() {
+    channel = nullptr;
+    mapping.close();
+}
+
+// -----------------------------------------------------------------------------
+// tryRead: lee el estado del canal con el protocolo seqlock.
+//   1. Leer la secuencia (acquire). Si es impar (escritura en curso) o no ha
+//      cambiado desde la última lectura, abortar: el sondeo sin cambios
+//      cuesta una sola carga atómica.
+//   2. Validar magic y versión.
+//   3. Copiar la cámara y las matrices de los objetos en uso.
+//   4. Barrera acquire y releer la secuencia: si cambió, el escritor
+//      sobrescribió el estado durante la copia y se descarta.
+// -----------------------------------------------------------------------------
+bool SharedTransformReader::tryRead(SharedTransformUpdate& outUpdate) {
+    if (!channel) {
+        return false;
+    }
+
+    // Paso 1: leer la secuencia inicial
+    const uint64_t seq1 = channel->sequence.load(std::memory_order_acquire);
+    if (seq1 == lastSequence || (seq1 & 1u) != 0) {
+        return false;
+    }
+
+    // Paso 2: validar magic y versión del protocolo
+    if (channel->magic != SharedTransformMagic || channel->version != SharedTransformVersion) {
+        return false;
+    }
+
+    // Paso 3: copiar el estado
+    uint32_t objectCount = channel->objectCount;
+    if (objectCount > SharedTransformMaxObjects) {
+        return false;
+    }
+
+    outUpdate.view = glm::make_mat4(channel->view);
+    outUpdate.proj = glm::make_mat4(channel->proj);
+    outUpdate.models.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        outUpdate.models[i] = glm::make_mat4(channel->models[i]);
+    }
+
+    // Paso 4: verificar que la secuencia no cambió durante la copia
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (channel->sequence.load(std::memory_order_relaxed) != seq1) {
+        return false;
+    }
+
+    outUpdate.sequence = seq1;
+    lastSequence = seq1;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// objectTransform: compone el TransformData que consume el renderer a
+// partir de la matriz de modelo de un objeto y la cámara compartida.
+// -----------------------------------------------------------------------------
+TransformData SharedTransformReader::objectTransform(const SharedTransformUpdate& update, uint32_t index) {
+    TransformData transform{};
+    transform.model = update.models[index];
+    transform.view = update.view;
+    transform.proj = update.proj;
+    return transform;
+}
+
+// -----------------------------------------------------------------------------
+// Destructor del escritor: cierra el canal si está abierto.
+// -----------------------------------------------------------------------------
+SharedTransformWriter::~SharedTransformWriter() {
+    close();
+}
+
+// -----------------------------------------------------------------------------
+// open: magic se escribe al final, tras una barrera, para que el lector nunca
+// vea un canal a medio inicializar.
+// -----------------------------------------------------------------------------
+bool SharedTransformWriter::open(const char* name) {
+    close();
+
+    if (mapping.create(name, sizeof(SharedTransformChannel)) != SharedMemoryStatus::Created) {
+        return false;
+    }
+    channel = reinterpret_cast<SharedTransformChannel*>(mapping.data());
+
+    std::memset(static_cast<void*>(channel), 0, sizeof(SharedTransformChannel));
+    channel->version = SharedTransformVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    channel->magic = SharedTransformMagic;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// close: desmapea la vista del canal y cierra el mapeo.
+// -----------------------------------------------------------------------------
+void SharedTransformWriter::close() {
+    channel = nullptr;
+    mapping.close();
+}
+
+// -----------------------------------------------------------------------------
+// write: sobrescribe el estado entre una secuencia impar (escritura en
+// curso) y la siguiente par (escritura completada). La barrera release tras
+// la marca impar impide que las escrituras del payload se adelanten a ella.
+// -----------------------------------------------------------------------------
+void SharedTransformWriter::write(const glm::mat4& view, const glm::mat4& proj, const std::vector<glm::mat4>& models) {
+    if (!channel) {
+        return;
+    }
+
+    const uint64_t seq = channel->sequence.load(std::memory_order_relaxed);
+    channel->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const uint32_t objectCount = static_cast<uint32_t>(std::min<size_t>(models.size(), SharedTransformMaxObjects));
+    channel->objectCount = objectCount;
+    std::memcpy(channel->view, glm::value_ptr(view), sizeof(float) * 16);
+    std::memcpy(channel->proj, glm::value_ptr(proj), sizeof(float) * 16);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        std::memcpy(channel->models[i], glm::value_ptr(models[i]), sizeof(float) * 16);
+    }
+
+    channel->sequence.store(seq + 2, std::memory_order_release);
+}
@@ -0,0 +1,121 @@
+﻿// =============================================================================
+// shared_transforms.hpp
+// Canal IPC ligero para transformaciones, separado del anillo de geometría.
+// Las transformaciones cambian a 60+ Hz mientras que la geometría cambia
+// rara vez; con un canal propio, el sondeo de cada frame solo toca unas pocas
+// líneas de caché y la región grande de geometría solo se lee cuando publica
+// un frame nuevo.
+//
+// Protocolo de sincronización: Seqlock
+// ────────────────────────────────────
+// El canal solo guarda el estado más reciente (una transformación antigua no
+// tiene valor), así que el escritor lo sobrescribe en su sitio: lleva
+// sequence a impar antes de escribir y a par al terminar. El lector copia el
+// estado y lo descarta si la secuencia era impar o cambió durante la copia.
+// Como la copia es pequeña, reintentar en el siguiente sondeo es barato.
+//
+// Estructura de la memoria compartida (todo alineado a líneas de 64 bytes):
+//   ┌──────────────────────────────────┐
+//   │ magic, version                   │
+//   │ sequence (línea propia)          │
+//   ├──────────────────────────────────┤
+//   │ objectCount, view[16], proj[16]  │  Cámara
+//   ├──────────────────────────────────┤
+//   │ models[256][16]                  │  Una matriz de modelo por objeto
+//   └──────────────────────────────────┘
+// =============================================================================
+
+#pragma once
+
+#include "geometry/transform.hpp"
+#include "ipc/shared_memory.hpp"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Constante mágica "XFRM" (en little-endian) para validar el canal.
+constexpr uint32_t SharedTransformMagic = 0x4D524658;
+
+// Versión del protocolo del canal de transformaciones.
+constexpr uint32_t SharedTransformVersion = 1;
+
+// Número máximo de objetos con matriz de modelo propia.
+constexpr uint32_t SharedTransformMaxObjects = 256;
+
+// Nombre del mapeo del canal de transformaciones.
+constexpr char SharedTransformMappingName[] = "VulkanSharedTransforms";
+
+// Región compartida del canal. Cada matriz ocupa exactamente una línea de
+// caché, así que el lector solo toca las líneas de los objetos en uso.
+struct SharedTransformChannel {
+    uint32_t magic;                            // Debe ser SharedTransformMagic
+    uint32_t version;                          // Versión del protocolo
+    alignas(64) std::atomic<uint64_t> sequence; // Seqlock: impar = escritura en curso
+    alignas(64) uint32_t objectCount;          // Objetos válidos en models
+    float view[16];                            // Matriz de vista (column-major)
+    float proj[16];                            // Matriz de proyección (column-major)
+    alignas(64) float models[SharedTransformMaxObjects][16]; // Matrices de modelo por objeto
+};
+
+// Resultado de una lectura del canal. Pensado para reutilizarse entre
+// lecturas: models solo se redimensiona y conserva su capacidad.
+struct SharedTransformUpdate {
+    glm::mat4 view{ 1.0f };
+    glm::mat4 proj{ 1.0f };
+    std::vector<glm::mat4> models; // Una matriz por objeto (models.size() = objectCount)
+    uint64_t sequence = 0;         // Secuencia de la lectura para tracking
+};
+
+// Lector del canal de transformaciones.
+class SharedTransformReader {
+public:
+    SharedTransformReader() = default;
+
+    // Cierra la conexión al canal al destruir el lector.
+    ~SharedTransformReader();
+
+    // Abre el canal por nombre. Devuelve false si el escritor aún no lo ha
+    // creado (se puede reintentar más tarde).
+    bool open(const char* name = SharedTransformMappingName);
+
+    // Cierra la vista del canal y el mapeo.
+    void close();
+
+    // Intenta leer el estado más reciente del canal. Devuelve true solo si
+    // la secuencia cambió desde la última lectura y la copia es consistente.
+    bool tryRead(SharedTransformUpdate& outUpdate);
+
+    // Devuelve la transformación completa del objeto index, combinando
+    // su matriz de modelo con la cámara. Requiere index < models.size().
+    static TransformData objectTransform(const SharedTransformUpdate& update, uint32_t index);
+
+private:
+    SharedMemoryMapping mapping;                // Mapeo de memoria compartida del canal
+    SharedTransformChannel* channel = nullptr;  // Puntero al canal mapeado
+    uint64_t lastSequence = 0;                  // Última secuencia leída con éxito
+};
+
+// Escritor del canal de transformaciones.
+class SharedTransformWriter {
+public:
+    SharedTransformWriter() = default;
+
+    // Cierra el canal al destruir el escritor.
+    ~SharedTransformWriter();
+
+    // Crea el canal (o lo reabre si ya existe, para que un lector que sigue
+    // conectado vea al nuevo escritor) y lo deja sin objetos. Devuelve false
+    // si no se pudo crear.
+    bool open(const char* name = SharedTransformMappingName);
+
+    // Cierra la vista del canal y el mapeo.
+    void close();
+
+    // Sobrescribe el canal con la cámara y las matrices de modelo de los
+    // objetos (como mucho SharedTransformMaxObjects; el resto se ignora).
+    void write(const glm::mat4& view, const glm::mat4& proj, const std::vector<glm::mat4>& models);
+
+private:
+    SharedMemoryMapping mapping;                // Mapeo de memoria compartida del canal
+    SharedTransformChannel* channel = nullptr;  // Puntero al canal mapeado
+};
@@ -3,82 +3,393 @@
 // Punto de entrada de la aplicacin. Orquesta los tres subsistemas principales:
 //   1. WindowCreator: ventana GLFW con soporte de pantalla completa.
 //   2. VulkanRenderer: motor de renderizado Vulkan completo.
-//   3. SharedGeometryReader: lectura de geometra y transformaciones desde
-//      memoria compartida (IPC con el proceso geometry_writer).
+//   3. IngestWorker / SharedTransformReader: lectura de geometra (en un
+//      hilo propio) y de transformaciones desde memoria compartida (IPC con
+//      el proceso geometry_writer), cada una por su propio canal.
+//   4. SharedProfilerWriter: publicacin peridica de las estadsticas del
+//      perfilador para un proceso de monitorizacin.
+//
+// Con --headless no se crea ventana: el renderer dibuja en un target
+// offscreen y cada frame se recoge desde el anillo de readback.
+// --present=low-latency|balanced|power-saving|high-throughput elige la
+// poltica de presentacin (balanced por defecto). Con --on-demand solo se
+// dibuja cuando llega algo nuevo (geometra o transformaciones IPC, eventos
+// de ventana) o el renderer lo necesita; entre tanto el hilo duerme.
+// --frames=N y --duration=S terminan el bucle tras N frames dibujados o S
+// segundos (lo primero que ocurra), y SIGINT/SIGTERM lo terminan en
+// cualquier momento; en todos los casos la salida pasa por la espera de la
+// GPU y los destructores (que guardan la pipeline cache). Sin ventana son la
+// nica forma de salir.
 //
 // Bucle principal:
-//   - Procesar eventos de ventana (input, redimensionamiento).
+//   - Procesar eventos de ventana (input, redimensionamiento); bajo demanda
+//     y sin nada que dibujar, esperarlos en lugar de sondearlos.
 //   - Detectar la tecla F11 para alternar pantalla completa.
-//   - Leer actualizaciones de geometra/transformacin desde IPC.
-//   - Renderizar un frame con Vulkan.
+//   - Recoger la geometra preparada por el hilo de ingesta y leer las
+//     transformaciones desde IPC.
+//   - Renderizar un frame con Vulkan (en headless, consumir los readbacks),
+//     salvo bajo demanda si no hay nada nuevo.
+//   - Devolver al escritor la latencia del ltimo frame IPC presentado.
+//   - Cada ProfilerPublishInterval frames, publicar el perfilador.
+//   - Salir si se alcanz el lmite de frames o de tiempo, o lleg una seal.
 //   - Al salir del bucle, esperar a que la GPU termine antes de destruir.
 // =============================================================================
 
 #include "window/window_creator.hpp"
 #include "vulkan/vulkan_renderer.hpp"
-#include "ipc/shared_geometry.hpp"
+#include "ipc/ingest_worker.hpp"
+#include "ipc/shared_transforms.hpp"
+#include "ipc/shared_profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Frames entre dos publicaciones del perfilador en memoria compartida.
+constexpr uint32_t ProfilerPublishInterval = 30;
+
+// Espera mxima de una vuelta ociosa en modo bajo demanda. La geometra
+// despierta al bucle en cuanto llega, pero el canal de transformaciones no
+// avisa: este intervalo es lo que puede tardar en verse una transformacin.
+constexpr double OnDemandWaitSeconds = 0.002;
+
+// Bandera de salida que fijan SIGINT y SIGTERM; el bucle principal la
+// consulta en cada vuelta para terminar por el camino normal.
+static volatile std::sig_atomic_t quitRequested = 0;
+
+static void requestQuit(int) {
+    quitRequested = 1;
+}
+
+// Traduce el valor de --present a una poltica; nullopt si no es vlido.
+static std::optional<VulkanRenderer::PresentPolicy> parsePresentPolicy(const char* name) {
+    if (std::strcmp(name, "low-latency") == 0) {
+        return VulkanRenderer::PresentPolicy::LowLatency;
+    }
+    if (std::strcmp(name, "balanced") == 0) {
+        return VulkanRenderer::PresentPolicy::Balanced;
+    }
+    if (std::strcmp(name, "power-saving") == 0) {
+        return VulkanRenderer::PresentPolicy::PowerSaving;
+    }
+    if (std::strcmp(name, "high-throughput") == 0) {
+        return VulkanRenderer::PresentPolicy::HighThroughput;
+    }
+    return std::nullopt;
+}
+
+int main(int argc, char** argv) {
+    bool headless = false;
+    bool onDemand = false;
+    VulkanRenderer::PresentPolicy presentPolicy = VulkanRenderer::PresentPolicy::Balanced;
+    uint64_t maxFrames = 0;       // 0 = sin lmite
+    double maxSeconds = 0.0;      // 0 = sin lmite
+    constexpr char presentPrefix[] = "--present=";
+    constexpr char framesPrefix[] = "--frames=";
+    constexpr char durationPrefix[] = "--duration=";
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        }
+        else if (std::strcmp(argv[i], "--on-demand") == 0) {
+            onDemand = true;
+        }
+        else if (std::strncmp(argv[i], presentPrefix, sizeof(presentPrefix) - 1) == 0) {
+            std::optional<VulkanRenderer::PresentPolicy> policy = parsePresentPolicy(argv[i] + sizeof(presentPrefix) - 1);
+            if (!policy.has_value()) {
+                std::cerr << "Unknown present policy: " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+            presentPolicy = *policy;
+        }
+        else if (std::strncmp(argv[i], framesPrefix, sizeof(framesPrefix) - 1) == 0) {
+            char* end = nullptr;
+            maxFrames = std::strtoull(argv[i] + sizeof(framesPrefix) - 1, &end, 10);
+            if (*end != '\0' || maxFrames == 0) {
+                std::cerr << "Invalid frame count: " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strncmp(argv[i], durationPrefix, sizeof(durationPrefix) - 1) == 0) {
+            char* end = nullptr;
+            maxSeconds = std::strtod(argv[i] + sizeof(durationPrefix) - 1, &end);
+            if (*end != '\0' || !(maxSeconds > 0.0)) {
+                std::cerr << "Invalid duration: " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    std::signal(SIGINT, requestQuit);
+    std::signal(SIGTERM, requestQuit);
 
-int main() {
     try {
         // Crear la ventana con ancho de 1800 pxeles; la altura se ajusta
         // automticamente a la relacin de aspecto del monitor.
-        WindowCreator appWindow(1800, "Vulkan Menu");
+        std::optional<WindowCreator> appWindow;
+        if (!headless) {
+            appWindow.emplace(1800, "Vulkan Menu");
+        }
 
-        // Inicializar el renderer de Vulkan vinculado a la ventana.
+        // Inicializar el renderer de Vulkan vinculado a la ventana (o, en
+        // headless, a un target offscreen con la configuracin por defecto).
         // Esto crea toda la infraestructura: instancia, dispositivo, swapchain,
-        // pipeline, buffers, sincronizacin, etc.
-        VulkanRenderer renderer(appWindow);
-
-        // Abrir la conexin IPC con el proceso escritor de geometra.
-        // Si el proceso escritor an no ha creado la memoria compartida,
-        // open() retornar false y tryRead() simplemente no leer nada.
-        SharedGeometryReader reader;
-        reader.open();
-
-        while (!appWindow.shouldClose()) {
-            // Procesar eventos del sistema de ventanas para mantener la
-            // ventana responsiva (teclado, ratn, resize, cierre, etc.).
-            appWindow.pollEvents();
-
-            // Deteccin de flanco ascendente de F11 para alternar fullscreen.
-            // Se usa una variable esttica para detectar el momento exacto
-            // en que la tecla pasa de no-pulsada a pulsada, evitando que
-            // se alterne mltiples veces mientras se mantiene presionada.
-            static bool wasF11Down = false;
-            bool isF11Down = glfwGetKey(appWindow.getGLFWwindow(), GLFW_KEY_F11) == GLFW_PRESS;
-            if (isF11Down && !wasF11Down) {
-                appWindow.toggleFullscreen();
+        // pipeline, buffers, sincronizacin, etc. En headless la poltica solo
+        // decide los frames en vuelo.
+        std::optional<VulkanRenderer> rendererStorage;
+        if (headless) {
+            rendererStorage.emplace(VulkanRenderer::HeadlessConfig{});
+            rendererStorage->setPresentPolicy(presentPolicy);
+        }
+        else {
+            rendererStorage.emplace(*appWindow, presentPolicy);
+        }
+        VulkanRenderer& renderer = *rendererStorage;
+
+        // Precompila en segundo plano la variante del layout estndar de
+        // Vertex, el que envan los productores habituales, para que la
+        // primera malla recibida no tenga que esperar a su pipeline.
+        GeometryData defaultLayout{};
+        defaultLayout.bindingDescription = Vertex::getBindingDescription();
+        auto defaultAttributes = Vertex::getAttributeDescriptions();
+        defaultLayout.attributeDescriptions.assign(defaultAttributes.begin(), defaultAttributes.end());
+        defaultLayout.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        renderer.warmPipelineVariant(defaultLayout);
+
+        // Hilo de ingesta de geometra: se conecta por su cuenta al proceso
+        // escritor (reintentando mientras no exista) y copia cada frame
+        // directamente a uno de sus slots, que viven en buffers de staging
+        // externos del renderer. El hilo de render solo recoge el ltimo slot
+        // preparado y graba las copias hacia la arena, as que el ritmo de
+        // frames no depende del tamao de la geometra recibida. Los slots
+        // empiezan pequeos y el worker pide uno mayor cuando un frame no
+        // cabe (ver ms abajo).
+        // Se declara despus del renderer para detenerse antes de que este
+        // destruya los buffers de los slots.
+        VulkanRenderer::StagingWriteRegion slotRegions[IngestWorkerSlotCount];
+        IngestWorker ingest;
+        for (uint32_t i = 0; i < IngestWorkerSlotCount; i++) {
+            slotRegions[i] = renderer.createExternalStagingBuffer(IngestWorkerInitialSlotBytes);
+            ingest.setSlotMemory(i, slotRegions[i].data, static_cast<size_t>(slotRegions[i].size));
+        }
+        if (onDemand && !headless) {
+            // Un slot nuevo despierta al hilo de render si est esperando
+            // eventos de ventana.
+            ingest.setPublishNotifier([] { glfwPostEmptyEvent(); });
+        }
+        ingest.start();
+
+        // Slots tomados cuya copia a la GPU an no ha terminado: no pueden
+        // devolverse al worker hasta entonces.
+        struct InFlightSlot {
+            int32_t slot;
+            uint64_t uploadTicket;
+        };
+        std::vector<InFlightSlot> inFlightSlots;
+
+        // Canal de transformaciones: pequeo y sondeado cada frame desde el
+        // hilo de render. Sin cambios, el sondeo cuesta una sola carga atmica.
+        SharedTransformReader transformReader;
+        transformReader.open();
+        SharedTransformUpdate transformUpdate{};
+
+        // Canal del perfilador: si no se puede crear, se sigue sin publicar.
+        SharedProfilerWriter profilerWriter;
+        profilerWriter.open();
+        uint32_t framesSincePublish = 0;
+
+        // Frame headless tomado del anillo de readback.
+        VulkanRenderer::ReadbackFrame readback;
+
+        // Bajo demanda: si la vuelta anterior no tena nada que dibujar, esta
+        // empieza esperando. Cualquier cosa que despierte la espera antes del
+        // timeout (un evento de ventana o un slot nuevo) pide un frame.
+        bool idle = false;
+
+        // Lmites de la ejecucin (--frames y --duration).
+        const auto runStart = std::chrono::steady_clock::now();
+        uint64_t framesDrawn = 0;
+
+        while (!quitRequested && (headless || !appWindow->shouldClose())) {
+            if (maxSeconds > 0.0 &&
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count() >= maxSeconds) {
+                break;
             }
-            wasF11Down = isF11Down;
-
-            // Intentar leer una actualizacin desde la memoria compartida.
-            // tryRead() usa un protocolo seqlock: solo devuelve datos cuando
-            // la secuencia es par (escritura completada) y ha cambiado desde
-            // la ltima lectura.
-            SharedGeometryUpdate update{};
-            if (reader.tryRead(update)) {
-                // Si hay geometra nueva, crear un objeto Mesh y pasarlo al
-                // renderer, que validar los datos, recrear los buffers de
-                // GPU y, si el layout de vrtices cambi, recrear el pipeline.
-                if (update.hasGeometry) {
-                    Mesh mesh(update.geometry);
-                    renderer.setMesh(mesh);
+
+            bool frameWanted = !onDemand || renderer.needsRedraw();
+
+            if (!headless) {
+                // Procesar eventos del sistema de ventanas para mantener la
+                // ventana responsiva (teclado, ratn, resize, cierre, etc.).
+                if (idle) {
+                    const auto waitStart = std::chrono::steady_clock::now();
+                    appWindow->waitEvents(OnDemandWaitSeconds);
+                    const std::chrono::duration<double> waited = std::chrono::steady_clock::now() - waitStart;
+                    frameWanted = frameWanted || waited.count() < OnDemandWaitSeconds;
+                }
+                else {
+                    appWindow->pollEvents();
                 }
 
-                // Si hay transformacin, aplicarla como override; si no,
-                // volver a la rotacin automtica por defecto.
-                if (update.hasTransform) {
-                    renderer.setTransform(update.transform);
+                // Deteccin de flanco ascendente de F11 para alternar
+                // fullscreen. Se usa una variable esttica para detectar el
+                // momento exacto en que la tecla pasa de no-pulsada a
+                // pulsada, evitando que se alterne mltiples veces mientras
+                // se mantiene presionada.
+                static bool wasF11Down = false;
+                bool isF11Down = glfwGetKey(appWindow->getGLFWwindow(), GLFW_KEY_F11) == GLFW_PRESS;
+                if (isF11Down && !wasF11Down) {
+                    appWindow->toggleFullscreen();
+                    frameWanted = true;
+                }
+                wasF11Down = isF11Down;
+            }
+            else if (idle) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(OnDemandWaitSeconds));
+            }
+
+            // Devolver al worker los slots cuya copia ya termin en la GPU.
+            for (size_t i = 0; i < inFlightSlots.size();) {
+                if (renderer.isUploadComplete(inFlightSlots[i].uploadTicket)) {
+                    ingest.releaseSlot(inFlightSlots[i].slot);
+                    inFlightSlots[i] = inFlightSlots.back();
+                    inFlightSlots.pop_back();
+                }
+                else {
+                    ++i;
+                }
+            }
+
+            // Recoger la geometra preparada por el worker, en orden: como
+            // mucho un frame completo seguido de frames parciales sobre l. Si
+            // el renderer an est transmitiendo subidas anteriores por falta
+            // de staging, se pospone: los slots siguen en la cola y se
+            // recogen cuando la cola de subidas se vace.
+            // Los bytes ya estn en el slot: el renderer validar el layout,
+            // reemplazar los rangos de la malla por defecto en la arena de
+            // GPU copiando desde el buffer del slot (o, en un frame parcial,
+            // solo los rangos modificados) y, si el layout de vrtices es
+            // nuevo, compilar la variante del pipeline.
+            int32_t takenSlots[IngestWorkerSlotCount];
+            const uint32_t takenCount = renderer.isUploadBackpressured() ? 0 : ingest.takeUpdates(takenSlots);
+            for (uint32_t taken = 0; taken < takenCount; taken++) {
+                const int32_t slotIndex = takenSlots[taken];
+                const IngestSlot& slot = ingest.getSlot(slotIndex);
+                if (slot.requiredBytes > 0) {
+                    // Peticin de crecimiento: el slot llega libre (su ltima
+                    // copia ya termin), as que su buffer se sustituye en el
+                    // acto por uno al menos el doble de grande, para que una
+                    // malla que crece poco a poco no lo reasigne en cada frame.
+                    const VkDeviceSize newSize = std::max<VkDeviceSize>(slot.requiredBytes, 2 * slotRegions[slotIndex].size);
+                    renderer.destroyExternalStagingBuffer(slotRegions[slotIndex]);
+                    slotRegions[slotIndex] = renderer.createExternalStagingBuffer(newSize);
+                    ingest.setSlotMemory(static_cast<uint32_t>(slotIndex), slotRegions[slotIndex].data, static_cast<size_t>(newSize));
+                    ingest.releaseSlot(slotIndex);
+                    continue;
+                }
+
+                renderer.getProfiler().addSample(ProfileMetric::IpcRead, slot.readMilliseconds);
+
+                VulkanRenderer::StagingWriteRegion vertexRegion{};
+                if (slot.vertexBytes > 0) {
+                    vertexRegion = slotRegions[slotIndex];
+                    vertexRegion.size = slot.vertexBytes;
+                }
+
+                VulkanRenderer::StagingWriteRegion indexRegion{};
+                if (slot.indexBytes > 0) {
+                    indexRegion = slotRegions[slotIndex];
+                    indexRegion.data += slot.indexOffset;
+                    indexRegion.offset += slot.indexOffset;
+                    indexRegion.size = slot.indexBytes;
+                }
+
+                VulkanRenderer::StagingWriteRegion instanceRegion{};
+                if (slot.instanceBytes > 0) {
+                    instanceRegion = slotRegions[slotIndex];
+                    instanceRegion.data += slot.instanceOffset;
+                    instanceRegion.offset += slot.instanceOffset;
+                    instanceRegion.size = slot.instanceBytes;
+                }
+
+                // Un frame parcial sobre una malla distinta de la que tiene el
+                // renderer (p. ej. tras descartarse un frame completo
+                // invlido) no aplica: el slot vuelve sin ms.
+                const uint64_t ticket = slot.dirtyRanges.empty()
+                    ? renderer.setMeshFromStaging(slot.layout, vertexRegion, indexRegion, instanceRegion)
+                    : renderer.setMeshRangesFromStaging(slot.layout, slot.dirtyRanges, vertexRegion, indexRegion, instanceRegion);
+                if (ticket == 0) {
+                    ingest.releaseSlot(slotIndex);
+                    continue;
+                }
+                inFlightSlots.push_back({ slotIndex, ticket });
+                renderer.traceLatency(ticket, slot.sequence, slot.publishTimeNs, slot.readTimeNs);
+                frameWanted = true;
+            }
+
+            // Si el canal de transformaciones cambi, aplicar la del primer
+            // objeto (la malla por defecto) como override; un canal sin
+            // objetos devuelve el control a la rotacin automtica. Una
+            // transformacin republicada sin cambios no pide frame.
+            if (transformReader.tryRead(transformUpdate)) {
+                if (!transformUpdate.models.empty()) {
+                    frameWanted = renderer.setTransform(SharedTransformReader::objectTransform(transformUpdate, 0)) || frameWanted;
                 }
                 else {
                     renderer.clearTransformOverride();
+                    frameWanted = true;
                 }
             }
 
+            // Sin nada nuevo que dibujar, la prxima vuelta espera. Los slots
+            // en vuelo no necesitan frames: sus subidas mantienen
+            // needsRedraw hasta promocionarse.
+            idle = !frameWanted;
+            if (idle) {
+                continue;
+            }
+
             // Ejecutar el ciclo completo de un frame: adquirir imagen del
             // swapchain, grabar comandos, enviar a la GPU y presentar.
             renderer.drawFrame();
+            framesDrawn++;
+
+            // Recoger los frames headless terminados. Aqu es donde un nodo
+            // de render los codificara o enviara; mientras se retiene un
+            // frame, su buffer no se reutiliza, pero la GPU no espera.
+            while (headless && renderer.acquireReadback(readback)) {
+                renderer.releaseReadback(readback);
+            }
+
+            // Si se present una geometra IPC nueva, devolver su recorrido
+            // (lectura, subida y presentacin) al escritor a travs del
+            // worker, que es quien tiene abierta la memoria compartida.
+            VulkanRenderer::LatencyTrace trace;
+            if (renderer.takePresentedLatency(trace)) {
+                auto sincePublish = [&trace](uint64_t timeNs) {
+                    return (timeNs > trace.publishTimeNs) ? timeNs - trace.publishTimeNs : 0;
+                };
+                SharedGeometryLatency latency{};
+                latency.sequence = trace.sequence;
+                latency.readLatencyNs = sincePublish(trace.readTimeNs);
+                latency.uploadLatencyNs = sincePublish(trace.uploadTimeNs);
+                latency.presentLatencyNs = sincePublish(trace.presentTimeNs);
+                ingest.publishLatency(latency);
+            }
+
+            if (++framesSincePublish >= ProfilerPublishInterval) {
+                profilerWriter.publish(renderer.getProfileSnapshot());
+                framesSincePublish = 0;
+            }
+
+            if (maxFrames > 0 && framesDrawn >= maxFrames) {
+                break;
+            }
         }
 
         // Esperar a que la GPU termine todo el trabajo pendiente antes de
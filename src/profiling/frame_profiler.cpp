@@ -0,0 +1,136 @@
+﻿// =============================================================================
+// frame_profiler.cpp
+// Implementación del perfilador de frames (FrameProfiler): anillos de
+// muestras por métrica y cálculo de percentiles bajo demanda.
+// =============================================================================
+
+#include "profiling/frame_profiler.hpp"
+#include <algorithm>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// profileMetricName: nombres estables, usados también por los lectores del
+// canal compartido para etiquetar las métricas.
+// -----------------------------------------------------------------------------
+const char* profileMetricName(ProfileMetric metric) {
+    switch (metric) {
+    case ProfileMetric::FrameTime:       return "frame";
+    case ProfileMetric::FenceWait:       return "fence_wait";
+    case ProfileMetric::Acquire:         return "acquire";
+    case ProfileMetric::Uploads:         return "uploads";
+    case ProfileMetric::Record:          return "record";
+    case ProfileMetric::Submit:          return "submit";
+    case ProfileMetric::Present:         return "present";
+    case ProfileMetric::IpcRead:         return "ipc_read";
+    case ProfileMetric::SetMesh:         return "set_mesh";
+    case ProfileMetric::GpuRender:       return "gpu_render";
+    case ProfileMetric::GpuTransfer:     return "gpu_transfer";
+    case ProfileMetric::TransferLatency: return "transfer_latency";
+    case ProfileMetric::IpcReadLatency:  return "ipc_read_latency";
+    case ProfileMetric::IpcUploadLatency: return "ipc_upload_latency";
+    case ProfileMetric::MotionToPhoton:  return "motion_to_photon";
+    case ProfileMetric::PresentWait:     return "present_wait";
+    default:                             return "unknown";
+    }
+}
+
+// -----------------------------------------------------------------------------
+// addSample: sobrescribe la muestra más antigua cuando el anillo está lleno.
+// -----------------------------------------------------------------------------
+void FrameProfiler::addSample(ProfileMetric metric, double milliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    SampleRing& ring = rings[static_cast<uint32_t>(metric)];
+    ring.samples[ring.next] = static_cast<float>(milliseconds);
+    ring.next = (ring.next + 1) % ProfilerWindowSize;
+    ring.count = std::min(ring.count + 1, ProfilerWindowSize);
+}
+
+// -----------------------------------------------------------------------------
+// addUploadBytes: acumula hasta el siguiente endFrame.
+// -----------------------------------------------------------------------------
+void FrameProfiler::addUploadBytes(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingUploadBytes += bytes;
+}
+
+// -----------------------------------------------------------------------------
+// endFrame: el primer frame solo fija la referencia temporal. A partir del
+// segundo, registra el intervalo como FrameTime y guarda los bytes subidos
+// junto a la duración del frame para el throughput de la ventana.
+// -----------------------------------------------------------------------------
+void FrameProfiler::endFrame() {
+    const Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+
+    frameCount++;
+    if (lastFrameEnd == Clock::time_point{}) {
+        lastFrameEnd = now;
+        pendingUploadBytes = 0;
+        return;
+    }
+
+    const double frameMilliseconds = elapsedMilliseconds(lastFrameEnd, now);
+    lastFrameEnd = now;
+
+    SampleRing& ring = rings[static_cast<uint32_t>(ProfileMetric::FrameTime)];
+    ring.samples[ring.next] = static_cast<float>(frameMilliseconds);
+    ring.next = (ring.next + 1) % ProfilerWindowSize;
+    ring.count = std::min(ring.count + 1, ProfilerWindowSize);
+
+    frameUploadBytes[frameWindowNext] = pendingUploadBytes;
+    frameDurations[frameWindowNext] = frameMilliseconds;
+    frameWindowNext = (frameWindowNext + 1) % ProfilerWindowSize;
+    frameWindowCount = std::min(frameWindowCount + 1, ProfilerWindowSize);
+    pendingUploadBytes = 0;
+}
+
+// -----------------------------------------------------------------------------
+// snapshot: copia los anillos bajo el mutex y calcula las estadísticas fuera
+// de él, para no retener a los hilos que miden mientras se ordena.
+// Los percentiles usan el rango más cercano sobre las muestras ordenadas.
+// -----------------------------------------------------------------------------
+ProfileSnapshot FrameProfiler::snapshot() const {
+    std::array<SampleRing, ProfileMetricCount> ringsCopy;
+    uint64_t windowBytes = 0;
+    double windowMilliseconds = 0.0;
+    ProfileSnapshot result{};
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ringsCopy = rings;
+        for (uint32_t i = 0; i < frameWindowCount; i++) {
+            windowBytes += frameUploadBytes[i];
+            windowMilliseconds += frameDurations[i];
+        }
+        result.frameCount = frameCount;
+    }
+
+    std::vector<float> sorted;
+    sorted.reserve(ProfilerWindowSize);
+    for (uint32_t m = 0; m < ProfileMetricCount; m++) {
+        const SampleRing& ring = ringsCopy[m];
+        if (ring.count == 0) {
+            continue;
+        }
+
+        sorted.assign(ring.samples.begin(), ring.samples.begin() + ring.count);
+        std::sort(sorted.begin(), sorted.end());
+
+        double sum = 0.0;
+        for (float sample : sorted) {
+            sum += sample;
+        }
+
+        ProfileMetricStats& stats = result.metrics[m];
+        stats.sampleCount = ring.count;
+        stats.p50 = sorted[(ring.count - 1) / 2];
+        stats.p99 = sorted[(ring.count - 1) * 99 / 100];
+        stats.mean = sum / ring.count;
+        stats.max = sorted.back();
+    }
+
+    if (windowMilliseconds > 0.0) {
+        result.uploadMegabytesPerSecond = (static_cast<double>(windowBytes) / (1024.0 * 1024.0)) / (windowMilliseconds / 1000.0);
+    }
+    return result;
+}
@@ -0,0 +1,142 @@
+﻿// =============================================================================
+// frame_profiler.hpp
+// Perfilador de frames integrado: tiempos de CPU por fase del frame, tiempos
+// de GPU medidos con timestamps y percentiles móviles de todos ellos.
+//
+// Cada métrica guarda sus últimas ProfilerWindowSize muestras en un anillo
+// propio; snapshot() ordena una copia de cada anillo para obtener p50/p99,
+// así que el coste de medir es una escritura por muestra y el de consultar
+// solo lo paga quien consulta (típicamente unas pocas veces por segundo).
+//
+// Las muestras pueden añadirse desde cualquier hilo: el acceso a los anillos
+// está protegido por un mutex, que a estas frecuencias (unas decenas de
+// muestras por frame) no tiene contención apreciable.
+// =============================================================================
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Número de muestras por métrica sobre las que se calculan los percentiles.
+constexpr uint32_t ProfilerWindowSize = 512;
+
+// Métricas del perfilador. Los tiempos se expresan en milisegundos.
+enum class ProfileMetric : uint32_t {
+    FrameTime,        // Intervalo entre dos endFrame consecutivos
+    FenceWait,        // vkWaitForFences del frame en vuelo
+    Acquire,          // vkAcquireNextImageKHR
+    Uploads,          // pumpUploads + submitUploadBatch al inicio del frame
+    Record,           // Actualización de buffers y grabación de comandos
+    Submit,           // vkQueueSubmit gráfico
+    Present,          // vkQueuePresentKHR
+    IpcRead,          // Lectura y copia de un frame IPC (hilo de ingesta)
+    SetMesh,          // Alta o sustitución de una malla en la escena
+    GpuRender,        // Render pass en la GPU (timestamps)
+    GpuTransfer,      // Lote de subidas en la GPU (timestamps)
+    TransferLatency,  // Del submit de un lote de subidas a observar su fin
+    IpcReadLatency,   // De la publicación del productor a su lectura
+    IpcUploadLatency, // De la publicación del productor al fin de su subida
+    MotionToPhoton,   // De la publicación del productor a su presentación
+    PresentWait,      // vkWaitForPresentKHR de LowLatency
+    Count
+};
+
+constexpr uint32_t ProfileMetricCount = static_cast<uint32_t>(ProfileMetric::Count);
+
+// Nombre legible de una métrica, para volcados y herramientas.
+const char* profileMetricName(ProfileMetric metric);
+
+// Estadísticas de una métrica sobre su ventana de muestras.
+struct ProfileMetricStats {
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double mean = 0.0;
+    double max = 0.0;
+    uint32_t sampleCount = 0;
+};
+
+// Estado del perfilador en un instante.
+struct ProfileSnapshot {
+    std::array<ProfileMetricStats, ProfileMetricCount> metrics{};
+    double uploadMegabytesPerSecond = 0.0; // Bytes subidos en la ventana / duración de la ventana
+    uint64_t frameCount = 0;               // Frames cerrados desde el inicio
+
+    const ProfileMetricStats& operator[](ProfileMetric metric) const {
+        return metrics[static_cast<uint32_t>(metric)];
+    }
+};
+
+class FrameProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Añade una muestra (en milisegundos) a la métrica.
+    void addSample(ProfileMetric metric, double milliseconds);
+
+    // Suma bytes subidos a la GPU al frame en curso; se usan para el
+    // throughput de subidas.
+    void addUploadBytes(uint64_t bytes);
+
+    // Cierra el frame: registra FrameTime y los bytes subidos en el frame.
+    void endFrame();
+
+    // Calcula las estadísticas de todas las métricas.
+    ProfileSnapshot snapshot() const;
+
+    // Milisegundos transcurridos entre dos instantes.
+    static double elapsedMilliseconds(Clock::time_point begin, Clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - begin).count();
+    }
+
+    // Instante actual de Clock en nanosegundos. En Windows steady_clock se
+    // basa en QueryPerformanceCounter, que es común a todos los procesos de
+    // la máquina, así que estos valores se pueden comparar entre procesos
+    // (p. ej. con el instante de publicación de un productor IPC).
+    static uint64_t timestampNanoseconds() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()).count());
+    }
+
+private:
+    // Anillo de muestras de una métrica.
+    struct SampleRing {
+        std::array<float, ProfilerWindowSize> samples{};
+        uint32_t count = 0; // Muestras válidas (hasta ProfilerWindowSize)
+        uint32_t next = 0;  // Posición de la siguiente escritura
+    };
+
+    mutable std::mutex mutex;
+    std::array<SampleRing, ProfileMetricCount> rings{};
+
+    // Bytes subidos y duración de cada frame de la ventana, en paralelo.
+    std::array<uint64_t, ProfilerWindowSize> frameUploadBytes{};
+    std::array<double, ProfilerWindowSize> frameDurations{};
+    uint32_t frameWindowCount = 0;
+    uint32_t frameWindowNext = 0;
+
+    uint64_t pendingUploadBytes = 0;
+    uint64_t frameCount = 0;
+    Clock::time_point lastFrameEnd{};
+};
+
+// Mide el tiempo de CPU de un ámbito y lo añade como muestra al destruirse.
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler& profiler, ProfileMetric metric)
+        : profiler(profiler), metric(metric), begin(FrameProfiler::Clock::now()) {}
+
+    ~ProfileScope() {
+        profiler.addSample(metric, FrameProfiler::elapsedMilliseconds(begin, FrameProfiler::Clock::now()));
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler& profiler;
+    ProfileMetric metric;
+    FrameProfiler::Clock::time_point begin;
+};
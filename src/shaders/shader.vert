@@ -4,16 +4,35 @@
 //
 // Recibe los atributos de cada vértice (posición y color) y los transforma
 // desde espacio local del objeto hasta espacio de clip de Vulkan, aplicando
-// las tres matrices de transformación del Uniform Buffer Object:
+// la matriz de modelo del objeto (storage buffer de ObjectData) y las de
+// vista y proyección del Uniform Buffer Object:
 //
 //   gl_Position = proyección × vista × modelo × posición
 //
+// Cada draw (directo o indirecto) usa firstInstance = índice del objeto, así
+// que gl_BaseInstance selecciona su ObjectData. Si el objeto tiene
+// instancias, gl_InstanceIndex - gl_BaseInstance es la instancia dentro del
+// draw y su transformación se lee por dirección de GPU (buffer device
+// address) desde la página de la arena donde vive; se aplica tras la de
+// modelo:
+//
+//   gl_Position = proyección × vista × modelo × instancia × posición
+//
+// La posición se decodifica primero con la escala y el offset del objeto
+// (identidad salvo en mallas cuantizadas, cuyo atributo llega normalizado a
+// [-1, 1] desde un formato snorm):
+//
+//   posición = inPosition × positionScale + positionOffset
+//
 // El color del vértice se pasa directamente al fragment shader, donde será
 // interpolado automáticamente por el rasterizador entre los tres vértices
 // de cada triángulo (interpolación baricéntrica).
 // =============================================================================
 
 #version 450
+#extension GL_ARB_shader_draw_parameters : require
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_buffer_reference_uvec2 : require
 
 // Atributos de entrada por vértice, vinculados al binding 0 del vertex buffer.
 // Las ubicaciones (location) corresponden a las VkVertexInputAttributeDescription
@@ -26,19 +45,54 @@ layout(location = 1) in vec3 inColor;     // Color RGB del vértice
 layout(location = 0) out vec3 fragColor;
 
 // Uniform Buffer Object (UBO) vinculado al binding 0 del descriptor set.
-// Contiene las matrices de transformación actualizadas cada frame por la CPU.
+// Contiene las matrices de cámara actualizadas una vez por frame por la CPU.
 // El layout std140 es implícito en Vulkan cuando se usa alignas(16) en C++.
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;  // Espacio local → espacio del mundo (posición, rotación, escala)
     mat4 view;   // Espacio del mundo → espacio de la cámara
     mat4 proj;   // Espacio de la cámara → espacio de clip (perspectiva)
 } ubo;
 
+// Transformaciones por instancia: mat4 consecutivas en la arena.
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer InstanceTransforms {
+    mat4 transforms[];
+};
+
+// Datos por objeto (mismo layout que ObjectData en vulkan_renderer.hpp).
+// El vertex shader usa model y las instancias; el resto es para el culling.
+// normalAddress queda disponible para un futuro sombreado con iluminación.
+struct ObjectData {
+    mat4 model;           // Espacio local → espacio del mundo
+    vec4 boundingSphere;
+    uint elementCount;
+    uint firstElement;
+    int vertexOffset;
+    uint indexed;
+    uint batch;
+    uint commandOffset;
+    uint instanceCount;   // 0 = una sola copia, sin transformación extra
+    uint padding0;
+    uvec2 instanceAddress;
+    uvec2 normalAddress;  // Normales suaves del preprocesado (0 = sin normales)
+    vec4 positionScale;   // Decodificación de posiciones cuantizadas (xyz)
+    vec4 positionOffset;
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
 void main() {
     // Multiplicar las matrices en orden: primero modelo (local→mundo),
     // luego vista (mundo→cámara), finalmente proyección (cámara→clip).
     // vec4(..., 1.0) convierte la posición 3D en coordenada homogénea.
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    uint objectIndex = uint(gl_BaseInstanceARB);
+    mat4 model = objects[objectIndex].model;
+    if (objects[objectIndex].instanceCount > 0u) {
+        uint instance = uint(gl_InstanceIndex - gl_BaseInstanceARB);
+        model = model * InstanceTransforms(objects[objectIndex].instanceAddress).transforms[instance];
+    }
+    vec3 position = inPosition * objects[objectIndex].positionScale.xyz + objects[objectIndex].positionOffset.xyz;
+    gl_Position = ubo.proj * ubo.view * model * vec4(position, 1.0);
 
     // Pasar el color al fragment shader sin modificación.
     fragColor = inColor;
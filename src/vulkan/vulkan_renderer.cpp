@@ -7,24 +7,53 @@
 #include "vulkan_renderer.hpp"
 
 // -----------------------------------------------------------------------------
-// Constructor: inicializa todos los subsistemas de Vulkan en el orden requerido
+// Constructor: renderer ligado a una ventana, que presenta en su swapchain.
+// -----------------------------------------------------------------------------
+VulkanRenderer::VulkanRenderer(WindowCreator& w, PresentPolicy policy)
+    : window{ &w }
+    , startTime{ std::chrono::high_resolution_clock::now() }
+{
+    presentPolicy = policy;
+    framesInFlight = framesInFlightFor(policy);
+    initVulkan();
+}
+
+// -----------------------------------------------------------------------------
+// Constructor headless: dibuja en targets offscreen y ofrece cada frame por el
+// anillo de readback.
+// -----------------------------------------------------------------------------
+VulkanRenderer::VulkanRenderer(const HeadlessConfig& config)
+    : headless{ true }
+    , headlessConfig{ config }
+    , startTime{ std::chrono::high_resolution_clock::now() }
+{
+    initVulkan();
+}
+
+// -----------------------------------------------------------------------------
+// initVulkan: inicializa todos los subsistemas de Vulkan en el orden requerido
 // por las dependencias entre recursos.
 // Orden de creación:
 //   1. Instancia y superficie (conexión con el sistema de ventanas)
 //   2. GPU física y dispositivo lógico (acceso al hardware)
 //   3. Asignador VMA (gestión eficiente de memoria de GPU)
 //   4. Formato de depth y nivel de MSAA (consultando capacidades de la GPU)
-//   5. Pipeline cache y shader modules (preparación para crear pipelines)
+//   5. Pipeline cache (desde disco) y shader modules (preparación para crear pipelines)
 //   6. Swapchain, image views, render pass, attachments, framebuffers
-//   7. Descriptor layout, command pool, staging ring, uniform buffers
+//   7. Descriptor layout, pipeline layout, pipeline de culling, command
+//      pools, staging ring, preprocesado de geometría, uniform buffers,
+//      buffers por objeto
 //   8. Descriptor pool/sets, command buffers, objetos de sincronización
+//   9. Hilos de grabación con sus command pools
+// En modo headless no hay superficie: en el paso 6 los targets offscreen
+// sustituyen al swapchain, y tras la sincronización se crea el anillo de
+// readback.
 // -----------------------------------------------------------------------------
-VulkanRenderer::VulkanRenderer(WindowCreator& w)
-    : window{ w }
-    , startTime{ std::chrono::high_resolution_clock::now() }
-{
+void VulkanRenderer::initVulkan() {
     createInstance();
-    createSurface();
+    if (!headless) {
+        createSurface();
+    }
     pickPhysicalDevice();
     createLogicalDevice();
     createAllocator();
@@ -32,73 +61,99 @@ VulkanRenderer::VulkanRenderer(WindowCreator& w)
     depthFormat = findDepthFormat();
     msaaSamples = getMaxUsableSampleCount();
 
-    VkPipelineCacheCreateInfo cacheInfo{};
-    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache);
+    createPipelineCache();
 
     loadShaderModules();
 
-    createSwapChain();
+    if (headless) {
+        createOffscreenTargets();
+    }
+    else {
+        createSwapChain();
+    }
     createImageViews();
     createRenderPass();
     createColorResources();
     createDepthResources();
     createFramebuffers();
     createDescriptorSetLayout();
+    createPipelineLayout();
+    createCullingPipeline();
     createCommandPool();
     createStagingRing();
+    createGeometryPreprocessor();
     createUniformBuffers();
+    createObjectBuffers();
     createDescriptorPool();
     createDescriptorSets();
     createCommandBuffers();
     createSyncObjects();
+    if (headless) {
+        createReadbackRing();
+    }
+    createTimestampQueries();
+    createRecordWorkers();
+    createPipelineWarmer();
+    createLodBuilder();
 }
 
 // -----------------------------------------------------------------------------
 // Destructor: libera todos los recursos en orden inverso al de creación.
-// Primero espera a que la GPU termine todo el trabajo pendiente para evitar
-// destruir recursos que aún estén en uso.
+// Primero envía el lote de subidas abierto (sus copias apuntan a la arena) y
+// espera a que la GPU termine todo el trabajo pendiente para evitar destruir
+// recursos que aún estén en uso.
 // -----------------------------------------------------------------------------
 VulkanRenderer::~VulkanRenderer() {
+    waitAllTransfers();
     vkDeviceWaitIdle(device);
 
+    destroyRecordWorkers();
+    destroyPipelineWarmer();
+    destroyLodBuilder();
+    destroyTimestampQueries();
+    destroyReadbackRing();
     cleanupSwapChain();
 
     destroyShaderModules();
 
     if (pipelineCache != VK_NULL_HANDLE) {
+        savePipelineCache();
         vkDestroyPipelineCache(device, pipelineCache, nullptr);
     }
 
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    destroyGraphicsPipelines();
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    destroyCullingPipeline();
 
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-    if (indexBuffer != VK_NULL_HANDLE) {
-        vmaDestroyBuffer(allocator, indexBuffer, indexBufferAllocation);
-    }
-    if (vertexBuffer != VK_NULL_HANDLE) {
-        vmaDestroyBuffer(allocator, vertexBuffer, vertexBufferAllocation);
-    }
+    destroyGeometryPreprocessor();
+    destroyGeometryArena();
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vmaDestroyBuffer(allocator, uniformBuffers[i], uniformBufferAllocations[i]);
     }
+    destroyObjectBuffers();
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
         vkDestroyFence(device, inFlightFences[i], nullptr);
     }
+    vkDestroyFence(device, singleTimeFence, nullptr);
 
     destroyStagingRing();
+    vkDestroySemaphore(device, frameTimeline, nullptr);
     vkDestroyCommandPool(device, commandPool, nullptr);
 
     if (transferCommandPool != VK_NULL_HANDLE && transferCommandPool != commandPool) {
         vkDestroyCommandPool(device, transferCommandPool, nullptr);
     }
+    if (computeCommandPool != VK_NULL_HANDLE && computeCommandPool != commandPool &&
+        computeCommandPool != transferCommandPool) {
+        vkDestroyCommandPool(device, computeCommandPool, nullptr);
+    }
 
     destroyAllocator();
     vkDestroyDevice(device, nullptr);
@@ -111,7 +166,7 @@ VulkanRenderer::~VulkanRenderer() {
 // depende de la resolución del swapchain. Se invoca antes de recrear el
 // swapchain (resize, fullscreen toggle) o al destruir el renderer.
 // Orden de destrucción: MSAA color → depth → framebuffers → image views →
-// render pass → swapchain.
+// render pass → swapchain (o, en modo headless, las imágenes offscreen).
 // -----------------------------------------------------------------------------
 void VulkanRenderer::cleanupSwapChain() {
     if (colorImageView != VK_NULL_HANDLE) {
@@ -147,8 +202,13 @@ void VulkanRenderer::cleanupSwapChain() {
     vkDestroyRenderPass(device, renderPass, nullptr);
     renderPass = VK_NULL_HANDLE;
 
-    vkDestroySwapchainKHR(device, swapChain, nullptr);
-    swapChain = VK_NULL_HANDLE;
+    if (headless) {
+        destroyOffscreenTargets();
+    }
+    else {
+        vkDestroySwapchainKHR(device, swapChain, nullptr);
+        swapChain = VK_NULL_HANDLE;
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -156,18 +216,23 @@ void VulkanRenderer::cleanupSwapChain() {
 // o cuando la ventana cambia de tamaño.
 // Si la ventana está minimizada (dimensiones 0x0), espera con pollEvents hasta
 // que recupere un tamaño válido.
-// Recrea el swapchain y todos sus recursos dependientes, incluyendo el pipeline
-// gráfico si ya existía (ya que depende del render pass).
+// Recrea el swapchain y todos sus recursos dependientes. Las variantes del
+// pipeline gráfico solo se recompilan si el formato de color cambió: con el
+// mismo formato, el mismo depth y el mismo MSAA el render pass nuevo es
+// compatible con el anterior y los pipelines siguen siendo válidos.
+// El hilo de precompilación se pausa mientras el render pass no existe.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::recreateSwapChain() {
-    WindowCreator::WindowDimensions dims = window.getDimensions();
+    WindowCreator::WindowDimensions dims = window->getDimensions();
     while (dims.width == 0 || dims.height == 0) {
-        window.pollEvents();
-        dims = window.getDimensions();
+        window->pollEvents();
+        dims = window->getDimensions();
     }
 
     vkDeviceWaitIdle(device);
+    pausePipelineWarmer();
 
+    const VkFormat previousFormat = swapChainImageFormat;
     cleanupSwapChain();
 
     createSwapChain();
@@ -177,7 +242,8 @@ void VulkanRenderer::recreateSwapChain() {
     createDepthResources();
     createFramebuffers();
 
-    if (graphicsPipeline != VK_NULL_HANDLE) {
-        recreateGraphicsPipeline();
+    if (swapChainImageFormat != previousFormat) {
+        recreateGraphicsPipelines();
     }
+    resumePipelineWarmer();
 }
\ No newline at end of file
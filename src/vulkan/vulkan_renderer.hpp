@@ -12,30 +12,102 @@
 
 #include "window/window_creator.hpp"
 #include "geometry/mesh.hpp"
+#include "geometry/mesh_lod.hpp"
 #include "geometry/transform.hpp"
+#include "profiling/frame_profiler.hpp"
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
 #include <vector>
 #include <array>
 #include <optional>
+#include <deque>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <cstdint>
 #include <chrono>
-
-// Estructura que contiene las tres matrices de transformación (modelo, vista y
-// proyección) que se envían al vertex shader a través de un Uniform Buffer Object.
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <atomic>
+
+// Matrices de cámara (vista y proyección) que se envían al vertex shader a
+// través de un Uniform Buffer Object, una sola vez por frame. La matriz de
+// modelo de cada objeto viaja en su ObjectData.
 // El alignas(16) garantiza que cada mat4 cumpla con el alineamiento std140 de GLSL.
 struct UniformBufferObject {
-    alignas(16) glm::mat4 model;
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 proj;
 };
 
+// Datos por objeto en el storage buffer del frame (layout std430), indexados
+// por su posición en drawOrder. El vertex shader lee model a través de
+// gl_BaseInstance (cada draw usa firstInstance = posición del objeto, y
+// gl_InstanceIndex - gl_BaseInstance es la instancia dentro del objeto) y el
+// compute shader de culling usa el resto para descartar el objeto o escribir
+// su comando indirecto. positionScale/positionOffset (xyz; w sin uso)
+// decodifican las posiciones cuantizadas de la malla en el vertex shader.
+// normalAddress apunta a las normales suaves calculadas por el preprocesado
+// de geometría (un vec4 por vértice, indexado como el vertex buffer).
+struct ObjectData {
+    glm::mat4 model;
+    glm::vec4 boundingSphere;   // Espacio local: xyz = centro, w = radio (< 0 = sin límites)
+    uint32_t elementCount;      // Índices (indexado) o vértices (directo)
+    uint32_t firstElement;      // firstIndex o firstVertex
+    int32_t vertexOffset;       // Solo en dibujo indexado
+    uint32_t indexed;           // 1 = VkDrawIndexedIndirectCommand, 0 = VkDrawIndirectCommand
+    uint32_t batch;             // Lote de draws al que pertenece
+    uint32_t commandOffset;     // Primer comando del lote en el buffer indirecto
+    uint32_t instanceCount;     // Transformaciones por instancia (0 = una sola copia)
+    uint32_t padding0;
+    uint64_t instanceAddress;   // Dirección de GPU de las mat4 por instancia
+    uint64_t normalAddress;     // Dirección de GPU de las normales (0 = sin normales)
+    glm::vec4 positionScale;    // Posición local = atributo × scale + offset
+    glm::vec4 positionOffset;
+};
+static_assert(sizeof(ObjectData) == 160, "ObjectData must match the std430 layout in the shaders");
+
+// Identificador opaco de una malla dentro de la escena del renderer.
+// Los handles son monótonos y nunca se reutilizan; 0 se reserva como inválido.
+using MeshHandle = uint32_t;
+constexpr MeshHandle InvalidMeshHandle = 0;
+
 class VulkanRenderer {
 public:
+    // Política de presentación: modo del swapchain y frames en vuelo.
+    //   - LowLatency: IMMEDIATE (o FIFO_RELAXED) con 1 frame en vuelo. Con
+    //     VK_KHR_present_wait, drawFrame no vuelve hasta que su imagen llega
+    //     a pantalla, así que el siguiente frame lee la entrada más reciente.
+    //   - Balanced: MAILBOX (o FIFO) con 2 frames en vuelo.
+    //   - PowerSaving: FIFO con 2 frames en vuelo; el V-Sync frena a CPU y GPU.
+    //   - HighThroughput: MAILBOX (o IMMEDIATE) con 3 frames en vuelo y una
+    //     imagen más en el swapchain.
+    // Los modos no disponibles caen a FIFO, que la especificación garantiza.
+    enum class PresentPolicy {
+        LowLatency,
+        Balanced,
+        PowerSaving,
+        HighThroughput
+    };
+
     // Construye el renderer, inicializando todos los recursos de Vulkan en el
     // orden correcto: instancia → superficie → dispositivo → swapchain → pipeline.
-    VulkanRenderer(WindowCreator& window);
+    VulkanRenderer(WindowCreator& window, PresentPolicy policy = PresentPolicy::Balanced);
+
+    // Configuración del modo headless: sin ventana, superficie ni swapchain.
+    // Cada frame se dibuja en un color target offscreen y se copia a un
+    // anillo de readbackSlots buffers host-cached que el llamador consume
+    // con acquireReadback/releaseReadback.
+    struct HeadlessConfig {
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        VkFormat colorFormat = VK_FORMAT_R8G8B8A8_SRGB; // Formato de 4 bytes por píxel
+        uint32_t readbackSlots = 4;                      // Mínimo MAX_FRAMES_IN_FLIGHT + 1
+    };
+
+    // Construye el renderer en modo headless. No requiere GLFW ni una GPU
+    // capaz de presentar.
+    explicit VulkanRenderer(const HeadlessConfig& config);
 
     // Destruye todos los recursos de Vulkan en orden inverso al de creación,
     // asegurando que la GPU haya terminado todo el trabajo pendiente primero.
@@ -47,32 +119,257 @@ public:
 
     // Ejecuta el ciclo completo de un frame: adquiere imagen del swapchain,
     // graba comandos, envía a la cola de gráficos y presenta en pantalla.
+    // En modo headless dibuja en el target offscreen y encola su readback.
     void drawFrame();
 
-    // Reemplaza la geometría activa del renderer. Valida la malla, recrea los
-    // buffers de vértices/índices y, si el layout de vértices cambió, recrea
-    // el pipeline gráfico completo.
+    // true si el renderer se construyó con HeadlessConfig.
+    bool isHeadless() const { return headless; }
+
+    // Cambia la política de presentación. Espera a que la GPU termine y, con
+    // ventana, recrea el swapchain si cambia el modo de presentación; en
+    // headless solo cambian los frames en vuelo. No hace nada si es la actual.
+    void setPresentPolicy(PresentPolicy policy);
+    PresentPolicy getPresentPolicy() const { return presentPolicy; }
+
+    // Frames en vuelo de la política actual (1 a MAX_FRAMES_IN_FLIGHT).
+    uint32_t getFramesInFlight() const { return framesInFlight; }
+
+    // true si la GPU expone VK_KHR_present_id y VK_KHR_present_wait, que
+    // LowLatency usa para acompasar los frames con la presentación.
+    bool isPresentWaitSupported() const { return presentWaitSupported; }
+
+    // true si dibujar otro frame cambiaría lo que se ve aunque no llegue nada
+    // nuevo: rotación automática (sin override de transformación), subidas
+    // en cola o sin promocionar, o un swapchain pendiente de recrear. Un
+    // bucle que solo dibuja bajo demanda debe seguir dibujando mientras sea true.
+    bool needsRedraw() const;
+
+    // Píxeles de un frame headless ya copiados a memoria de CPU. Las filas
+    // están contiguas (rowPitch = width * 4) en el formato de colorFormat.
+    struct ReadbackFrame {
+        const uint8_t* pixels = nullptr;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t rowPitch = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint64_t frameNumber = 0;   // Frame headless en que se dibujó (desde 0)
+        uint32_t slot = UINT32_MAX; // Buffer del anillo; lo usa releaseReadback
+    };
+
+    // Toma el frame terminado más antiguo sin bloquear (los frames salen en
+    // orden). Devuelve false si no hay ninguno. Los píxeles son válidos hasta
+    // releaseReadback; mientras tanto su buffer no se reutiliza.
+    bool acquireReadback(ReadbackFrame& outFrame);
+
+    // Devuelve al anillo el buffer de un frame tomado con acquireReadback.
+    void releaseReadback(const ReadbackFrame& frame);
+
+    // Frames cuyo readback se descartó porque el llamador no consumía a
+    // tiempo: la GPU nunca espera a la CPU, así que con el anillo lleno se
+    // sobrescribe el frame terminado más antiguo (o, si todos están tomados
+    // o en vuelo, el frame se dibuja sin readback).
+    uint64_t getDroppedReadbacks() const { return droppedReadbacks; }
+
+    // Añade una malla a la escena y devuelve su handle. La geometría se
+    // sub-asigna dentro de la arena de GPU compartida: no se crea ningún
+    // buffer de Vulkan nuevo salvo que la arena necesite otra página.
+    // La versión const copia los datos; la versión rvalue los consume.
+    MeshHandle addMesh(const Mesh& newMesh);
+    MeshHandle addMesh(Mesh&& newMesh);
+
+    // Reemplaza la geometría de una malla existente sin bloquear: la versión
+    // nueva se sube a rangos propios y sustituye a la actual en el primer
+    // frame tras completarse su transferencia. El resto de la escena no se toca.
+    void updateMesh(MeshHandle handle, const Mesh& newMesh);
+    void updateMesh(MeshHandle handle, Mesh&& newMesh);
+
+    // Elimina una malla de la escena. Sus rangos vuelven a la arena cuando
+    // ningún frame en vuelo puede leerlos ya.
+    void removeMesh(MeshHandle handle);
+
+    // Fija la matriz de modelo propia de una malla (identidad por defecto),
+    // que se aplica tras la de la escena: rotación automática o modelo del
+    // override de setTransform. Cuesta 64 bytes en el buffer de objetos del
+    // próximo frame; no se crea ni se reescribe ningún descriptor set.
+    void setObjectTransform(MeshHandle handle, const glm::mat4& model);
+
+    // Pide compilar en segundo plano la variante del pipeline para el layout
+    // de vértices y la topología de layout (sus vectores de datos se
+    // ignoran). Pensado para layouts que se esperan pronto, como los de un
+    // productor IPC: cuando llegue la primera malla con ese layout, la
+    // variante ya estará lista y el hilo de render no compilará nada.
+    void warmPipelineVariant(const GeometryData& layout);
+
+    // Fija el presupuesto máximo de memoria de staging, en bytes. El staging
+    // crece por segmentos de 8 MB hasta este límite según la demanda.
+    void setStagingBudget(VkDeviceSize bytes);
+
+    // Bytes de subidas aceptadas que aún esperan espacio de staging.
+    VkDeviceSize getPendingUploadBytes() const { return queuedUploadBytes; }
+
+    // Devuelve true si hay subidas esperando espacio de staging. En lugar de
+    // bloquearse, el renderer las transmite en frames posteriores; el llamador
+    // debería posponer nuevas subidas mientras dure la contrapresión.
+    bool isUploadBackpressured() const { return !uploadQueue.empty(); }
+
+    // Región contigua de staging reservada para que el llamador escriba en
+    // ella directamente (por ejemplo, el lector IPC copiando desde la memoria
+    // compartida), de modo que los datos lleguen a vkCmdCopyBuffer con una
+    // sola copia en la CPU.
+    struct StagingWriteRegion {
+        uint8_t* data = nullptr;    // Puntero mapeado donde escribir
+        VkDeviceSize size = 0;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        uint64_t timelineValue = 0; // Lote de subidas al que pertenece (0 = buffer externo)
+    };
+
+    // Reserva size bytes contiguos de staging sin bloquear. Devuelve false si
+    // no hay espacio, si hay subidas en cola (contrapresión) o si size supera
+    // un segmento. Una región que no llega a usarse no necesita devolverse:
+    // se recupera sola cuando termina el lote al que pertenece.
+    bool acquireStagingWrite(VkDeviceSize size, StagingWriteRegion& region);
+
+    // Crea un buffer de staging propiedad del llamador, host-visible y con
+    // mapeo persistente, fuera del anillo de staging. Pensado para hilos que
+    // escriben geometría sin tocar el renderer (ver IngestWorker): el llamador
+    // decide cuándo reescribirlo, y debe esperar con isUploadComplete al
+    // ticket de la última subida que lo leyó. Vive hasta destruir el renderer
+    // o hasta destroyExternalStagingBuffer.
+    StagingWriteRegion createExternalStagingBuffer(VkDeviceSize size);
+
+    // Destruye antes de tiempo un buffer creado con createExternalStagingBuffer
+    // (region es la región que devolvió). Como al reescribirlo, el llamador
+    // debe haber visto completa la última subida que lo leyó.
+    void destroyExternalStagingBuffer(const StagingWriteRegion& region);
+
+    // Devuelve true si la subida con ese ticket (y todas las anteriores) ha
+    // llegado por completo a la GPU. No bloquea.
+    bool isUploadComplete(uint64_t uploadTicket) const;
+
+    // Reemplaza la geometría de la malla por defecto de la escena (flujo de
+    // una sola malla, usado por el lector IPC). La crea en la primera llamada.
     void setMesh(const Mesh& newMesh);
+    void setMesh(Mesh&& newMesh);
+
+    // Igual que setMesh, consumiendo directamente un GeometryData: sus
+    // vectores pasan a la cola de subidas sin ninguna copia.
+    void setGeometry(GeometryData&& geometry);
+
+    // Variante de setMesh cuyos bytes ya están escritos en regiones de
+    // staging obtenidas con acquireStagingWrite en este mismo frame. De
+    // layout solo se usa la metadata (binding, atributos, topología, tipo de
+    // índice, esfera envolvente); sus vectores de datos se ignoran.
+    // indexRegion vacía = sin índices; instanceRegion vacía = sin instancias
+    // (si no, contiene las mat4 por instancia).
+    // Las regiones pueden venir también de createExternalStagingBuffer.
+    // Devuelve el ticket de la subida.
+    uint64_t setMeshFromStaging(const GeometryData& layout, const StagingWriteRegion& vertexRegion,
+        const StagingWriteRegion& indexRegion, const StagingWriteRegion& instanceRegion);
+
+    // Actualización parcial de la malla por defecto: reescribe solo los rangos
+    // de ranges en su versión más reciente (pending si la hay; si no, la que
+    // se dibuja, en su sitio). Los bytes de cada flujo vienen empaquetados en
+    // su región en el orden de ranges, como los deja
+    // SharedGeometryReader::tryRead. De layout se usan los conteos y el
+    // formato, que deben coincidir con los de la versión destino, y la esfera
+    // envolvente, que se actualiza. Devuelve el ticket de la subida, o 0 si
+    // no hay malla o su geometría no es la de layout (la actualización no
+    // aplica y se descarta).
+    uint64_t setMeshRangesFromStaging(const GeometryData& layout, const std::vector<GeometryDirtyRange>& ranges,
+        const StagingWriteRegion& vertexRegion, const StagingWriteRegion& indexRegion,
+        const StagingWriteRegion& instanceRegion);
 
     // Establece una transformación externa (modelo/vista/proyección) que
-    // sobreescribe la rotación automática por defecto.
-    void setTransform(const TransformData& transform);
+    // sobreescribe la rotación automática por defecto. Devuelve false si es
+    // idéntica a la ya activa: no cambia nada y un bucle bajo demanda no
+    // necesita dibujar por ella.
+    bool setTransform(const TransformData& transform);
 
     // Limpia la transformación externa, volviendo a la rotación automática.
     void clearTransformOverride();
 
+    // Activa o desactiva el dibujo GPU-driven (frustum culling en compute y
+    // vkCmdDraw*IndirectCount). Solo tiene efecto si la GPU lo soporta; si no,
+    // o desactivado, se graba un draw por objeto desde la CPU.
+    void setGpuCulling(bool enabled) { gpuCullingEnabled = enabled; }
+    bool isGpuCullingSupported() const { return gpuCullingSupported; }
+
+    // Activa o desactiva los niveles de detalle (desactivados por defecto).
+    // Activados, cada malla indexada de triángulos o puntos que llega con sus
+    // datos en la CPU (addMesh, updateMesh, setMesh, setGeometry) genera en
+    // segundo plano índices simplificados sobre sus mismos vértices, y cada
+    // frame se dibuja el nivel más simple cuyo error proyectado no supera
+    // setLodPixelError píxeles. Desactivarlos vuelve a dibujar todo a
+    // resolución completa; los niveles ya generados se conservan.
+    void setLodEnabled(bool enabled) { lodEnabled = enabled; }
+    bool isLodEnabled() const { return lodEnabled; }
+
+    // Error máximo en pantalla, en píxeles, que se tolera al elegir un nivel.
+    void setLodPixelError(float pixels) { lodPixelError = pixels; }
+
+    // Activa o desactiva el preprocesado de geometría en compute (desactivado
+    // por defecto). Activado, cada malla sin instancias que llega ya escrita
+    // en staging (setMeshFromStaging) con posiciones float o snorm de 16 bits
+    // se analiza en la GPU, sin coste de CPU en la ingesta: su caja
+    // envolvente da la esfera que usan el culling y los niveles de detalle
+    // si el productor no envió una, y en listas de triángulos se calculan
+    // sus normales suaves (ObjectData::normalAddress). Los resultados llegan
+    // unos frames después que la malla, que mientras tanto se dibuja sin ellos.
+    void setGeometryPreprocessing(bool enabled) { geometryPreprocessingEnabled = enabled; }
+    bool isGeometryPreprocessingEnabled() const { return geometryPreprocessingEnabled; }
+
+    // true si la GPU tiene una familia de compute sin gráficos, en cuya cola
+    // el preprocesado corre en paralelo con el dibujo. Si no, usa la de gráficos.
+    bool isAsyncComputeSupported() const { return asyncComputeSupported; }
+
+    // Perfilador del renderer. drawFrame mide sus fases y los timestamps de
+    // GPU; el llamador puede añadir sus propias muestras (p. ej. IpcRead).
+    FrameProfiler& getProfiler() { return profiler; }
+
+    // Percentiles actuales de todas las métricas del perfilador.
+    ProfileSnapshot getProfileSnapshot() const { return profiler.snapshot(); }
+
+    // Recorrido de una actualización de un productor externo, con instantes
+    // en nanosegundos de FrameProfiler::timestampNanoseconds (0 = aún no).
+    struct LatencyTrace {
+        uint64_t sequence = 0;      // Identificador del productor (p. ej. secuencia IPC)
+        uint64_t uploadTicket = 0;  // Subida que lleva sus datos a la GPU
+        uint64_t publishTimeNs = 0; // El productor publicó la actualización
+        uint64_t readTimeNs = 0;    // Se terminó de leer en este proceso
+        uint64_t uploadTimeNs = 0;  // El renderer observó el fin de su subida
+        uint64_t presentTimeNs = 0; // Se presentó el primer frame que la dibuja
+    };
+
+    // Sigue una actualización ya entregada (setMeshFromStaging devolvió
+    // uploadTicket): el renderer sella el fin de su subida y su
+    // presentación, y al presentarse añade al perfilador IpcReadLatency,
+    // IpcUploadLatency y MotionToPhoton. "Presentada" significa aceptada por
+    // vkQueuePresentKHR; el scanout real llega como pronto en el siguiente
+    // vblank.
+    void traceLatency(uint64_t uploadTicket, uint64_t sequence, uint64_t publishTimeNs, uint64_t readTimeNs);
+
+    // Devuelve el recorrido completo más reciente presentado desde la última
+    // llamada, o false si no se ha presentado ninguno nuevo.
+    bool takePresentedLatency(LatencyTrace& outTrace);
+
     // Devuelve el handle del dispositivo lógico para uso externo (por ejemplo,
     // para esperar con vkDeviceWaitIdle antes de cerrar la aplicación).
     VkDevice getDevice() { return device; }
 
 private:
-    // Número máximo de frames que pueden estar en vuelo simultáneamente.
-    // Con 2, mientras la GPU renderiza el frame N, la CPU puede preparar el N+1.
+    // Número máximo de frames que pueden estar en vuelo simultáneamente. Los
+    // recursos por frame se crean para todos; la política de presentación
+    // decide cuántos se usan (framesInFlight).
     // Es constexpr para permitir su uso como tamaño de std::array en tiempo de compilación.
-    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+
+    // Ventana GLFW que posee la superficie de dibujo (nula en modo headless).
+    WindowCreator* window = nullptr;
 
-    // Referencia a la ventana GLFW que posee la superficie de dibujo.
-    WindowCreator& window;
+    // Modo headless: sin superficie ni swapchain (ver HeadlessConfig).
+    bool headless = false;
+    HeadlessConfig headlessConfig{};
 
     // ==========================================================================
     // Handles fundamentales de Vulkan
@@ -105,8 +402,22 @@ private:
     // ejecutan en paralelo con el renderizado. Si no, se usa graphicsQueue.
     VkQueue transferQueue = VK_NULL_HANDLE;
 
+    // Índices de familia de las colas de gráficos y transferencia. Si difieren,
+    // cada subida transfiere la propiedad de los rangos escritos de una
+    // familia a otra (barreras release/acquire).
+    uint32_t graphicsQueueFamily = 0;
+    uint32_t transferQueueFamily = 0;
+
+    // Cola de compute asíncrona para el preprocesado de geometría: la de una
+    // familia de compute sin gráficos si existe (asyncComputeSupported), o
+    // graphicsQueue si no. Puede coincidir con transferQueue si ambas salen
+    // de la misma familia.
+    VkQueue computeQueue = VK_NULL_HANDLE;
+    uint32_t computeQueueFamily = 0;
+    bool asyncComputeSupported = false;
+
     // Superficie de dibujo: puente entre la ventana GLFW y Vulkan.
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
 
     // Render pass: define la estructura de los attachments (color, depth, resolve)
     // y las dependencias de subpass para sincronización automática.
@@ -114,7 +425,7 @@ private:
 
     // Swapchain: cadena de imágenes de presentación propiedad del sistema de
     // ventanas. El renderer adquiere una, dibuja sobre ella y la presenta.
-    VkSwapchainKHR swapChain;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 
     // Formato de color de las imágenes del swapchain (ej: B8G8R8A8_SRGB).
     VkFormat swapChainImageFormat;
@@ -126,15 +437,44 @@ private:
     // disponibles durante la ejecución del pipeline.
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 
-    // Pipeline gráfico: objeto compilado que contiene todas las etapas
-    // (vertex, fragment), estados fijos (rasterización, blending, depth)
-    // y la configuración del vertex input de la geometría actual.
-    VkPipeline graphicsPipeline = VK_NULL_HANDLE;
-
     // Caché de pipeline: acelera la creación de pipelines al reutilizar
-    // resultados de compilación previos durante la misma ejecución.
+    // resultados de compilación previos. Persiste en PIPELINE_CACHE_FILE entre
+    // ejecuciones: se carga al arrancar si la cabecera corresponde a esta GPU
+    // y driver, y se vuelve a escribir al destruir el renderer y, si se
+    // compilaron pipelines nuevos, como mucho cada PIPELINE_CACHE_SAVE_INTERVAL.
     VkPipelineCache pipelineCache = VK_NULL_HANDLE;
 
+    static constexpr const char* PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+    static constexpr std::chrono::seconds PIPELINE_CACHE_SAVE_INTERVAL{ 30 };
+
+    // Prefijo propio del archivo de caché. La cabecera estándar de Vulkan ya
+    // identifica GPU y caché (vendorID, deviceID, pipelineCacheUUID); el
+    // prefijo añade la versión del driver y el tamaño de los datos, para
+    // descartar archivos truncados o de otro driver antes de entregarlos.
+    struct PipelineCacheFileHeader {
+        uint32_t magic;
+        uint32_t driverVersion;
+        uint64_t dataSize;
+    };
+    static constexpr uint32_t PIPELINE_CACHE_FILE_MAGIC = 0x43504B56; // "VKPC"
+
+    // true si se han compilado pipelines desde el último guardado. Atómico
+    // porque el hilo de precompilación también compila.
+    std::atomic<bool> pipelineCacheDirty{ false };
+    std::chrono::steady_clock::time_point lastPipelineCacheSave{};
+
+    // Crea pipelineCache a partir del archivo en disco, si es válido para
+    // este dispositivo; si no, la crea vacía.
+    void createPipelineCache();
+
+    // Escribe el contenido de pipelineCache en disco (archivo temporal +
+    // renombrado, para no dejar nunca un archivo a medias). Los errores se
+    // ignoran: la caché es solo una optimización.
+    void savePipelineCache();
+
+    // Guarda la caché si hay pipelines nuevos y ha pasado el intervalo.
+    void savePipelineCacheIfDue();
+
     // Command pool de gráficos: pool de donde se asignan los command buffers
     // de renderizado. Vinculado a la familia de colas de gráficos.
     VkCommandPool commandPool;
@@ -143,30 +483,501 @@ private:
     // dedicada. Si no hay familia dedicada, apunta al mismo pool de gráficos.
     VkCommandPool transferCommandPool = VK_NULL_HANDLE;
 
+    // Command pool de compute: pool propio de la familia de compute; si es la
+    // de gráficos, apunta al mismo pool de gráficos.
+    VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+
+    // ==========================================================================
+    // Arena de geometría (vértices, índices e instancias de toda la escena)
+    // Páginas de buffers DEVICE_LOCAL grandes con uso VERTEX|INDEX|STORAGE.
+    // Las transformaciones por instancia se leen desde el vertex shader con
+    // la dirección de GPU de la página (buffer device address). Cada página
+    // lleva un bloque virtual de VMA que sub-asigna rangos sin tocar memoria
+    // real, de modo que añadir o reemplazar una malla solo reserva y libera
+    // offsets dentro de buffers que ya existen.
+    // ==========================================================================
+
+    static constexpr VkDeviceSize GEOMETRY_ARENA_PAGE_SIZE = 64 * 1024 * 1024;
+
+    // Página de la arena: buffer real de VRAM más su sub-asignador virtual.
+    struct ArenaPage {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VmaVirtualBlock block = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkDeviceAddress deviceAddress = 0;
+    };
+    std::vector<ArenaPage> arenaPages;
+
+    // Rango sub-asignado dentro de una página. offset ya está alineado al
+    // tamaño de elemento pedido (stride de vértice o tamaño de índice), lo que
+    // permite dibujar con vertexOffset/firstIndex sin re-vincular buffers.
+    struct ArenaRange {
+        uint32_t page = UINT32_MAX;
+        VmaVirtualAllocation allocation = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+
+        bool isValid() const { return page != UINT32_MAX; }
+    };
+
+    // Reserva un rango de al menos size bytes cuyo offset es múltiplo de
+    // elementSize. Si ninguna página tiene hueco, crea una nueva.
+    ArenaRange arenaAllocate(VkDeviceSize size, VkDeviceSize elementSize);
+
+    // Devuelve un rango a su página y lo deja inválido.
+    void arenaFree(ArenaRange& range);
+
+    // Crea una nueva página de la arena con al menos minSize bytes.
+    uint32_t createArenaPage(VkDeviceSize minSize);
+
+    // Libera todos los rangos y destruye las páginas de la arena.
+    void destroyGeometryArena();
+
+    // Rango retirado a la espera de que la GPU deje de usarlo. uploadTicket es
+    // la última subida que escribe en él (0 si ya no hay ninguna).
+    struct RetiredRange {
+        ArenaRange range;
+        uint64_t uploadTicket = 0;
+    };
+
+    // Colas de borrado diferido, una por frame en vuelo. Un rango retirado se
+    // encola en el slot del último frame enviado, el más reciente que puede
+    // leerlo; se libera cuando ese slot vuelve a empezar (su fence ya se ha
+    // señalizado) y su subida, si la tiene, ha terminado.
+    std::array<std::vector<RetiredRange>, MAX_FRAMES_IN_FLIGHT> deletionQueues;
+
+    // Encola un rango para liberarlo cuando la GPU termine con él y lo deja
+    // inválido. No bloquea.
+    void arenaRetire(ArenaRange& range, uint64_t uploadTicket);
+
+    // Buffers propios de una versión (fuera de la arena) con el mismo borrado
+    // diferido por frame. Ninguna subida escribe en ellos, así que basta con
+    // el fence del slot.
+    struct RetiredBuffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+    };
+    std::array<std::vector<RetiredBuffer>, MAX_FRAMES_IN_FLIGHT> bufferDeletionQueues;
+
+    // Encola un buffer para destruirlo cuando ningún frame en vuelo pueda
+    // leerlo y deja los handles nulos. No hace nada con un buffer nulo.
+    void bufferRetire(VkBuffer& buffer, VmaAllocation& allocation);
+
+    // Libera los rangos y buffers de la cola del frame indicado que ya no
+    // están en uso. Se llama tras esperar el fence de ese frame.
+    void processDeletionQueue(uint32_t frameIndex);
+
     // ==========================================================================
-    // Buffers de geometría (vértices e índices)
+    // Escena (mallas activas)
     // ==========================================================================
 
-    // Buffer de vértices en memoria DEVICE_LOCAL (VRAM). Se llena mediante una
-    // copia desde el staging ring buffer para máximo rendimiento de lectura.
-    VkBuffer vertexBuffer = VK_NULL_HANDLE;
-    VmaAllocation vertexBufferAllocation = VK_NULL_HANDLE;
+    // Versión de la geometría de una malla sub-asignada en la arena: layout y
+    // conteos (los vectores de bytes se entregan a la cola de subidas), los
+    // rangos que ocupa, su variante del pipeline, su layout de vertex input
+    // dinámico y el ticket de la última subida que la rellena.
+    struct SceneGeometry {
+        GeometryData geometry;
+        ArenaRange vertexRange;
+        ArenaRange indexRange;
+        ArenaRange instanceRange;
+        uint32_t pipelineIndex = 0;
+        uint32_t vertexInputIndex = 0;  // En vertexInputLayouts; 0 sin vertex input dinámico
+        uint64_t uploadTicket = 0;
+        std::vector<LodLevel> lods;     // Niveles tras los índices originales de indexRange
+        uint64_t lodTicket = 0;         // Subida de los índices de lods
+        uint64_t lodKey = 0;            // Trabajo de LOD que espera esta versión (0 = ninguno)
+        uint64_t preprocessKey = 0;     // Preprocesado que espera esta versión (0 = ninguno)
+        VkBuffer normalBuffer = VK_NULL_HANDLE;   // Normales suaves del preprocesado, si las hay
+        VmaAllocation normalAllocation = VK_NULL_HANDLE;
+        VkDeviceAddress normalAddress = 0;
+    };
+
+    // Malla de la escena con doble buffer: current es la versión que se dibuja
+    // y pending la que se está subiendo. Cuando la subida de pending
+    // termina, se promociona a current y la versión anterior se retira a la
+    // cola de borrado, sin que la CPU espere nunca a la GPU.
+    struct SceneObject {
+        MeshHandle handle = InvalidMeshHandle;
+        std::optional<SceneGeometry> current;
+        std::optional<SceneGeometry> pending;
+        glm::mat4 model{ 1.0f };  // Modelo propio (ver setObjectTransform)
+    };
+
+    // Objetos almacenados de forma contigua para recorrerlos al grabar; el mapa
+    // traduce handle → posición y se corrige al eliminar (swap-and-pop).
+    std::vector<SceneObject> sceneObjects;
+    std::unordered_map<MeshHandle, size_t> sceneObjectIndices;
+    MeshHandle nextMeshHandle = 1;
+
+    // Handle de la malla usada por setMesh (flujo de una sola malla).
+    MeshHandle defaultMeshHandle = InvalidMeshHandle;
+
+    // Orden de dibujo: índices de sceneObjects ordenados por pipeline y página
+    // para minimizar cambios de estado. Se reconstruye solo si la escena cambió.
+    std::vector<uint32_t> drawOrder;
+    bool drawOrderDirty = true;
+
+    // Comprueba que la GPU admite como vertex buffer el formato de cada
+    // atributo (los cuantizados que no son de soporte obligatorio pueden
+    // faltar). Lanza std::runtime_error si alguno no lo es.
+    void validateVertexFormats(const GeometryData& geometry) const;
+
+    // Resuelve la variante del pipeline y reserva en la arena los rangos para
+    // una geometría validada de los tamaños indicados. No sube ningún dato.
+    SceneGeometry allocateSceneGeometry(GeometryData&& geometry, VkDeviceSize vertexBytes, VkDeviceSize indexBytes, VkDeviceSize instanceBytes);
+
+    // Sube una geometría ya validada a rangos nuevos de la arena y devuelve la
+    // versión resultante. Vacía los bytes de geometry al terminar.
+    SceneGeometry uploadSceneGeometry(GeometryData&& geometry);
+
+    // Igual que uploadSceneGeometry, pero copiando a la arena desde regiones
+    // de staging ya escritas por el llamador.
+    SceneGeometry uploadSceneGeometryFromStaging(GeometryData&& layout, const StagingWriteRegion& vertexRegion,
+        const StagingWriteRegion& indexRegion, const StagingWriteRegion& instanceRegion);
+
+    // Añade a la escena un objeto nuevo cuya primera versión es pending.
+    MeshHandle addSceneObject(SceneGeometry&& pending);
+
+    // Rutas comunes de addMesh/updateMesh: validan y suben una geometría
+    // tomando posesión de ella.
+    MeshHandle addGeometry(GeometryData&& geometry);
+    void updateGeometry(MeshHandle handle, GeometryData&& geometry);
+
+    // Sustituye la versión pending de un objeto (retirando la anterior, si
+    // no llegó a promocionarse).
+    void replacePendingGeometry(MeshHandle handle, SceneGeometry&& pending);
+
+    // Retira los rangos de una versión (y sus normales) a la cola de borrado
+    // diferido.
+    void retireSceneGeometry(SceneGeometry& sceneGeometry);
+
+    // Promociona a current las versiones pending cuya subida ya ha
+    // terminado. Se llama al inicio de cada frame, antes de grabar.
+    void promoteCompletedUploads();
+
+    // Ordena drawOrder por (pipeline, topología, vertex input, página de
+    // vértices, página de índices),
+    // incluyendo solo los objetos que tienen una versión current dibujable,
+    // y lo divide en drawBatches.
+    void rebuildDrawOrder();
+
+    // Lote de draws: tramo contiguo de drawOrder que comparte pipeline,
+    // estado dinámico, páginas y tipo de índice, y por tanto se puede emitir con un solo
+    // vkCmdDraw*IndirectCount. Sus comandos ocupan el mismo tramo del buffer
+    // indirecto.
+    struct DrawBatch {
+        uint32_t firstObject = 0;
+        uint32_t objectCount = 0;
+    };
+    std::vector<DrawBatch> drawBatches;
+
+    // ==========================================================================
+    // Datos por objeto y dibujo GPU-driven (culling en compute)
+    // ==========================================================================
+
+    static constexpr uint32_t INITIAL_OBJECT_CAPACITY = 256;
+    static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+
+    // Tamaño de cada comando en el buffer indirecto. Los comandos indexados y
+    // directos comparten buffer y stride: un VkDrawIndirectCommand (16 bytes)
+    // ocupa el slot de un VkDrawIndexedIndirectCommand (20 bytes).
+    static constexpr uint32_t INDIRECT_COMMAND_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+
+    // Buffers por objeto de un frame en vuelo:
+    //   - objectBuffer: ObjectData de cada objeto (host-visible, escrito cada frame).
+    //   - indirectBuffer: comandos compactados por el culling (device-local).
+    //   - countBuffer: número de comandos visibles de cada lote (device-local).
+    // Todos tienen capacidad para capacity objetos (y lotes).
+    struct FrameObjectBuffers {
+        VkBuffer objectBuffer = VK_NULL_HANDLE;
+        VmaAllocation objectAllocation = VK_NULL_HANDLE;
+        ObjectData* objectMapped = nullptr;
+        VkBuffer indirectBuffer = VK_NULL_HANDLE;
+        VmaAllocation indirectAllocation = VK_NULL_HANDLE;
+        VkBuffer countBuffer = VK_NULL_HANDLE;
+        VmaAllocation countAllocation = VK_NULL_HANDLE;
+        uint32_t capacity = 0;
+    };
+    std::array<FrameObjectBuffers, MAX_FRAMES_IN_FLIGHT> frameObjects{};
+
+    // Matriz de modelo de la escena en el frame actual (la rotación por
+    // defecto o la del override externo), calculada en updateUniformBuffer.
+    glm::mat4 frameModel{ 1.0f };
+
+    // Producto proyección × vista del frame actual, para los planos del frustum.
+    glm::mat4 frameViewProj{ 1.0f };
+
+    // La GPU soporta multiDrawIndirect, drawIndirectFirstInstance y
+    // drawIndirectCount; gpuCullingEnabled lo elige el usuario.
+    bool gpuCullingSupported = false;
+    bool gpuCullingEnabled = true;
+
+    // Compute pipeline de culling: set 0 = objetos, comandos y contadores
+    // del frame; push constants = planos del frustum y número de objetos.
+    VkDescriptorSetLayout cullDescriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> cullDescriptorSets{};
+
+    // Push constants del compute de culling.
+    struct CullPushConstants {
+        glm::vec4 frustumPlanes[6];
+        uint32_t objectCount;
+    };
+
+    bool isGpuCullingActive() const { return gpuCullingSupported && gpuCullingEnabled; }
+
+    // Crea los buffers por objeto de cada frame con la capacidad inicial.
+    void createObjectBuffers();
+
+    // Destruye los buffers por objeto de todos los frames.
+    void destroyObjectBuffers();
+
+    // Crea y destruye los buffers por objeto de un frame.
+    void createFrameObjectBuffers(uint32_t frameIndex, uint32_t capacity);
+    void destroyFrameObjectBuffers(uint32_t frameIndex);
+
+    // Garantiza capacidad para objectCount objetos en los buffers del frame,
+    // recreándolos (y reescribiendo sus descriptores) si hace falta. Se llama
+    // tras esperar el fence del frame, cuando la GPU ya no los usa.
+    void ensureObjectCapacity(uint32_t frameIndex, uint32_t objectCount);
+
+    // Apunta los descriptores del frame (binding 1 gráfico y set de culling)
+    // a sus buffers por objeto actuales.
+    void writeObjectDescriptors(uint32_t frameIndex);
+
+    // Escribe el ObjectData de cada objeto de drawOrder en el buffer del frame.
+    void updateObjectBuffer(uint32_t frameIndex);
+
+    // Crea el descriptor set layout, pipeline layout y pipeline de culling.
+    void createCullingPipeline();
+
+    // Destruye los objetos de createCullingPipeline.
+    void destroyCullingPipeline();
+
+    // Graba, fuera del render pass, la puesta a cero de los contadores, el
+    // dispatch de culling y las barreras hacia la lectura indirecta.
+    void recordCulling(VkCommandBuffer commandBuffer);
+
+    // Graba un vkCmdDraw*IndirectCount por lote de drawBatches.
+    void recordIndirectDraws(VkCommandBuffer commandBuffer);
+
+    // ==========================================================================
+    // Niveles de detalle (LOD)
+    // Los niveles de una malla son índices simplificados (ver mesh_lod.hpp)
+    // que se generan en lodThread y se suben justo detrás de sus índices
+    // originales, en el hueco que allocateSceneGeometry deja al final de
+    // indexRange: comparten página con ellos, así que elegir un nivel solo
+    // cambia firstIndex e indexCount, sin tocar lotes ni vinculaciones.
+    // ==========================================================================
+
+    bool lodEnabled = false;
+    float lodPixelError = 1.0f;
+
+    // Índices mínimos de una malla para generarle niveles.
+    static constexpr uint32_t LOD_MIN_INDEX_COUNT = 4096;
+
+    // Vista y proyección del frame actual, calculadas en updateUniformBuffer,
+    // con las que se proyecta el error de cada nivel.
+    glm::mat4 frameView{ 1.0f };
+    glm::mat4 frameProj{ 1.0f };
+
+    // Nivel elegido para cada posición de drawOrder en el frame actual
+    // (0 = malla original, k = lods[k - 1]). Lo escribe updateObjectBuffer y
+    // lo leen los hilos de grabación de recordDraws.
+    std::vector<uint8_t> frameLodLevels;
+
+    // Trabajo del hilo de LOD: copia de los vértices e índices de una
+    // versión, identificada por su lodKey. Los índices generados no pueden
+    // pasar de maxIndices, el hueco reservado tras los originales.
+    struct LodJob {
+        uint64_t key = 0;
+        GeometryData geometry;
+        size_t maxIndices = 0;
+    };
+
+    // Niveles generados, con sus índices ya empaquetados en el tipo de índice
+    // de la malla y listos para subir.
+    struct LodResult {
+        uint64_t key = 0;
+        std::vector<LodLevel> levels;
+        std::vector<uint8_t> indexData;
+    };
+
+    // Estado compartido con lodThread, protegido por lodMutex. lodResultsReady
+    // permite a needsRedraw y adoptLodResults comprobar sin bloquear si hay
+    // resultados.
+    std::thread lodThread;
+    std::mutex lodMutex;
+    std::condition_variable lodCondition;
+    std::deque<LodJob> lodQueue;
+    std::vector<LodResult> lodResults;
+    std::atomic<bool> lodResultsReady{ false };
+    bool lodShutdown = false;
+    uint64_t nextLodKey = 1;
+
+    // Arrancan y detienen el hilo de LOD.
+    void createLodBuilder();
+    void destroyLodBuilder();
+
+    // Bucle del hilo de LOD.
+    void lodBuildLoop();
+
+    // Índices que se reservan al final de indexRange para los niveles de una
+    // geometría (0 si no admite niveles o están desactivados).
+    uint32_t getLodIndexHeadroom(const GeometryData& geometry) const;
+
+    // Encola la generación de niveles de una geometría con sus datos aún en
+    // la CPU (se copian) y devuelve la clave del trabajo.
+    uint64_t queueLodBuild(const GeometryData& geometry, uint32_t maxIndices);
+
+    // Descarta el trabajo de una versión que se retira, si aún está en cola.
+    void cancelLodBuild(uint64_t key);
+
+    // Sube los niveles terminados a las versiones que aún los esperan. Se
+    // llama cada frame, tras promoteCompletedUploads.
+    void adoptLodResults();
+
+    // Nivel que se debe dibujar de un objeto en el frame actual.
+    uint8_t selectLodLevel(const SceneObject& sceneObject) const;
+
+    // Primer índice y número de índices del nivel level de una versión.
+    static void getLodDrawRange(const SceneGeometry& object, uint8_t level, uint32_t& firstIndex, uint32_t& indexCount);
+
+    // ==========================================================================
+    // Preprocesado de geometría (compute asíncrono)
+    // Las mallas que llegan por staging nunca pasan por la CPU del renderer,
+    // así que sus límites y normales se calculan en la GPU: el mismo lote que
+    // las sube a la arena copia también sus vértices e índices al buffer de
+    // trabajo de un slot, y preprocess.comp los recorre en computeQueue tras
+    // esperar a ese lote en transferTimeline. Cada trabajo señaliza su valor
+    // de computeTimeline; cuando la CPU lo ve completo, lee la caja
+    // envolvente y entrega las normales a la versión que aún lo espera. Los
+    // buffers que cruzan de familia se crean CONCURRENT, así que no hacen
+    // falta barreras de propiedad entre colas.
+    // ==========================================================================
+
+    bool geometryPreprocessingEnabled = false;
+
+    // Trabajos simultáneos. Con todos los slots ocupados, la malla siguiente
+    // se dibuja sin preprocesar, como con el preprocesado desactivado.
+    static constexpr uint32_t PREPROCESS_SLOT_COUNT = 2;
+    static constexpr uint32_t PREPROCESS_WORKGROUP_SIZE = 64;
+
+    // Bytes por slot en el buffer de cajas: min[3] y max[3] como uint
+    // ordenados (ver preprocess.comp), redondeados a 32.
+    static constexpr VkDeviceSize PREPROCESS_BOUNDS_STRIDE = 32;
+
+    // Alineación de los índices tras los vértices en el buffer de trabajo.
+    static constexpr VkDeviceSize PREPROCESS_STREAM_ALIGNMENT = 16;
+
+    // Push constants de preprocess.comp (mismo orden que PreprocessParams).
+    // Los offsets y el stride van en palabras de 4 bytes.
+    struct PreprocessPushConstants {
+        glm::vec4 positionScale;
+        glm::vec4 positionOffset;
+        VkDeviceAddress sourceAddress;   // Buffer de trabajo del slot
+        VkDeviceAddress normalAddress;   // Normales de la versión (0 sin normales)
+        VkDeviceAddress boundsAddress;   // Caja del slot
+        uint32_t pass;                   // 0 = caja, 1 = normales de cara, 2 = normalización
+        uint32_t vertexCount;
+        uint32_t indexCount;             // 0 = sin índices
+        uint32_t indexWordOffset;
+        uint32_t indexFormat;            // 0 = uint32, 1 = uint16
+        uint32_t strideWords;
+        uint32_t positionWordOffset;
+        uint32_t positionFormat;         // 0 = float, 1 = snorm de 16 bits
+    };
 
-    // Buffer de índices en DEVICE_LOCAL. Permite reutilizar vértices compartidos
-    // entre triángulos, reduciendo el consumo de memoria y ancho de banda.
-    VkBuffer indexBuffer = VK_NULL_HANDLE;
-    VmaAllocation indexBufferAllocation = VK_NULL_HANDLE;
+    // Slot de preprocesado: buffer de trabajo (crece bajo demanda), command
+    // buffer de compute y el trabajo en curso, si lo hay (key != 0).
+    // computeValue es 0 mientras el lote de subidas del trabajo no se ha
+    // enviado; las normales son del slot hasta que se entregan.
+    struct PreprocessSlot {
+        VkBuffer scratchBuffer = VK_NULL_HANDLE;
+        VmaAllocation scratchAllocation = VK_NULL_HANDLE;
+        VkDeviceSize scratchCapacity = 0;
+        VkDeviceAddress scratchAddress = 0;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint64_t key = 0;
+        uint64_t transferValue = 0;     // Lote de subidas que llena el buffer de trabajo
+        uint64_t computeValue = 0;      // Valor de computeTimeline del trabajo
+        bool computesBounds = false;
+        VkBuffer normalBuffer = VK_NULL_HANDLE;
+        VmaAllocation normalAllocation = VK_NULL_HANDLE;
+        VkDeviceAddress normalAddress = 0;
+    };
+    std::array<PreprocessSlot, PREPROCESS_SLOT_COUNT> preprocessSlots{};
+
+    // Cajas de todos los slots, en memoria host-visible que la CPU lee al
+    // completarse cada trabajo.
+    VkBuffer preprocessBoundsBuffer = VK_NULL_HANDLE;
+    VmaAllocation preprocessBoundsAllocation = VK_NULL_HANDLE;
+    const uint32_t* preprocessBoundsMapped = nullptr;
+    VkDeviceAddress preprocessBoundsAddress = 0;
+
+    // Compute pipeline de preprocesado: sin descriptor sets, todo por
+    // dirección de GPU en las push constants.
+    VkPipelineLayout preprocessPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline preprocessPipeline = VK_NULL_HANDLE;
+
+    // Grupos máximos por dispatch (maxComputeWorkGroupCount[0]); una malla
+    // que no cabe en un dispatch no se preprocesa.
+    uint32_t preprocessMaxGroupCount = 0;
+
+    // Timeline de la cola de compute: cada trabajo lo lleva a su computeValue.
+    VkSemaphore computeTimeline = VK_NULL_HANDLE;
+    uint64_t nextComputeValue = 1;
+    uint64_t nextPreprocessKey = 1;
+
+    // Valor de computeTimeline que el submit del frame en grabación debe
+    // esperar (0 si no estrena normales).
+    uint64_t frameComputeWaitValue = 0;
+
+    // Crean y destruyen el pipeline, el buffer de cajas, los command buffers
+    // de los slots y computeTimeline.
+    void createGeometryPreprocessor();
+    void destroyGeometryPreprocessor();
+
+    // Crea un buffer device-local con dirección de GPU, compartido
+    // (CONCURRENT) entre dos familias si difieren.
+    void createPreprocessBuffer(VkDeviceSize size, VkBufferUsageFlags usage, uint32_t familyA, uint32_t familyB,
+        VkBuffer& buffer, VmaAllocation& allocation, VkDeviceAddress& address);
+
+    // true si la geometría admite preprocesado (ver setGeometryPreprocessing).
+    bool canPreprocessGeometry(const GeometryData& geometry) const;
+
+    // Graba en el lote abierto la copia de las regiones al buffer de trabajo
+    // de un slot libre y, en su command buffer, el trabajo de compute.
+    // Devuelve la clave del trabajo, o 0 si no hay nada que calcular, la
+    // geometría no lo admite o no queda slot libre.
+    uint64_t queueGeometryPreprocess(const GeometryData& geometry, const StagingWriteRegion& vertexRegion,
+        const StagingWriteRegion& indexRegion);
+
+    // Envía a computeQueue los trabajos cuyo lote de subidas ya se envió.
+    // Se llama cada frame, tras submitUploadBatch.
+    void submitGeometryPreprocessing();
+
+    // Entrega los resultados de los trabajos completados a las versiones que
+    // aún los esperan, libera sus slots y fija frameComputeWaitValue. Se
+    // llama cada frame, tras adoptLodResults.
+    void adoptPreprocessResults();
+
+    // Desliga una versión de su preprocesado: descarta el trabajo que aún
+    // espera y retira sus normales.
+    void dropPreprocessedData(SceneGeometry& sceneGeometry);
 
     // ==========================================================================
     // Descriptores (UBO binding)
     // ==========================================================================
 
-    // Layout del descriptor set: describe que el binding 0 es un uniform buffer
-    // accesible desde el vertex shader.
+    // Layout del descriptor set: el binding 0 es el uniform buffer de cámara y
+    // el binding 1 el storage buffer de ObjectData, ambos del vertex shader.
     VkDescriptorSetLayout descriptorSetLayout;
 
-    // Pool de descriptores: reserva espacio para MAX_FRAMES_IN_FLIGHT
-    // descriptor sets de tipo uniform buffer.
+    // Pool de descriptores: reserva espacio para los sets gráficos y de
+    // culling de cada frame en vuelo.
     VkDescriptorPool descriptorPool;
 
     // Descriptor sets asignados, uno por frame en vuelo, cada uno apuntando
@@ -210,53 +1021,203 @@ private:
     // lecturas de archivo repetidas.
     VkShaderModule cachedVertShaderModule = VK_NULL_HANDLE;
     VkShaderModule cachedFragShaderModule = VK_NULL_HANDLE;
+    VkShaderModule cachedCullShaderModule = VK_NULL_HANDLE;
+    VkShaderModule cachedPreprocessShaderModule = VK_NULL_HANDLE;
 
     // ==========================================================================
-    // Staging Ring Buffer
-    // Buffer circular de 8 MB en memoria HOST_VISIBLE para subir datos a la GPU.
-    // Los datos se escriben secuencialmente y se copian a buffers DEVICE_LOCAL
-    // mediante comandos de transferencia asíncronos con fences individuales.
-    // Antes de sobreescribir una región, se verifica que las transferencias
-    // pendientes que la usan hayan completado.
+    // Staging (segmentos circulares) y cola de subidas
+    // Memoria HOST_VISIBLE para subir datos a la GPU, organizada en segmentos
+    // de 8 MB que funcionan como buffers circulares independientes. Se añaden
+    // segmentos bajo demanda hasta stagingBudget. Las subidas se encolan en
+    // orden FIFO y se copian por trozos a medida que hay espacio, de modo que
+    // una malla mayor que un segmento se transmite a lo largo de varios submits
+    // sin bloquear la CPU. Cada lote de copias señaliza un valor propio de un
+    // timeline semaphore, que la CPU sondea y el submit de gráficos espera.
     // ==========================================================================
 
-    static constexpr VkDeviceSize STAGING_RING_SIZE = 8 * 1024 * 1024;
-    VkBuffer stagingRingBuffer = VK_NULL_HANDLE;
-    VmaAllocation stagingRingAllocation = VK_NULL_HANDLE;
-    void* stagingRingMapped = nullptr;  // Puntero persistente al mapeo del buffer
-    VkDeviceSize stagingRingOffset = 0; // Posición de escritura actual en el anillo
+    static constexpr VkDeviceSize STAGING_SEGMENT_SIZE = 8 * 1024 * 1024;
+    static constexpr VkDeviceSize DEFAULT_STAGING_BUDGET = 64 * 1024 * 1024;
+
+    // Tamaño mínimo de un trozo: por debajo de esto se prefiere esperar a que
+    // se libere espacio (o crecer) antes que fragmentar la copia en exceso.
+    static constexpr VkDeviceSize STAGING_MIN_CHUNK = 256 * 1024;
 
-    // Representa una transferencia DMA en curso con su fence de sincronización
-    // y la región del ring buffer que ocupa (para detección de solapamiento).
-    struct PendingTransfer {
-        VkFence fence;              // Fence que se señaliza cuando la copia termina
-        VkCommandBuffer commandBuffer; // Command buffer de un solo uso para la copia
-        VkDeviceSize ringOffset;    // Inicio de la región usada en el staging ring
-        VkDeviceSize ringSize;      // Tamaño de la región usada
+    // Región de un segmento ocupada por una copia cuyo lote aún no ha terminado.
+    struct StagingRegion {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint64_t timelineValue;     // Valor que señaliza su lote al terminar
     };
-    std::vector<PendingTransfer> pendingTransfers;
 
-    // Crea el staging ring buffer con VMA y obtiene el puntero mapeado persistente.
-    void createStagingRing();
+    // Segmento de staging: buffer con mapeo persistente gestionado como anillo.
+    // Las regiones en vuelo se liberan en el mismo orden en que se reservaron
+    // (el timeline solo avanza), así que basta con una cola y un cabezal.
+    struct StagingSegment {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        uint8_t* mapped = nullptr;
+        VkDeviceSize size = 0;
+        VkDeviceSize head = 0;      // Siguiente posición de escritura
+        std::deque<StagingRegion> inFlight;
+    };
+    std::vector<StagingSegment> stagingSegments;
 
-    // Espera todas las transferencias pendientes y destruye el staging ring buffer.
-    void destroyStagingRing();
+    // Buffers de staging creados con createExternalStagingBuffer. No cuentan
+    // para el presupuesto del anillo.
+    struct ExternalStagingBuffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+    };
+    std::vector<ExternalStagingBuffer> externalStagingBuffers;
+
+    // Presupuesto total de memoria de staging y capacidad asignada actualmente.
+    VkDeviceSize stagingBudget = DEFAULT_STAGING_BUDGET;
+    VkDeviceSize stagingCapacity = 0;
+
+    // Trozo de staging reservado para una copia.
+    struct StagingChunk {
+        uint32_t segment;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    // Subida aceptada pero aún no copiada por completo al staging. Posee los
+    // datos para poder seguir transmitiéndolos en frames posteriores.
+    struct QueuedUpload {
+        uint64_t ticket;
+        VkBuffer dstBuffer;
+        VkDeviceSize dstOffset;
+        std::vector<uint8_t> data;
+        VkDeviceSize written = 0;
+    };
+    std::deque<QueuedUpload> uploadQueue;
+    VkDeviceSize queuedUploadBytes = 0;
+
+    // Tickets de subida: se asignan en orden y, como la cola es FIFO, también
+    // terminan en orden. Toda subida con ticket <= completedUploadTicket ha
+    // llegado por completo a su buffer destino.
+    uint64_t nextUploadTicket = 1;
+    uint64_t completedUploadTicket = 0;
+
+    // Siguiente valor del timeline a asignar a un lote (0 significa "ninguno").
+    uint64_t nextTransferId = 1;
+
+    // Lote de subidas: command buffer reciclado que acumula todas las copias
+    // emitidas entre dos frames y se envía en un único vkQueueSubmit.
+    // lastUploadTicket es el mayor ticket cuya última copia va en este lote.
+    // bytes, querySlot y submitTime alimentan al perfilador.
+    struct UploadBatch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint64_t timelineValue = 0;
+        uint64_t lastUploadTicket = 0;
+        VkDeviceSize bytes = 0;                 // Bytes copiados en el lote
+        uint32_t querySlot = UINT32_MAX;        // Par de timestamps en transferQueryPool
+        bool waitsForFrames = false;            // Escribe rangos que los frames enviados leen
+        std::chrono::steady_clock::time_point submitTime{};
+    };
+
+    // Lote abierto en grabación (commandBuffer nulo si no hay ninguno).
+    UploadBatch openUploadBatch;
+
+    // Lotes enviados cuyo valor del timeline aún no se ha alcanzado.
+    std::vector<UploadBatch> inFlightUploadBatches;
+
+    // Command buffers de transferencia ya reseteados, listos para reutilizarse.
+    // Se asignan una sola vez y se reciclan, sin vkAllocate/vkFree por subida.
+    std::vector<VkCommandBuffer> freeUploadCommandBuffers;
+
+    // Abre un lote de subidas si no hay ninguno, reutilizando un command buffer
+    // libre (o asignando uno si el pool está vacío).
+    void beginUploadBatch();
+
+    // Cierra y envía el lote abierto a la cola de transferencia, señalizando
+    // su valor del timeline (y, si waitsForFrames, esperando en frameTimeline
+    // a los frames ya enviados). No hace nada si no hay lote abierto.
+    void submitUploadBatch();
+
+    // Timeline semaphore de la cola de transferencia: su contador alcanza el
+    // valor de cada lote cuando éste termina.
+    VkSemaphore transferTimeline = VK_NULL_HANDLE;
+
+    // Último valor del timeline observado por la CPU (actualizado en
+    // flushCompletedTransfers). Todo lote con valor <= este terminó.
+    uint64_t completedTransferValue = 0;
+
+    // Rango escrito por una copia que la cola de gráficos aún debe adquirir
+    // antes de leerlo: barrera acquire si las familias difieren, y en
+    // cualquier caso una espera sobre el timeline en el submit del frame.
+    // inPlace marca una escritura sobre una versión que ya se dibuja: se
+    // adquiere en cuanto su lote está enviado, sin esperar a que termine.
+    struct PendingAcquire {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint64_t timelineValue;
+        bool inPlace = false;
+    };
+    std::vector<PendingAcquire> pendingAcquires;
 
-    // Escribe datos en la posición actual del ring. Si al avanzar se solaparía con
-    // transferencias pendientes, espera a que éstas terminen antes de sobreescribir.
-    // Devuelve el offset dentro del ring donde se escribieron los datos.
-    VkDeviceSize stagingRingWrite(const void* data, VkDeviceSize size);
+    // Valor del timeline que el submit del frame en grabación debe esperar
+    // (0 si el frame no consume ninguna subida nueva).
+    uint64_t frameTransferWaitValue = 0;
 
-    // Sube datos a un buffer DEVICE_LOCAL: escribe en el staging ring, graba un
-    // comando de copia, lo envía a la cola de transferencia con un fence y lo
-    // registra como transferencia pendiente.
-    void transferToDeviceLocal(VkBuffer dstBuffer, const void* data, VkDeviceSize size);
+    // Graba las barreras acquire de las copias ya completadas (y de las
+    // escrituras en el sitio ya enviadas) y fija frameTransferWaitValue. Se
+    // llama antes del render pass.
+    void recordTransferAcquires(VkCommandBuffer commandBuffer);
+
+    // Bloquea hasta que el timeline alcance timelineValue, y recicla las
+    // transferencias terminadas.
+    void waitForTransfer(uint64_t timelineValue);
+
+    // Crea el primer segmento de staging y el timeline semaphore.
+    void createStagingRing();
 
-    // Recorre las transferencias pendientes y libera las que ya han completado
-    // (según su fence), recuperando sus regiones del ring para reutilización.
+    // Espera todas las transferencias pendientes y destruye los segmentos de
+    // staging y el timeline semaphore.
+    void destroyStagingRing();
+
+    // Crea un segmento de staging nuevo con mapeo persistente.
+    uint32_t createStagingSegment();
+
+    // Reserva un trozo contiguo de staging de entre minSize y maxSize bytes
+    // sin esperar: busca hueco en los segmentos existentes y, si no lo hay,
+    // añade uno mientras quepa en el presupuesto. Devuelve false si no hay
+    // espacio.
+    bool stagingAcquire(VkDeviceSize minSize, VkDeviceSize maxSize, StagingChunk& chunk);
+
+    // Copia al staging tantos trozos de la cola de subidas como quepan, sin
+    // bloquear, y graba sus copias en el lote abierto.
+    void pumpUploads();
+
+    // Encola una subida a un buffer DEVICE_LOCAL a partir de dstOffset, tomando
+    // posesión de los datos, e intenta transmitirla de inmediato. Las copias se
+    // envían una vez por frame en submitUploadBatch. Devuelve el ticket de la
+    // subida, con el que el llamador puede sondear su finalización.
+    uint64_t transferToDeviceLocal(VkBuffer dstBuffer, VkDeviceSize dstOffset, std::vector<uint8_t>&& data);
+
+    // Graba la copia de una región de staging ya escrita hacia dstOffset en
+    // el lote abierto y devuelve el ticket de la subida. La región debe
+    // pertenecer al lote abierto (o ser externa) y no puede haber subidas en
+    // cola delante.
+    uint64_t transferFromStaging(VkBuffer dstBuffer, VkDeviceSize dstOffset, const StagingWriteRegion& region);
+
+    // Como transferFromStaging, pero graba varias copias: en cada una,
+    // srcOffset es relativo a region y dstOffset, a dstBase. Con inPlace, el
+    // destino es una versión que se está dibujando y el lote espera antes a
+    // los frames ya enviados.
+    uint64_t transferRangesFromStaging(VkBuffer dstBuffer, VkDeviceSize dstBase, const StagingWriteRegion& region,
+        const std::vector<VkBufferCopy>& copies, bool inPlace);
+
+    // Devuelve true si el lote con ese valor del timeline (y todos los
+    // anteriores) ha completado. No bloquea.
+    bool isTransferComplete(uint64_t timelineValue) const;
+
+    // Lee el contador del timeline, libera las regiones de staging de los
+    // lotes completados y recicla sus command buffers.
     void flushCompletedTransfers();
 
-    // Bloquea hasta que todas las transferencias pendientes hayan completado.
+    // Bloquea hasta que todas las subidas encoladas y en vuelo hayan completado.
     // Se usa antes de destruir buffers que podrían estar siendo copiados.
     void waitAllTransfers();
 
@@ -264,6 +1225,9 @@ private:
     // Funciones de inicialización (se llaman en orden desde el constructor)
     // ==========================================================================
 
+    // Secuencia de creación común a los dos constructores.
+    void initVulkan();
+
     // Crea la instancia de Vulkan con las extensiones requeridas por GLFW
     // y, opcionalmente, las capas de validación para depuración.
     void createInstance();
@@ -275,8 +1239,9 @@ private:
     // familias de colas necesarias y la extensión VK_KHR_swapchain.
     void pickPhysicalDevice();
 
-    // Crea el dispositivo lógico con las colas de gráficos, presentación y
-    // transferencia (si hay familia dedicada), y habilita sample rate shading.
+    // Crea el dispositivo lógico con las colas de gráficos, presentación,
+    // transferencia y compute (si hay familias dedicadas), y habilita sample
+    // rate shading y timeline semaphores.
     void createLogicalDevice();
 
     // Inicializa el asignador VMA, que gestiona la memoria de GPU en pools.
@@ -299,24 +1264,94 @@ private:
     // attachments de profundidad y, si MSAA está activo, el attachment de color.
     void createFramebuffers();
 
-    // Crea el pipeline gráfico completo: shaders, vertex input, rasterización,
-    // multisampling, depth test, color blending y estados dinámicos.
-    void createGraphicsPipeline();
-
-    // Destruye el pipeline y layout actuales y los recrea. Se invoca cuando
-    // cambia el layout de vértices o la topología de la malla.
-    void recreateGraphicsPipeline();
-
-    // Crea los command pools para las colas de gráficos y transferencia.
+    // Crea el pipeline layout compartido por todas las variantes del pipeline.
+    void createPipelineLayout();
+
+    // Crea el pipeline gráfico completo para un layout de vértices y topología:
+    // shaders, vertex input, rasterización, multisampling, depth test, color
+    // blending y estados dinámicos.
+    VkPipeline createGraphicsPipeline(const VkVertexInputBindingDescription& bindingDescription,
+        const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions,
+        VkPrimitiveTopology topology);
+
+    // Destruye y recrea todas las variantes del pipeline. Se invoca cuando
+    // cambia el render pass (tras recrear el swapchain).
+    void recreateGraphicsPipelines();
+
+    // Destruye todas las variantes del pipeline.
+    void destroyGraphicsPipelines();
+
+    // Devuelve el índice de la variante del pipeline compatible con la
+    // geometría, creándola si es la primera malla con ese layout/topología.
+    // Si la variante se está precompilando, espera a ese resultado en vez de
+    // compilarla dos veces.
+    uint32_t findOrCreatePipelineVariant(const GeometryData& geometry);
+
+    // Parte del estado de la geometría que queda horneada en el pipeline:
+    // sin vertex input si es dinámico y con la clase de la topología si la
+    // topología es dinámica. Devuelve la variante (sin compilar) con su clave.
+    struct PipelineVariant;
+    PipelineVariant describePipelineVariant(const GeometryData& geometry) const;
+
+    // Topología representativa de la clase de topology (POINT_LIST,
+    // LINE_LIST, TRIANGLE_LIST o PATCH_LIST).
+    static VkPrimitiveTopology getTopologyClass(VkPrimitiveTopology topology);
+
+    // Devuelve el índice del layout de vertex input dinámico de la geometría,
+    // registrándolo si es nuevo.
+    uint32_t findOrCreateVertexInputLayout(const GeometryData& geometry);
+
+    // Hash de un layout de vértices.
+    static uint64_t hashVertexLayout(const VkVertexInputBindingDescription& bindingDescription,
+        const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
+
+    // Hash del layout de vértices y la topología de una variante.
+    static uint64_t hashPipelineVariant(const VkVertexInputBindingDescription& bindingDescription,
+        const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions,
+        VkPrimitiveTopology topology);
+
+    // Busca una variante existente con ese layout y topología (-1 si no hay).
+    int32_t findPipelineVariant(uint64_t key, const VkVertexInputBindingDescription& bindingDescription,
+        const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions,
+        VkPrimitiveTopology topology) const;
+
+    // Registra una variante ya compilada y devuelve su índice.
+    uint32_t addPipelineVariant(PipelineVariant&& variant);
+
+    // Pasa a pipelineVariants los resultados del hilo de precompilación.
+    void adoptWarmedPipelines();
+
+    // Arrancan y detienen el hilo de precompilación.
+    void createPipelineWarmer();
+    void destroyPipelineWarmer();
+
+    // Detienen y reanudan el hilo de precompilación mientras el render pass
+    // se destruye y se vuelve a crear. pause espera a que termine la
+    // compilación en curso.
+    void pausePipelineWarmer();
+    void resumePipelineWarmer();
+
+    // Bucle del hilo de precompilación.
+    void pipelineWarmLoop();
+
+    // Crea los command pools para las colas de gráficos, transferencia y compute.
     void createCommandPool();
 
-    // Asigna MAX_FRAMES_IN_FLIGHT command buffers del pool de gráficos.
+    // Asigna MAX_FRAMES_IN_FLIGHT command buffers del pool de gráficos, más el
+    // de operaciones puntuales.
     void createCommandBuffers();
 
     // Crea los semáforos (imagen disponible, render terminado) y fences
     // (sincronización CPU-GPU) para cada frame en vuelo.
     void createSyncObjects();
 
+    // Crea los slices de grabación paralela (un command pool y un secondary
+    // command buffer por frame en vuelo para cada uno) y lanza sus hilos.
+    void createRecordWorkers();
+
+    // Detiene los hilos de grabación y destruye sus command pools.
+    void destroyRecordWorkers();
+
     // Crea la imagen y vista de profundidad con el nivel de MSAA correspondiente.
     void createDepthResources();
 
@@ -352,12 +1387,6 @@ private:
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
         VkBuffer& buffer, VmaAllocation& allocation);
 
-    // Crea el buffer de vértices DEVICE_LOCAL y lo llena con transferToDeviceLocal.
-    void createVertexBuffer();
-
-    // Crea el buffer de índices DEVICE_LOCAL y lo llena con transferToDeviceLocal.
-    void createIndexBuffer();
-
     // Crea un uniform buffer HOST_VISIBLE por cada frame en vuelo, con mapeo
     // persistente para actualizaciones directas con memcpy cada frame.
     void createUniformBuffers();
@@ -379,16 +1408,25 @@ private:
     void updateUniformBuffer(uint32_t currentImage);
 
     // Compara el layout de vértices (binding description y attribute descriptions)
-    // de la geometría actual con una nueva, para decidir si hay que recrear el pipeline.
-    bool isVertexLayoutDifferent(const GeometryData& other) const;
-
-    // Asigna un command buffer temporal del pool de gráficos, marcado como
-    // ONE_TIME_SUBMIT para operaciones puntuales.
+    // de dos geometrías, para decidir si pueden compartir el mismo pipeline.
+    static bool isSameVertexLayout(const VkVertexInputBindingDescription& bindingA,
+        const std::vector<VkVertexInputAttributeDescription>& attributesA,
+        const VkVertexInputBindingDescription& bindingB,
+        const std::vector<VkVertexInputAttributeDescription>& attributesB);
+
+    // Resetea y abre el command buffer reutilizable de operaciones puntuales,
+    // marcado como ONE_TIME_SUBMIT.
     VkCommandBuffer beginSingleTimeCommands();
 
-    // Finaliza, envía y espera (con fence) un command buffer temporal, luego lo libera.
+    // Finaliza, envía y espera (con el fence reutilizable) el command buffer
+    // de operaciones puntuales.
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
+    // Command buffer y fence de las operaciones puntuales, creados una sola vez
+    // con el resto de command buffers y objetos de sincronización.
+    VkCommandBuffer singleTimeCommandBuffer = VK_NULL_HANDLE;
+    VkFence singleTimeFence = VK_NULL_HANDLE;
+
     // Copia el contenido de un buffer a otro mediante un command buffer temporal.
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
@@ -443,6 +1481,7 @@ private:
         std::optional<uint32_t> graphicsFamily;  // Familia con capacidad de gráficos
         std::optional<uint32_t> presentFamily;   // Familia que puede presentar a la superficie
         std::optional<uint32_t> transferFamily;  // Familia exclusiva de transferencia (DMA)
+        std::optional<uint32_t> computeFamily;   // Familia de compute sin gráficos (asíncrona)
 
         // El renderer requiere al menos una familia de gráficos y una de presentación.
         bool isComplete() {
@@ -451,12 +1490,15 @@ private:
     };
 
     // Enumera las familias de colas de la GPU y busca las de gráficos,
-    // presentación y transferencia dedicada.
+    // presentación, transferencia dedicada y compute asíncrono.
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 
     // Verifica que la GPU soporte VK_KHR_swapchain.
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 
+    // Verifica que la GPU implemente Vulkan 1.2 con timeline semaphores.
+    bool checkDeviceFeatureSupport(VkPhysicalDevice device);
+
     // Verifica que las capas de validación solicitadas estén instaladas.
     bool checkValidationLayerSupport();
 
@@ -465,6 +1507,7 @@ private:
     // ==========================================================================
 
     // Imágenes internas del swapchain (propiedad del sistema de ventanas).
+    // En modo headless son los targets offscreen, propiedad del renderer.
     std::vector<VkImage> swapChainImages;
 
     // Vistas sobre las imágenes del swapchain para usarlas como attachments.
@@ -488,6 +1531,165 @@ private:
     // frame actual se señalice antes de reutilizar sus recursos.
     std::array<VkFence, MAX_FRAMES_IN_FLIGHT> inFlightFences;
 
+    // Timeline semaphore de la cola de gráficos: cada submit de frame lo
+    // lleva a ++submittedFrameValue. Los lotes de subidas que reescriben una
+    // geometría en uso lo esperan para no pisar lo que un frame está leyendo.
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
+    uint64_t submittedFrameValue = 0;
+
+    // ==========================================================================
+    // Grabación multihilo de los draws (secondary command buffers)
+    // ==========================================================================
+
+    // Objetos mínimos por slice. Por debajo, el coste de despertar hilos y de
+    // ejecutar secondaries supera al de grabar los draws en línea.
+    static constexpr size_t RECORD_SLICE_MIN_OBJECTS = 256;
+
+    // Tope de slices (hilo de render incluido).
+    static constexpr uint32_t MAX_RECORD_SLICES = 8;
+
+    // Slice de grabación: un tramo contiguo de drawOrder grabado en su propio
+    // secondary command buffer. Cada slice tiene sus propios command pools
+    // (uno por frame en vuelo) porque un pool no puede usarse desde dos hilos
+    // a la vez. El slice 0 lo graba el hilo de render; cada slice restante
+    // tiene un hilo de grabación dedicado.
+    struct RecordSlice {
+        std::array<VkCommandPool, MAX_FRAMES_IN_FLIGHT> commandPools{};
+        std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> commandBuffers{};
+        size_t begin = 0;           // Tramo [begin, end) de drawOrder
+        size_t end = 0;
+        std::exception_ptr error;   // Error de grabación, relanzado en el hilo de render
+    };
+    std::vector<RecordSlice> recordSlices;
+    std::vector<std::thread> recordThreads;
+
+    // Reparto de trabajo: el hilo de render publica un trabajo nuevo
+    // incrementando recordGeneration bajo recordMutex, y espera a que
+    // recordPendingSlices llegue a 0.
+    std::mutex recordMutex;
+    std::condition_variable recordStartCondition;
+    std::condition_variable recordDoneCondition;
+    uint64_t recordGeneration = 0;
+    uint32_t recordActiveSlices = 0;
+    uint32_t recordPendingSlices = 0;
+    VkFramebuffer recordFramebuffer = VK_NULL_HANDLE;
+    bool recordShutdown = false;
+
+    // ==========================================================================
+    // Perfilado (tiempos de CPU y timestamps de GPU)
+    // ==========================================================================
+
+    // Pares de timestamps de transferencia: limita cuántos lotes en vuelo se
+    // miden a la vez. Un lote sin par libre simplemente no se mide.
+    static constexpr uint32_t TRANSFER_QUERY_SLOTS = 32;
+
+    FrameProfiler profiler;
+
+    // Los timestamps requieren hostQueryReset (los pools se resetean desde
+    // la CPU, porque la cola de transferencia no admite vkCmdResetQueryPool)
+    // y timestampValidBits > 0 en la familia correspondiente.
+    bool gpuTimestampsSupported = false;
+    bool transferTimestampsSupported = false;
+    double timestampPeriodNs = 1.0;   // Nanosegundos por tick
+    uint64_t graphicsTimestampMask = 0;
+    uint64_t transferTimestampMask = 0;
+
+    // Par de timestamps alrededor del render pass de cada frame en vuelo.
+    VkQueryPool frameQueryPool = VK_NULL_HANDLE;
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> frameTimestampsWritten{};
+
+    // Par de timestamps alrededor de cada lote de subidas y pares libres.
+    VkQueryPool transferQueryPool = VK_NULL_HANDLE;
+    std::vector<uint32_t> freeTransferQuerySlots;
+
+    // Crea y destruye los query pools (si el dispositivo los soporta).
+    void createTimestampQueries();
+    void destroyTimestampQueries();
+
+    // Lee el par del frame frameIndex (su fence ya se esperó), lo añade como
+    // GpuRender y resetea el par para su siguiente uso.
+    void collectFrameTimestamps(uint32_t frameIndex);
+
+    // Añade las muestras de un lote de subidas completado (GpuTransfer,
+    // TransferLatency y bytes) y libera su par de timestamps.
+    void collectTransferTimestamps(const UploadBatch& batch);
+
+    // Diferencia en milisegundos entre dos timestamps con la máscara de bits
+    // válidos de su familia.
+    double timestampDeltaMilliseconds(uint64_t begin, uint64_t end, uint64_t mask) const;
+
+    // Recorridos seguidos con traceLatency, en orden de ticket. Se acotan a
+    // MAX_LATENCY_TRACES: si el llamador traza más rápido de lo que se
+    // presenta, los más antiguos se descartan sin medir.
+    static constexpr size_t MAX_LATENCY_TRACES = 16;
+    std::deque<LatencyTrace> latencyTraces;
+
+    // Último recorrido presentado, pendiente de takePresentedLatency.
+    std::optional<LatencyTrace> presentedLatency;
+
+    // Sella uploadTimeNs en los recorridos cuya subida ya terminó
+    // (flushCompletedTransfers).
+    void stampUploadLatencies();
+
+    // Tras presentar un frame que dibujó todas las subidas hasta
+    // visibleUploadTicket, cierra sus recorridos y añade sus muestras.
+    void stampPresentLatencies(uint64_t visibleUploadTicket);
+
+    // ==========================================================================
+    // Modo headless (target offscreen y readback asíncrono)
+    // ==========================================================================
+
+    // Estado de un buffer del anillo de readback.
+    enum class ReadbackState {
+        Free,     // Disponible para el próximo frame
+        InFlight, // Su copia está en un submit aún no completado
+        Ready,    // Copia completada, a la espera de acquireReadback
+        Held      // Tomado por el llamador hasta releaseReadback
+    };
+
+    struct ReadbackSlot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        const uint8_t* mapped = nullptr;
+        ReadbackState state = ReadbackState::Free;
+        uint32_t frameIndex = 0;   // Frame en vuelo cuyo fence señaliza la copia
+        uint64_t frameNumber = 0;
+    };
+
+    // Una imagen offscreen por frame en vuelo (imageIndex = currentFrame),
+    // para que el render pass de un frame no pise la copia del anterior.
+    std::vector<VmaAllocation> offscreenImageAllocations;
+
+    std::vector<ReadbackSlot> readbackSlots;
+    VkDeviceSize readbackBytes = 0;
+    uint32_t readbackRowPitch = 0;
+
+    // Buffer de readback que usa cada frame en vuelo (UINT32_MAX = ninguno).
+    std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> frameReadbackSlots{};
+
+    uint64_t headlessFrameNumber = 0;
+    uint64_t droppedReadbacks = 0;
+
+    // Crea y destruye las imágenes offscreen, que ocupan el lugar de las del
+    // swapchain (fija swapChainImageFormat y swapChainExtent).
+    void createOffscreenTargets();
+    void destroyOffscreenTargets();
+
+    // Crea y destruye el anillo de buffers de readback.
+    void createReadbackRing();
+    void destroyReadbackRing();
+
+    // Elige un buffer para el frame actual y graba la copia de su imagen
+    // offscreen (ya en TRANSFER_SRC_OPTIMAL) junto con la barrera hacia el
+    // host. Se llama tras cerrar el render pass.
+    void recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+    // Marca como listo el buffer del frame frameIndex tras esperar su fence.
+    void completeFrameReadback(uint32_t frameIndex);
+
+    // Marca como listos, sin bloquear, los buffers cuyo fence ya se señalizó.
+    void pollReadbacks();
+
     // ==========================================================================
     // Uniform buffers (uno por frame en vuelo)
     // ==========================================================================
@@ -501,15 +1703,117 @@ private:
     // mapeados durante toda la vida del buffer).
     std::array<void*, MAX_FRAMES_IN_FLIGHT> uniformBuffersMapped{};
 
-    // Índice del frame actual dentro del ciclo de frames en vuelo (0 o 1).
+    // Versión del contenido del UBO (vista y proyección): sube cada vez que
+    // este cambia (override nuevo o retirado, resolución nueva en la cámara
+    // por defecto). Cada uniform buffer recuerda la versión que contiene y
+    // solo se reescribe si está atrasado, de modo que una escena estática no
+    // escribe nada en la memoria mapeada.
+    uint64_t uniformVersion = 1;
+    std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> uniformBufferVersions{};
+
+    // Índice del frame actual dentro del ciclo de frames en vuelo
+    // (de 0 a framesInFlight - 1).
     uint32_t currentFrame = 0;
 
     // ==========================================================================
-    // Estado de la malla y transformaciones
+    // Política de presentación
     // ==========================================================================
 
-    // Malla actualmente cargada en los buffers de vértices/índices.
-    Mesh mesh;
+    PresentPolicy presentPolicy = PresentPolicy::Balanced;
+
+    // Frames en vuelo que usa la política actual. currentFrame da la vuelta
+    // en este valor; los slots por encima no se usan hasta que crezca.
+    uint32_t framesInFlight = 2;
+
+    // Modo con que se creó el swapchain actual.
+    VkPresentModeKHR swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+    // Frames en vuelo que corresponden a cada política.
+    static uint32_t framesInFlightFor(PresentPolicy policy);
+
+    // VK_KHR_present_id + VK_KHR_present_wait, detectados en
+    // createLogicalDevice. Con ellos cada presentación lleva un id creciente
+    // (nunca se reinicia, así que también crece en cada swapchain nuevo) y
+    // LowLatency espera a que la suya llegue a pantalla.
+    bool presentWaitSupported = false;
+    PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+    uint64_t nextPresentId = 1;
+
+    // Tope de la espera de una presentación: una ventana oculta o minimizada
+    // puede no completarla nunca, y el bucle no debe quedarse parado.
+    static constexpr uint64_t PRESENT_WAIT_TIMEOUT_NS = 100'000'000;
+
+    // Espera a que la presentación presentId llegue a pantalla (ver
+    // presentWaitSupported) y la mide como PresentWait.
+    void waitForPresentId(uint64_t presentId);
+
+    // ==========================================================================
+    // Variantes del pipeline y transformaciones
+    // ==========================================================================
+
+    // Variante del pipeline gráfico: la parte del vertex input y de la
+    // topología que no es estado dinámico está horneada en el pipeline
+    // compilado, así que cada combinación distinta de esa parte necesita su
+    // propio VkPipeline (ver describePipelineVariant). Todas comparten
+    // el mismo pipelineLayout y el mismo render pass (formatos y MSAA), así
+    // que esa parte de la clave es común a todas: si cambia, se recompilan
+    // todas en recreateGraphicsPipelines.
+    // Las variantes nunca se destruyen mientras viva el renderer: alternar
+    // entre layouts ya vistos es solo una búsqueda.
+    struct PipelineVariant {
+        VkVertexInputBindingDescription bindingDescription{};
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        uint64_t key = 0;           // hashPipelineVariant del layout y la topología
+        uint64_t generation = 0;    // pipelineGeneration con la que se compiló
+    };
+    std::vector<PipelineVariant> pipelineVariants;
+
+    // Índice de pipelineVariants por clave. Cada clave guarda las variantes
+    // que comparten hash; la comparación completa resuelve las colisiones.
+    std::unordered_map<uint64_t, std::vector<uint32_t>> pipelineVariantLookup;
+
+    // Precompilación: las variantes pedidas con warmPipelineVariant se
+    // compilan en pipelineWarmThread y se adoptan en findOrCreatePipelineVariant.
+    // Todo el estado compartido está protegido por pipelineWarmMutex.
+    std::thread pipelineWarmThread;
+    std::mutex pipelineWarmMutex;
+    std::condition_variable pipelineWarmCondition;      // Despierta al hilo
+    std::condition_variable pipelineWarmDoneCondition;  // Avisa al hilo de render
+    std::deque<PipelineVariant> pipelineWarmQueue;      // Pendientes de compilar
+    std::vector<PipelineVariant> pipelineWarmResults;   // Compiladas, sin adoptar
+    std::optional<PipelineVariant> pipelineWarmCurrent; // En compilación (sin pipeline)
+    bool pipelineWarmPaused = false;                    // Render pass en recreación
+    bool pipelineWarmShutdown = false;
+
+    // Se incrementa al recompilar todas las variantes; un resultado de una
+    // generación anterior se descarta al adoptarlo.
+    uint64_t pipelineGeneration = 0;
+
+    // Estado dinámico opcional, detectado en createLogicalDevice:
+    //   - dynamicTopologySupported (VK_EXT_extended_dynamic_state): la
+    //     topología se fija al grabar y los pipelines solo distinguen su
+    //     clase (puntos, líneas, triángulos o parches).
+    //   - dynamicVertexInputSupported (VK_EXT_vertex_input_dynamic_state): el
+    //     vertex input se fija al grabar y no forma parte del pipeline.
+    // Con ambos, mallas con cualquier layout y topología de la misma clase
+    // comparten un único VkPipeline. Sin ellos, cada combinación tiene el suyo.
+    bool dynamicTopologySupported = false;
+    bool dynamicVertexInputSupported = false;
+    PFN_vkCmdSetPrimitiveTopologyEXT cmdSetPrimitiveTopology = nullptr;
+    PFN_vkCmdSetVertexInputEXT cmdSetVertexInput = nullptr;
+
+    // Layout de vértices para vkCmdSetVertexInputEXT, convertido al formato
+    // de la extensión al registrarlo. Solo se usan con vertex input dinámico.
+    struct VertexInputLayout {
+        VkVertexInputBindingDescription bindingDescription{};
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        VkVertexInputBindingDescription2EXT binding2{};
+        std::vector<VkVertexInputAttributeDescription2EXT> attributes2;
+    };
+    std::vector<VertexInputLayout> vertexInputLayouts;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> vertexInputLookup;
 
     // Transformación externa opcional. Si tiene valor, sobreescribe la rotación
     // automática por defecto en updateUniformBuffer.
@@ -545,8 +1849,8 @@ private:
     // Selecciona el formato de superficie preferido (B8G8R8A8_SRGB si está disponible).
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 
-    // Selecciona el modo de presentación preferido (MAILBOX para triple buffering,
-    // con fallback a FIFO que es V-Sync garantizado).
+    // Selecciona el modo de presentación preferido por presentPolicy, con
+    // fallback a FIFO que es V-Sync garantizado.
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 
     // Determina la resolución del swapchain según las capacidades de la superficie
@@ -560,7 +1864,36 @@ private:
     VkShaderModule createShaderModule(const std::vector<char>& code);
 
     // Graba los comandos de renderizado de un frame en el command buffer:
-    // begin render pass, bind pipeline, set viewport/scissor, bind vertex/index
-    // buffers, bind descriptor sets, draw, end render pass.
+    // begin render pass, set viewport/scissor, bind descriptor sets y, por cada
+    // objeto de la escena, bind pipeline/arena (solo si cambian) y draw.
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+    // Graba viewport, scissor y el descriptor set del frame, comunes a todos
+    // los caminos de dibujo.
+    void recordFrameDrawState(VkCommandBuffer commandBuffer);
+
+    // Graba la topología y el vertex input dinámicos del objeto si difieren
+    // de los vinculados (boundTopology/boundVertexInput se actualizan). No
+    // hace nada para el estado que no es dinámico en este dispositivo.
+    void recordDynamicDrawState(VkCommandBuffer commandBuffer, const SceneGeometry& object,
+        VkPrimitiveTopology& boundTopology, uint32_t& boundVertexInput);
+
+    // Graba viewport, scissor, descriptor set y los draws del tramo
+    // [begin, end) de drawOrder. Sirve tanto al command buffer primario
+    // (grabación en línea) como a los secondaries de cada slice.
+    void recordDraws(VkCommandBuffer commandBuffer, size_t begin, size_t end);
+
+    // Número de slices con el que grabar objectCount objetos (1 = en línea).
+    uint32_t getRecordSliceCount(size_t objectCount) const;
+
+    // Reparte drawOrder entre sliceCount slices, graba el slice 0 en el hilo
+    // actual y espera a los demás. Al volver, los secondaries del frame
+    // actual de los sliceCount primeros slices están listos para ejecutarse.
+    void recordDrawsParallel(VkFramebuffer framebuffer, uint32_t sliceCount);
+
+    // Graba el secondary del frame actual de un slice.
+    void recordSlice(uint32_t sliceIndex);
+
+    // Bucle de un hilo de grabación.
+    void recordWorkerLoop(uint32_t sliceIndex);
 };
\ No newline at end of file
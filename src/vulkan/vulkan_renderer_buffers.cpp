@@ -2,10 +2,11 @@
 // vulkan_renderer_buffers.cpp
 // Gestin de buffers de memoria: creacin con VMA, comandos de copia,
 // staging ring buffer circular para transferencias asncronas a VRAM,
-// y creacin de buffers de vrtices e ndices.
+// y la arena de geometra donde se sub-asignan los vrtices e ndices.
 // =============================================================================
 
 #include "vulkan_renderer.hpp"
+#include <algorithm>
 #include <stdexcept>
 #include <cstring>
 
@@ -39,21 +40,15 @@ void VulkanRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, V
 }
 
 // -----------------------------------------------------------------------------
-// beginSingleTimeCommands: asigna un command buffer temporal del pool de grficos,
-// marcado con ONE_TIME_SUBMIT para indicar al driver que se usar una sola vez.
-// Se usa para operaciones puntuales como copias de buffer.
+// beginSingleTimeCommands: resetea y abre el command buffer reutilizable de
+// operaciones puntuales, marcado con ONE_TIME_SUBMIT para indicar al driver
+// que cada grabacin se enva una sola vez. Se usa para operaciones puntuales
+// como copias de buffer. No se asigna nada: el command buffer se cre junto
+// con los de los frames.
 // -----------------------------------------------------------------------------
 VkCommandBuffer VulkanRenderer::beginSingleTimeCommands() {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate command buffer!");
-    }
+    VkCommandBuffer commandBuffer = singleTimeCommandBuffer;
+    vkResetCommandBuffer(commandBuffer, 0);
 
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -67,23 +62,18 @@ VkCommandBuffer VulkanRenderer::beginSingleTimeCommands() {
 }
 
 // -----------------------------------------------------------------------------
-// endSingleTimeCommands: finaliza, enva y espera un command buffer temporal.
-// Usa un fence dedicado en lugar de vkQueueWaitIdle para evitar bloquear
-// todo el trabajo pendiente en la cola: solo espera a que este comando
-// especfico termine.
+// endSingleTimeCommands: finaliza, enva y espera el command buffer de
+// operaciones puntuales. Usa un fence dedicado (reutilizado entre llamadas)
+// en lugar de vkQueueWaitIdle para evitar bloquear todo el trabajo pendiente
+// en la cola: solo espera a que este comando especfico termine.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-
-    VkFence fence;
-    if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create fence for single-time commands!");
-    }
+    VkFence fence = singleTimeFence;
+    vkResetFences(device, 1, &fence);
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -91,19 +81,16 @@ void VulkanRenderer::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     submitInfo.pCommandBuffers = &commandBuffer;
 
     if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
-        vkDestroyFence(device, fence, nullptr);
         throw std::runtime_error("failed to submit command buffer!");
     }
 
     vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-    vkDestroyFence(device, fence, nullptr);
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
 // -----------------------------------------------------------------------------
 // copyBuffer: copia el contenido de un buffer a otro usando un command buffer
 // temporal. Es una operacin sncrona (bloquea hasta que la copia termina).
-// Se usa como alternativa simple cuando no se necesita el staging ring.
+// Se usa como alternativa simple cuando no se necesita el staging.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
@@ -116,163 +103,310 @@ void VulkanRenderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDevice
 }
 
 // =============================================================================
-// Staging Ring Buffer
-// Buffer circular de 8 MB en memoria HOST_VISIBLE|HOST_COHERENT que sirve como
-// rea de transferencia temporal para subir datos de CPU a GPU.
+// Staging por segmentos
+// Memoria HOST_VISIBLE|HOST_COHERENT dividida en segmentos de 8 MB, cada uno
+// gestionado como un buffer circular, que sirve como rea de transferencia
+// temporal para subir datos de CPU a GPU.
 //
 // Funcionamiento:
-//   1. Los datos se escriben secuencialmente en el ring con stagingRingWrite().
-//   2. Se graba un comando de copia al buffer destino DEVICE_LOCAL.
-//   3. Se enva a la cola de transferencia con un fence individual.
-//   4. El fence y la regin del ring se registran como PendingTransfer.
-//   5. Antes de escribir nuevos datos, se verifica que no se solapen con
-//      transferencias pendientes; si hay solapamiento, se espera al fence.
-//   6. Las transferencias completadas se limpian peridicamente.
+//   1. transferToDeviceLocal() encola la subida (tomando posesin de sus
+//      datos) y pumpUploads() la copia al staging por trozos, tantos como
+//      quepan sin esperar. Si ningn segmento tiene hueco, se aade otro
+//      mientras no se supere stagingBudget; si no, la subida queda en cola
+//      (contrapresin) y se retoma en el siguiente frame.
+//   2. Cada trozo graba un comando de copia al buffer destino DEVICE_LOCAL en
+//      el lote de subidas abierto, y su regin del segmento queda marcada con
+//      el valor del timeline del lote.
+//   3. Una vez por frame, el lote completo se enva a la cola de transferencia
+//      en un nico submit que sealiza en transferTimeline su valor. Si la
+//      cola de transferencia es de otra familia, el lote incluye las barreras
+//      release que ceden la propiedad de los rangos a la familia de grficos.
+//   4. Las regiones se liberan en orden al leer el contador del timeline, y
+//      los command buffers de los lotes terminados vuelven al pool de libres.
+//   5. Una subida termina cuando lo hace el lote con su ltimo trozo; su
+//      ticket pasa entonces a completedUploadTicket.
+//   6. El primer frame que consume un rango graba la barrera acquire y su
+//      submit espera el valor del timeline correspondiente.
 // =============================================================================
 
 // -----------------------------------------------------------------------------
-// createStagingRing: crea el buffer circular en memoria host-visible y obtiene
-// el puntero mapeado persistente proporcionado por VMA.
+// createStagingRing: crea el primer segmento de staging y el timeline
+// semaphore con valor inicial 0 (ninguna transferencia completada). El resto
+// de segmentos se crean bajo demanda.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createStagingRing() {
-    createBuffer(STAGING_RING_SIZE,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingRingBuffer,
-        stagingRingAllocation);
+    createStagingSegment();
 
-    VmaAllocationInfo allocInfo;
-    vmaGetAllocationInfo(allocator, stagingRingAllocation, &allocInfo);
-    stagingRingMapped = allocInfo.pMappedData;
-    stagingRingOffset = 0;
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &transferTimeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create transfer timeline semaphore!");
+    }
+    completedTransferValue = 0;
 }
 
 // -----------------------------------------------------------------------------
 // destroyStagingRing: espera todas las transferencias pendientes y destruye
-// el buffer. VMA gestiona el desmapeo automticamente.
+// los segmentos y el timeline. VMA gestiona el desmapeo automticamente.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::destroyStagingRing() {
     waitAllTransfers();
+    pendingAcquires.clear();
+
+    // Los command buffers de los lotes se liberan junto con transferCommandPool.
+    freeUploadCommandBuffers.clear();
 
-    stagingRingMapped = nullptr;
+    if (transferTimeline != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device, transferTimeline, nullptr);
+        transferTimeline = VK_NULL_HANDLE;
+    }
+
+    for (auto& segment : stagingSegments) {
+        vmaDestroyBuffer(allocator, segment.buffer, segment.allocation);
+    }
+    stagingSegments.clear();
+    stagingCapacity = 0;
 
-    if (stagingRingBuffer != VK_NULL_HANDLE) {
-        vmaDestroyBuffer(allocator, stagingRingBuffer, stagingRingAllocation);
-        stagingRingBuffer = VK_NULL_HANDLE;
-        stagingRingAllocation = VK_NULL_HANDLE;
+    for (auto& external : externalStagingBuffers) {
+        vmaDestroyBuffer(allocator, external.buffer, external.allocation);
     }
+    externalStagingBuffers.clear();
 }
 
 // -----------------------------------------------------------------------------
-// flushCompletedTransfers: recorre las transferencias pendientes y libera las
-// que ya han completado (su fence est sealizado), recuperando el fence,
-// el command buffer y marcando la regin del ring como disponible.
-// Se llama al inicio de cada transferToDeviceLocal para reciclar recursos.
+// createStagingSegment: crea un segmento de STAGING_SEGMENT_SIZE bytes en
+// memoria host-visible y obtiene el puntero mapeado persistente de VMA.
+// Devuelve su ndice en stagingSegments.
 // -----------------------------------------------------------------------------
-void VulkanRenderer::flushCompletedTransfers() {
-    auto it = pendingTransfers.begin();
-    while (it != pendingTransfers.end()) {
-        VkResult result = vkGetFenceStatus(device, it->fence);
-        if (result == VK_SUCCESS) {
-            vkDestroyFence(device, it->fence, nullptr);
-            vkFreeCommandBuffers(device, transferCommandPool, 1, &it->commandBuffer);
-            it = pendingTransfers.erase(it);
-        }
-        else {
-            ++it;
-        }
-    }
+uint32_t VulkanRenderer::createStagingSegment() {
+    StagingSegment segment;
+    segment.size = STAGING_SEGMENT_SIZE;
+
+    createBuffer(segment.size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        segment.buffer,
+        segment.allocation);
+
+    VmaAllocationInfo allocInfo;
+    vmaGetAllocationInfo(allocator, segment.allocation, &allocInfo);
+    segment.mapped = static_cast<uint8_t*>(allocInfo.pMappedData);
+
+    stagingSegments.push_back(std::move(segment));
+    stagingCapacity += STAGING_SEGMENT_SIZE;
+    return static_cast<uint32_t>(stagingSegments.size() - 1);
 }
 
 // -----------------------------------------------------------------------------
-// waitAllTransfers: bloquea hasta que todas las transferencias pendientes
-// hayan completado. Se usa antes de destruir buffers que podran estar
-// siendo copiados, o antes de destruir el staging ring.
+// setStagingBudget: fija el lmite de memoria de staging. Nunca baja de un
+// segmento, para que siempre pueda progresar al menos una subida. Un
+// presupuesto menor que la capacidad ya asignada no libera segmentos; solo
+// impide crear ms.
 // -----------------------------------------------------------------------------
-void VulkanRenderer::waitAllTransfers() {
-    for (auto& pt : pendingTransfers) {
-        vkWaitForFences(device, 1, &pt.fence, VK_TRUE, UINT64_MAX);
-        vkDestroyFence(device, pt.fence, nullptr);
-        vkFreeCommandBuffers(device, transferCommandPool, 1, &pt.commandBuffer);
-    }
-    pendingTransfers.clear();
+void VulkanRenderer::setStagingBudget(VkDeviceSize bytes) {
+    stagingBudget = std::max(bytes, STAGING_SEGMENT_SIZE);
 }
 
 // -----------------------------------------------------------------------------
-// stagingRingWrite: escribe datos en la posicin actual del ring buffer.
-// Si la escritura se desborda del final del ring, reinicia al inicio (wrap).
-// Antes de escribir, verifica que ninguna transferencia pendiente est usando
-// la regin que se va a sobreescribir; si hay solapamiento, espera a que
-// esas transferencias terminen.
-// Devuelve el offset dentro del ring donde se escribieron los datos.
+// stagingAcquire: busca en cada segmento un hueco contiguo tras su cabezal.
+// Las regiones en vuelo ocupan el intervalo circular [cola, cabezal), con la
+// cola en la regin ms antigua; si el tramo hasta el final del segmento no
+// basta, se prueba desde el inicio (wrap) hasta la cola. Un hueco menor que
+// minSize no se usa: pumpUploads pasa STAGING_MIN_CHUNK (o lo que queda por
+// copiar) para no trocear la subida en copias diminutas, y acquireStagingWrite
+// el tamao completo. Los offsets se alinean a 16 bytes.
+// Si ningn segmento sirve y el presupuesto lo permite, se aade uno nuevo.
+// La regin se registra con el valor del timeline del lote abierto, que debe
+// existir antes de llamar a esta funcin.
 // -----------------------------------------------------------------------------
-VkDeviceSize VulkanRenderer::stagingRingWrite(const void* data, VkDeviceSize size) {
-    if (size > STAGING_RING_SIZE) {
-        throw std::runtime_error("Transfer size exceeds staging ring buffer capacity!");
-    }
+bool VulkanRenderer::stagingAcquire(VkDeviceSize minSize, VkDeviceSize maxSize, StagingChunk& chunk) {
+    constexpr VkDeviceSize alignment = 16;
 
-    VkDeviceSize writeOffset = stagingRingOffset;
-    bool wrapped = false;
+    auto tryAcquire = [&](uint32_t index) -> bool {
+        StagingSegment& segment = stagingSegments[index];
 
-    if (writeOffset + size > STAGING_RING_SIZE) {
-        writeOffset = 0;
-        wrapped = true;
-    }
+        VkDeviceSize offset = 0;
+        VkDeviceSize available = 0;
+        if (segment.inFlight.empty()) {
+            segment.head = 0;
+            available = segment.size;
+        }
+        else {
+            VkDeviceSize tail = segment.inFlight.front().offset;
+            if (segment.head > tail) {
+                offset = segment.head;
+                available = segment.size - segment.head;
+                if (available < minSize) {
+                    offset = 0;
+                    available = tail;
+                }
+            }
+            else {
+                offset = segment.head;
+                available = tail - segment.head;
+            }
+        }
 
-    VkDeviceSize writeEnd = writeOffset + size;
+        if (available < minSize) {
+            return false;
+        }
 
-    auto it = pendingTransfers.begin();
-    while (it != pendingTransfers.end()) {
-        VkDeviceSize tStart = it->ringOffset;
-        VkDeviceSize tEnd = tStart + it->ringSize;
+        chunk.segment = index;
+        chunk.offset = offset;
+        chunk.size = std::min(maxSize, available);
+        segment.head = std::min((offset + chunk.size + alignment - 1) & ~(alignment - 1), segment.size);
+        segment.inFlight.push_back({ chunk.offset, chunk.size, openUploadBatch.timelineValue });
+        return true;
+    };
+
+    for (uint32_t i = 0; i < stagingSegments.size(); i++) {
+        if (tryAcquire(i)) {
+            return true;
+        }
+    }
 
-        bool overlaps = (writeOffset < tEnd) && (tStart < writeEnd);
+    if (stagingCapacity + STAGING_SEGMENT_SIZE <= stagingBudget) {
+        return tryAcquire(createStagingSegment());
+    }
+    return false;
+}
 
-        if (wrapped && !overlaps) {
-            overlaps = (tStart >= stagingRingOffset);
+// -----------------------------------------------------------------------------
+// flushCompletedTransfers: lee el contador del timeline una sola vez, libera
+// las regiones de staging de los lotes alcanzados, recicla sus command
+// buffers y avanza completedUploadTicket. Cada lote completado se entrega
+// tambin al perfilador (collectTransferTimestamps), y los recorridos de
+// latencia cuya subida termin reciben su instante (stampUploadLatencies).
+// Se llama al inicio de cada pumpUploads y de cada frame.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::flushCompletedTransfers() {
+    if (vkGetSemaphoreCounterValue(device, transferTimeline, &completedTransferValue) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to query transfer timeline value!");
+    }
+
+    for (auto& segment : stagingSegments) {
+        while (!segment.inFlight.empty() && segment.inFlight.front().timelineValue <= completedTransferValue) {
+            segment.inFlight.pop_front();
         }
+    }
 
-        if (overlaps) {
-            vkWaitForFences(device, 1, &it->fence, VK_TRUE, UINT64_MAX);
-            vkDestroyFence(device, it->fence, nullptr);
-            vkFreeCommandBuffers(device, transferCommandPool, 1, &it->commandBuffer);
-            it = pendingTransfers.erase(it);
+    auto batchIt = inFlightUploadBatches.begin();
+    while (batchIt != inFlightUploadBatches.end()) {
+        if (batchIt->timelineValue <= completedTransferValue) {
+            completedUploadTicket = std::max(completedUploadTicket, batchIt->lastUploadTicket);
+            collectTransferTimestamps(*batchIt);
+            vkResetCommandBuffer(batchIt->commandBuffer, 0);
+            freeUploadCommandBuffers.push_back(batchIt->commandBuffer);
+            batchIt = inFlightUploadBatches.erase(batchIt);
         }
         else {
-            ++it;
+            ++batchIt;
         }
     }
 
-    std::memcpy(static_cast<uint8_t*>(stagingRingMapped) + writeOffset, data, static_cast<size_t>(size));
-    stagingRingOffset = writeEnd;
+    stampUploadLatencies();
+}
 
-    return writeOffset;
+// -----------------------------------------------------------------------------
+// isTransferComplete: el contador del timeline solo crece, as que un lote ha
+// completado (junto con todos los anteriores) cuando su valor no supera el
+// ltimo valor observado.
+// -----------------------------------------------------------------------------
+bool VulkanRenderer::isTransferComplete(uint64_t timelineValue) const {
+    return timelineValue <= completedTransferValue;
 }
 
 // -----------------------------------------------------------------------------
-// transferToDeviceLocal: sube datos de CPU a un buffer DEVICE_LOCAL (VRAM).
-//   1. Limpia transferencias completadas para reciclar regiones del ring.
-//   2. Escribe los datos en el staging ring (con proteccin de solapamiento).
-//   3. Graba un comando de copia (vkCmdCopyBuffer) en un command buffer temporal.
-//   4. Enva el comando a la cola de transferencia con un fence individual.
-//   5. Registra la transferencia como pendiente con su regin del ring.
-// La copia se ejecuta de forma asncrona en la cola de transferencia (que puede
-// ser una cola DMA dedicada, ejecutndose en paralelo con el renderizado).
-// -----------------------------------------------------------------------------
-void VulkanRenderer::transferToDeviceLocal(VkBuffer dstBuffer, const void* data, VkDeviceSize size) {
+// isUploadComplete: las subidas terminan en el orden en que se encolaron, as
+// que basta con comparar con el mayor ticket completado.
+// -----------------------------------------------------------------------------
+bool VulkanRenderer::isUploadComplete(uint64_t uploadTicket) const {
+    return uploadTicket <= completedUploadTicket;
+}
+
+// -----------------------------------------------------------------------------
+// waitForTransfer: bloquea en el timeline hasta que alcance timelineValue y
+// recicla las transferencias terminadas. Si el valor pertenece al lote
+// todava abierto, lo enva antes para no esperar indefinidamente.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::waitForTransfer(uint64_t timelineValue) {
+    if (isTransferComplete(timelineValue)) {
+        return;
+    }
+
+    if (openUploadBatch.commandBuffer != VK_NULL_HANDLE && timelineValue >= openUploadBatch.timelineValue) {
+        submitUploadBatch();
+    }
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &transferTimeline;
+    waitInfo.pValues = &timelineValue;
+
+    if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to wait on transfer timeline!");
+    }
     flushCompletedTransfers();
+}
 
-    VkDeviceSize srcOffset = stagingRingWrite(data, size);
+// -----------------------------------------------------------------------------
+// waitAllTransfers: bloquea hasta que todas las subidas hayan completado,
+// incluidas las que an esperan espacio de staging: enva lo que haya, espera
+// al lote ms antiguo para liberar staging y repite hasta vaciar la cola.
+// Se usa antes de destruir buffers que podran estar siendo copiados, o
+// antes de destruir el staging.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::waitAllTransfers() {
+    while (true) {
+        pumpUploads();
+        submitUploadBatch();
+
+        if (inFlightUploadBatches.empty()) {
+            if (!uploadQueue.empty()) {
+                throw std::runtime_error("Staging upload queue stalled with no transfers in flight!");
+            }
+            return;
+        }
+        waitForTransfer(inFlightUploadBatches.front().timelineValue);
+    }
+}
 
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = transferCommandPool;
-    allocInfo.commandBufferCount = 1;
+// -----------------------------------------------------------------------------
+// beginUploadBatch: abre un lote de subidas si no hay ninguno. Reutiliza un
+// command buffer del pool de libres (ya reseteado al completarse su lote
+// anterior) y solo asigna uno nuevo cuando todos estn en vuelo, por lo que en
+// rgimen estable no hay llamadas a vkAllocateCommandBuffers. El lote recibe
+// el siguiente valor del timeline, que compartirn todas sus copias.
+// Si hay un par de timestamps libre, el lote lo toma y escribe el primero.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::beginUploadBatch() {
+    if (openUploadBatch.commandBuffer != VK_NULL_HANDLE) {
+        return;
+    }
 
     VkCommandBuffer cmdBuf;
-    if (vkAllocateCommandBuffers(device, &allocInfo, &cmdBuf) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate transfer command buffer!");
+    if (!freeUploadCommandBuffers.empty()) {
+        cmdBuf = freeUploadCommandBuffers.back();
+        freeUploadCommandBuffers.pop_back();
+    }
+    else {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = transferCommandPool;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, &cmdBuf) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate transfer command buffer!");
+        }
     }
 
     VkCommandBufferBeginInfo beginInfo{};
@@ -280,76 +414,530 @@ void VulkanRenderer::transferToDeviceLocal(VkBuffer dstBuffer, const void* data,
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     vkBeginCommandBuffer(cmdBuf, &beginInfo);
 
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = srcOffset;
-    copyRegion.dstOffset = 0;
-    copyRegion.size = size;
-    vkCmdCopyBuffer(cmdBuf, stagingRingBuffer, dstBuffer, 1, &copyRegion);
+    openUploadBatch.commandBuffer = cmdBuf;
+    openUploadBatch.timelineValue = nextTransferId++;
 
-    vkEndCommandBuffer(cmdBuf);
+    if (transferTimestampsSupported && !freeTransferQuerySlots.empty()) {
+        openUploadBatch.querySlot = freeTransferQuerySlots.back();
+        freeTransferQuerySlots.pop_back();
+        vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, transferQueryPool, openUploadBatch.querySlot * 2);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// submitUploadBatch: cierra el lote abierto y lo enva a la cola de
+// transferencia en un solo submit que sealiza su valor del timeline.
+// Antes de cerrar, graba de una vez las barreras release de todos los rangos
+// escritos en el lote (solo si las familias de colas difieren) y el
+// timestamp de cierre si el lote se mide.
+// Un lote con escrituras en el sitio espera en frameTimeline, en la etapa de
+// transferencia, a todos los frames ya enviados: son los que pueden estar
+// leyendo los rangos que reescribe. Los frames siguientes se ordenan tras l
+// con la espera de frameTransferWaitValue.
+// drawFrame lo llama una vez por frame; tambin se invoca si hay que esperar
+// a una copia del lote abierto.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::submitUploadBatch() {
+    if (openUploadBatch.commandBuffer == VK_NULL_HANDLE) {
+        return;
+    }
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkCommandBuffer cmdBuf = openUploadBatch.commandBuffer;
+
+    if (transferQueueFamily != graphicsQueueFamily) {
+        std::vector<VkBufferMemoryBarrier> releases;
+        for (const auto& pa : pendingAcquires) {
+            if (pa.timelineValue != openUploadBatch.timelineValue) {
+                continue;
+            }
+            VkBufferMemoryBarrier release{};
+            release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            release.dstAccessMask = 0;
+            release.srcQueueFamilyIndex = transferQueueFamily;
+            release.dstQueueFamilyIndex = graphicsQueueFamily;
+            release.buffer = pa.buffer;
+            release.offset = pa.offset;
+            release.size = pa.size;
+            releases.push_back(release);
+        }
 
-    VkFence fence;
-    if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create transfer fence!");
+        vkCmdPipelineBarrier(cmdBuf,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, static_cast<uint32_t>(releases.size()), releases.data(), 0, nullptr);
     }
 
+    if (openUploadBatch.querySlot != UINT32_MAX) {
+        vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, transferQueryPool, openUploadBatch.querySlot * 2 + 1);
+    }
+
+    vkEndCommandBuffer(cmdBuf);
+
+    const bool waitFrames = openUploadBatch.waitsForFrames && submittedFrameValue > 0;
+    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = waitFrames ? 1 : 0;
+    timelineInfo.pWaitSemaphoreValues = &submittedFrameValue;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &openUploadBatch.timelineValue;
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = waitFrames ? 1 : 0;
+    submitInfo.pWaitSemaphores = &frameTimeline;
+    submitInfo.pWaitDstStageMask = &waitStage;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &cmdBuf;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &transferTimeline;
 
-    if (vkQueueSubmit(transferQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+    if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit transfer command!");
     }
 
-    pendingTransfers.push_back({ fence, cmdBuf, srcOffset, size });
+    openUploadBatch.submitTime = std::chrono::steady_clock::now();
+    inFlightUploadBatches.push_back(openUploadBatch);
+    openUploadBatch = UploadBatch{};
 }
 
 // -----------------------------------------------------------------------------
-// createVertexBuffer: crea un buffer de vrtices en memoria DEVICE_LOCAL y lo
-// llena con los datos de la malla actual mediante transferToDeviceLocal.
-// El flag TRANSFER_DST_BIT indica que ser destino de una operacin de copia.
+// pumpUploads: recorre la cola de subidas en orden y, para cada una, reserva
+// trozos de staging, copia en ellos la parte pendiente de sus datos y graba
+// la copia correspondiente en el lote abierto. Nunca espera a la GPU: si no
+// queda espacio ni presupuesto para crecer, se detiene y la subida contina
+// en la siguiente llamada (un frame despus, cuando se hayan liberado
+// regiones). Al terminar una subida, su ticket se asocia al lote abierto y
+// sus datos se liberan.
 // -----------------------------------------------------------------------------
-void VulkanRenderer::createVertexBuffer() {
-    const auto& geometry = mesh.getData();
-    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(geometry.vertexData.size());
-    if (bufferSize == 0) {
-        return;
+void VulkanRenderer::pumpUploads() {
+    flushCompletedTransfers();
+
+    while (!uploadQueue.empty()) {
+        QueuedUpload& upload = uploadQueue.front();
+        VkDeviceSize totalSize = static_cast<VkDeviceSize>(upload.data.size());
+
+        while (upload.written < totalSize) {
+            beginUploadBatch();
+
+            StagingChunk chunk;
+            VkDeviceSize remaining = totalSize - upload.written;
+            if (!stagingAcquire(std::min(remaining, STAGING_MIN_CHUNK), remaining, chunk)) {
+                return;
+            }
+
+            StagingSegment& segment = stagingSegments[chunk.segment];
+            std::memcpy(segment.mapped + chunk.offset, upload.data.data() + upload.written, static_cast<size_t>(chunk.size));
+
+            VkBufferCopy copyRegion{};
+            copyRegion.srcOffset = chunk.offset;
+            copyRegion.dstOffset = upload.dstOffset + upload.written;
+            copyRegion.size = chunk.size;
+            vkCmdCopyBuffer(openUploadBatch.commandBuffer, segment.buffer, upload.dstBuffer, 1, &copyRegion);
+
+            pendingAcquires.push_back({ upload.dstBuffer, copyRegion.dstOffset, chunk.size, openUploadBatch.timelineValue });
+
+            upload.written += chunk.size;
+            queuedUploadBytes -= chunk.size;
+            openUploadBatch.bytes += chunk.size;
+        }
+
+        beginUploadBatch();
+        openUploadBatch.lastUploadTicket = upload.ticket;
+        uploadQueue.pop_front();
     }
+}
+
+// -----------------------------------------------------------------------------
+// transferToDeviceLocal: sube datos de CPU a un buffer DEVICE_LOCAL (VRAM).
+// La subida se encola con el siguiente ticket y se transmite de inmediato
+// todo lo que quepa en el staging; el resto se retoma en frames posteriores.
+// Las copias no se envan aqu: todas las del frame viajan juntas en el
+// submit de submitUploadBatch, y se ejecutan de forma asncrona en la cola
+// de transferencia (que puede ser una cola DMA dedicada, en paralelo con el
+// renderizado). Devuelve el ticket, con el que el llamador puede sondear su
+// finalizacin mediante isUploadComplete.
+// -----------------------------------------------------------------------------
+uint64_t VulkanRenderer::transferToDeviceLocal(VkBuffer dstBuffer, VkDeviceSize dstOffset, std::vector<uint8_t>&& data) {
+    uint64_t ticket = nextUploadTicket++;
+    queuedUploadBytes += static_cast<VkDeviceSize>(data.size());
+    uploadQueue.push_back({ ticket, dstBuffer, dstOffset, std::move(data) });
+
+    pumpUploads();
+    return ticket;
+}
 
-    createBuffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+// -----------------------------------------------------------------------------
+// acquireStagingWrite: reserva una regin contigua de staging para que el
+// llamador la rellene directamente. La regin queda marcada con el valor del
+// lote abierto, igual que un trozo de pumpUploads, as que si el llamador la
+// abandona (por ejemplo, una lectura IPC que resulta inconsistente) se libera
+// sola al completarse ese lote. No se concede mientras haya subidas en cola:
+// su ticket adelantara al de subidas anteriores an sin copiar.
+// -----------------------------------------------------------------------------
+bool VulkanRenderer::acquireStagingWrite(VkDeviceSize size, StagingWriteRegion& region) {
+    if (!uploadQueue.empty() || size == 0 || size > STAGING_SEGMENT_SIZE) {
+        return false;
+    }
+
+    flushCompletedTransfers();
+    beginUploadBatch();
+
+    StagingChunk chunk;
+    if (!stagingAcquire(size, size, chunk)) {
+        return false;
+    }
+
+    region.data = stagingSegments[chunk.segment].mapped + chunk.offset;
+    region.size = chunk.size;
+    region.buffer = stagingSegments[chunk.segment].buffer;
+    region.offset = chunk.offset;
+    region.timelineValue = openUploadBatch.timelineValue;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// createExternalStagingBuffer: crea un buffer de staging fuera del anillo. La
+// regin devuelta cubre el buffer completo y lleva timelineValue 0, que
+// transferFromStaging interpreta como "sin lote asociado": el llamador es
+// quien garantiza que no lo reescribe mientras una copia lo est leyendo.
+// -----------------------------------------------------------------------------
+VulkanRenderer::StagingWriteRegion VulkanRenderer::createExternalStagingBuffer(VkDeviceSize size) {
+    if (size == 0) {
+        throw std::runtime_error("External staging buffer must not be empty!");
+    }
+
+    ExternalStagingBuffer external;
+    createBuffer(size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        external.buffer,
+        external.allocation);
+
+    VmaAllocationInfo allocInfo;
+    vmaGetAllocationInfo(allocator, external.allocation, &allocInfo);
+
+    StagingWriteRegion region;
+    region.data = static_cast<uint8_t*>(allocInfo.pMappedData);
+    region.size = size;
+    region.buffer = external.buffer;
+    region.offset = 0;
+    region.timelineValue = 0;
+
+    externalStagingBuffers.push_back(external);
+    return region;
+}
+
+// -----------------------------------------------------------------------------
+// destroyExternalStagingBuffer: se busca por VkBuffer; una regin que no sea
+// de un buffer externo (o ya destruido) es un error del llamador.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::destroyExternalStagingBuffer(const StagingWriteRegion& region) {
+    for (size_t i = 0; i < externalStagingBuffers.size(); i++) {
+        if (externalStagingBuffers[i].buffer == region.buffer) {
+            vmaDestroyBuffer(allocator, externalStagingBuffers[i].buffer, externalStagingBuffers[i].allocation);
+            externalStagingBuffers[i] = externalStagingBuffers.back();
+            externalStagingBuffers.pop_back();
+            return;
+        }
+    }
+    throw std::runtime_error("Unknown external staging buffer!");
+}
+
+// -----------------------------------------------------------------------------
+// transferFromStaging: graba la copia de una regin ya escrita por el llamador
+// hacia el buffer destino, sin pasar por la cola de subidas. La subida recibe
+// el siguiente ticket y termina con el lote abierto. Las regiones externas
+// (timelineValue 0) no estn ligadas a ningn lote y abren uno si hace falta.
+// -----------------------------------------------------------------------------
+uint64_t VulkanRenderer::transferFromStaging(VkBuffer dstBuffer, VkDeviceSize dstOffset, const StagingWriteRegion& region) {
+    if (region.timelineValue == 0) {
+        beginUploadBatch();
+    }
+    else if (openUploadBatch.commandBuffer == VK_NULL_HANDLE || region.timelineValue != openUploadBatch.timelineValue) {
+        throw std::runtime_error("Staging write region belongs to an already submitted upload batch!");
+    }
+    if (!uploadQueue.empty()) {
+        throw std::runtime_error("Staging write region committed behind queued uploads!");
+    }
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = region.offset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = region.size;
+    vkCmdCopyBuffer(openUploadBatch.commandBuffer, region.buffer, dstBuffer, 1, &copyRegion);
+    openUploadBatch.bytes += region.size;
+
+    pendingAcquires.push_back({ dstBuffer, dstOffset, region.size, openUploadBatch.timelineValue });
+
+    uint64_t ticket = nextUploadTicket++;
+    openUploadBatch.lastUploadTicket = ticket;
+    return ticket;
+}
+
+// -----------------------------------------------------------------------------
+// transferRangesFromStaging: variante de transferFromStaging para
+// actualizaciones parciales. Los rangos destino pueden haberse escrito en un
+// lote anterior (o en este mismo), as que antes de las copias se graba una
+// barrera de memoria entre escrituras de transferencia. Cada copia deja su
+// propio rango pendiente de adquirir.
+// -----------------------------------------------------------------------------
+uint64_t VulkanRenderer::transferRangesFromStaging(VkBuffer dstBuffer, VkDeviceSize dstBase, const StagingWriteRegion& region,
+    const std::vector<VkBufferCopy>& copies, bool inPlace) {
+    if (region.timelineValue == 0) {
+        beginUploadBatch();
+    }
+    else if (openUploadBatch.commandBuffer == VK_NULL_HANDLE || region.timelineValue != openUploadBatch.timelineValue) {
+        throw std::runtime_error("Staging write region belongs to an already submitted upload batch!");
+    }
+    if (!uploadQueue.empty()) {
+        throw std::runtime_error("Staging write region committed behind queued uploads!");
+    }
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(openUploadBatch.commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    std::vector<VkBufferCopy> regions(copies);
+    for (VkBufferCopy& copy : regions) {
+        copy.srcOffset += region.offset;
+        copy.dstOffset += dstBase;
+        openUploadBatch.bytes += copy.size;
+        pendingAcquires.push_back({ dstBuffer, copy.dstOffset, copy.size, openUploadBatch.timelineValue, inPlace });
+    }
+    vkCmdCopyBuffer(openUploadBatch.commandBuffer, region.buffer, dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+    openUploadBatch.waitsForFrames = openUploadBatch.waitsForFrames || inPlace;
+
+    uint64_t ticket = nextUploadTicket++;
+    openUploadBatch.lastUploadTicket = ticket;
+    return ticket;
+}
+
+// -----------------------------------------------------------------------------
+// recordTransferAcquires: graba, al principio del command buffer del frame,
+// la mitad acquire de la transferencia de propiedad de cada rango cuya subida
+// ya ha completado, y anota el mayor valor adquirido en frameTransferWaitValue.
+// El submit del frame espera ese valor del timeline en la etapa de vertex
+// input: la espera ya est satisfecha (la CPU vio el valor), pero es la que
+// establece la dependencia de memoria entre la copia y la lectura de vrtices.
+// Solo se adquieren subidas completas, para que el frame nunca quede
+// bloqueado en la GPU por una transferencia an en curso. La excepcin son
+// las escrituras en el sitio: la versin que reescriben ya se dibuja, as que
+// el frame debe verlas en cuanto su lote est enviado, y la espera del
+// timeline pasa a ser real. Cubre tambin la etapa de vertex shader, que lee
+// las transformaciones por instancia por direccin.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recordTransferAcquires(VkCommandBuffer commandBuffer) {
+    frameTransferWaitValue = 0;
+
+    std::vector<VkBufferMemoryBarrier> barriers;
+    auto it = pendingAcquires.begin();
+    while (it != pendingAcquires.end()) {
+        const bool submitted = openUploadBatch.commandBuffer == VK_NULL_HANDLE || it->timelineValue < openUploadBatch.timelineValue;
+        if (!isTransferComplete(it->timelineValue) && !(it->inPlace && submitted)) {
+            ++it;
+            continue;
+        }
+
+        if (transferQueueFamily != graphicsQueueFamily) {
+            VkBufferMemoryBarrier acquire{};
+            acquire.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            acquire.srcAccessMask = 0;
+            acquire.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            acquire.srcQueueFamilyIndex = transferQueueFamily;
+            acquire.dstQueueFamilyIndex = graphicsQueueFamily;
+            acquire.buffer = it->buffer;
+            acquire.offset = it->offset;
+            acquire.size = it->size;
+            barriers.push_back(acquire);
+        }
+
+        frameTransferWaitValue = std::max(frameTransferWaitValue, it->timelineValue);
+        it = pendingAcquires.erase(it);
+    }
+
+    if (!barriers.empty()) {
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+            0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+}
+
+// =============================================================================
+// Arena de geometra
+// Pginas de 64 MB en memoria DEVICE_LOCAL con uso VERTEX|INDEX|TRANSFER_DST.
+// Cada pgina se sub-divide con un VmaVirtualBlock: reservar o liberar un
+// rango solo actualiza la contabilidad del bloque virtual, sin llamadas a
+// vkAllocateMemory ni creacin de buffers. Las pginas solo se crean cuando
+// ninguna existente tiene hueco, y viven hasta la destruccin del renderer.
+//
+// Los rangos que la GPU todava puede estar leyendo (frames en vuelo) o
+// escribiendo (transferencias pendientes) no se liberan directamente: se
+// retiran a una cola de borrado por frame que se procesa al reutilizar el slot.
+// =============================================================================
+
+// -----------------------------------------------------------------------------
+// createArenaPage: crea una pgina nueva de la arena de al menos minSize bytes
+// (una malla mayor que GEOMETRY_ARENA_PAGE_SIZE obtiene una pgina a medida)
+// y su bloque virtual asociado, y guarda su direccin de GPU para las
+// transformaciones por instancia. Devuelve el ndice de la pgina.
+// -----------------------------------------------------------------------------
+uint32_t VulkanRenderer::createArenaPage(VkDeviceSize minSize) {
+    ArenaPage page{};
+    page.size = std::max(minSize, GEOMETRY_ARENA_PAGE_SIZE);
+
+    createBuffer(page.size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        vertexBuffer,
-        vertexBufferAllocation);
+        page.buffer,
+        page.allocation);
+
+    VkBufferDeviceAddressInfo addressInfo{};
+    addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    addressInfo.buffer = page.buffer;
+    page.deviceAddress = vkGetBufferDeviceAddress(device, &addressInfo);
+
+    VmaVirtualBlockCreateInfo blockInfo{};
+    blockInfo.size = page.size;
+
+    if (vmaCreateVirtualBlock(&blockInfo, &page.block) != VK_SUCCESS) {
+        vmaDestroyBuffer(allocator, page.buffer, page.allocation);
+        throw std::runtime_error("Failed to create geometry arena virtual block!");
+    }
+
+    arenaPages.push_back(page);
+    return static_cast<uint32_t>(arenaPages.size() - 1);
+}
+
+// -----------------------------------------------------------------------------
+// arenaAllocate: reserva un rango cuyo offset es mltiplo de elementSize.
+// El stride de un vrtice no tiene por qu ser potencia de dos, as que no
+// basta con la alineacin del bloque virtual: se piden elementSize - 1 bytes
+// extra y se redondea el offset devuelto hacia arriba dentro de ese margen.
+// Se prueba cada pgina existente en orden y, si ninguna tiene hueco, se crea
+// una nueva.
+// -----------------------------------------------------------------------------
+VulkanRenderer::ArenaRange VulkanRenderer::arenaAllocate(VkDeviceSize size, VkDeviceSize elementSize) {
+    VmaVirtualAllocationCreateInfo allocInfo{};
+    allocInfo.size = size + elementSize - 1;
+    allocInfo.alignment = 4;
+
+    auto tryPage = [&](uint32_t pageIndex, ArenaRange& range) {
+        VkDeviceSize rawOffset = 0;
+        if (vmaVirtualAllocate(arenaPages[pageIndex].block, &allocInfo, &range.allocation, &rawOffset) != VK_SUCCESS) {
+            return false;
+        }
+        range.page = pageIndex;
+        range.offset = ((rawOffset + elementSize - 1) / elementSize) * elementSize;
+        range.size = size;
+        return true;
+    };
+
+    ArenaRange range{};
+    for (uint32_t i = 0; i < static_cast<uint32_t>(arenaPages.size()); i++) {
+        if (tryPage(i, range)) {
+            return range;
+        }
+    }
+
+    if (!tryPage(createArenaPage(allocInfo.size), range)) {
+        throw std::runtime_error("Failed to allocate geometry arena range!");
+    }
+    return range;
+}
 
-    transferToDeviceLocal(vertexBuffer, geometry.vertexData.data(), bufferSize);
+// -----------------------------------------------------------------------------
+// arenaFree: devuelve un rango a su bloque virtual. La memoria real de la
+// pgina no se libera; el hueco queda disponible para prximas mallas.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::arenaFree(ArenaRange& range) {
+    if (!range.isValid()) {
+        return;
+    }
+    vmaVirtualFree(arenaPages[range.page].block, range.allocation);
+    range = ArenaRange{};
 }
 
 // -----------------------------------------------------------------------------
-// createIndexBuffer: crea un buffer de ndices en memoria DEVICE_LOCAL y lo
-// llena con los datos de ndices de la malla actual. Permite reutilizar
-// vrtices compartidos entre tringulos, reduciendo el ancho de banda.
+// arenaRetire: encola un rango en la cola de borrado del ltimo frame enviado.
+// Los frames se envan en orden a la misma cola, as que cuando el fence de
+// ese slot se sealice ningn frame anterior podr seguir leyendo el rango.
 // -----------------------------------------------------------------------------
-void VulkanRenderer::createIndexBuffer() {
-    const auto& geometry = mesh.getData();
-    if (geometry.indexCount == 0) {
+void VulkanRenderer::arenaRetire(ArenaRange& range, uint64_t uploadTicket) {
+    if (!range.isValid()) {
         return;
     }
+    uint32_t lastSubmittedFrame = (currentFrame + framesInFlight - 1) % framesInFlight;
+    deletionQueues[lastSubmittedFrame].push_back({ range, uploadTicket });
+    range = ArenaRange{};
+}
 
-    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(geometry.indexData.size());
-    if (bufferSize == 0) {
+// -----------------------------------------------------------------------------
+// bufferRetire: como arenaRetire, pero para un buffer propio de una versin
+// (las normales del preprocesado), que se destruye en lugar de liberarse.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::bufferRetire(VkBuffer& buffer, VmaAllocation& allocation) {
+    if (buffer == VK_NULL_HANDLE) {
         return;
     }
+    uint32_t lastSubmittedFrame = (currentFrame + framesInFlight - 1) % framesInFlight;
+    bufferDeletionQueues[lastSubmittedFrame].push_back({ buffer, allocation });
+    buffer = VK_NULL_HANDLE;
+    allocation = VK_NULL_HANDLE;
+}
 
-    createBuffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        indexBuffer,
-        indexBufferAllocation);
+// -----------------------------------------------------------------------------
+// processDeletionQueue: libera los rangos retirados en el slot indicado, cuyo
+// fence acaba de esperarse en drawFrame. Un rango cuya subida an no
+// ha terminado (una subida sustituida antes de completarse) se conserva
+// en la cola hasta una vuelta posterior. Los buffers retirados se destruyen
+// siempre: solo los leen los frames.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::processDeletionQueue(uint32_t frameIndex) {
+    for (RetiredBuffer& retired : bufferDeletionQueues[frameIndex]) {
+        vmaDestroyBuffer(allocator, retired.buffer, retired.allocation);
+    }
+    bufferDeletionQueues[frameIndex].clear();
+
+    auto& queue = deletionQueues[frameIndex];
+    auto it = queue.begin();
+    while (it != queue.end()) {
+        if (isUploadComplete(it->uploadTicket)) {
+            arenaFree(it->range);
+            it = queue.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
 
-    transferToDeviceLocal(indexBuffer, geometry.indexData.data(), bufferSize);
-}
\ No newline at end of file
+// -----------------------------------------------------------------------------
+// destroyGeometryArena: limpia los bloques virtuales (VMA exige que estn
+// vacos al destruirlos) y destruye los buffers de todas las pginas y los
+// buffers retirados que an esperaban en las colas de borrado.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::destroyGeometryArena() {
+    for (auto& queue : deletionQueues) {
+        queue.clear();
+    }
+    for (auto& queue : bufferDeletionQueues) {
+        for (RetiredBuffer& retired : queue) {
+            vmaDestroyBuffer(allocator, retired.buffer, retired.allocation);
+        }
+        queue.clear();
+    }
+    for (auto& page : arenaPages) {
+        vmaClearVirtualBlock(page.block);
+        vmaDestroyVirtualBlock(page.block);
+        vmaDestroyBuffer(allocator, page.buffer, page.allocation);
+    }
+    arenaPages.clear();
+}
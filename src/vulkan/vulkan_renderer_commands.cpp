@@ -5,6 +5,7 @@
 // =============================================================================
 
 #include "vulkan_renderer.hpp"
+#include <algorithm>
 #include <stdexcept>
 
 // -----------------------------------------------------------------------------
@@ -12,7 +13,8 @@
 // de colas de gráficos, con el flag RESET_COMMAND_BUFFER_BIT para permitir
 // resetear command buffers individuales entre frames.
 // Si existe una familia de transferencia dedicada, crea un pool separado para
-// ella; si no, reutiliza el pool de gráficos.
+// ella; si no, reutiliza el pool de gráficos. Lo mismo con la familia de
+// compute, que comparte pool con la de transferencia si es la misma.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createCommandPool() {
     QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
@@ -40,11 +42,29 @@ void VulkanRenderer::createCommandPool() {
     else {
         transferCommandPool = commandPool;
     }
+
+    if (computeQueueFamily == transferQueueFamily && transferCommandPool != commandPool) {
+        computeCommandPool = transferCommandPool;
+    }
+    else if (computeQueueFamily != queueFamilyIndices.graphicsFamily.value()) {
+        VkCommandPoolCreateInfo computePoolInfo{};
+        computePoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        computePoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        computePoolInfo.queueFamilyIndex = computeQueueFamily;
+
+        if (vkCreateCommandPool(device, &computePoolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create compute command pool!");
+        }
+    }
+    else {
+        computeCommandPool = commandPool;
+    }
 }
 
 // -----------------------------------------------------------------------------
 // createCommandBuffers: asigna MAX_FRAMES_IN_FLIGHT command buffers primarios
-// del pool de gráficos, uno por cada frame en vuelo.
+// del pool de gráficos, uno por cada frame en vuelo, y el command buffer
+// reutilizable de operaciones puntuales (beginSingleTimeCommands).
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createCommandBuffers() {
     VkCommandBufferAllocateInfo allocInfo{};
@@ -56,6 +76,11 @@ void VulkanRenderer::createCommandBuffers() {
     if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
         throw std::runtime_error("Failed to allocate command buffers!");
     }
+
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &singleTimeCommandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate single-time command buffer!");
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -64,6 +89,8 @@ void VulkanRenderer::createCommandBuffers() {
 //   - renderFinishedSemaphores: la GPU los señaliza cuando termina el renderizado.
 //   - inFlightFences: la CPU espera en ellos para no sobreescribir recursos en uso.
 // Los fences se crean señalizados para que el primer frame no se bloquee.
+// También crea el fence reutilizable de las operaciones puntuales y el
+// timeline de frames enviados (frameTimeline).
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createSyncObjects() {
     VkSemaphoreCreateInfo semaphoreInfo{};
@@ -80,19 +107,43 @@ void VulkanRenderer::createSyncObjects() {
             throw std::runtime_error("Failed to create synchronization objects!");
         }
     }
+
+    VkFenceCreateInfo singleTimeFenceInfo{};
+    singleTimeFenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device, &singleTimeFenceInfo, nullptr, &singleTimeFence) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create single-time fence!");
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frameTimeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create frame timeline semaphore!");
+    }
+    submittedFrameValue = 0;
 }
 
 // -----------------------------------------------------------------------------
 // recordCommandBuffer: graba los comandos de renderizado para un frame.
+//   0. Graba las barreras acquire de las subidas completadas desde el frame
+//      anterior (fuera del render pass, como exige vkCmdPipelineBarrier) y,
+//      en el camino GPU-driven, el compute de culling.
 //   1. Inicia el render pass con los valores de limpieza (negro para color,
 //      1.0 para depth).
-//   2. Si hay geometría cargada y pipeline válido:
-//      a. Vincula el pipeline gráfico.
-//      b. Configura viewport y scissor dinámicos al tamaño del swapchain.
-//      c. Vincula el buffer de vértices.
-//      d. Vincula el descriptor set del frame actual (UBO).
-//      e. Ejecuta el dibujo: indexado si hay índices, directo si no.
-//   3. Finaliza el render pass y el command buffer.
+//   2. Graba los draws de la escena:
+//      - GPU-driven: un vkCmdDraw*IndirectCount por lote, en línea.
+//      - Con pocos objetos, un draw por objeto en línea en el primario.
+//      - Con muchos, el render pass se inicia con contenido de secondaries,
+//        drawOrder se reparte entre los hilos de grabación y el primario
+//        solo ejecuta los secondaries resultantes, en orden.
+//   3. Finaliza el render pass y, en modo headless, graba el readback de la
+//      imagen offscreen.
+//   4. Finaliza el command buffer.
+// Si hay timestamps de GPU, el render pass queda entre el par del frame.
+// drawOrder y los ObjectData del frame ya están actualizados (drawFrame).
 // -----------------------------------------------------------------------------
 void VulkanRenderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
     VkCommandBufferBeginInfo beginInfo{};
@@ -102,6 +153,13 @@ void VulkanRenderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t
         throw std::runtime_error("Failed to begin recording command buffer!");
     }
 
+    recordTransferAcquires(commandBuffer);
+
+    bool gpuDriven = isGpuCullingActive() && !drawOrder.empty();
+    if (gpuDriven) {
+        recordCulling(commandBuffer);
+    }
+
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = renderPass;
@@ -115,57 +173,176 @@ void VulkanRenderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t
     renderPassInfo.clearValueCount = 2;
     renderPassInfo.pClearValues = clearValues;
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-    const auto& geometry = mesh.getData();
-    bool hasGeometry = graphicsPipeline != VK_NULL_HANDLE && geometry.vertexCount > 0;
-
-    if (hasGeometry) {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)swapChainExtent.width;
-        viewport.height = (float)swapChainExtent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    if (gpuTimestampsSupported) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frameQueryPool, currentFrame * 2);
+    }
 
-        VkRect2D scissor{};
-        scissor.offset = { 0, 0 };
-        scissor.extent = swapChainExtent;
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    uint32_t sliceCount = getRecordSliceCount(drawOrder.size());
+    if (gpuDriven) {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-        VkBuffer vertexBuffers[] = { vertexBuffer };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        recordIndirectDraws(commandBuffer);
+    }
+    else if (sliceCount > 1) {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+        recordDrawsParallel(swapChainFramebuffers[imageIndex], sliceCount);
 
-        if (geometry.indexCount > 0) {
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, geometry.indexType);
-            vkCmdDrawIndexed(commandBuffer, geometry.indexCount, 1, 0, 0, 0);
+        std::array<VkCommandBuffer, MAX_RECORD_SLICES> secondaries{};
+        for (uint32_t i = 0; i < sliceCount; i++) {
+            secondaries[i] = recordSlices[i].commandBuffers[currentFrame];
         }
-        else {
-            vkCmdDraw(commandBuffer, geometry.vertexCount, 1, 0, 0);
+        vkCmdExecuteCommands(commandBuffer, sliceCount, secondaries.data());
+    }
+    else {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        if (!drawOrder.empty()) {
+            recordDraws(commandBuffer, 0, drawOrder.size());
         }
     }
 
     vkCmdEndRenderPass(commandBuffer);
 
+    if (gpuTimestampsSupported) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameQueryPool, currentFrame * 2 + 1);
+        frameTimestampsWritten[currentFrame] = true;
+    }
+
+    if (headless) {
+        recordReadback(commandBuffer, imageIndex);
+    }
+
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("Failed to record command buffer!");
     }
 }
 
+// -----------------------------------------------------------------------------
+// recordFrameDrawState: configura viewport y scissor dinámicos al tamaño del
+// swapchain (un secondary no hereda el estado dinámico del primario) y
+// vincula el descriptor set del frame actual (UBO y ObjectData), compartido
+// por todas las variantes porque usan el mismo pipeline layout.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recordFrameDrawState(VkCommandBuffer commandBuffer) {
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)swapChainExtent.width;
+    viewport.height = (float)swapChainExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = { 0, 0 };
+    scissor.extent = swapChainExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+}
+
+// -----------------------------------------------------------------------------
+// recordDynamicDrawState: la topología y el vertex input dinámicos se graban
+// por objeto, pero como drawOrder está ordenado por ese estado solo se emiten
+// al cambiar. El estado dinámico sobrevive a los cambios de pipeline porque
+// todas las variantes declaran los mismos estados dinámicos.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recordDynamicDrawState(VkCommandBuffer commandBuffer, const SceneGeometry& object,
+    VkPrimitiveTopology& boundTopology, uint32_t& boundVertexInput) {
+    if (dynamicTopologySupported && object.geometry.topology != boundTopology) {
+        cmdSetPrimitiveTopology(commandBuffer, object.geometry.topology);
+        boundTopology = object.geometry.topology;
+    }
+
+    if (dynamicVertexInputSupported && object.vertexInputIndex != boundVertexInput) {
+        const VertexInputLayout& layout = vertexInputLayouts[object.vertexInputIndex];
+        cmdSetVertexInput(commandBuffer, 1, &layout.binding2,
+            static_cast<uint32_t>(layout.attributes2.size()), layout.attributes2.data());
+        boundVertexInput = object.vertexInputIndex;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// recordDraws: graba un tramo de drawOrder.
+//   a. Graba el estado común del frame (recordFrameDrawState).
+//   b. Recorre los objetos del tramo (agrupados por pipeline, estado
+//      dinámico y página) y solo vincula pipeline, estado dinámico, página de
+//      vértices o página de índices cuando cambian respecto al objeto anterior.
+//   c. Dibuja cada objeto con su offset dentro de la arena: indexado con
+//      firstIndex/vertexOffset si hay índices, directo con firstVertex si no.
+//      firstInstance es la posición del objeto en drawOrder, con la que el
+//      vertex shader localiza su ObjectData; una malla con instancias dibuja
+//      todas sus copias en el mismo draw.
+// Solo lee el estado de la escena, así que varios hilos pueden grabar tramos
+// distintos a la vez en command buffers distintos.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recordDraws(VkCommandBuffer commandBuffer, size_t begin, size_t end) {
+    recordFrameDrawState(commandBuffer);
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkPrimitiveTopology boundTopology = VK_PRIMITIVE_TOPOLOGY_MAX_ENUM;
+    uint32_t boundVertexInput = UINT32_MAX;
+    uint32_t boundVertexPage = UINT32_MAX;
+    uint32_t boundVertexBinding = UINT32_MAX;
+    uint32_t boundIndexPage = UINT32_MAX;
+    VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+    for (size_t i = begin; i < end; i++) {
+        const uint32_t firstInstance = static_cast<uint32_t>(i);
+        const SceneGeometry& object = *sceneObjects[drawOrder[i]].current;
+        const GeometryData& geometry = object.geometry;
+        const uint32_t instanceCount = std::max(geometry.instanceCount, 1u);
+
+        VkPipeline pipeline = pipelineVariants[object.pipelineIndex].pipeline;
+        if (pipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            boundPipeline = pipeline;
+        }
+        recordDynamicDrawState(commandBuffer, object, boundTopology, boundVertexInput);
+
+        uint32_t binding = geometry.bindingDescription.binding;
+        if (object.vertexRange.page != boundVertexPage || binding != boundVertexBinding) {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, binding, 1, &arenaPages[object.vertexRange.page].buffer, &offset);
+            boundVertexPage = object.vertexRange.page;
+            boundVertexBinding = binding;
+        }
+
+        uint32_t firstVertex = static_cast<uint32_t>(object.vertexRange.offset / geometry.bindingDescription.stride);
+
+        if (geometry.indexCount > 0) {
+            if (object.indexRange.page != boundIndexPage || geometry.indexType != boundIndexType) {
+                vkCmdBindIndexBuffer(commandBuffer, arenaPages[object.indexRange.page].buffer, 0, geometry.indexType);
+                boundIndexPage = object.indexRange.page;
+                boundIndexType = geometry.indexType;
+            }
+
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+            getLodDrawRange(object, frameLodLevels[i], firstIndex, indexCount);
+            vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, static_cast<int32_t>(firstVertex), firstInstance);
+        }
+        else {
+            vkCmdDraw(commandBuffer, geometry.vertexCount, instanceCount, firstVertex, firstInstance);
+        }
+    }
+}
+
 // -----------------------------------------------------------------------------
 // drawFrame: ejecuta el ciclo completo de un frame de renderizado.
 //
-// Flujo de sincronización (con 2 frames en vuelo):
-//   CPU espera fence[N] → adquiere imagen → resetea fence[N] →
-//   graba comandos → submit con wait(imageAvailable[N]) y signal(renderFinished[N])
-//   y signal fence[N] → presenta con wait(renderFinished[N])
+// Flujo de sincronización (con framesInFlight slots, según la política de
+// presentación):
+//   continúa las subidas en cola y envía el lote acumulado y los trabajos de
+//   preprocesado listos → CPU espera fence[N] → promociona mallas subidas,
+//   adopta niveles y preprocesados terminados y libera los rangos
+//   retirados del slot N → adquiere imagen → resetea fence[N] →
+//   graba comandos → submit con wait(imageAvailable[N]), wait(transferTimeline
+//   ≥ última subida adquirida), wait(computeTimeline ≥ último preprocesado
+//   adoptado), signal(renderFinished[N]), signal(frameTimeline
+//   = ++submittedFrameValue) y signal fence[N] →
+//   presenta con wait(renderFinished[N])
 //
 // Manejo de swapchain desactualizado:
 //   - Si vkAcquireNextImageKHR devuelve OUT_OF_DATE, recrea el swapchain y
@@ -173,12 +350,53 @@ void VulkanRenderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t
 //     no se reseteó, así que el próximo frame funciona correctamente).
 //   - Si vkQueuePresentKHR devuelve OUT_OF_DATE, SUBOPTIMAL o se marcó
 //     framebufferResized, recrea el swapchain tras la presentación.
+//
+// En modo headless no hay adquisición ni presentación: la imagen del frame es
+// la offscreen de su slot (imageIndex = currentFrame), el submit no espera ni
+// señaliza semáforos binarios (solo los timelines) y su readback se da por listo al esperar el
+// fence del slot. Los recorridos de latencia se cierran en el submit.
+//
+// Con LowLatency y VK_KHR_present_wait, cada presentación lleva su id y
+// drawFrame espera a que llegue a pantalla antes de volver (ver
+// waitForPresentId); con un solo frame en vuelo, el llamador lee la entrada
+// del siguiente justo después.
+//
+// Cada fase (subidas, espera del fence, adquisición, grabación, submit y
+// presentación) se mide con un ProfileScope; tras el fence se recogen los
+// timestamps de GPU del frame que ocupaba el slot. Tras presentar se cierran
+// los recorridos de latencia de las subidas que el frame ya dibujaba.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::drawFrame() {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    {
+        ProfileScope scope(profiler, ProfileMetric::Uploads);
+        pumpUploads();
+        submitUploadBatch();
+        submitGeometryPreprocessing();
+    }
 
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    {
+        ProfileScope scope(profiler, ProfileMetric::FenceWait);
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    }
+    collectFrameTimestamps(currentFrame);
+    if (headless) {
+        completeFrameReadback(currentFrame);
+    }
+
+    promoteCompletedUploads();
+    adoptLodResults();
+    adoptPreprocessResults();
+    processDeletionQueue(currentFrame);
+
+    // Subidas que verá este frame, para cerrar sus recorridos al presentarlo.
+    const uint64_t visibleUploadTicket = completedUploadTicket;
+
+    uint32_t imageIndex = currentFrame;
+    VkResult result = VK_SUCCESS;
+    if (!headless) {
+        ProfileScope scope(profiler, ProfileMetric::Acquire);
+        result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    }
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         recreateSwapChain();
@@ -190,49 +408,157 @@ void VulkanRenderer::drawFrame() {
 
     vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
-    vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-    updateUniformBuffer(currentFrame);
-    recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+    {
+        ProfileScope scope(profiler, ProfileMetric::Record);
+        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+        if (drawOrderDirty) {
+            rebuildDrawOrder();
+        }
+        updateUniformBuffer(currentFrame);
+        updateObjectBuffer(currentFrame);
+        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+    }
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
+    // El semáforo binario ignora su valor; cada timeline solo se espera si el
+    // frame adquirió alguna subida nueva o estrena normales del preprocesado.
+    // En modo headless no hay semáforo de adquisición.
+    VkSemaphore waitSemaphores[3];
+    VkPipelineStageFlags waitStages[3];
+    uint64_t waitValues[3];
+    uint32_t waitCount = 0;
+    auto addWait = [&](VkSemaphore semaphore, VkPipelineStageFlags stage, uint64_t value) {
+        waitSemaphores[waitCount] = semaphore;
+        waitStages[waitCount] = stage;
+        waitValues[waitCount] = value;
+        waitCount++;
+    };
+    if (!headless) {
+        addWait(imageAvailableSemaphores[currentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0);
+    }
+    if (frameTransferWaitValue > 0) {
+        addWait(transferTimeline, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, frameTransferWaitValue);
+    }
+    if (frameComputeWaitValue > 0) {
+        addWait(computeTimeline, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, frameComputeWaitValue);
+    }
+    submitInfo.waitSemaphoreCount = waitCount;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
 
+    // Igual con las señales: en headless solo se señaliza frameTimeline.
+    uint64_t signalValues[] = { 0, submittedFrameValue + 1 };
+    const uint32_t signalFirst = headless ? 1 : 0;
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = waitCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = 2 - signalFirst;
+    timelineInfo.pSignalSemaphoreValues = signalValues + signalFirst;
+    submitInfo.pNext = &timelineInfo;
+
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
-    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame], frameTimeline };
+    submitInfo.signalSemaphoreCount = 2 - signalFirst;
+    submitInfo.pSignalSemaphores = signalSemaphores + signalFirst;
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to submit draw command buffer!");
+    {
+        ProfileScope scope(profiler, ProfileMetric::Submit);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit draw command buffer!");
+        }
     }
+    submittedFrameValue++;
 
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    if (headless) {
+        stampPresentLatencies(visibleUploadTicket);
+        headlessFrameNumber++;
+    }
+    else {
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = signalSemaphores;
+
+        VkSwapchainKHR swapChains[] = { swapChain };
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = swapChains;
+        presentInfo.pImageIndices = &imageIndex;
+
+        const uint64_t presentId = nextPresentId;
+        VkPresentIdKHR presentIdInfo{};
+        presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds = &presentId;
+        if (presentWaitSupported) {
+            presentInfo.pNext = &presentIdInfo;
+            nextPresentId++;
+        }
 
-    VkSwapchainKHR swapChains[] = { swapChain };
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
+        {
+            ProfileScope scope(profiler, ProfileMetric::Present);
+            result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            stampPresentLatencies(visibleUploadTicket);
+            if (presentWaitSupported && presentPolicy == PresentPolicy::LowLatency) {
+                waitForPresentId(presentId);
+            }
+        }
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
-        framebufferResized = false;
-        recreateSwapChain();
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+            framebufferResized = false;
+            recreateSwapChain();
+        }
+        else if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to present swap chain image!");
+        }
     }
-    else if (result != VK_SUCCESS) {
-        throw std::runtime_error("Failed to present swap chain image!");
+
+    currentFrame = (currentFrame + 1) % framesInFlight;
+    profiler.endFrame();
+
+    savePipelineCacheIfDue();
+}
+
+// -----------------------------------------------------------------------------
+// waitForPresentId: se llama justo tras presentar, con el swapchain con que
+// se presentó el id. Un timeout o un swapchain desactualizado no son errores:
+// el frame simplemente deja de acompasarse y el siguiente recrea el swapchain
+// si hace falta.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::waitForPresentId(uint64_t presentId) {
+    ProfileScope scope(profiler, ProfileMetric::PresentWait);
+    VkResult result = waitForPresent(device, swapChain, presentId, PRESENT_WAIT_TIMEOUT_NS);
+    if (result != VK_SUCCESS && result != VK_TIMEOUT && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
+        throw std::runtime_error("Failed to wait for present!");
     }
+}
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-}
\ No newline at end of file
+// -----------------------------------------------------------------------------
+// needsRedraw: una subida solo llega a la pantalla cuando drawFrame la
+// promociona, así que cualquier objeto con versión pending (o subidas aún en
+// cola) exige seguir dibujando hasta que se vea. Una escritura en el sitio se
+// ve en cuanto un frame la adquiere. Lo mismo con los niveles de detalle:
+// hay que dibujar para adoptarlos y hasta que su subida termine, y con los
+// trabajos de preprocesado, que solo se envían y adoptan en drawFrame.
+// -----------------------------------------------------------------------------
+bool VulkanRenderer::needsRedraw() const {
+    if (!transformOverride.has_value() || framebufferResized || drawOrderDirty || !uploadQueue.empty()) {
+        return true;
+    }
+    if (lodResultsReady.load(std::memory_order_acquire) ||
+        std::any_of(pendingAcquires.begin(), pendingAcquires.end(), [](const PendingAcquire& pa) { return pa.inPlace; }) ||
+        std::any_of(preprocessSlots.begin(), preprocessSlots.end(), [](const PreprocessSlot& slot) { return slot.key != 0; })) {
+        return true;
+    }
+    return std::any_of(sceneObjects.begin(), sceneObjects.end(), [this](const SceneObject& object) {
+        return object.pending.has_value() ||
+            (object.current.has_value() && !object.current->lods.empty() && !isUploadComplete(object.current->lodTicket));
+    });
+}
@@ -0,0 +1,384 @@
+﻿// =============================================================================
+// vulkan_renderer_culling.cpp
+// Datos por objeto (storage buffer de ObjectData) y dibujo GPU-driven: un
+// compute shader descarta los objetos fuera del frustum y compacta los
+// comandos indirectos de cada lote, que se emiten con un solo
+// vkCmdDraw*IndirectCount por lote. El coste de CPU del frame deja de
+// depender del número de objetos visibles.
+// =============================================================================
+
+#include "vulkan_renderer.hpp"
+#include <stdexcept>
+
+// -----------------------------------------------------------------------------
+// extractFrustumPlanes: obtiene los seis planos del frustum (normal hacia
+// dentro) de una matriz proyección × vista, por el método de Gribb-Hartmann.
+// Con la profundidad de Vulkan en [0, 1], el plano cercano es la fila 2 sola.
+// glm guarda las matrices por columnas, así que la fila i es m[c][i] para c = 0..3.
+// -----------------------------------------------------------------------------
+static void extractFrustumPlanes(const glm::mat4& m, glm::vec4 planes[6]) {
+    auto row = [&](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+
+    planes[0] = row(3) + row(0); // Izquierdo
+    planes[1] = row(3) - row(0); // Derecho
+    planes[2] = row(3) + row(1); // Inferior
+    planes[3] = row(3) - row(1); // Superior
+    planes[4] = row(2);          // Cercano
+    planes[5] = row(3) - row(2); // Lejano
+
+    for (int i = 0; i < 6; i++) {
+        float length = glm::length(glm::vec3(planes[i].x, planes[i].y, planes[i].z));
+        if (length > 0.0f) {
+            planes[i] = planes[i] * (1.0f / length);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// createObjectBuffers / destroyObjectBuffers: buffers por objeto de todos los
+// frames en vuelo, con INITIAL_OBJECT_CAPACITY objetos cada uno.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createObjectBuffers() {
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createFrameObjectBuffers(i, INITIAL_OBJECT_CAPACITY);
+    }
+}
+
+void VulkanRenderer::destroyObjectBuffers() {
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        destroyFrameObjectBuffers(i);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// createFrameObjectBuffers: el buffer de ObjectData es host-visible con mapeo
+// persistente (la CPU lo reescribe cada frame, antes del submit). Los buffers
+// indirecto y de contadores solo los tocan la GPU (vkCmdFillBuffer y el
+// compute), así que viven en memoria device-local.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createFrameObjectBuffers(uint32_t frameIndex, uint32_t capacity) {
+    FrameObjectBuffers& buffers = frameObjects[frameIndex];
+
+    createBuffer(sizeof(ObjectData) * capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        buffers.objectBuffer,
+        buffers.objectAllocation);
+
+    VmaAllocationInfo allocInfo;
+    vmaGetAllocationInfo(allocator, buffers.objectAllocation, &allocInfo);
+    buffers.objectMapped = static_cast<ObjectData*>(allocInfo.pMappedData);
+
+    createBuffer(static_cast<VkDeviceSize>(INDIRECT_COMMAND_STRIDE) * capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        buffers.indirectBuffer,
+        buffers.indirectAllocation);
+
+    createBuffer(sizeof(uint32_t) * capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        buffers.countBuffer,
+        buffers.countAllocation);
+
+    buffers.capacity = capacity;
+}
+
+void VulkanRenderer::destroyFrameObjectBuffers(uint32_t frameIndex) {
+    FrameObjectBuffers& buffers = frameObjects[frameIndex];
+    if (buffers.objectBuffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(allocator, buffers.objectBuffer, buffers.objectAllocation);
+    }
+    if (buffers.indirectBuffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(allocator, buffers.indirectBuffer, buffers.indirectAllocation);
+    }
+    if (buffers.countBuffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(allocator, buffers.countBuffer, buffers.countAllocation);
+    }
+    buffers = FrameObjectBuffers{};
+}
+
+// -----------------------------------------------------------------------------
+// ensureObjectCapacity: duplica la capacidad hasta que quepan objectCount
+// objetos. Solo se recrean los buffers del frame indicado, cuyo fence ya se
+// esperó; el otro frame crecerá cuando le toque.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::ensureObjectCapacity(uint32_t frameIndex, uint32_t objectCount) {
+    uint32_t capacity = frameObjects[frameIndex].capacity;
+    if (objectCount <= capacity) {
+        return;
+    }
+    while (capacity < objectCount) {
+        capacity *= 2;
+    }
+
+    destroyFrameObjectBuffers(frameIndex);
+    createFrameObjectBuffers(frameIndex, capacity);
+    writeObjectDescriptors(frameIndex);
+}
+
+// -----------------------------------------------------------------------------
+// writeObjectDescriptors: binding 1 del set gráfico = ObjectData; set de
+// culling = ObjectData, comandos indirectos y contadores. Los descriptor
+// sets de un frame solo se reescriben cuando la GPU ya no los usa.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::writeObjectDescriptors(uint32_t frameIndex) {
+    const FrameObjectBuffers& buffers = frameObjects[frameIndex];
+
+    VkDescriptorBufferInfo bufferInfos[3]{};
+    bufferInfos[0].buffer = buffers.objectBuffer;
+    bufferInfos[0].offset = 0;
+    bufferInfos[0].range = VK_WHOLE_SIZE;
+    bufferInfos[1].buffer = buffers.indirectBuffer;
+    bufferInfos[1].offset = 0;
+    bufferInfos[1].range = VK_WHOLE_SIZE;
+    bufferInfos[2].buffer = buffers.countBuffer;
+    bufferInfos[2].offset = 0;
+    bufferInfos[2].range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet writes[4]{};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[0].dstSet = descriptorSets[frameIndex];
+    writes[0].dstBinding = 1;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[0].descriptorCount = 1;
+    writes[0].pBufferInfo = &bufferInfos[0];
+
+    for (uint32_t i = 0; i < 3; i++) {
+        writes[i + 1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i + 1].dstSet = cullDescriptorSets[frameIndex];
+        writes[i + 1].dstBinding = i;
+        writes[i + 1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i + 1].descriptorCount = 1;
+        writes[i + 1].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+}
+
+// -----------------------------------------------------------------------------
+// updateObjectBuffer: escribe el ObjectData de cada objeto de drawOrder, lote
+// a lote, en el buffer mapeado del frame, que hace de asignador lineal de
+// los datos por objeto: cada objeto ocupa el hueco de su posición en
+// drawOrder y el buffer se reescribe entero cada frame. El modelo es el de
+// la escena por el propio del objeto. Los parámetros de dibujo son los
+// mismos que usa recordDraws: offsets dentro de la página de la arena
+// convertidos a firstIndex/vertexOffset o firstVertex. Las transformaciones
+// por instancia se pasan como dirección de GPU dentro de su página. El nivel
+// de detalle de cada objeto se elige aquí y queda en frameLodLevels, para que
+// recordDraws dibuje el mismo tramo de índices.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::updateObjectBuffer(uint32_t frameIndex) {
+    ensureObjectCapacity(frameIndex, static_cast<uint32_t>(drawOrder.size()));
+    frameLodLevels.resize(drawOrder.size());
+
+    ObjectData* objects = frameObjects[frameIndex].objectMapped;
+    for (uint32_t b = 0; b < static_cast<uint32_t>(drawBatches.size()); b++) {
+        const DrawBatch& batch = drawBatches[b];
+        for (uint32_t i = batch.firstObject; i < batch.firstObject + batch.objectCount; i++) {
+            const SceneObject& sceneObject = sceneObjects[drawOrder[i]];
+            const SceneGeometry& object = *sceneObject.current;
+            const GeometryData& geometry = object.geometry;
+
+            ObjectData data{};
+            data.model = frameModel * sceneObject.model;
+            data.boundingSphere = geometry.boundingSphere;
+            data.positionScale = glm::vec4(geometry.positionScale, 0.0f);
+            data.positionOffset = glm::vec4(geometry.positionOffset, 0.0f);
+            data.batch = b;
+            data.commandOffset = batch.firstObject;
+            data.instanceCount = geometry.instanceCount;
+            if (object.instanceRange.isValid()) {
+                data.instanceAddress = arenaPages[object.instanceRange.page].deviceAddress + object.instanceRange.offset;
+            }
+            data.normalAddress = object.normalAddress;
+
+            uint32_t firstVertex = static_cast<uint32_t>(object.vertexRange.offset / geometry.bindingDescription.stride);
+            frameLodLevels[i] = selectLodLevel(sceneObject);
+            if (geometry.indexCount > 0) {
+                getLodDrawRange(object, frameLodLevels[i], data.firstElement, data.elementCount);
+                data.vertexOffset = static_cast<int32_t>(firstVertex);
+                data.indexed = 1;
+            }
+            else {
+                data.elementCount = geometry.vertexCount;
+                data.firstElement = firstVertex;
+                data.vertexOffset = 0;
+                data.indexed = 0;
+            }
+
+            objects[i] = data;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// createCullingPipeline: set 0 con tres storage buffers (objetos, comandos,
+// contadores), push constants con los planos del frustum y el compute
+// pipeline con el módulo de culling cacheado.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createCullingPipeline() {
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    for (uint32_t i = 0; i < 3; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create culling descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create culling pipeline layout!");
+    }
+
+    VkPipelineShaderStageCreateInfo stageInfo{};
+    stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stageInfo.module = cachedCullShaderModule;
+    stageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = stageInfo;
+    pipelineInfo.layout = cullPipelineLayout;
+
+    if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create culling pipeline!");
+    }
+    pipelineCacheDirty = true;
+}
+
+void VulkanRenderer::destroyCullingPipeline() {
+    if (cullPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, cullPipeline, nullptr);
+        cullPipeline = VK_NULL_HANDLE;
+    }
+    if (cullPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+        cullPipelineLayout = VK_NULL_HANDLE;
+    }
+    if (cullDescriptorSetLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, nullptr);
+        cullDescriptorSetLayout = VK_NULL_HANDLE;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// recordCulling: graba el paso de culling del frame, fuera del render pass.
+//   1. Pone a cero los contadores de los lotes (vkCmdFillBuffer).
+//   2. Barrera transfer → compute para que el shader vea los ceros.
+//   3. Dispatch de un hilo por objeto con los planos del frustum del frame.
+//   4. Barrera compute → draw indirect para que los draws lean los comandos
+//      y contadores ya escritos.
+// Los ObjectData escritos por la CPU son visibles sin barrera: vkQueueSubmit
+// hace visibles las escrituras de host previas.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recordCulling(VkCommandBuffer commandBuffer) {
+    const FrameObjectBuffers& buffers = frameObjects[currentFrame];
+    const uint32_t objectCount = static_cast<uint32_t>(drawOrder.size());
+
+    vkCmdFillBuffer(commandBuffer, buffers.countBuffer, 0, sizeof(uint32_t) * drawBatches.size(), 0);
+
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    CullPushConstants pushConstants{};
+    extractFrustumPlanes(frameViewProj, pushConstants.frustumPlanes);
+    pushConstants.objectCount = objectCount;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSets[currentFrame], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+// -----------------------------------------------------------------------------
+// recordIndirectDraws: un draw indirecto con contador por lote. El estado
+// (pipeline, estado dinámico, página de vértices, página y tipo de índices)
+// se toma del primer objeto del lote, que lo comparte con el resto, y solo se
+// vincula cuando cambia respecto al lote anterior. maxDrawCount es el tamaño del
+// lote; el número real lo decide el contador escrito por el culling.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recordIndirectDraws(VkCommandBuffer commandBuffer) {
+    const FrameObjectBuffers& buffers = frameObjects[currentFrame];
+
+    recordFrameDrawState(commandBuffer);
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkPrimitiveTopology boundTopology = VK_PRIMITIVE_TOPOLOGY_MAX_ENUM;
+    uint32_t boundVertexInput = UINT32_MAX;
+    uint32_t boundVertexPage = UINT32_MAX;
+    uint32_t boundVertexBinding = UINT32_MAX;
+    uint32_t boundIndexPage = UINT32_MAX;
+    VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+    for (uint32_t b = 0; b < static_cast<uint32_t>(drawBatches.size()); b++) {
+        const DrawBatch& batch = drawBatches[b];
+        const SceneGeometry& object = *sceneObjects[drawOrder[batch.firstObject]].current;
+        const GeometryData& geometry = object.geometry;
+
+        VkPipeline pipeline = pipelineVariants[object.pipelineIndex].pipeline;
+        if (pipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            boundPipeline = pipeline;
+        }
+        recordDynamicDrawState(commandBuffer, object, boundTopology, boundVertexInput);
+
+        uint32_t binding = geometry.bindingDescription.binding;
+        if (object.vertexRange.page != boundVertexPage || binding != boundVertexBinding) {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, binding, 1, &arenaPages[object.vertexRange.page].buffer, &offset);
+            boundVertexPage = object.vertexRange.page;
+            boundVertexBinding = binding;
+        }
+
+        VkDeviceSize commandOffset = static_cast<VkDeviceSize>(batch.firstObject) * INDIRECT_COMMAND_STRIDE;
+        VkDeviceSize countOffset = static_cast<VkDeviceSize>(b) * sizeof(uint32_t);
+
+        if (geometry.indexCount > 0) {
+            if (object.indexRange.page != boundIndexPage || geometry.indexType != boundIndexType) {
+                vkCmdBindIndexBuffer(commandBuffer, arenaPages[object.indexRange.page].buffer, 0, geometry.indexType);
+                boundIndexPage = object.indexRange.page;
+                boundIndexType = geometry.indexType;
+            }
+
+            vkCmdDrawIndexedIndirectCount(commandBuffer, buffers.indirectBuffer, commandOffset,
+                buffers.countBuffer, countOffset, batch.objectCount, INDIRECT_COMMAND_STRIDE);
+        }
+        else {
+            vkCmdDrawIndirectCount(commandBuffer, buffers.indirectBuffer, commandOffset,
+                buffers.countBuffer, countOffset, batch.objectCount, INDIRECT_COMMAND_STRIDE);
+        }
+    }
+}
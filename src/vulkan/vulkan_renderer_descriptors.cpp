@@ -13,22 +13,29 @@
 
 // -----------------------------------------------------------------------------
 // createDescriptorSetLayout: define la estructura de los descriptor sets que
-// el pipeline espera recibir. En este caso, un solo binding (0) de tipo
-// UNIFORM_BUFFER accesible desde el VERTEX_BIT (vertex shader).
+// el pipeline espera recibir. Dos bindings accesibles desde el VERTEX_BIT
+// (vertex shader): el 0, de tipo UNIFORM_BUFFER, con las matrices de cmara,
+// y el 1, de tipo STORAGE_BUFFER, con el ObjectData de cada objeto.
 // El layout es un "contrato" entre el pipeline y los datos que se le pasan.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createDescriptorSetLayout() {
-    VkDescriptorSetLayoutBinding uboLayoutBinding{};
-    uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    uboLayoutBinding.pImmutableSamplers = nullptr;
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    bindings[0].pImmutableSamplers = nullptr;
+
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    bindings[1].pImmutableSamplers = nullptr;
 
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
 
     if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor set layout!");
@@ -61,18 +68,21 @@ void VulkanRenderer::createUniformBuffers() {
 
 // -----------------------------------------------------------------------------
 // createDescriptorPool: crea el pool de donde se asignan los descriptor sets.
-// Reserva espacio para MAX_FRAMES_IN_FLIGHT descriptores de tipo uniform buffer.
+// Por cada frame en vuelo reserva el set grfico (un uniform buffer y un
+// storage buffer) y el set de culling (tres storage buffers).
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createDescriptorPool() {
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 4);
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 2);
 
     if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
@@ -80,11 +90,13 @@ void VulkanRenderer::createDescriptorPool() {
 }
 
 // -----------------------------------------------------------------------------
-// createDescriptorSets: asigna un descriptor set por frame en vuelo y los
-// configura para apuntar a sus respectivos uniform buffers.
+// createDescriptorSets: asigna un descriptor set grfico y uno de culling por
+// frame en vuelo y los configura para apuntar a los buffers de ese frame.
 // Cada VkWriteDescriptorSet conecta el binding 0 del descriptor set con el
 // buffer uniform correspondiente, indicando el rango completo del UBO.
-// Esta conexin permite que el shader acceda a las matrices de transformacin.
+// Esta conexin permite que el shader acceda a las matrices de cmara. Los
+// bindings de los buffers por objeto los escribe writeObjectDescriptors,
+// que se vuelve a llamar cada vez que esos buffers crecen.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createDescriptorSets() {
     std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
@@ -117,25 +129,55 @@ void VulkanRenderer::createDescriptorSets() {
 
         vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
     }
+
+    std::vector<VkDescriptorSetLayout> cullLayouts(MAX_FRAMES_IN_FLIGHT, cullDescriptorSetLayout);
+    allocInfo.pSetLayouts = cullLayouts.data();
+    if (vkAllocateDescriptorSets(device, &allocInfo, cullDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate culling descriptor sets!");
+    }
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        writeObjectDescriptors(i);
+    }
 }
 
 // -----------------------------------------------------------------------------
 // setTransform / clearTransformOverride: permiten que un proceso externo
 // (como el geometry writer via IPC) controle las matrices de transformacin.
 // Cuando hay un override activo, updateUniformBuffer usa esas matrices
-// directamente en lugar de la rotacin automtica.
+// directamente en lugar de la rotacin automtica. Un override idntico al
+// activo (un productor que republica la misma cmara) no cuenta como cambio:
+// ni avanza uniformVersion ni pide un frame.
 // -----------------------------------------------------------------------------
-void VulkanRenderer::setTransform(const TransformData& transform) {
+bool VulkanRenderer::setTransform(const TransformData& transform) {
+    if (transformOverride.has_value() && transformOverride->model == transform.model &&
+        transformOverride->view == transform.view && transformOverride->proj == transform.proj) {
+        return false;
+    }
+    if (!transformOverride.has_value() || transformOverride->view != transform.view ||
+        transformOverride->proj != transform.proj) {
+        uniformVersion++;
+    }
     transformOverride = transform;
+    return true;
 }
 
 void VulkanRenderer::clearTransformOverride() {
-    transformOverride.reset();
+    if (transformOverride.has_value()) {
+        transformOverride.reset();
+        uniformVersion++;
+    }
 }
 
 // -----------------------------------------------------------------------------
-// updateUniformBuffer: actualiza las matrices modelo/vista/proyeccin en el
-// uniform buffer del frame actual mediante memcpy al puntero mapeado persistente.
+// updateUniformBuffer: actualiza las matrices vista/proyeccin en el uniform
+// buffer del frame actual mediante memcpy al puntero mapeado persistente, y
+// deja la matriz de modelo de la escena en frameModel para updateObjectBuffer
+// (y la vista y la proyeccin en frameView/frameProj, para elegir los LOD).
+// El memcpy solo ocurre si el buffer del frame guarda una versin anterior a
+// uniformVersion: con una cmara fija, cada buffer se escribe una vez por
+// cambio y el resto de frames no tocan la memoria write-combined. La matriz
+// de modelo no vive en el UBO, as que la rotacin automtica no lo ensucia.
 //
 // Dos modos de operacin:
 //   1. Con override externo: usa las matrices proporcionadas por setTransform.
@@ -155,7 +197,7 @@ void VulkanRenderer::updateUniformBuffer(uint32_t currentImage) {
     UniformBufferObject ubo{};
 
     if (transformOverride.has_value()) {
-        ubo.model = transformOverride->model;
+        frameModel = transformOverride->model;
         ubo.view = transformOverride->view;
         ubo.proj = transformOverride->proj;
     }
@@ -170,12 +212,19 @@ void VulkanRenderer::updateUniformBuffer(uint32_t currentImage) {
             cachedProj[1][1] *= -1;
 
             cachedExtent = swapChainExtent;
+            uniformVersion++;
         }
 
-        ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        frameModel = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
         ubo.view = cachedView;
         ubo.proj = cachedProj;
     }
 
-    std::memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+    frameView = ubo.view;
+    frameProj = ubo.proj;
+    frameViewProj = ubo.proj * ubo.view;
+    if (uniformBufferVersions[currentImage] != uniformVersion) {
+        std::memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+        uniformBufferVersions[currentImage] = uniformVersion;
+    }
 }
\ No newline at end of file
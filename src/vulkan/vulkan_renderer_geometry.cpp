@@ -1,10 +1,12 @@
 // =============================================================================
 // vulkan_renderer_geometry.cpp
 // Gestin de la geometra del renderer: validacin de mallas, comparacin de
-// layouts de vrtices, y actualizacin en caliente de los buffers de GPU.
+// layouts de vrtices, y la escena de mallas (alta, reemplazo y baja) cuyos
+// datos viven sub-asignados en la arena de geometra de GPU.
 // =============================================================================
 
 #include "vulkan_renderer.hpp"
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
 
@@ -37,94 +39,567 @@ static bool areAttributesEqual(const std::vector<VkVertexInputAttributeDescripti
 }
 
 // -----------------------------------------------------------------------------
-// isVertexLayoutDifferent: compara el layout de vrtices de la geometra actual
-// con el de una nueva geometra. Si el binding o los atributos difieren, el
-// pipeline grfico debe recrearse porque el vertex input state est horneado
-// en el pipeline compilado.
+// validateGeometry: valida la geometra entrante (stride no nulo, datos de
+// vrtices presentes, tamao de datos coherente con stride, indexType y
+// mat4 por instancia) y calcula vertexCount, indexCount e instanceCount a
+// partir del tamao de los datos. Los
+// tamaos se pasan aparte porque en las subidas desde staging los bytes no
+// estn en los vectores de geometry. Si la esfera envolvente no viene dada y
+// los vrtices estn en CPU, se calcula aqu para el culling.
 // -----------------------------------------------------------------------------
-bool VulkanRenderer::isVertexLayoutDifferent(const GeometryData& other) const {
-    const auto& current = mesh.getData();
-    if (!areBindingsEqual(current.bindingDescription, other.bindingDescription)) {
-        return true;
+static void validateGeometry(GeometryData& geometry, size_t vertexBytes, size_t indexBytes, size_t instanceBytes) {
+    if (geometry.bindingDescription.stride == 0) {
+        throw std::runtime_error("Geometry must define a valid stride.");
+    }
+    if (vertexBytes == 0) {
+        throw std::runtime_error("Geometry must have vertexData.");
+    }
+    if (vertexBytes % geometry.bindingDescription.stride != 0) {
+        throw std::runtime_error("vertexData size does not match stride.");
+    }
+
+    geometry.vertexCount = static_cast<uint32_t>(vertexBytes / geometry.bindingDescription.stride);
+
+    if (indexBytes > 0) {
+        uint32_t indexStride = (geometry.indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
+        if (indexBytes % indexStride != 0) {
+            throw std::runtime_error("indexData size does not match index type.");
+        }
+        geometry.indexCount = static_cast<uint32_t>(indexBytes / indexStride);
+    }
+    else {
+        geometry.indexCount = 0;
+    }
+
+    if (instanceBytes % sizeof(glm::mat4) != 0) {
+        throw std::runtime_error("instanceData size does not match mat4 instance transforms.");
+    }
+    geometry.instanceCount = static_cast<uint32_t>(instanceBytes / sizeof(glm::mat4));
+
+    if (geometry.boundingSphere.w < 0.0f && geometry.vertexData.size() == vertexBytes) {
+        geometry.boundingSphere = computeBoundingSphere(geometry);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// isSameVertexLayout: compara dos layouts de vrtices. Si el binding o los
+// atributos difieren, no pueden compartir pipeline porque el vertex input
+// state est horneado en el pipeline compilado.
+// -----------------------------------------------------------------------------
+bool VulkanRenderer::isSameVertexLayout(const VkVertexInputBindingDescription& bindingA,
+    const std::vector<VkVertexInputAttributeDescription>& attributesA,
+    const VkVertexInputBindingDescription& bindingB,
+    const std::vector<VkVertexInputAttributeDescription>& attributesB) {
+    return areBindingsEqual(bindingA, bindingB) && areAttributesEqual(attributesA, attributesB);
+}
+
+// -----------------------------------------------------------------------------
+// validateVertexFormats: la consulta es barata (como mucho unos pocos
+// atributos por geometra), as que no se cachea.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::validateVertexFormats(const GeometryData& geometry) const {
+    for (const auto& attribute : geometry.attributeDescriptions) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, attribute.format, &properties);
+        if ((properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) == 0) {
+            throw std::runtime_error("Vertex attribute format is not supported by the GPU.");
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// allocateSceneGeometry: prepara una versin nueva para una geometra validada.
+//   1. Obtiene (o crea) la variante del pipeline para su layout y topologa
+//      y, con vertex input dinmico, el ndice de su layout.
+//   2. Reserva un rango de vrtices alineado al stride y, si hay ndices, un
+//      rango alineado al tamao del ndice, de modo que el dibujo pueda usar
+//      vertexOffset/firstIndex con la pgina vinculada en el offset 0.
+//   3. Si hay instancias, reserva su rango alineado a una mat4, lo que cumple
+//      la alineacin de 16 bytes con la que el shader lee por direccin.
+// Los rangos son siempre nuevos, as que la versin que se est dibujando
+// no se toca y no hace falta esperar a la GPU.
+// -----------------------------------------------------------------------------
+VulkanRenderer::SceneGeometry VulkanRenderer::allocateSceneGeometry(GeometryData&& geometry, VkDeviceSize vertexBytes, VkDeviceSize indexBytes, VkDeviceSize instanceBytes) {
+    validateVertexFormats(geometry);
+
+    SceneGeometry result{};
+    result.pipelineIndex = findOrCreatePipelineVariant(geometry);
+    if (dynamicVertexInputSupported) {
+        result.vertexInputIndex = findOrCreateVertexInputLayout(geometry);
+    }
+    result.vertexRange = arenaAllocate(vertexBytes, geometry.bindingDescription.stride);
+
+    if (geometry.indexCount > 0) {
+        VkDeviceSize indexStride = (geometry.indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
+        result.indexRange = arenaAllocate(indexBytes, indexStride);
+    }
+
+    if (geometry.instanceCount > 0) {
+        result.instanceRange = arenaAllocate(instanceBytes, sizeof(glm::mat4));
+    }
+
+    result.geometry = std::move(geometry);
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+// uploadSceneGeometry: sube una geometra validada a rangos nuevos de la arena.
+// Entrega los bytes a la cola de subidas (sin copiarlos) y anota el ticket de
+// la ltima, que marca cundo la versin es dibujable: las subidas terminan
+// en orden, as que cubre tambin la de vrtices. Solo se conserva la
+// metadata; los vectores quedan vacos tras moverlos.
+// Si la geometra admite niveles de detalle, su trabajo se encola antes de
+// mover los vectores y el rango de ndices se reserva con el hueco para
+// ellos (ver getLodIndexHeadroom).
+// -----------------------------------------------------------------------------
+VulkanRenderer::SceneGeometry VulkanRenderer::uploadSceneGeometry(GeometryData&& geometry) {
+    const uint32_t lodHeadroom = getLodIndexHeadroom(geometry);
+    const uint64_t lodKey = (lodHeadroom > 0) ? queueLodBuild(geometry, lodHeadroom) : 0;
+    const VkDeviceSize indexStride = (geometry.indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
+
+    std::vector<uint8_t> vertexData = std::move(geometry.vertexData);
+    std::vector<uint8_t> indexData = std::move(geometry.indexData);
+    std::vector<uint8_t> instanceData = std::move(geometry.instanceData);
+    geometry.vertexData = {};
+    geometry.indexData = {};
+    geometry.instanceData = {};
+
+    SceneGeometry result = allocateSceneGeometry(std::move(geometry),
+        static_cast<VkDeviceSize>(vertexData.size()), static_cast<VkDeviceSize>(indexData.size()) + lodHeadroom * indexStride,
+        static_cast<VkDeviceSize>(instanceData.size()));
+    result.lodKey = lodKey;
+
+    result.uploadTicket = transferToDeviceLocal(arenaPages[result.vertexRange.page].buffer, result.vertexRange.offset,
+        std::move(vertexData));
+
+    if (result.indexRange.isValid()) {
+        result.uploadTicket = transferToDeviceLocal(arenaPages[result.indexRange.page].buffer, result.indexRange.offset,
+            std::move(indexData));
+    }
+
+    if (result.instanceRange.isValid()) {
+        result.uploadTicket = transferToDeviceLocal(arenaPages[result.instanceRange.page].buffer, result.instanceRange.offset,
+            std::move(instanceData));
+    }
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+// uploadSceneGeometryFromStaging: como uploadSceneGeometry, pero los bytes ya
+// estn en regiones de staging escritas por el llamador, as que solo se
+// graban las copias hacia los rangos nuevos. Si la geometra admite
+// preprocesado, el mismo lote copia tambin sus vrtices e ndices para l.
+// -----------------------------------------------------------------------------
+VulkanRenderer::SceneGeometry VulkanRenderer::uploadSceneGeometryFromStaging(GeometryData&& layout, const StagingWriteRegion& vertexRegion,
+    const StagingWriteRegion& indexRegion, const StagingWriteRegion& instanceRegion) {
+    SceneGeometry result = allocateSceneGeometry(std::move(layout), vertexRegion.size, indexRegion.size, instanceRegion.size);
+
+    result.uploadTicket = transferFromStaging(arenaPages[result.vertexRange.page].buffer, result.vertexRange.offset,
+        vertexRegion);
+
+    if (result.indexRange.isValid()) {
+        result.uploadTicket = transferFromStaging(arenaPages[result.indexRange.page].buffer, result.indexRange.offset,
+            indexRegion);
+    }
+
+    if (result.instanceRange.isValid()) {
+        result.uploadTicket = transferFromStaging(arenaPages[result.instanceRange.page].buffer, result.instanceRange.offset,
+            instanceRegion);
+    }
+
+    result.preprocessKey = queueGeometryPreprocess(result.geometry, vertexRegion, indexRegion);
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+// retireSceneGeometry: enva los rangos de una versin a la cola de borrado
+// diferido. Si la versin nunca lleg a completarse, sus rangos esperan
+// adems a que termine su subida (el de ndices, tambin a la de sus
+// niveles de detalle), y su trabajo de LOD en cola se descarta. Lo mismo con
+// su preprocesado: el trabajo pendiente ya no encontrar destino y sus
+// normales siguen el borrado diferido.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::retireSceneGeometry(SceneGeometry& sceneGeometry) {
+    if (sceneGeometry.lodKey != 0) {
+        cancelLodBuild(sceneGeometry.lodKey);
+        sceneGeometry.lodKey = 0;
+    }
+    dropPreprocessedData(sceneGeometry);
+    arenaRetire(sceneGeometry.vertexRange, sceneGeometry.uploadTicket);
+    arenaRetire(sceneGeometry.indexRange, std::max(sceneGeometry.uploadTicket, sceneGeometry.lodTicket));
+    arenaRetire(sceneGeometry.instanceRange, sceneGeometry.uploadTicket);
+}
+
+// -----------------------------------------------------------------------------
+// promoteCompletedUploads: recicla las transferencias terminadas y, para cada
+// objeto con una versin pending ya completa, la convierte en current y
+// retira la anterior. El intercambio ocurre entre frames, as que el frame
+// que se va a grabar ve exclusivamente la versin nueva.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::promoteCompletedUploads() {
+    flushCompletedTransfers();
+
+    for (auto& object : sceneObjects) {
+        if (!object.pending.has_value() || !isUploadComplete(object.pending->uploadTicket)) {
+            continue;
+        }
+        if (object.current.has_value()) {
+            retireSceneGeometry(*object.current);
+        }
+        object.current = std::move(object.pending);
+        object.pending.reset();
+        drawOrderDirty = true;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// rebuildDrawOrder: ordena los objetos por variante de pipeline, estado
+// dinmico (topologa y vertex input) y pgina de la arena, para que
+// recordCommandBuffer solo emita vkCmdBindPipeline, vkCmdSet* y
+// vkCmdBind*Buffer(s) cuando el estado cambia realmente. Los objetos cuya
+// primera subida an no ha terminado no tienen versin current y se omiten.
+// Despus agrupa los tramos consecutivos que comparten todo ese estado en
+// drawBatches: cada lote se dibuja con un nico draw indirecto.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::rebuildDrawOrder() {
+    drawOrder.clear();
+    for (uint32_t i = 0; i < static_cast<uint32_t>(sceneObjects.size()); i++) {
+        if (sceneObjects[i].current.has_value()) {
+            drawOrder.push_back(i);
+        }
+    }
+
+    std::sort(drawOrder.begin(), drawOrder.end(), [this](uint32_t a, uint32_t b) {
+        const SceneGeometry& objA = *sceneObjects[a].current;
+        const SceneGeometry& objB = *sceneObjects[b].current;
+        if (objA.pipelineIndex != objB.pipelineIndex) {
+            return objA.pipelineIndex < objB.pipelineIndex;
+        }
+        if (objA.geometry.topology != objB.geometry.topology) {
+            return objA.geometry.topology < objB.geometry.topology;
+        }
+        if (objA.vertexInputIndex != objB.vertexInputIndex) {
+            return objA.vertexInputIndex < objB.vertexInputIndex;
+        }
+        if (objA.vertexRange.page != objB.vertexRange.page) {
+            return objA.vertexRange.page < objB.vertexRange.page;
+        }
+        if (objA.indexRange.page != objB.indexRange.page) {
+            return objA.indexRange.page < objB.indexRange.page;
+        }
+        bool indexedA = objA.geometry.indexCount > 0;
+        bool indexedB = objB.geometry.indexCount > 0;
+        if (indexedA != indexedB) {
+            return indexedA < indexedB;
+        }
+        return objA.geometry.indexType < objB.geometry.indexType;
+    });
+
+    drawBatches.clear();
+    for (uint32_t i = 0; i < static_cast<uint32_t>(drawOrder.size()); i++) {
+        const SceneGeometry& object = *sceneObjects[drawOrder[i]].current;
+        if (!drawBatches.empty()) {
+            const SceneGeometry& first = *sceneObjects[drawOrder[drawBatches.back().firstObject]].current;
+            bool sameState = first.pipelineIndex == object.pipelineIndex &&
+                first.geometry.topology == object.geometry.topology &&
+                first.vertexInputIndex == object.vertexInputIndex &&
+                first.vertexRange.page == object.vertexRange.page &&
+                first.indexRange.page == object.indexRange.page &&
+                (first.geometry.indexCount > 0) == (object.geometry.indexCount > 0) &&
+                first.geometry.indexType == object.geometry.indexType;
+            if (sameState) {
+                drawBatches.back().objectCount++;
+                continue;
+            }
+        }
+        drawBatches.push_back({ i, 1 });
     }
-    return !areAttributesEqual(current.attributeDescriptions, other.attributeDescriptions);
+
+    drawOrderDirty = false;
 }
 
 // -----------------------------------------------------------------------------
-// setMesh: reemplaza la geometra activa del renderer.
+// addMesh: aade una malla nueva a la escena. Como solo se reservan rangos
+// libres de la arena, ningn objeto existente se ve afectado. La malla
+// empieza a dibujarse en el primer frame tras completarse su transferencia.
+// La versin const hace la nica copia de los datos; la versin rvalue los
+// entrega tal cual.
+// -----------------------------------------------------------------------------
+MeshHandle VulkanRenderer::addMesh(const Mesh& newMesh) {
+    GeometryData copy = newMesh.getData();
+    return addGeometry(std::move(copy));
+}
+
+MeshHandle VulkanRenderer::addMesh(Mesh&& newMesh) {
+    return addGeometry(newMesh.releaseData());
+}
+
+// -----------------------------------------------------------------------------
+// addGeometry: valida la geometra y la sube como versin pending de un objeto
+// nuevo. Sus vectores acaban en la cola de subidas sin copiarse.
+// -----------------------------------------------------------------------------
+MeshHandle VulkanRenderer::addGeometry(GeometryData&& geometry) {
+    validateGeometry(geometry, geometry.vertexData.size(), geometry.indexData.size(), geometry.instanceData.size());
+    return addSceneObject(uploadSceneGeometry(std::move(geometry)));
+}
+
+// -----------------------------------------------------------------------------
+// updateMesh: reemplaza la geometra de una malla existente sin bloquear.
 //
 // Proceso:
-//   1. Valida la geometra entrante: stride no nulo, datos de vrtices presentes,
-//      tamao de datos coherente con stride e indexType.
-//   2. Calcula vertexCount e indexCount a partir del tamao de los datos.
-//   3. Determina si el layout de vrtices o la topologa cambiaron
-//      (lo que requiere recrear el pipeline).
-//   4. Sincronizacin: espera a que todos los frames en vuelo terminen
-//      (usando los fences individuales, no vkDeviceWaitIdle) y espera
-//      las transferencias pendientes que podran estar llenando los buffers
-//      actuales.
-//   5. Destruye los buffers de vrtices e ndices antiguos.
-//   6. Almacena la nueva malla.
-//   7. Recrea el pipeline grfico si es necesario (o lo crea por primera vez).
-//   8. Crea los nuevos buffers de vrtices e ndices y los llena
-//      mediante el staging ring buffer.
+//   1. Valida la geometra entrante antes de tocar el estado de la escena.
+//   2. Si ya haba una versin pending sin promocionar, queda sustituida: sus
+//      rangos se retiran (se liberarn cuando termine su subida).
+//   3. Sube la nueva geometra a rangos nuevos como versin pending.
+//      La versin current se sigue dibujando hasta que la subida
+//      termina; entonces promoteCompletedUploads hace el intercambio.
 // -----------------------------------------------------------------------------
-void VulkanRenderer::setMesh(const Mesh& newMesh) {
-    GeometryData validated = newMesh.getData();
+void VulkanRenderer::updateMesh(MeshHandle handle, const Mesh& newMesh) {
+    GeometryData copy = newMesh.getData();
+    updateGeometry(handle, std::move(copy));
+}
 
-    if (validated.bindingDescription.stride == 0) {
-        throw std::runtime_error("Geometry must define a valid stride.");
+void VulkanRenderer::updateMesh(MeshHandle handle, Mesh&& newMesh) {
+    updateGeometry(handle, newMesh.releaseData());
+}
+
+// -----------------------------------------------------------------------------
+// updateGeometry: ruta comn de updateMesh, que toma posesin de la geometra.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::updateGeometry(MeshHandle handle, GeometryData&& geometry) {
+    if (sceneObjectIndices.find(handle) == sceneObjectIndices.end()) {
+        throw std::runtime_error("Unknown mesh handle.");
     }
-    if (validated.vertexData.empty()) {
-        throw std::runtime_error("Geometry must have vertexData.");
+
+    validateGeometry(geometry, geometry.vertexData.size(), geometry.indexData.size(), geometry.instanceData.size());
+
+    replacePendingGeometry(handle, uploadSceneGeometry(std::move(geometry)));
+}
+
+// -----------------------------------------------------------------------------
+// addSceneObject: registra un objeto nuevo con su primera versin como
+// pending; empieza a dibujarse cuando sta se promociona.
+// -----------------------------------------------------------------------------
+MeshHandle VulkanRenderer::addSceneObject(SceneGeometry&& pending) {
+    SceneObject object{};
+    object.handle = nextMeshHandle++;
+    object.pending = std::move(pending);
+
+    sceneObjectIndices[object.handle] = sceneObjects.size();
+    sceneObjects.push_back(std::move(object));
+
+    return sceneObjects.back().handle;
+}
+
+// -----------------------------------------------------------------------------
+// replacePendingGeometry: instala una versin pending nueva. Si ya haba una
+// sin promocionar, queda sustituida y sus rangos se retiran.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::replacePendingGeometry(MeshHandle handle, SceneGeometry&& pending) {
+    SceneObject& object = sceneObjects[sceneObjectIndices.at(handle)];
+    if (object.pending.has_value()) {
+        retireSceneGeometry(*object.pending);
+        object.pending.reset();
     }
-    if (validated.vertexData.size() % validated.bindingDescription.stride != 0) {
-        throw std::runtime_error("vertexData size does not match stride.");
+    object.pending = std::move(pending);
+}
+
+// -----------------------------------------------------------------------------
+// removeMesh: elimina una malla de la escena. Sus rangos se retiran a la cola
+// de borrado diferido (los frames en vuelo an pueden leerlos) y el hueco en
+// sceneObjects se cierra moviendo el ltimo objeto a su posicin
+// (swap-and-pop).
+// -----------------------------------------------------------------------------
+void VulkanRenderer::removeMesh(MeshHandle handle) {
+    auto it = sceneObjectIndices.find(handle);
+    if (it == sceneObjectIndices.end()) {
+        throw std::runtime_error("Unknown mesh handle.");
     }
 
-    validated.vertexCount = static_cast<uint32_t>(validated.vertexData.size() / validated.bindingDescription.stride);
+    size_t index = it->second;
+    SceneObject& object = sceneObjects[index];
+    if (object.current.has_value()) {
+        retireSceneGeometry(*object.current);
+    }
+    if (object.pending.has_value()) {
+        retireSceneGeometry(*object.pending);
+    }
+    sceneObjectIndices.erase(it);
 
-    if (!validated.indexData.empty()) {
-        uint32_t indexStride = (validated.indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
-        if (validated.indexData.size() % indexStride != 0) {
-            throw std::runtime_error("indexData size does not match index type.");
-        }
-        validated.indexCount = static_cast<uint32_t>(validated.indexData.size() / indexStride);
+    if (index != sceneObjects.size() - 1) {
+        sceneObjects[index] = std::move(sceneObjects.back());
+        sceneObjectIndices[sceneObjects[index].handle] = index;
+    }
+    sceneObjects.pop_back();
+
+    if (handle == defaultMeshHandle) {
+        defaultMeshHandle = InvalidMeshHandle;
+    }
+    drawOrderDirty = true;
+}
+
+// -----------------------------------------------------------------------------
+// setObjectTransform: guarda el modelo propio del objeto. Se conserva entre
+// versiones de su geometra y updateObjectBuffer lo recoge en el frame
+// siguiente, as que no hace falta reconstruir drawOrder.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::setObjectTransform(MeshHandle handle, const glm::mat4& model) {
+    auto it = sceneObjectIndices.find(handle);
+    if (it == sceneObjectIndices.end()) {
+        throw std::runtime_error("Unknown mesh handle.");
+    }
+    sceneObjects[it->second].model = model;
+}
+
+// -----------------------------------------------------------------------------
+// setMesh: reemplaza la geometra de la malla por defecto de la escena.
+// Mantiene la semntica del flujo de una sola malla: la primera llamada la
+// aade y las siguientes la actualizan en su sitio.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::setMesh(const Mesh& newMesh) {
+    GeometryData copy = newMesh.getData();
+    setGeometry(std::move(copy));
+}
+
+void VulkanRenderer::setMesh(Mesh&& newMesh) {
+    setGeometry(newMesh.releaseData());
+}
+
+// -----------------------------------------------------------------------------
+// setGeometry: ruta comn de setMesh, que toma posesin de la geometra.
+// Su duracin se registra como SetMesh en el perfilador.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::setGeometry(GeometryData&& geometry) {
+    ProfileScope scope(profiler, ProfileMetric::SetMesh);
+    if (defaultMeshHandle == InvalidMeshHandle) {
+        defaultMeshHandle = addGeometry(std::move(geometry));
     }
     else {
-        validated.indexCount = 0;
+        updateGeometry(defaultMeshHandle, std::move(geometry));
     }
+}
 
-    bool recreatePipeline = isVertexLayoutDifferent(validated) || mesh.getData().topology != validated.topology;
+// -----------------------------------------------------------------------------
+// setMeshFromStaging: como setMesh, pero con los bytes ya escritos por el
+// llamador en staging. Se valida con los tamaos de las regiones y solo se
+// copia la metadata de layout; los datos no vuelven a pasar por la CPU.
+// Su duracin se registra como SetMesh en el perfilador.
+// -----------------------------------------------------------------------------
+uint64_t VulkanRenderer::setMeshFromStaging(const GeometryData& layout, const StagingWriteRegion& vertexRegion,
+    const StagingWriteRegion& indexRegion, const StagingWriteRegion& instanceRegion) {
+    ProfileScope scope(profiler, ProfileMetric::SetMesh);
+    GeometryData validated{};
+    validated.bindingDescription = layout.bindingDescription;
+    validated.attributeDescriptions = layout.attributeDescriptions;
+    validated.topology = layout.topology;
+    validated.indexType = layout.indexType;
+    validated.boundingSphere = layout.boundingSphere;
+    validated.positionScale = layout.positionScale;
+    validated.positionOffset = layout.positionOffset;
+    validateGeometry(validated, static_cast<size_t>(vertexRegion.size), static_cast<size_t>(indexRegion.size),
+        static_cast<size_t>(instanceRegion.size));
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkWaitForFences(device, 1, &inFlightFences[i], VK_TRUE, UINT64_MAX);
+    SceneGeometry staged = uploadSceneGeometryFromStaging(std::move(validated), vertexRegion, indexRegion, instanceRegion);
+    uint64_t ticket = staged.uploadTicket;
+    if (defaultMeshHandle == InvalidMeshHandle) {
+        defaultMeshHandle = addSceneObject(std::move(staged));
+    }
+    else {
+        replacePendingGeometry(defaultMeshHandle, std::move(staged));
     }
+    return ticket;
+}
 
-    waitAllTransfers();
+// -----------------------------------------------------------------------------
+// setMeshRangesFromStaging: aplica una actualizacin parcial a la versin ms
+// reciente de la malla por defecto.
+//   - Si hay pending, an no se dibuja: sus rangos se reescriben sin esperar
+//     a nadie y su ticket pasa a ser el de esta subida, as que se promociona
+//     ya con los cambios.
+//   - Si no, se reescribe current en su sitio: el lote espera a los frames
+//     enviados y los siguientes adquieren los rangos al grabarse (ver
+//     recordTransferAcquires). Su ticket tambin avanza, para que si se
+//     retira lo haga tras esta escritura.
+// La geometra de layout debe ser la de la versin destino (mismos conteos y
+// formato); si no lo es, la actualizacin se refera a otra malla y se
+// descarta. Rangos fuera de la geometra o que no cuadran con las regiones
+// son un error del llamador. Si cambian los vrtices o los ndices, los
+// niveles de detalle y las normales de la versin dejan de corresponderle y
+// se abandonan (las regiones solo traen los rangos, as que el preprocesado
+// no puede repetirse).
+// Su duracin se registra como SetMesh en el perfilador.
+// -----------------------------------------------------------------------------
+uint64_t VulkanRenderer::setMeshRangesFromStaging(const GeometryData& layout, const std::vector<GeometryDirtyRange>& ranges,
+    const StagingWriteRegion& vertexRegion, const StagingWriteRegion& indexRegion,
+    const StagingWriteRegion& instanceRegion) {
+    ProfileScope scope(profiler, ProfileMetric::SetMesh);
+    if (defaultMeshHandle == InvalidMeshHandle || ranges.empty()) {
+        return 0;
+    }
 
-    if (vertexBuffer != VK_NULL_HANDLE) {
-        vmaDestroyBuffer(allocator, vertexBuffer, vertexBufferAllocation);
-        vertexBuffer = VK_NULL_HANDLE;
-        vertexBufferAllocation = VK_NULL_HANDLE;
+    SceneObject& object = sceneObjects[sceneObjectIndices.at(defaultMeshHandle)];
+    const bool inPlace = !object.pending.has_value();
+    if (inPlace && !object.current.has_value()) {
+        return 0;
     }
-    if (indexBuffer != VK_NULL_HANDLE) {
-        vmaDestroyBuffer(allocator, indexBuffer, indexBufferAllocation);
-        indexBuffer = VK_NULL_HANDLE;
-        indexBufferAllocation = VK_NULL_HANDLE;
+    SceneGeometry& target = inPlace ? *object.current : *object.pending;
+    const GeometryData& geometry = target.geometry;
+
+    auto sameAttribute = [](const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b) {
+        return a.location == b.location && a.binding == b.binding && a.format == b.format && a.offset == b.offset;
+    };
+    if (layout.bindingDescription.stride != geometry.bindingDescription.stride || layout.topology != geometry.topology ||
+        layout.vertexCount != geometry.vertexCount || layout.indexCount != geometry.indexCount ||
+        (geometry.indexCount > 0 && layout.indexType != geometry.indexType) || layout.instanceCount != geometry.instanceCount ||
+        !std::equal(layout.attributeDescriptions.begin(), layout.attributeDescriptions.end(),
+            geometry.attributeDescriptions.begin(), geometry.attributeDescriptions.end(), sameAttribute)) {
+        return 0;
     }
 
-    mesh = Mesh(std::move(validated));
+    const VkDeviceSize indexStride = (geometry.indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
+    const VkDeviceSize streamBytes[3] = {
+        static_cast<VkDeviceSize>(geometry.vertexCount) * geometry.bindingDescription.stride,
+        static_cast<VkDeviceSize>(geometry.indexCount) * indexStride,
+        static_cast<VkDeviceSize>(geometry.instanceCount) * sizeof(glm::mat4)
+    };
+    const StagingWriteRegion* regions[3] = { &vertexRegion, &indexRegion, &instanceRegion };
+    const ArenaRange* arenaRanges[3] = { &target.vertexRange, &target.indexRange, &target.instanceRange };
 
-    if (graphicsPipeline == VK_NULL_HANDLE) {
-        createGraphicsPipeline();
+    // Copias de cada flujo: el origen avanza por los bytes empaquetados
+    std::vector<VkBufferCopy> copies[3];
+    VkDeviceSize packedBytes[3] = {};
+    for (const GeometryDirtyRange& range : ranges) {
+        const uint32_t stream = static_cast<uint32_t>(range.stream);
+        if (stream > 2 || range.size == 0 || range.offset > streamBytes[stream] || range.size > streamBytes[stream] - range.offset) {
+            throw std::runtime_error("Dirty range lies outside of the mesh geometry!");
+        }
+        copies[stream].push_back({ packedBytes[stream], range.offset, range.size });
+        packedBytes[stream] += range.size;
     }
-    else if (recreatePipeline) {
-        recreateGraphicsPipeline();
+
+    uint64_t ticket = 0;
+    for (uint32_t stream = 0; stream < 3; stream++) {
+        if (packedBytes[stream] != (copies[stream].empty() ? 0 : regions[stream]->size)) {
+            throw std::runtime_error("Dirty ranges do not match their staging regions!");
+        }
+        if (!copies[stream].empty()) {
+            const ArenaRange& arenaRange = *arenaRanges[stream];
+            ticket = transferRangesFromStaging(arenaPages[arenaRange.page].buffer, arenaRange.offset, *regions[stream],
+                copies[stream], inPlace);
+        }
     }
 
-    createVertexBuffer();
-    if (mesh.getData().indexCount > 0) {
-        createIndexBuffer();
+    if (!copies[0].empty() || !copies[1].empty()) {
+        if (target.lodKey != 0) {
+            cancelLodBuild(target.lodKey);
+            target.lodKey = 0;
+        }
+        target.lods.clear();
+        dropPreprocessedData(target);
     }
-}
\ No newline at end of file
+
+    target.uploadTicket = ticket;
+    target.geometry.boundingSphere = layout.boundingSphere;
+    return ticket;
+}
@@ -0,0 +1,259 @@
+﻿// =============================================================================
+// vulkan_renderer_headless.cpp
+// Modo headless: targets de color offscreen en lugar del swapchain y readback
+// asíncrono de cada frame a un anillo de buffers host-cached.
+//
+// El readback nunca bloquea a la GPU: la copia de cada frame se graba en su
+// propio command buffer, tras el render pass, y se completa con el fence del
+// frame. El llamador recoge los frames terminados cuando quiere; si no da
+// abasto, los frames más antiguos se sobrescriben en lugar de esperar.
+// =============================================================================
+
+#include "vulkan_renderer.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+// -----------------------------------------------------------------------------
+// createOffscreenTargets: una imagen 1x por frame en vuelo, usable como
+// attachment de color (o de resolve, con MSAA) y como origen de copia. El
+// resto de la cadena (image views, MSAA color, depth, framebuffers) se crea
+// sobre ellas exactamente como sobre las del swapchain.
+// Solo se admiten formatos de 4 bytes por píxel, para que el readback tenga
+// filas contiguas de width * 4 bytes.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createOffscreenTargets() {
+    const VkFormat format = headlessConfig.colorFormat;
+    if (format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB &&
+        format != VK_FORMAT_B8G8R8A8_UNORM && format != VK_FORMAT_B8G8R8A8_SRGB) {
+        throw std::runtime_error("Headless color format must be a 4-byte RGBA or BGRA format!");
+    }
+    if (headlessConfig.width == 0 || headlessConfig.height == 0) {
+        throw std::runtime_error("Headless target must not be empty!");
+    }
+
+    findSupportedFormat({ format }, VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT);
+
+    swapChainImageFormat = format;
+    swapChainExtent = { headlessConfig.width, headlessConfig.height };
+
+    swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+    offscreenImageAllocations.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createImage(
+            swapChainExtent.width,
+            swapChainExtent.height,
+            swapChainImageFormat,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            swapChainImages[i],
+            offscreenImageAllocations[i],
+            VK_SAMPLE_COUNT_1_BIT);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// destroyOffscreenTargets: sus image views ya se destruyeron en
+// cleanupSwapChain, como las del swapchain.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::destroyOffscreenTargets() {
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        vmaDestroyImage(allocator, swapChainImages[i], offscreenImageAllocations[i]);
+    }
+    swapChainImages.clear();
+    offscreenImageAllocations.clear();
+}
+
+// -----------------------------------------------------------------------------
+// createReadbackRing: buffers destino de copia con mapeo persistente. Se
+// prefiere memoria HOST_CACHED porque la CPU lee los píxeles (las lecturas
+// de memoria write-combined son muy lentas); si no es coherente, la
+// invalidación se hace en acquireReadback.
+// Con menos de MAX_FRAMES_IN_FLIGHT + 1 buffers, los frames en vuelo
+// ocuparían todo el anillo y el llamador nunca vería uno terminado a tiempo.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createReadbackRing() {
+    readbackRowPitch = swapChainExtent.width * 4;
+    readbackBytes = static_cast<VkDeviceSize>(readbackRowPitch) * swapChainExtent.height;
+
+    const uint32_t slotCount = std::max<uint32_t>(headlessConfig.readbackSlots, MAX_FRAMES_IN_FLIGHT + 1);
+    readbackSlots.resize(slotCount);
+
+    for (ReadbackSlot& slot : readbackSlots) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = readbackBytes;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocCreateInfo{};
+        allocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+        allocCreateInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        allocCreateInfo.preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+        VmaAllocationInfo allocInfo;
+        if (vmaCreateBuffer(allocator, &bufferInfo, &allocCreateInfo, &slot.buffer, &slot.allocation, &allocInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create readback buffer!");
+        }
+        slot.mapped = static_cast<const uint8_t*>(allocInfo.pMappedData);
+        slot.state = ReadbackState::Free;
+    }
+
+    frameReadbackSlots.fill(UINT32_MAX);
+}
+
+// -----------------------------------------------------------------------------
+// destroyReadbackRing: debe llamarse con la GPU ociosa. Los frames que el
+// llamador aún tuviera tomados dejan de ser válidos.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::destroyReadbackRing() {
+    for (ReadbackSlot& slot : readbackSlots) {
+        vmaDestroyBuffer(allocator, slot.buffer, slot.allocation);
+    }
+    readbackSlots.clear();
+}
+
+// -----------------------------------------------------------------------------
+// recordReadback: prefiere un buffer libre; si no hay, sobrescribe el frame
+// terminado más antiguo (cuenta como descartado). Si todos están tomados o en
+// vuelo, el frame no tiene readback, pero se dibuja igualmente: en ningún
+// caso la GPU espera a que la CPU consuma.
+// La barrera final hace visibles al host las escrituras de la copia una vez
+// señalizado el fence del frame.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    uint32_t slotIndex = UINT32_MAX;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(readbackSlots.size()); i++) {
+        if (readbackSlots[i].state == ReadbackState::Free) {
+            slotIndex = i;
+            break;
+        }
+    }
+    if (slotIndex == UINT32_MAX) {
+        for (uint32_t i = 0; i < static_cast<uint32_t>(readbackSlots.size()); i++) {
+            const ReadbackSlot& candidate = readbackSlots[i];
+            if (candidate.state == ReadbackState::Ready &&
+                (slotIndex == UINT32_MAX || candidate.frameNumber < readbackSlots[slotIndex].frameNumber)) {
+                slotIndex = i;
+            }
+        }
+        droppedReadbacks++;
+    }
+
+    frameReadbackSlots[currentFrame] = slotIndex;
+    if (slotIndex == UINT32_MAX) {
+        return;
+    }
+
+    ReadbackSlot& slot = readbackSlots[slotIndex];
+    slot.state = ReadbackState::InFlight;
+    slot.frameIndex = currentFrame;
+    slot.frameNumber = headlessFrameNumber;
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;   // Filas contiguas
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+
+    vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        slot.buffer, 1, &region);
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = slot.buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+// -----------------------------------------------------------------------------
+// completeFrameReadback: drawFrame lo llama justo después de esperar el fence
+// del frame, antes de resetearlo para el siguiente uso del slot.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::completeFrameReadback(uint32_t frameIndex) {
+    const uint32_t slotIndex = frameReadbackSlots[frameIndex];
+    if (slotIndex == UINT32_MAX) {
+        return;
+    }
+    if (readbackSlots[slotIndex].state == ReadbackState::InFlight) {
+        readbackSlots[slotIndex].state = ReadbackState::Ready;
+    }
+    frameReadbackSlots[frameIndex] = UINT32_MAX;
+}
+
+// -----------------------------------------------------------------------------
+// pollReadbacks: un buffer en vuelo sigue registrado en frameReadbackSlots
+// hasta que drawFrame espera su fence, y el fence no se resetea antes, así
+// que su estado corresponde a ese mismo submit.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::pollReadbacks() {
+    for (uint32_t frameIndex = 0; frameIndex < MAX_FRAMES_IN_FLIGHT; frameIndex++) {
+        if (frameReadbackSlots[frameIndex] != UINT32_MAX &&
+            vkGetFenceStatus(device, inFlightFences[frameIndex]) == VK_SUCCESS) {
+            completeFrameReadback(frameIndex);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// acquireReadback: entrega los frames en el orden en que se dibujaron, de
+// modo que un llamador que consume a tiempo los recibe todos.
+// -----------------------------------------------------------------------------
+bool VulkanRenderer::acquireReadback(ReadbackFrame& outFrame) {
+    if (!headless) {
+        return false;
+    }
+
+    pollReadbacks();
+
+    uint32_t slotIndex = UINT32_MAX;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(readbackSlots.size()); i++) {
+        const ReadbackSlot& candidate = readbackSlots[i];
+        if (candidate.state == ReadbackState::Ready &&
+            (slotIndex == UINT32_MAX || candidate.frameNumber < readbackSlots[slotIndex].frameNumber)) {
+            slotIndex = i;
+        }
+    }
+    if (slotIndex == UINT32_MAX) {
+        return false;
+    }
+
+    ReadbackSlot& slot = readbackSlots[slotIndex];
+    if (vmaInvalidateAllocation(allocator, slot.allocation, 0, VK_WHOLE_SIZE) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to invalidate readback buffer!");
+    }
+    slot.state = ReadbackState::Held;
+
+    outFrame.pixels = slot.mapped;
+    outFrame.width = swapChainExtent.width;
+    outFrame.height = swapChainExtent.height;
+    outFrame.rowPitch = readbackRowPitch;
+    outFrame.format = swapChainImageFormat;
+    outFrame.frameNumber = slot.frameNumber;
+    outFrame.slot = slotIndex;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// releaseReadback: ignora frames que no estén tomados (p. ej. una segunda
+// liberación del mismo frame).
+// -----------------------------------------------------------------------------
+void VulkanRenderer::releaseReadback(const ReadbackFrame& frame) {
+    if (frame.slot >= readbackSlots.size() || readbackSlots[frame.slot].state != ReadbackState::Held) {
+        return;
+    }
+    readbackSlots[frame.slot].state = ReadbackState::Free;
+}
@@ -0,0 +1,259 @@
+﻿// =============================================================================
+// vulkan_renderer_lod.cpp
+// Niveles de detalle del renderer: generación en segundo plano de índices
+// simplificados para las mallas que llegan con sus datos en la CPU, su subida
+// al hueco reservado tras los índices originales y la elección por frame del
+// nivel de cada objeto según su tamaño proyectado en pantalla.
+// =============================================================================
+
+#include "vulkan_renderer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// -----------------------------------------------------------------------------
+// createLodBuilder / destroyLodBuilder: el hilo solo trabaja sobre copias de
+// la CPU, así que no depende de ningún objeto de Vulkan. Al detenerlo se
+// descartan los trabajos en cola; el que esté en curso termina antes.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createLodBuilder() {
+    lodShutdown = false;
+    lodThread = std::thread(&VulkanRenderer::lodBuildLoop, this);
+}
+
+void VulkanRenderer::destroyLodBuilder() {
+    {
+        std::lock_guard<std::mutex> lock(lodMutex);
+        lodShutdown = true;
+        lodQueue.clear();
+    }
+    lodCondition.notify_all();
+
+    if (lodThread.joinable()) {
+        lodThread.join();
+    }
+    lodResults.clear();
+    lodResultsReady = false;
+}
+
+// -----------------------------------------------------------------------------
+// getLodIndexHeadroom: admiten niveles las mallas indexadas de listas de
+// triángulos o puntos, sin instancias (su esfera envolvente no cubre las
+// copias) y con posiciones en un formato que decodePositions entienda. El
+// hueco es la mitad de los índices originales: el primer nivel deja como
+// mucho 3/4 de ellos y cada uno de los siguientes un cuarto del anterior en
+// una superficie densa, así que la cadena casi nunca lo llena; si lo hace,
+// buildLodChain se detiene antes.
+// -----------------------------------------------------------------------------
+uint32_t VulkanRenderer::getLodIndexHeadroom(const GeometryData& geometry) const {
+    if (!lodEnabled || geometry.indexCount < LOD_MIN_INDEX_COUNT || geometry.instanceCount > 0 ||
+        !supportsLodTopology(geometry.topology)) {
+        return 0;
+    }
+
+    auto position = std::find_if(geometry.attributeDescriptions.begin(), geometry.attributeDescriptions.end(),
+        [](const VkVertexInputAttributeDescription& attribute) { return attribute.location == 0; });
+    if (position == geometry.attributeDescriptions.end() ||
+        (position->format != VK_FORMAT_R16G16B16A16_SNORM && position->format != VK_FORMAT_R32G32B32_SFLOAT &&
+            position->format != VK_FORMAT_R32G32B32A32_SFLOAT)) {
+        return 0;
+    }
+    return geometry.indexCount / 2;
+}
+
+// -----------------------------------------------------------------------------
+// queueLodBuild: copia la geometría (vértices e índices; sin instancias por
+// getLodIndexHeadroom) para que el hilo no dependa de los vectores que
+// acaban en la cola de subidas. La copia es el único coste en el hilo de
+// render; la decodificación y la simplificación ocurren en el de LOD.
+// -----------------------------------------------------------------------------
+uint64_t VulkanRenderer::queueLodBuild(const GeometryData& geometry, uint32_t maxIndices) {
+    LodJob job{};
+    job.key = nextLodKey++;
+    job.geometry = geometry;
+    job.maxIndices = maxIndices;
+
+    const uint64_t key = job.key;
+    {
+        std::lock_guard<std::mutex> lock(lodMutex);
+        lodQueue.push_back(std::move(job));
+    }
+    lodCondition.notify_one();
+    return key;
+}
+
+// -----------------------------------------------------------------------------
+// cancelLodBuild: con un flujo de setMesh más rápido que la simplificación,
+// las versiones sustituidas dejan de acumular trabajo. Un trabajo ya en curso
+// termina y su resultado se descarta al no encontrar su versión.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::cancelLodBuild(uint64_t key) {
+    std::lock_guard<std::mutex> lock(lodMutex);
+    std::erase_if(lodQueue, [key](const LodJob& job) { return job.key == key; });
+}
+
+// -----------------------------------------------------------------------------
+// lodBuildLoop: decodifica las posiciones, pasa los índices a uint32, genera
+// la cadena y la empaqueta en el tipo de índice de la malla (los niveles
+// reutilizan sus vértices, así que caben en él). También entrega los
+// trabajos sin niveles, para que su versión deje de esperarlos.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::lodBuildLoop() {
+    while (true) {
+        LodJob job{};
+        {
+            std::unique_lock<std::mutex> lock(lodMutex);
+            lodCondition.wait(lock, [this] { return lodShutdown || !lodQueue.empty(); });
+            if (lodShutdown) {
+                return;
+            }
+            job = std::move(lodQueue.front());
+            lodQueue.pop_front();
+        }
+
+        const GeometryData& geometry = job.geometry;
+        LodResult result{};
+        result.key = job.key;
+
+        std::vector<glm::vec3> positions;
+        if (decodePositions(geometry, positions)) {
+            std::vector<uint32_t> indices(geometry.indexCount);
+            if (geometry.indexType == VK_INDEX_TYPE_UINT32) {
+                std::memcpy(indices.data(), geometry.indexData.data(), indices.size() * sizeof(uint32_t));
+            }
+            else {
+                const uint16_t* source = reinterpret_cast<const uint16_t*>(geometry.indexData.data());
+                std::copy(source, source + indices.size(), indices.begin());
+            }
+
+            LodChain chain = buildLodChain(positions, indices, geometry.topology, job.maxIndices);
+            result.levels = std::move(chain.levels);
+            if (geometry.indexType == VK_INDEX_TYPE_UINT32) {
+                result.indexData.resize(chain.indices.size() * sizeof(uint32_t));
+                std::memcpy(result.indexData.data(), chain.indices.data(), result.indexData.size());
+            }
+            else {
+                result.indexData.resize(chain.indices.size() * sizeof(uint16_t));
+                uint16_t* packed = reinterpret_cast<uint16_t*>(result.indexData.data());
+                for (size_t i = 0; i < chain.indices.size(); i++) {
+                    packed[i] = static_cast<uint16_t>(chain.indices[i]);
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(lodMutex);
+            lodResults.push_back(std::move(result));
+            lodResultsReady = true;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// adoptLodResults: cada resultado va a la versión (current o pending) que
+// aún espera su clave; si ya no existe, se retiró o cambió su geometría y
+// el resultado se descarta. Los índices se suben tras los originales, en
+// una parte de indexRange que ningún frame lee todavía, así que la subida no
+// espera a nadie. Los niveles se usan una vez completa (ver selectLodLevel).
+// -----------------------------------------------------------------------------
+void VulkanRenderer::adoptLodResults() {
+    if (!lodResultsReady.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::vector<LodResult> results;
+    {
+        std::lock_guard<std::mutex> lock(lodMutex);
+        results.swap(lodResults);
+        lodResultsReady = false;
+    }
+
+    for (auto& result : results) {
+        SceneGeometry* target = nullptr;
+        for (auto& object : sceneObjects) {
+            if (object.current.has_value() && object.current->lodKey == result.key) {
+                target = &*object.current;
+            }
+            else if (object.pending.has_value() && object.pending->lodKey == result.key) {
+                target = &*object.pending;
+            }
+            if (target) {
+                break;
+            }
+        }
+        if (!target) {
+            continue;
+        }
+
+        target->lodKey = 0;
+        if (result.levels.empty()) {
+            continue;
+        }
+
+        const GeometryData& geometry = target->geometry;
+        const VkDeviceSize indexStride = (geometry.indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
+        target->lodTicket = transferToDeviceLocal(arenaPages[target->indexRange.page].buffer,
+            target->indexRange.offset + static_cast<VkDeviceSize>(geometry.indexCount) * indexStride,
+            std::move(result.indexData));
+        target->lods = std::move(result.levels);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// selectLodLevel: proyecta el error de cada nivel (su tamaño de celda) a
+// píxeles en el punto de la esfera envolvente más cercano a la cámara y
+// elige el más simple que no supera lodPixelError.
+//   - La escala del modelo es la mayor de sus columnas, que acota cuánto
+//     puede estirarse una celda.
+//   - En perspectiva, un segmento de longitud l a distancia d ocupa
+//     l · |proj[1][1]| · alto / (2 d) píxeles; en ortográfica (proj[2][3] =
+//     0) no depende de d.
+//   - Si la esfera envuelve a la cámara o la malla no tiene límites, se
+//     dibuja la original.
+// -----------------------------------------------------------------------------
+uint8_t VulkanRenderer::selectLodLevel(const SceneObject& sceneObject) const {
+    const SceneGeometry& object = *sceneObject.current;
+    const glm::vec4& sphere = object.geometry.boundingSphere;
+    if (!lodEnabled || object.lods.empty() || !isUploadComplete(object.lodTicket) || sphere.w < 0.0f) {
+        return 0;
+    }
+
+    const glm::mat4 model = frameModel * sceneObject.model;
+    const float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])),
+        glm::length(glm::vec3(model[2])) });
+
+    float pixelsPerUnit = std::abs(frameProj[1][1]) * 0.5f * static_cast<float>(swapChainExtent.height);
+    if (frameProj[2][3] != 0.0f) {
+        const glm::vec4 center = frameView * model * glm::vec4(glm::vec3(sphere), 1.0f);
+        const float nearest = -center.z - sphere.w * scale;
+        if (!(nearest > 0.0f)) {
+            return 0;
+        }
+        pixelsPerUnit /= nearest;
+    }
+
+    uint8_t level = 0;
+    for (size_t k = 0; k < object.lods.size(); k++) {
+        if (object.lods[k].cellSize * scale * pixelsPerUnit > lodPixelError) {
+            break;
+        }
+        level = static_cast<uint8_t>(k + 1);
+    }
+    return level;
+}
+
+// -----------------------------------------------------------------------------
+// getLodDrawRange: los índices de los niveles siguen a los originales dentro
+// de indexRange, así que el nivel k empieza indexCount índices más allá.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::getLodDrawRange(const SceneGeometry& object, uint8_t level, uint32_t& firstIndex, uint32_t& indexCount) {
+    const GeometryData& geometry = object.geometry;
+    const VkDeviceSize indexStride = (geometry.indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
+    firstIndex = static_cast<uint32_t>(object.indexRange.offset / indexStride);
+    indexCount = geometry.indexCount;
+    if (level > 0) {
+        const LodLevel& lod = object.lods[level - 1];
+        firstIndex += geometry.indexCount + lod.firstIndex;
+        indexCount = lod.indexCount;
+    }
+}
@@ -4,9 +4,15 @@
 // El pipeline es un objeto compilado e inmutable que define cmo se procesan
 // los vrtices y fragmentos: shaders, vertex input, rasterizacin, MSAA,
 // depth test, color blending y estados dinmicos.
+// Se mantiene una variante por cada combinacin de layout de vrtices y
+// topologa presente en la escena, todas con el mismo pipeline layout.
+// La cach de pipelines persiste en disco entre ejecuciones.
 // =============================================================================
 
 #include "vulkan_renderer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <stdexcept>
 #include <string>
@@ -35,6 +41,125 @@ std::vector<char> VulkanRenderer::readFile(const std::string& filename) {
     return buffer;
 }
 
+// -----------------------------------------------------------------------------
+// createPipelineCache: lee PIPELINE_CACHE_FILE y, si es vlido para esta GPU,
+// crea la cach con sus datos. Se comprueba:
+//   1. El prefijo propio: magic, versin del driver y tamao de los datos.
+//   2. La cabecera de Vulkan al inicio de los datos: versin de cabecera,
+//      vendorID, deviceID y pipelineCacheUUID del dispositivo.
+// Un driver no est obligado a sobrevivir a datos ajenos, as que ante
+// cualquier discrepancia se descarta el archivo y se empieza con la cach
+// vaca.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createPipelineCache() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    std::vector<char> fileData;
+    std::ifstream file(PIPELINE_CACHE_FILE, std::ios::ate | std::ios::binary);
+    if (file.is_open()) {
+        fileData.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(fileData.data(), fileData.size());
+        if (!file) {
+            fileData.clear();
+        }
+    }
+
+    const char* initialData = nullptr;
+    size_t initialSize = 0;
+    if (fileData.size() >= sizeof(PipelineCacheFileHeader) + sizeof(VkPipelineCacheHeaderVersionOne)) {
+        PipelineCacheFileHeader fileHeader;
+        std::memcpy(&fileHeader, fileData.data(), sizeof(fileHeader));
+
+        VkPipelineCacheHeaderVersionOne cacheHeader;
+        std::memcpy(&cacheHeader, fileData.data() + sizeof(fileHeader), sizeof(cacheHeader));
+
+        bool valid = fileHeader.magic == PIPELINE_CACHE_FILE_MAGIC &&
+            fileHeader.driverVersion == properties.driverVersion &&
+            fileHeader.dataSize == fileData.size() - sizeof(fileHeader) &&
+            cacheHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            cacheHeader.vendorID == properties.vendorID &&
+            cacheHeader.deviceID == properties.deviceID &&
+            std::memcmp(cacheHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        if (valid) {
+            initialData = fileData.data() + sizeof(fileHeader);
+            initialSize = static_cast<size_t>(fileHeader.dataSize);
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialSize;
+    cacheInfo.pInitialData = initialData;
+
+    if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+        // Datos rechazados por el driver: reintentar con la cach vaca.
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline cache!");
+        }
+    }
+
+    lastPipelineCacheSave = std::chrono::steady_clock::now();
+}
+
+// -----------------------------------------------------------------------------
+// savePipelineCache: obtiene los datos de la cach con vkGetPipelineCacheData
+// y los escribe tras el prefijo propio en un archivo temporal, que despus
+// sustituye al anterior. As una cada a mitad de escritura nunca deja un
+// archivo corrupto en PIPELINE_CACHE_FILE.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::savePipelineCache() {
+    pipelineCacheDirty = false;
+    lastPipelineCacheSave = std::chrono::steady_clock::now();
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+        return;
+    }
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    PipelineCacheFileHeader fileHeader{};
+    fileHeader.magic = PIPELINE_CACHE_FILE_MAGIC;
+    fileHeader.driverVersion = properties.driverVersion;
+    fileHeader.dataSize = dataSize;
+
+    const std::string tempPath = std::string(PIPELINE_CACHE_FILE) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+        file.write(data.data(), static_cast<std::streamsize>(dataSize));
+        if (!file) {
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, PIPELINE_CACHE_FILE, error);
+}
+
+// -----------------------------------------------------------------------------
+// savePipelineCacheIfDue: guardado peridico, para que una compilacin
+// costosa (p. ej. la de un layout de vrtices nuevo llegado por IPC) no se
+// pierda si el proceso termina sin pasar por el destructor.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::savePipelineCacheIfDue() {
+    if (pipelineCacheDirty && std::chrono::steady_clock::now() - lastPipelineCacheSave >= PIPELINE_CACHE_SAVE_INTERVAL) {
+        savePipelineCache();
+    }
+}
+
 // -----------------------------------------------------------------------------
 // createShaderModule: envuelve bytecode SPIR-V en un VkShaderModule que puede
 // vincularse a una etapa del pipeline. El bytecode debe estar alineado a 4 bytes.
@@ -53,17 +178,22 @@ VkShaderModule VulkanRenderer::createShaderModule(const std::vector<char>& code)
 }
 
 // -----------------------------------------------------------------------------
-// loadShaderModules: lee los archivos SPIR-V del vertex y fragment shader
-// y crea mdulos de shader que se cachean para toda la vida del renderer.
+// loadShaderModules: lee los archivos SPIR-V del vertex, fragment y compute
+// (culling y preprocesado de geometra) shader y crea mdulos de shader que
+// se cachean para toda la vida del renderer.
 // Esto evita releer los archivos desde disco cada vez que se recrea el pipeline.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::loadShaderModules() {
     const std::string shaderDir = SHADER_DIR;
     auto vertShaderCode = readFile(shaderDir + "/shader.vert.spv");
     auto fragShaderCode = readFile(shaderDir + "/shader.frag.spv");
+    auto cullShaderCode = readFile(shaderDir + "/cull.comp.spv");
+    auto preprocessShaderCode = readFile(shaderDir + "/preprocess.comp.spv");
 
     cachedVertShaderModule = createShaderModule(vertShaderCode);
     cachedFragShaderModule = createShaderModule(fragShaderCode);
+    cachedCullShaderModule = createShaderModule(cullShaderCode);
+    cachedPreprocessShaderModule = createShaderModule(preprocessShaderCode);
 }
 
 // -----------------------------------------------------------------------------
@@ -79,23 +209,412 @@ void VulkanRenderer::destroyShaderModules() {
         vkDestroyShaderModule(device, cachedFragShaderModule, nullptr);
         cachedFragShaderModule = VK_NULL_HANDLE;
     }
+    if (cachedCullShaderModule != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, cachedCullShaderModule, nullptr);
+        cachedCullShaderModule = VK_NULL_HANDLE;
+    }
+    if (cachedPreprocessShaderModule != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, cachedPreprocessShaderModule, nullptr);
+        cachedPreprocessShaderModule = VK_NULL_HANDLE;
+    }
 }
 
 // -----------------------------------------------------------------------------
-// recreateGraphicsPipeline: destruye el pipeline y layout existentes y los
-// recrea desde cero. Se invoca cuando cambia el layout de vrtices, la
-// topologa de la malla, o el render pass (tras recrear el swapchain).
+// createPipelineLayout: crea el layout compartido por todas las variantes del
+// pipeline. Solo depende del descriptor set layout (UBO y ObjectData), por lo que se crea
+// una vez en el constructor y no se recrea con el swapchain.
 // -----------------------------------------------------------------------------
-void VulkanRenderer::recreateGraphicsPipeline() {
-    if (graphicsPipeline != VK_NULL_HANDLE) {
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
-        graphicsPipeline = VK_NULL_HANDLE;
+void VulkanRenderer::createPipelineLayout() {
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline layout!");
     }
-    if (pipelineLayout != VK_NULL_HANDLE) {
-        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-        pipelineLayout = VK_NULL_HANDLE;
+}
+
+// -----------------------------------------------------------------------------
+// Mezcla FNV-1a de un valor de 32 bits, byte a byte.
+// -----------------------------------------------------------------------------
+static void mixHash(uint64_t& hash, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        hash ^= (value >> (i * 8)) & 0xFFu;
+        hash *= 1099511628211ull;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// hashVertexLayout: FNV-1a sobre los campos del binding y de cada atributo.
+// Se hashean campo a campo (no la estructura entera) para que el relleno
+// entre miembros no influya.
+// -----------------------------------------------------------------------------
+uint64_t VulkanRenderer::hashVertexLayout(const VkVertexInputBindingDescription& bindingDescription,
+    const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions) {
+    uint64_t hash = 14695981039346656037ull;
+    mixHash(hash, bindingDescription.binding);
+    mixHash(hash, bindingDescription.stride);
+    mixHash(hash, static_cast<uint32_t>(bindingDescription.inputRate));
+    mixHash(hash, static_cast<uint32_t>(attributeDescriptions.size()));
+    for (const auto& attribute : attributeDescriptions) {
+        mixHash(hash, attribute.location);
+        mixHash(hash, attribute.binding);
+        mixHash(hash, static_cast<uint32_t>(attribute.format));
+        mixHash(hash, attribute.offset);
+    }
+    return hash;
+}
+
+// -----------------------------------------------------------------------------
+// hashPipelineVariant: hash del layout de vrtices seguido de la topologa.
+// -----------------------------------------------------------------------------
+uint64_t VulkanRenderer::hashPipelineVariant(const VkVertexInputBindingDescription& bindingDescription,
+    const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions,
+    VkPrimitiveTopology topology) {
+    uint64_t hash = hashVertexLayout(bindingDescription, attributeDescriptions);
+    mixHash(hash, static_cast<uint32_t>(topology));
+    return hash;
+}
+
+// -----------------------------------------------------------------------------
+// getTopologyClass: VK_EXT_extended_dynamic_state solo permite cambiar la
+// topologa dentro de la clase con la que se compil el pipeline (las
+// variantes strip, fan y con adyacencia pertenecen a la clase de su lista).
+// -----------------------------------------------------------------------------
+VkPrimitiveTopology VulkanRenderer::getTopologyClass(VkPrimitiveTopology topology) {
+    switch (topology) {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+        return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+        return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+        return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+    default:
+        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// describePipelineVariant: reduce el estado de la geometra a lo que queda
+// horneado en el pipeline. Con vertex input dinmico el layout se omite, y
+// con topologa dinmica se guarda solo su clase, de modo que mallas que
+// solo difieren en ese estado comparten variante.
+// -----------------------------------------------------------------------------
+VulkanRenderer::PipelineVariant VulkanRenderer::describePipelineVariant(const GeometryData& geometry) const {
+    PipelineVariant variant{};
+    if (!dynamicVertexInputSupported) {
+        variant.bindingDescription = geometry.bindingDescription;
+        variant.attributeDescriptions = geometry.attributeDescriptions;
+    }
+    variant.topology = dynamicTopologySupported ? getTopologyClass(geometry.topology) : geometry.topology;
+    variant.key = hashPipelineVariant(variant.bindingDescription, variant.attributeDescriptions, variant.topology);
+    return variant;
+}
+
+// -----------------------------------------------------------------------------
+// findOrCreateVertexInputLayout: busca el layout por hash y comparacin
+// completa; si es nuevo, lo registra ya convertido a las estructuras de
+// vkCmdSetVertexInputEXT (divisor 1: sin instancing por atributos).
+// -----------------------------------------------------------------------------
+uint32_t VulkanRenderer::findOrCreateVertexInputLayout(const GeometryData& geometry) {
+    const uint64_t key = hashVertexLayout(geometry.bindingDescription, geometry.attributeDescriptions);
+    auto& candidates = vertexInputLookup[key];
+    for (uint32_t index : candidates) {
+        const VertexInputLayout& layout = vertexInputLayouts[index];
+        if (isSameVertexLayout(layout.bindingDescription, layout.attributeDescriptions,
+            geometry.bindingDescription, geometry.attributeDescriptions)) {
+            return index;
+        }
+    }
+
+    VertexInputLayout layout{};
+    layout.bindingDescription = geometry.bindingDescription;
+    layout.attributeDescriptions = geometry.attributeDescriptions;
+
+    layout.binding2.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT;
+    layout.binding2.binding = geometry.bindingDescription.binding;
+    layout.binding2.stride = geometry.bindingDescription.stride;
+    layout.binding2.inputRate = geometry.bindingDescription.inputRate;
+    layout.binding2.divisor = 1;
+
+    layout.attributes2.reserve(geometry.attributeDescriptions.size());
+    for (const auto& attribute : geometry.attributeDescriptions) {
+        VkVertexInputAttributeDescription2EXT attribute2{};
+        attribute2.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT;
+        attribute2.location = attribute.location;
+        attribute2.binding = attribute.binding;
+        attribute2.format = attribute.format;
+        attribute2.offset = attribute.offset;
+        layout.attributes2.push_back(attribute2);
+    }
+
+    const uint32_t index = static_cast<uint32_t>(vertexInputLayouts.size());
+    candidates.push_back(index);
+    vertexInputLayouts.push_back(std::move(layout));
+    return index;
+}
+
+// -----------------------------------------------------------------------------
+// findPipelineVariant: consulta el ndice por clave y confirma la
+// coincidencia completa entre las variantes con ese hash.
+// -----------------------------------------------------------------------------
+int32_t VulkanRenderer::findPipelineVariant(uint64_t key, const VkVertexInputBindingDescription& bindingDescription,
+    const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions,
+    VkPrimitiveTopology topology) const {
+    auto it = pipelineVariantLookup.find(key);
+    if (it == pipelineVariantLookup.end()) {
+        return -1;
+    }
+
+    for (uint32_t index : it->second) {
+        const auto& variant = pipelineVariants[index];
+        if (variant.topology == topology &&
+            isSameVertexLayout(variant.bindingDescription, variant.attributeDescriptions,
+                bindingDescription, attributeDescriptions)) {
+            return static_cast<int32_t>(index);
+        }
+    }
+    return -1;
+}
+
+// -----------------------------------------------------------------------------
+// addPipelineVariant: aade la variante al final (los ndices existentes no
+// cambian) y la registra en el ndice por clave.
+// -----------------------------------------------------------------------------
+uint32_t VulkanRenderer::addPipelineVariant(PipelineVariant&& variant) {
+    const uint32_t index = static_cast<uint32_t>(pipelineVariants.size());
+    pipelineVariantLookup[variant.key].push_back(index);
+    pipelineVariants.push_back(std::move(variant));
+    return index;
+}
+
+// -----------------------------------------------------------------------------
+// findOrCreatePipelineVariant: busca la variante que corresponde a la
+// geometra segn describePipelineVariant. Si no existe:
+//   1. Adopta lo que haya terminado el hilo de precompilacin y vuelve a
+//      buscar.
+//   2. Si la variante est encolada sin empezar, la saca de la cola y la
+//      compila aqu; si se est compilando, espera a que termine.
+//   3. Si nadie la tena pedida, la compila en lnea.
+// -----------------------------------------------------------------------------
+uint32_t VulkanRenderer::findOrCreatePipelineVariant(const GeometryData& geometry) {
+    PipelineVariant variant = describePipelineVariant(geometry);
+    int32_t index = findPipelineVariant(variant.key, variant.bindingDescription, variant.attributeDescriptions, variant.topology);
+    if (index >= 0) {
+        return static_cast<uint32_t>(index);
+    }
+
+    auto matches = [&variant](const PipelineVariant& other) {
+        return other.key == variant.key && other.topology == variant.topology &&
+            isSameVertexLayout(other.bindingDescription, other.attributeDescriptions,
+                variant.bindingDescription, variant.attributeDescriptions);
+    };
+
+    {
+        std::unique_lock<std::mutex> lock(pipelineWarmMutex);
+        auto queued = std::find_if(pipelineWarmQueue.begin(), pipelineWarmQueue.end(), matches);
+        if (queued != pipelineWarmQueue.end()) {
+            pipelineWarmQueue.erase(queued);
+        }
+        else if (pipelineWarmCurrent && matches(*pipelineWarmCurrent)) {
+            pipelineWarmDoneCondition.wait(lock, [&] { return !pipelineWarmCurrent || !matches(*pipelineWarmCurrent); });
+        }
+    }
+
+    adoptWarmedPipelines();
+    index = findPipelineVariant(variant.key, variant.bindingDescription, variant.attributeDescriptions, variant.topology);
+    if (index >= 0) {
+        return static_cast<uint32_t>(index);
+    }
+
+    variant.generation = pipelineGeneration;
+    variant.pipeline = createGraphicsPipeline(variant.bindingDescription, variant.attributeDescriptions, variant.topology);
+    return addPipelineVariant(std::move(variant));
+}
+
+// -----------------------------------------------------------------------------
+// adoptWarmedPipelines: mueve a pipelineVariants los resultados del hilo de
+// precompilacin. Se descartan los compilados contra un render pass anterior
+// (otra generacin) y los que ya existen porque se compilaron en lnea.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::adoptWarmedPipelines() {
+    std::vector<PipelineVariant> results;
+    {
+        std::lock_guard<std::mutex> lock(pipelineWarmMutex);
+        if (pipelineWarmResults.empty()) {
+            return;
+        }
+        results.swap(pipelineWarmResults);
+    }
+
+    for (auto& variant : results) {
+        if (variant.generation != pipelineGeneration ||
+            findPipelineVariant(variant.key, variant.bindingDescription, variant.attributeDescriptions, variant.topology) >= 0) {
+            vkDestroyPipeline(device, variant.pipeline, nullptr);
+            continue;
+        }
+        addPipelineVariant(std::move(variant));
+    }
+}
+
+// -----------------------------------------------------------------------------
+// warmPipelineVariant: encola el layout y la topologa para el hilo de
+// precompilacin, salvo que la variante ya exista o ya est pedida.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::warmPipelineVariant(const GeometryData& layout) {
+    PipelineVariant request = describePipelineVariant(layout);
+    if (findPipelineVariant(request.key, request.bindingDescription, request.attributeDescriptions, request.topology) >= 0) {
+        return;
+    }
+
+    auto matches = [&request](const PipelineVariant& variant) {
+        return variant.key == request.key && variant.topology == request.topology &&
+            isSameVertexLayout(variant.bindingDescription, variant.attributeDescriptions,
+                request.bindingDescription, request.attributeDescriptions);
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(pipelineWarmMutex);
+        if (std::any_of(pipelineWarmQueue.begin(), pipelineWarmQueue.end(), matches) ||
+            std::any_of(pipelineWarmResults.begin(), pipelineWarmResults.end(), matches) ||
+            (pipelineWarmCurrent && matches(*pipelineWarmCurrent))) {
+            return;
+        }
+        pipelineWarmQueue.push_back(std::move(request));
+    }
+    pipelineWarmCondition.notify_one();
+}
+
+// -----------------------------------------------------------------------------
+// createPipelineWarmer: lanza el hilo de precompilacin. Necesita el render
+// pass, el pipeline layout y los shader modules ya creados.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createPipelineWarmer() {
+    pipelineWarmShutdown = false;
+    pipelineWarmPaused = false;
+    pipelineWarmThread = std::thread(&VulkanRenderer::pipelineWarmLoop, this);
+}
+
+// -----------------------------------------------------------------------------
+// destroyPipelineWarmer: detiene el hilo (la compilacin en curso termina
+// antes) y destruye los resultados que no llegaron a adoptarse.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::destroyPipelineWarmer() {
+    {
+        std::lock_guard<std::mutex> lock(pipelineWarmMutex);
+        pipelineWarmShutdown = true;
+        pipelineWarmQueue.clear();
+    }
+    pipelineWarmCondition.notify_all();
+
+    if (pipelineWarmThread.joinable()) {
+        pipelineWarmThread.join();
+    }
+
+    for (auto& variant : pipelineWarmResults) {
+        vkDestroyPipeline(device, variant.pipeline, nullptr);
+    }
+    pipelineWarmResults.clear();
+}
+
+// -----------------------------------------------------------------------------
+// pausePipelineWarmer / resumePipelineWarmer: con el hilo en pausa no empieza
+// ninguna compilacin nueva, y pause espera a la que est en curso, as que
+// el render pass puede destruirse sin que el hilo lo est usando.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::pausePipelineWarmer() {
+    std::unique_lock<std::mutex> lock(pipelineWarmMutex);
+    pipelineWarmPaused = true;
+    pipelineWarmDoneCondition.wait(lock, [this] { return !pipelineWarmCurrent; });
+}
+
+void VulkanRenderer::resumePipelineWarmer() {
+    {
+        std::lock_guard<std::mutex> lock(pipelineWarmMutex);
+        pipelineWarmPaused = false;
+    }
+    pipelineWarmCondition.notify_one();
+}
+
+// -----------------------------------------------------------------------------
+// pipelineWarmLoop: toma la siguiente peticin, la compila fuera del mutex y
+// deja el resultado para adoptWarmedPipelines, etiquetado con la generacin
+// vigente al empezar (la pausa garantiza que no cambia durante la
+// compilacin). Si la compilacin falla, la peticin se descarta: cuando una
+// malla necesite esa variante se compilar en lnea y el error se propagar
+// desde el hilo de render.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::pipelineWarmLoop() {
+    while (true) {
+        PipelineVariant variant{};
+        {
+            std::unique_lock<std::mutex> lock(pipelineWarmMutex);
+            pipelineWarmCondition.wait(lock, [this] {
+                return pipelineWarmShutdown || (!pipelineWarmPaused && !pipelineWarmQueue.empty());
+            });
+            if (pipelineWarmShutdown) {
+                return;
+            }
+            variant = std::move(pipelineWarmQueue.front());
+            pipelineWarmQueue.pop_front();
+            variant.generation = pipelineGeneration;
+            pipelineWarmCurrent = variant;
+        }
+
+        try {
+            variant.pipeline = createGraphicsPipeline(variant.bindingDescription, variant.attributeDescriptions, variant.topology);
+        }
+        catch (const std::exception&) {
+            variant.pipeline = VK_NULL_HANDLE;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pipelineWarmMutex);
+            pipelineWarmCurrent.reset();
+            if (variant.pipeline != VK_NULL_HANDLE) {
+                pipelineWarmResults.push_back(std::move(variant));
+            }
+        }
+        pipelineWarmDoneCondition.notify_all();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// destroyGraphicsPipelines: destruye el VkPipeline de todas las variantes,
+// conservando su descripcin para poder recrearlas.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::destroyGraphicsPipelines() {
+    for (auto& variant : pipelineVariants) {
+        if (variant.pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, variant.pipeline, nullptr);
+            variant.pipeline = VK_NULL_HANDLE;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// recreateGraphicsPipelines: recrea todas las variantes existentes. Se invoca
+// tras recrear el swapchain si el render pass nuevo no es compatible con el
+// anterior (cambi el formato de color). Los ndices de variante no cambian,
+// as que los objetos de la escena siguen apuntando a la variante correcta.
+// Debe llamarse con el hilo de precompilacin en pausa: la generacin nueva
+// invalida lo que este hubiera compilado contra el render pass anterior.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recreateGraphicsPipelines() {
+    destroyGraphicsPipelines();
+    {
+        std::lock_guard<std::mutex> lock(pipelineWarmMutex);
+        pipelineGeneration++;
+    }
+    for (auto& variant : pipelineVariants) {
+        variant.pipeline = createGraphicsPipeline(variant.bindingDescription, variant.attributeDescriptions, variant.topology);
+        variant.generation = pipelineGeneration;
     }
-    createGraphicsPipeline();
 }
 
 // -----------------------------------------------------------------------------
@@ -103,23 +622,27 @@ void VulkanRenderer::recreateGraphicsPipeline() {
 //
 // Etapas del pipeline configuradas:
 //   1. Shader stages: vertex y fragment shader (mdulos cacheados).
-//   2. Vertex input: describe el layout de los vrtices de la malla actual
-//      (binding description y attribute descriptions dinmicos).
-//   3. Input assembly: topologa de la geometra (ej: TRIANGLE_LIST).
+//   2. Vertex input: describe el layout de vrtices de la variante. Con
+//      vertex input dinmico se ignora y se fija al grabar.
+//   3. Input assembly: topologa de la geometra (ej: TRIANGLE_LIST), o la
+//      de su clase si la topologa es dinmica.
 //   4. Viewport/scissor: dinmicos, configurados por frame en recordCommandBuffer.
+//      Tambin la topologa y el vertex input si el dispositivo lo permite.
 //   5. Rasterizacin: relleno de polgonos, culling de caras traseras (BACK_BIT),
 //      front face counter-clockwise.
 //   6. Multisampling: nivel de MSAA determinado al inicio, con sample shading
 //      habilitado para suavizar el interior de los polgonos (no solo bordes).
 //   7. Depth/stencil: depth test activado con COMPARE_OP_LESS.
 //   8. Color blending: desactivado (escritura directa de colores).
-//   9. Pipeline layout: referencia al descriptor set layout (UBO).
+//   9. Pipeline layout: el layout compartido creado en createPipelineLayout.
 //
 // Se usa el pipeline cache para acelerar la compilacin si el driver puede
 // reutilizar resultados previos.
 // Los shader modules no se destruyen aqu porque estn cacheados.
 // -----------------------------------------------------------------------------
-void VulkanRenderer::createGraphicsPipeline() {
+VkPipeline VulkanRenderer::createGraphicsPipeline(const VkVertexInputBindingDescription& bindingDescription,
+    const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions,
+    VkPrimitiveTopology topology) {
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -134,20 +657,18 @@ void VulkanRenderer::createGraphicsPipeline() {
 
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-    const auto& geometry = mesh.getData();
-    const auto& bindingDescription = geometry.bindingDescription;
-    const auto& attributeDescriptions = geometry.attributeDescriptions;
-
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    if (!dynamicVertexInputSupported) {
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    }
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = geometry.topology;
+    inputAssembly.topology = topology;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
     VkPipelineViewportStateCreateInfo viewportState{};
@@ -155,10 +676,16 @@ void VulkanRenderer::createGraphicsPipeline() {
     viewportState.viewportCount = 1;
     viewportState.scissorCount = 1;
 
-    const std::array<VkDynamicState, 2> dynamicStates = {
+    std::vector<VkDynamicState> dynamicStates = {
         VK_DYNAMIC_STATE_VIEWPORT,
         VK_DYNAMIC_STATE_SCISSOR
     };
+    if (dynamicTopologySupported) {
+        dynamicStates.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT);
+    }
+    if (dynamicVertexInputSupported) {
+        dynamicStates.push_back(VK_DYNAMIC_STATE_VERTEX_INPUT_EXT);
+    }
 
     VkPipelineDynamicStateCreateInfo dynamicState{};
     dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
@@ -199,16 +726,6 @@ void VulkanRenderer::createGraphicsPipeline() {
     colorBlending.attachmentCount = 1;
     colorBlending.pAttachments = &colorBlendAttachment;
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create pipeline layout!");
-    }
-
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineInfo.stageCount = 2;
@@ -225,7 +742,10 @@ void VulkanRenderer::createGraphicsPipeline() {
     pipelineInfo.renderPass = renderPass;
     pipelineInfo.subpass = 0;
 
-    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create graphics pipeline!");
     }
+    pipelineCacheDirty = true;
+    return pipeline;
 }
\ No newline at end of file
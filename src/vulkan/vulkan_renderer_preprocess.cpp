@@ -0,0 +1,520 @@
+﻿// =============================================================================
+// vulkan_renderer_preprocess.cpp
+// Preprocesado de geometría en compute asíncrono: para las mallas que llegan
+// por staging (sin datos en la CPU), preprocess.comp calcula en computeQueue
+// su caja envolvente, de la que sale la esfera del culling y del LOD, y sus
+// normales suaves. El hilo de ingesta y el de render solo graban una copia
+// más y un command buffer; el trabajo corre en paralelo a los frames y sus
+// resultados se adoptan cuando el timeline de compute indica que terminó.
+// =============================================================================
+
+#include "vulkan_renderer.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+// -----------------------------------------------------------------------------
+// createGeometryPreprocessor: pipeline sin descriptor sets (solo push
+// constants), buffer de cajas host-visible con una caja por slot, un command
+// buffer de compute por slot y el timeline de compute. El buffer de cajas es
+// EXCLUSIVE de la familia de compute: la CPU lo lee tras el timeline, sin
+// que ninguna otra cola lo toque.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createGeometryPreprocessor() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    preprocessMaxGroupCount = properties.limits.maxComputeWorkGroupCount[0];
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PreprocessPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &preprocessPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create preprocess pipeline layout!");
+    }
+
+    VkPipelineShaderStageCreateInfo stageInfo{};
+    stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stageInfo.module = cachedPreprocessShaderModule;
+    stageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = stageInfo;
+    pipelineInfo.layout = preprocessPipelineLayout;
+
+    if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &preprocessPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create preprocess pipeline!");
+    }
+    pipelineCacheDirty = true;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = PREPROCESS_SLOT_COUNT * PREPROCESS_BOUNDS_STRIDE;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocCreateInfo{};
+    allocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+    allocCreateInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    allocCreateInfo.preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+    VmaAllocationInfo allocInfo;
+    if (vmaCreateBuffer(allocator, &bufferInfo, &allocCreateInfo, &preprocessBoundsBuffer, &preprocessBoundsAllocation,
+        &allocInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create preprocess bounds buffer!");
+    }
+    preprocessBoundsMapped = static_cast<const uint32_t*>(allocInfo.pMappedData);
+
+    VkBufferDeviceAddressInfo addressInfo{};
+    addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    addressInfo.buffer = preprocessBoundsBuffer;
+    preprocessBoundsAddress = vkGetBufferDeviceAddress(device, &addressInfo);
+
+    std::array<VkCommandBuffer, PREPROCESS_SLOT_COUNT> slotCommandBuffers{};
+    VkCommandBufferAllocateInfo commandInfo{};
+    commandInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandInfo.commandPool = computeCommandPool;
+    commandInfo.commandBufferCount = PREPROCESS_SLOT_COUNT;
+
+    if (vkAllocateCommandBuffers(device, &commandInfo, slotCommandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate preprocess command buffers!");
+    }
+    for (uint32_t i = 0; i < PREPROCESS_SLOT_COUNT; i++) {
+        preprocessSlots[i] = PreprocessSlot{};
+        preprocessSlots[i].commandBuffer = slotCommandBuffers[i];
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &computeTimeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute timeline semaphore!");
+    }
+    nextComputeValue = 1;
+    frameComputeWaitValue = 0;
+}
+
+// -----------------------------------------------------------------------------
+// destroyGeometryPreprocessor: debe llamarse con la GPU ociosa. Destruye
+// también las normales de las versiones vivas, que no pasan por la arena;
+// los command buffers se liberan con su pool.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::destroyGeometryPreprocessor() {
+    for (PreprocessSlot& slot : preprocessSlots) {
+        if (slot.scratchBuffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(allocator, slot.scratchBuffer, slot.scratchAllocation);
+        }
+        if (slot.normalBuffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(allocator, slot.normalBuffer, slot.normalAllocation);
+        }
+        slot = PreprocessSlot{};
+    }
+
+    for (auto& object : sceneObjects) {
+        for (std::optional<SceneGeometry>* version : { &object.current, &object.pending }) {
+            if (version->has_value() && (*version)->normalBuffer != VK_NULL_HANDLE) {
+                vmaDestroyBuffer(allocator, (*version)->normalBuffer, (*version)->normalAllocation);
+                (*version)->normalBuffer = VK_NULL_HANDLE;
+                (*version)->normalAllocation = VK_NULL_HANDLE;
+                (*version)->normalAddress = 0;
+            }
+        }
+    }
+
+    if (preprocessBoundsBuffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(allocator, preprocessBoundsBuffer, preprocessBoundsAllocation);
+        preprocessBoundsBuffer = VK_NULL_HANDLE;
+        preprocessBoundsAllocation = VK_NULL_HANDLE;
+        preprocessBoundsMapped = nullptr;
+    }
+    if (preprocessPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, preprocessPipeline, nullptr);
+        preprocessPipeline = VK_NULL_HANDLE;
+    }
+    if (preprocessPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(device, preprocessPipelineLayout, nullptr);
+        preprocessPipelineLayout = VK_NULL_HANDLE;
+    }
+    if (computeTimeline != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device, computeTimeline, nullptr);
+        computeTimeline = VK_NULL_HANDLE;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// createPreprocessBuffer: con CONCURRENT entre las dos familias, la copia de
+// transferencia, el compute y el vertex shader usan el buffer sin
+// transferencias de propiedad; si coinciden, basta con EXCLUSIVE.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createPreprocessBuffer(VkDeviceSize size, VkBufferUsageFlags usage, uint32_t familyA, uint32_t familyB,
+    VkBuffer& buffer, VmaAllocation& allocation, VkDeviceAddress& address) {
+    const uint32_t families[2] = { familyA, familyB };
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    if (familyA != familyB) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = families;
+    }
+    else {
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    VmaAllocationCreateInfo allocCreateInfo{};
+    allocCreateInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    if (vmaCreateBuffer(allocator, &bufferInfo, &allocCreateInfo, &buffer, &allocation, nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create preprocess buffer!");
+    }
+
+    VkBufferDeviceAddressInfo addressInfo{};
+    addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    addressInfo.buffer = buffer;
+    address = vkGetBufferDeviceAddress(device, &addressInfo);
+}
+
+// -----------------------------------------------------------------------------
+// canPreprocessGeometry: el shader lee la posición (location 0, en el
+// binding de vértices) por palabras de 4 bytes, así que el stride y el
+// offset deben ser múltiplos de 4 y el formato uno de los que decodifica.
+// Como con el LOD, las mallas con instancias se excluyen: su esfera debe
+// envolver todas las copias. Cada pasada es un solo dispatch.
+// -----------------------------------------------------------------------------
+bool VulkanRenderer::canPreprocessGeometry(const GeometryData& geometry) const {
+    if (!geometryPreprocessingEnabled || geometry.instanceCount > 0 || geometry.vertexCount == 0 ||
+        geometry.bindingDescription.stride % 4 != 0) {
+        return false;
+    }
+
+    auto position = std::find_if(geometry.attributeDescriptions.begin(), geometry.attributeDescriptions.end(),
+        [](const VkVertexInputAttributeDescription& attribute) { return attribute.location == 0; });
+    if (position == geometry.attributeDescriptions.end() || position->binding != geometry.bindingDescription.binding ||
+        position->offset % 4 != 0 ||
+        (position->format != VK_FORMAT_R16G16B16A16_SNORM && position->format != VK_FORMAT_R32G32B32_SFLOAT &&
+            position->format != VK_FORMAT_R32G32B32A32_SFLOAT)) {
+        return false;
+    }
+
+    const uint32_t elementCount = (geometry.indexCount > 0) ? geometry.indexCount : geometry.vertexCount;
+    const uint64_t vertexGroups = (static_cast<uint64_t>(geometry.vertexCount) + PREPROCESS_WORKGROUP_SIZE - 1) / PREPROCESS_WORKGROUP_SIZE;
+    const uint64_t triangleGroups = (static_cast<uint64_t>(elementCount / 3) + PREPROCESS_WORKGROUP_SIZE - 1) / PREPROCESS_WORKGROUP_SIZE;
+    return std::max(vertexGroups, triangleGroups) <= preprocessMaxGroupCount;
+}
+
+// -----------------------------------------------------------------------------
+// queueGeometryPreprocess: la caja solo se calcula si la malla llega sin
+// esfera y las normales solo en listas de triángulos. Pasos:
+//   1. Hace crecer el buffer de trabajo del slot si no caben los vértices
+//      más los índices (alineados a PREPROCESS_STREAM_ALIGNMENT). El slot
+//      está libre, así que ninguna cola lo usa y se destruye sin esperar.
+//   2. Graba en el lote abierto (el mismo de las copias a la arena) las
+//      copias de las regiones al buffer de trabajo.
+//   3. Graba en el command buffer del slot: limpieza de la caja (+máx,
+//      -máx) y de las sumas, barrera, pasadas 0 y 1, barrera, pasada 2 y
+//      barrera hacia la lectura de la CPU. Solo pass cambia entre pasadas.
+// El envío queda para submitGeometryPreprocessing, cuando el lote se envíe.
+// -----------------------------------------------------------------------------
+uint64_t VulkanRenderer::queueGeometryPreprocess(const GeometryData& geometry, const StagingWriteRegion& vertexRegion,
+    const StagingWriteRegion& indexRegion) {
+    if (!canPreprocessGeometry(geometry)) {
+        return 0;
+    }
+
+    const uint32_t elementCount = (geometry.indexCount > 0) ? geometry.indexCount : geometry.vertexCount;
+    const bool needsBounds = geometry.boundingSphere.w < 0.0f;
+    const bool needsNormals = geometry.topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST && elementCount >= 3;
+    if (!needsBounds && !needsNormals) {
+        return 0;
+    }
+
+    auto freeSlot = std::find_if(preprocessSlots.begin(), preprocessSlots.end(),
+        [](const PreprocessSlot& slot) { return slot.key == 0; });
+    if (freeSlot == preprocessSlots.end()) {
+        return 0;
+    }
+    PreprocessSlot& slot = *freeSlot;
+    const uint32_t slotIndex = static_cast<uint32_t>(freeSlot - preprocessSlots.begin());
+
+    auto alignUp = [](VkDeviceSize value) {
+        return (value + PREPROCESS_STREAM_ALIGNMENT - 1) & ~(PREPROCESS_STREAM_ALIGNMENT - 1);
+    };
+    const VkDeviceSize indexOffset = alignUp(vertexRegion.size);
+    const VkDeviceSize requiredBytes = alignUp(indexOffset + ((geometry.indexCount > 0) ? indexRegion.size : 0));
+
+    if (requiredBytes > slot.scratchCapacity) {
+        if (slot.scratchBuffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(allocator, slot.scratchBuffer, slot.scratchAllocation);
+            slot.scratchBuffer = VK_NULL_HANDLE;
+            slot.scratchAllocation = VK_NULL_HANDLE;
+        }
+        slot.scratchCapacity = std::max(requiredBytes, slot.scratchCapacity * 2);
+        createPreprocessBuffer(slot.scratchCapacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            transferQueueFamily, computeQueueFamily, slot.scratchBuffer, slot.scratchAllocation, slot.scratchAddress);
+    }
+
+    const VkDeviceSize normalBytes = static_cast<VkDeviceSize>(geometry.vertexCount) * sizeof(glm::vec4);
+    if (needsNormals) {
+        createPreprocessBuffer(normalBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            computeQueueFamily, graphicsQueueFamily, slot.normalBuffer, slot.normalAllocation, slot.normalAddress);
+    }
+
+    // Copias de las regiones de staging al buffer de trabajo.
+    beginUploadBatch();
+    VkBufferCopy copies[2]{};
+    uint32_t copyCount = 0;
+    copies[copyCount].srcOffset = vertexRegion.offset;
+    copies[copyCount].dstOffset = 0;
+    copies[copyCount].size = vertexRegion.size;
+    vkCmdCopyBuffer(openUploadBatch.commandBuffer, vertexRegion.buffer, slot.scratchBuffer, 1, &copies[copyCount++]);
+    if (geometry.indexCount > 0) {
+        copies[copyCount].srcOffset = indexRegion.offset;
+        copies[copyCount].dstOffset = indexOffset;
+        copies[copyCount].size = indexRegion.size;
+        vkCmdCopyBuffer(openUploadBatch.commandBuffer, indexRegion.buffer, slot.scratchBuffer, 1, &copies[copyCount++]);
+    }
+    for (uint32_t i = 0; i < copyCount; i++) {
+        openUploadBatch.bytes += copies[i].size;
+    }
+    slot.transferValue = openUploadBatch.timelineValue;
+
+    // Trabajo de compute.
+    const auto position = std::find_if(geometry.attributeDescriptions.begin(), geometry.attributeDescriptions.end(),
+        [](const VkVertexInputAttributeDescription& attribute) { return attribute.location == 0; });
+    const VkDeviceSize boundsOffset = static_cast<VkDeviceSize>(slotIndex) * PREPROCESS_BOUNDS_STRIDE;
+
+    PreprocessPushConstants pushConstants{};
+    pushConstants.positionScale = glm::vec4(geometry.positionScale, 0.0f);
+    pushConstants.positionOffset = glm::vec4(geometry.positionOffset, 0.0f);
+    pushConstants.sourceAddress = slot.scratchAddress;
+    pushConstants.normalAddress = slot.normalAddress;
+    pushConstants.boundsAddress = preprocessBoundsAddress + boundsOffset;
+    pushConstants.vertexCount = geometry.vertexCount;
+    pushConstants.indexCount = geometry.indexCount;
+    pushConstants.indexWordOffset = static_cast<uint32_t>(indexOffset / 4);
+    pushConstants.indexFormat = (geometry.indexType == VK_INDEX_TYPE_UINT16) ? 1 : 0;
+    pushConstants.strideWords = geometry.bindingDescription.stride / 4;
+    pushConstants.positionWordOffset = position->offset / 4;
+    pushConstants.positionFormat = (position->format == VK_FORMAT_R16G16B16A16_SNORM) ? 1 : 0;
+
+    VkCommandBuffer cmdBuf = slot.commandBuffer;
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmdBuf, &beginInfo);
+
+    if (needsBounds) {
+        vkCmdFillBuffer(cmdBuf, preprocessBoundsBuffer, boundsOffset, 3 * sizeof(uint32_t), 0xFFFFFFFFu);
+        vkCmdFillBuffer(cmdBuf, preprocessBoundsBuffer, boundsOffset + 3 * sizeof(uint32_t), 3 * sizeof(uint32_t), 0);
+    }
+    if (needsNormals) {
+        vkCmdFillBuffer(cmdBuf, slot.normalBuffer, 0, normalBytes, 0);
+    }
+
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    const uint32_t vertexGroups = (geometry.vertexCount + PREPROCESS_WORKGROUP_SIZE - 1) / PREPROCESS_WORKGROUP_SIZE;
+    const uint32_t triangleGroups = (elementCount / 3 + PREPROCESS_WORKGROUP_SIZE - 1) / PREPROCESS_WORKGROUP_SIZE;
+    auto setPass = [&](uint32_t pass) {
+        pushConstants.pass = pass;
+        vkCmdPushConstants(cmdBuf, preprocessPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+            offsetof(PreprocessPushConstants, pass), sizeof(uint32_t), &pushConstants.pass);
+    };
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, preprocessPipeline);
+    vkCmdPushConstants(cmdBuf, preprocessPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    if (needsBounds) {
+        vkCmdDispatch(cmdBuf, vertexGroups, 1, 1);
+    }
+    if (needsNormals) {
+        setPass(1);
+        vkCmdDispatch(cmdBuf, triangleGroups, 1, 1);
+
+        VkMemoryBarrier sumBarrier{};
+        sumBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        sumBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        sumBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &sumBarrier, 0, nullptr, 0, nullptr);
+
+        setPass(2);
+        vkCmdDispatch(cmdBuf, vertexGroups, 1, 1);
+    }
+
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+    vkEndCommandBuffer(cmdBuf);
+
+    slot.key = nextPreprocessKey++;
+    slot.computeValue = 0;
+    slot.computesBounds = needsBounds;
+    return slot.key;
+}
+
+// -----------------------------------------------------------------------------
+// submitGeometryPreprocessing: cada trabajo espera en transferTimeline, en la
+// etapa de compute, al lote que llena su buffer de trabajo (las limpiezas
+// del principio no dependen de él), y señaliza su propio valor de
+// computeTimeline. Un lote que aún está abierto se envía en un frame
+// posterior.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::submitGeometryPreprocessing() {
+    for (PreprocessSlot& slot : preprocessSlots) {
+        if (slot.key == 0 || slot.computeValue != 0) {
+            continue;
+        }
+        if (openUploadBatch.commandBuffer != VK_NULL_HANDLE && slot.transferValue >= openUploadBatch.timelineValue) {
+            continue;
+        }
+
+        slot.computeValue = nextComputeValue++;
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = &slot.transferValue;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &slot.computeValue;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &transferTimeline;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &slot.commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &computeTimeline;
+
+        if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit geometry preprocessing!");
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// adoptPreprocessResults: como adoptLodResults, cada trabajo completado va a
+// la versión (current o pending) que aún espera su clave.
+//   - La caja se decodifica de uint ordenados a float y se convierte en la
+//     esfera que la envuelve (centro de la caja, media diagonal), salvo que
+//     la versión ya tuviera una. Una caja vacía (min > max, por ejemplo con
+//     posiciones NaN) deja la malla sin límites.
+//   - Las normales pasan a la versión. Como puede empezar a dibujarse en el
+//     frame actual, su submit espera a este trabajo en computeTimeline
+//     (frameComputeWaitValue), lo que además hace visibles sus escrituras.
+// Sin versión destino, el trabajo se tiró (o cambió su geometría) y sus
+// normales se destruyen ya: el trabajo terminó y nadie más las ha visto.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::adoptPreprocessResults() {
+    frameComputeWaitValue = 0;
+
+    uint64_t completedValue = 0;
+    bool queried = false;
+    for (PreprocessSlot& slot : preprocessSlots) {
+        if (slot.key == 0 || slot.computeValue == 0) {
+            continue;
+        }
+        if (!queried) {
+            vkGetSemaphoreCounterValue(device, computeTimeline, &completedValue);
+            queried = true;
+        }
+        if (slot.computeValue > completedValue) {
+            continue;
+        }
+
+        SceneGeometry* target = nullptr;
+        for (auto& object : sceneObjects) {
+            if (object.current.has_value() && object.current->preprocessKey == slot.key) {
+                target = &*object.current;
+            }
+            else if (object.pending.has_value() && object.pending->preprocessKey == slot.key) {
+                target = &*object.pending;
+            }
+            if (target) {
+                break;
+            }
+        }
+
+        if (target) {
+            target->preprocessKey = 0;
+
+            glm::vec4& sphere = target->geometry.boundingSphere;
+            if (slot.computesBounds && sphere.w < 0.0f) {
+                const VkDeviceSize boundsOffset = static_cast<VkDeviceSize>(&slot - preprocessSlots.data()) * PREPROCESS_BOUNDS_STRIDE;
+                vmaInvalidateAllocation(allocator, preprocessBoundsAllocation, boundsOffset, PREPROCESS_BOUNDS_STRIDE);
+
+                auto decode = [](uint32_t bits) {
+                    bits = ((bits & 0x80000000u) != 0) ? (bits & 0x7FFFFFFFu) : ~bits;
+                    float value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    return value;
+                };
+                const uint32_t* bounds = preprocessBoundsMapped + boundsOffset / sizeof(uint32_t);
+                const glm::vec3 boxMin(decode(bounds[0]), decode(bounds[1]), decode(bounds[2]));
+                const glm::vec3 boxMax(decode(bounds[3]), decode(bounds[4]), decode(bounds[5]));
+                if (boxMin.x <= boxMax.x && boxMin.y <= boxMax.y && boxMin.z <= boxMax.z) {
+                    sphere = glm::vec4((boxMin + boxMax) * 0.5f, glm::length(boxMax - boxMin) * 0.5f);
+                }
+            }
+
+            if (slot.normalBuffer != VK_NULL_HANDLE) {
+                target->normalBuffer = slot.normalBuffer;
+                target->normalAllocation = slot.normalAllocation;
+                target->normalAddress = slot.normalAddress;
+                frameComputeWaitValue = std::max(frameComputeWaitValue, slot.computeValue);
+            }
+        }
+        else if (slot.normalBuffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(allocator, slot.normalBuffer, slot.normalAllocation);
+        }
+
+        slot.normalBuffer = VK_NULL_HANDLE;
+        slot.normalAllocation = VK_NULL_HANDLE;
+        slot.normalAddress = 0;
+        slot.key = 0;
+        slot.computeValue = 0;
+        slot.computesBounds = false;
+        vkResetCommandBuffer(slot.commandBuffer, 0);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// dropPreprocessedData: el trabajo en curso no se cancela (ya puede estar en
+// la GPU); al no encontrar su versión, adoptPreprocessResults lo descarta.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::dropPreprocessedData(SceneGeometry& sceneGeometry) {
+    sceneGeometry.preprocessKey = 0;
+    bufferRetire(sceneGeometry.normalBuffer, sceneGeometry.normalAllocation);
+    sceneGeometry.normalAddress = 0;
+}
@@ -0,0 +1,226 @@
+﻿// =============================================================================
+// vulkan_renderer_profiling.cpp
+// Instrumentación del renderer: query pools de timestamps de GPU alrededor
+// del render pass y de los lotes de subidas, y su traducción a muestras del
+// perfilador. Los tiempos de CPU se miden con ProfileScope en drawFrame.
+// También sigue el recorrido de las actualizaciones de productores externos
+// hasta su presentación (latencia de extremo a extremo).
+// =============================================================================
+
+#include "vulkan_renderer.hpp"
+#include <stdexcept>
+
+// -----------------------------------------------------------------------------
+// createTimestampQueries: decide qué timestamps se miden y crea sus pools.
+//   - Render: requiere hostQueryReset y timestampValidBits en la familia
+//     gráfica; un par por frame en vuelo.
+//   - Transferencia: además, timestampValidBits en la familia de
+//     transferencia (las colas DMA dedicadas no siempre los tienen);
+//     TRANSFER_QUERY_SLOTS pares.
+// Los pools se resetean desde la CPU al crearse y tras cada lectura.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createTimestampQueries() {
+    if (!gpuTimestampsSupported) {
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    auto validBitsMask = [](uint32_t bits) {
+        return bits >= 64 ? UINT64_MAX : ((uint64_t(1) << bits) - 1);
+    };
+
+    const uint32_t graphicsBits = families[graphicsQueueFamily].timestampValidBits;
+    const uint32_t transferBits = families[transferQueueFamily].timestampValidBits;
+    if (graphicsBits == 0 || properties.limits.timestampPeriod <= 0.0f) {
+        gpuTimestampsSupported = false;
+        return;
+    }
+
+    timestampPeriodNs = properties.limits.timestampPeriod;
+    graphicsTimestampMask = validBitsMask(graphicsBits);
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+
+    if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &frameQueryPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create frame timestamp query pool!");
+    }
+    vkResetQueryPool(device, frameQueryPool, 0, queryPoolInfo.queryCount);
+
+    transferTimestampsSupported = transferBits > 0;
+    if (!transferTimestampsSupported) {
+        return;
+    }
+
+    transferTimestampMask = validBitsMask(transferBits);
+    queryPoolInfo.queryCount = 2 * TRANSFER_QUERY_SLOTS;
+
+    if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &transferQueryPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create transfer timestamp query pool!");
+    }
+    vkResetQueryPool(device, transferQueryPool, 0, queryPoolInfo.queryCount);
+
+    for (uint32_t i = 0; i < TRANSFER_QUERY_SLOTS; i++) {
+        freeTransferQuerySlots.push_back(TRANSFER_QUERY_SLOTS - 1 - i);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// destroyTimestampQueries: debe llamarse con la GPU ociosa y sin lotes de
+// subidas en vuelo.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::destroyTimestampQueries() {
+    if (frameQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, frameQueryPool, nullptr);
+        frameQueryPool = VK_NULL_HANDLE;
+    }
+    if (transferQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, transferQueryPool, nullptr);
+        transferQueryPool = VK_NULL_HANDLE;
+    }
+    freeTransferQuerySlots.clear();
+}
+
+// -----------------------------------------------------------------------------
+// timestampDeltaMilliseconds: los bits no válidos de un timestamp son
+// indefinidos, así que se enmascaran; la resta modular tolera un desborde
+// del contador entre los dos timestamps.
+// -----------------------------------------------------------------------------
+double VulkanRenderer::timestampDeltaMilliseconds(uint64_t begin, uint64_t end, uint64_t mask) const {
+    const uint64_t ticks = ((end & mask) - (begin & mask)) & mask;
+    return static_cast<double>(ticks) * timestampPeriodNs / 1.0e6;
+}
+
+// -----------------------------------------------------------------------------
+// collectFrameTimestamps: se llama tras esperar el fence del frame, así que
+// sus timestamps ya están disponibles y la lectura no bloquea. Un frame que
+// no llegó a grabarse (swapchain desactualizado al adquirir) no tiene par.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::collectFrameTimestamps(uint32_t frameIndex) {
+    if (!frameTimestampsWritten[frameIndex]) {
+        return;
+    }
+
+    uint64_t timestamps[2] = {};
+    VkResult result = vkGetQueryPoolResults(device, frameQueryPool, frameIndex * 2, 2,
+        sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS) {
+        profiler.addSample(ProfileMetric::GpuRender, timestampDeltaMilliseconds(timestamps[0], timestamps[1], graphicsTimestampMask));
+    }
+
+    vkResetQueryPool(device, frameQueryPool, frameIndex * 2, 2);
+    frameTimestampsWritten[frameIndex] = false;
+}
+
+// -----------------------------------------------------------------------------
+// collectTransferTimestamps: TransferLatency mide desde el submit del lote
+// hasta que la CPU observa su valor del timeline, por lo que incluye la
+// granularidad del sondeo (una vez por frame); es la latencia que percibe
+// quien espera una subida. Los bytes cuentan para el throughput del frame en
+// que el lote se completa.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::collectTransferTimestamps(const UploadBatch& batch) {
+    profiler.addSample(ProfileMetric::TransferLatency,
+        FrameProfiler::elapsedMilliseconds(batch.submitTime, std::chrono::steady_clock::now()));
+    profiler.addUploadBytes(batch.bytes);
+
+    if (batch.querySlot == UINT32_MAX) {
+        return;
+    }
+
+    uint64_t timestamps[2] = {};
+    VkResult result = vkGetQueryPoolResults(device, transferQueryPool, batch.querySlot * 2, 2,
+        sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS) {
+        profiler.addSample(ProfileMetric::GpuTransfer, timestampDeltaMilliseconds(timestamps[0], timestamps[1], transferTimestampMask));
+    }
+
+    vkResetQueryPool(device, transferQueryPool, batch.querySlot * 2, 2);
+    freeTransferQuerySlots.push_back(batch.querySlot);
+}
+
+// -----------------------------------------------------------------------------
+// traceLatency: las subidas terminan en orden de ticket, así que los
+// recorridos se guardan en ese mismo orden y se cierran por el frente.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::traceLatency(uint64_t uploadTicket, uint64_t sequence, uint64_t publishTimeNs, uint64_t readTimeNs) {
+    if (latencyTraces.size() >= MAX_LATENCY_TRACES) {
+        latencyTraces.pop_front();
+    }
+
+    LatencyTrace trace{};
+    trace.sequence = sequence;
+    trace.uploadTicket = uploadTicket;
+    trace.publishTimeNs = publishTimeNs;
+    trace.readTimeNs = readTimeNs;
+    latencyTraces.push_back(trace);
+}
+
+// -----------------------------------------------------------------------------
+// takePresentedLatency: entrega y olvida el último recorrido presentado.
+// -----------------------------------------------------------------------------
+bool VulkanRenderer::takePresentedLatency(LatencyTrace& outTrace) {
+    if (!presentedLatency.has_value()) {
+        return false;
+    }
+    outTrace = *presentedLatency;
+    presentedLatency.reset();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// stampUploadLatencies: como TransferLatency, el instante incluye la
+// granularidad con que se sondea el timeline (al menos una vez por frame).
+// -----------------------------------------------------------------------------
+void VulkanRenderer::stampUploadLatencies() {
+    uint64_t now = 0;
+    for (LatencyTrace& trace : latencyTraces) {
+        if (!isUploadComplete(trace.uploadTicket)) {
+            break;
+        }
+        if (trace.uploadTimeNs == 0) {
+            now = (now != 0) ? now : FrameProfiler::timestampNanoseconds();
+            trace.uploadTimeNs = now;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// stampPresentLatencies: un recorrido se cierra en el primer frame presentado
+// cuya promoción ya incluía su subida. Si una actualización se sustituyó por
+// otra más nueva antes de verse, cuenta como presentada con ella: su latencia
+// sale mayor, nunca menor, que la que percibió el usuario.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::stampPresentLatencies(uint64_t visibleUploadTicket) {
+    if (latencyTraces.empty() || latencyTraces.front().uploadTicket > visibleUploadTicket) {
+        return;
+    }
+
+    auto sinceMilliseconds = [](uint64_t beginNs, uint64_t endNs) {
+        return (endNs > beginNs) ? static_cast<double>(endNs - beginNs) / 1.0e6 : 0.0;
+    };
+
+    const uint64_t now = FrameProfiler::timestampNanoseconds();
+    while (!latencyTraces.empty() && latencyTraces.front().uploadTicket <= visibleUploadTicket) {
+        LatencyTrace trace = latencyTraces.front();
+        latencyTraces.pop_front();
+
+        trace.presentTimeNs = now;
+        if (trace.uploadTimeNs == 0) {
+            trace.uploadTimeNs = now;
+        }
+        profiler.addSample(ProfileMetric::IpcReadLatency, sinceMilliseconds(trace.publishTimeNs, trace.readTimeNs));
+        profiler.addSample(ProfileMetric::IpcUploadLatency, sinceMilliseconds(trace.publishTimeNs, trace.uploadTimeNs));
+        profiler.addSample(ProfileMetric::MotionToPhoton, sinceMilliseconds(trace.publishTimeNs, trace.presentTimeNs));
+        presentedLatency = trace;
+    }
+}
@@ -0,0 +1,201 @@
+﻿// =============================================================================
+// vulkan_renderer_recording.cpp
+// Grabación multihilo de los draws de la escena: slices de drawOrder
+// grabados en paralelo en secondary command buffers, cada uno con sus propios
+// command pools, y ejecutados después desde el command buffer primario.
+// =============================================================================
+
+#include "vulkan_renderer.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+// -----------------------------------------------------------------------------
+// createRecordWorkers: crea un slice por núcleo disponible (hasta
+// MAX_RECORD_SLICES). Los pools son TRANSIENT y se resetean enteros cada vez
+// que se reutiliza su frame, en vez de resetear command buffers sueltos.
+// El slice 0 pertenece al hilo de render; el resto recibe un hilo propio.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::createRecordWorkers() {
+    uint32_t sliceCount = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_RECORD_SLICES);
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+    recordSlices.resize(sliceCount);
+    for (RecordSlice& slice : recordSlices) {
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkCommandPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &slice.commandPools[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create recording command pool!");
+            }
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = slice.commandPools[i];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(device, &allocInfo, &slice.commandBuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to allocate secondary command buffer!");
+            }
+        }
+    }
+
+    recordShutdown = false;
+    for (uint32_t i = 1; i < sliceCount; i++) {
+        recordThreads.emplace_back(&VulkanRenderer::recordWorkerLoop, this, i);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// destroyRecordWorkers: despierta a los hilos con recordShutdown, espera a
+// que terminen y destruye los pools (lo que libera sus secondaries). Debe
+// llamarse con la GPU ociosa.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::destroyRecordWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(recordMutex);
+        recordShutdown = true;
+    }
+    recordStartCondition.notify_all();
+
+    for (std::thread& thread : recordThreads) {
+        thread.join();
+    }
+    recordThreads.clear();
+
+    for (RecordSlice& slice : recordSlices) {
+        for (VkCommandPool pool : slice.commandPools) {
+            if (pool != VK_NULL_HANDLE) {
+                vkDestroyCommandPool(device, pool, nullptr);
+            }
+        }
+    }
+    recordSlices.clear();
+}
+
+// -----------------------------------------------------------------------------
+// getRecordSliceCount: usa tantos slices como permitan los objetos de la
+// escena a razón de RECORD_SLICE_MIN_OBJECTS por slice, sin pasar del número
+// de slices creados. Con escenas pequeñas devuelve 1 y se graba en línea.
+// -----------------------------------------------------------------------------
+uint32_t VulkanRenderer::getRecordSliceCount(size_t objectCount) const {
+    size_t bySize = objectCount / RECORD_SLICE_MIN_OBJECTS;
+    return static_cast<uint32_t>(std::clamp<size_t>(bySize, 1, recordSlices.size()));
+}
+
+// -----------------------------------------------------------------------------
+// recordDrawsParallel: reparte drawOrder en tramos contiguos del mismo tamaño
+// (conservando el orden por pipeline y página dentro de cada tramo, así que
+// cada secondary sigue minimizando sus binds), publica el trabajo para los
+// hilos de grabación y graba el slice 0 en el hilo actual mientras tanto.
+// Los datos de la escena no se modifican durante la grabación, así que los
+// hilos solo los leen. Si algún slice falló, su excepción se relanza aquí.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recordDrawsParallel(VkFramebuffer framebuffer, uint32_t sliceCount) {
+    const size_t objectCount = drawOrder.size();
+    for (uint32_t i = 0; i < sliceCount; i++) {
+        recordSlices[i].begin = objectCount * i / sliceCount;
+        recordSlices[i].end = objectCount * (i + 1) / sliceCount;
+        recordSlices[i].error = nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(recordMutex);
+        recordFramebuffer = framebuffer;
+        recordActiveSlices = sliceCount;
+        recordPendingSlices = sliceCount - 1;
+        recordGeneration++;
+    }
+    recordStartCondition.notify_all();
+
+    recordSlice(0);
+
+    {
+        std::unique_lock<std::mutex> lock(recordMutex);
+        recordDoneCondition.wait(lock, [this] { return recordPendingSlices == 0; });
+    }
+
+    for (uint32_t i = 0; i < sliceCount; i++) {
+        if (recordSlices[i].error) {
+            std::rethrow_exception(recordSlices[i].error);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// recordSlice: resetea el pool del frame actual del slice (la CPU ya esperó
+// al fence de ese frame, así que la GPU no lo está usando) y graba su tramo
+// en un secondary que hereda el render pass y el framebuffer del primario.
+// Los errores se guardan en el slice en vez de propagarse, para no terminar
+// el proceso desde un hilo de grabación.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recordSlice(uint32_t sliceIndex) {
+    RecordSlice& slice = recordSlices[sliceIndex];
+
+    try {
+        vkResetCommandPool(device, slice.commandPools[currentFrame], 0);
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = recordFramebuffer;
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        VkCommandBuffer commandBuffer = slice.commandBuffers[currentFrame];
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin recording secondary command buffer!");
+        }
+
+        recordDraws(commandBuffer, slice.begin, slice.end);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record secondary command buffer!");
+        }
+    }
+    catch (...) {
+        slice.error = std::current_exception();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// recordWorkerLoop: espera a una generación de trabajo nueva, graba su slice
+// si participa en ella y avisa al hilo de render al terminar. El mutex da la
+// relación happens-before con los datos del frame que publica el hilo de
+// render y con los secondaries que este va a ejecutar.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::recordWorkerLoop(uint32_t sliceIndex) {
+    uint64_t seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(recordMutex);
+            recordStartCondition.wait(lock, [&] { return recordShutdown || recordGeneration != seenGeneration; });
+            if (recordShutdown) {
+                return;
+            }
+            seenGeneration = recordGeneration;
+            if (sliceIndex >= recordActiveSlices) {
+                continue;
+            }
+        }
+
+        recordSlice(sliceIndex);
+
+        bool lastSlice = false;
+        {
+            std::lock_guard<std::mutex> lock(recordMutex);
+            lastSlice = (--recordPendingSlices == 0);
+        }
+        if (lastSlice) {
+            recordDoneCondition.notify_one();
+        }
+    }
+}
@@ -6,6 +6,7 @@
 // =============================================================================
 
 #include "vulkan_renderer.hpp"
+#include <algorithm>
 #include <stdexcept>
 #include <set>
 #include <string>
@@ -16,6 +17,8 @@
 // Registra las extensiones requeridas por GLFW para crear superficies de ventana
 // y, en builds de depuración, habilita las capas de validación de Khronos para
 // detectar errores de uso de la API en tiempo de ejecución.
+// En modo headless no se piden las extensiones de GLFW (ni se necesita GLFW
+// inicializado): sin superficie no hacen falta.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createInstance() {
     if (enableValidationLayers && !checkValidationLayerSupport()) {
@@ -28,17 +31,19 @@ void VulkanRenderer::createInstance() {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_2;
 
     VkInstanceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
 
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> extensions;
+    if (!headless) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     createInfo.ppEnabledExtensionNames = extensions.data();
@@ -62,12 +67,13 @@ void VulkanRenderer::createInstance() {
 // imágenes renderizadas en la ventana.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createSurface() {
-    window.createSurface(instance, &surface);
+    window->createSurface(instance, &surface);
 }
 
 // -----------------------------------------------------------------------------
 // checkDeviceExtensionSupport: verifica que la GPU soporte todas las extensiones
-// de dispositivo requeridas (actualmente solo VK_KHR_swapchain).
+// de dispositivo requeridas (actualmente solo VK_KHR_swapchain, y ninguna en
+// modo headless).
 // Enumera las extensiones disponibles y elimina del conjunto de requeridas las
 // que encuentra; si el conjunto queda vacío, la GPU cumple los requisitos.
 // -----------------------------------------------------------------------------
@@ -78,7 +84,10 @@ bool VulkanRenderer::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    std::set<std::string> requiredExtensions;
+    if (!headless) {
+        requiredExtensions.insert(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -87,10 +96,45 @@ bool VulkanRenderer::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return requiredExtensions.empty();
 }
 
+// -----------------------------------------------------------------------------
+// checkDeviceFeatureSupport: verifica que la GPU implemente Vulkan 1.2 y
+// exponga:
+//   - timelineSemaphore, que sincroniza las subidas de la cola de
+//     transferencia con los submits de gráficos;
+//   - shaderDrawParameters (gl_BaseInstance), con el que el vertex shader
+//     separa el objeto de la instancia dentro de un draw instanciado;
+//   - bufferDeviceAddress, para leer las transformaciones por instancia
+//     directamente desde su página de la arena.
+// -----------------------------------------------------------------------------
+bool VulkanRenderer::checkDeviceFeatureSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceVulkan11Features features11{};
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    features11.pNext = &features12;
+
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &features11;
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    return features12.timelineSemaphore == VK_TRUE &&
+        features12.bufferDeviceAddress == VK_TRUE &&
+        features11.shaderDrawParameters == VK_TRUE;
+}
+
 // -----------------------------------------------------------------------------
 // pickPhysicalDevice: enumera las GPUs del sistema y selecciona la primera que:
 //   1. Tenga familias de colas de gráficos y presentación.
-//   2. Soporte VK_KHR_swapchain.
+//   2. Soporte VK_KHR_swapchain (salvo en modo headless).
+//   3. Implemente Vulkan 1.2 con las features de checkDeviceFeatureSupport.
 // En un sistema con múltiples GPUs, se podría extender con un sistema de
 // puntuación para preferir GPUs discretas.
 // -----------------------------------------------------------------------------
@@ -108,7 +152,7 @@ void VulkanRenderer::pickPhysicalDevice() {
     for (const auto& device : devices) {
         QueueFamilyIndices indices = findQueueFamilies(device);
         bool extensionsSupported = checkDeviceExtensionSupport(device);
-        if (indices.isComplete() && extensionsSupported) {
+        if (indices.isComplete() && extensionsSupported && checkDeviceFeatureSupport(device)) {
             physicalDevice = device;
             break;
         }
@@ -125,7 +169,19 @@ void VulkanRenderer::pickPhysicalDevice() {
 //   - Gráficos: para comandos de dibujo y render passes.
 //   - Presentación: para entregar imágenes al swapchain (puede coincidir con gráficos).
 //   - Transferencia dedicada: para copias DMA en paralelo (si la GPU la tiene).
-// Habilita sampleRateShading para el sombreado por muestra de MSAA.
+//   - Compute asíncrono: para el preprocesado de geometría (si la GPU lo tiene;
+//     si no, se usa la cola de gráficos).
+// Habilita sampleRateShading para el sombreado por muestra de MSAA, de
+// Vulkan 1.1 shaderDrawParameters y, de Vulkan 1.2, timelineSemaphore y
+// bufferDeviceAddress (ver checkDeviceFeatureSupport).
+// Si la GPU ofrece multiDrawIndirect, drawIndirectFirstInstance y
+// drawIndirectCount, los habilita también y activa gpuCullingSupported.
+// hostQueryReset se habilita si existe; sin él no hay timestamps de GPU.
+// Si expone VK_EXT_extended_dynamic_state o VK_EXT_vertex_input_dynamic_state
+// con su feature, activa la extensión, carga su comando y marca
+// dynamicTopologySupported o dynamicVertexInputSupported.
+// Con ventana, si expone VK_KHR_present_id y VK_KHR_present_wait con sus
+// features, los activa juntos y marca presentWaitSupported.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createLogicalDevice() {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
@@ -139,6 +195,9 @@ void VulkanRenderer::createLogicalDevice() {
     if (indices.transferFamily.has_value()) {
         uniqueQueueFamilies.insert(indices.transferFamily.value());
     }
+    if (indices.computeFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.computeFamily.value());
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -155,13 +214,125 @@ void VulkanRenderer::createLogicalDevice() {
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+    auto hasExtension = [&availableExtensions](const char* name) {
+        return std::any_of(availableExtensions.begin(), availableExtensions.end(),
+            [name](const VkExtensionProperties& extension) { return std::strcmp(extension.extensionName, name) == 0; });
+    };
+    const bool hasExtendedDynamicState = hasExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    const bool hasVertexInputDynamicState = hasExtension(VK_EXT_VERTEX_INPUT_DYNAMIC_STATE_EXTENSION_NAME);
+    const bool hasPresentWait = !headless &&
+        hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+    // Las estructuras de features de una extensión solo se encadenan si el
+    // dispositivo la expone.
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT supportedExtendedDynamicState{};
+    supportedExtendedDynamicState.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+    VkPhysicalDeviceVertexInputDynamicStateFeaturesEXT supportedVertexInputDynamicState{};
+    supportedVertexInputDynamicState.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_INPUT_DYNAMIC_STATE_FEATURES_EXT;
+
+    VkPhysicalDevicePresentIdFeaturesKHR supportedPresentId{};
+    supportedPresentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR supportedPresentWait{};
+    supportedPresentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+    VkPhysicalDeviceVulkan12Features supported12{};
+    supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    void** supportedTail = &supported12.pNext;
+    if (hasExtendedDynamicState) {
+        *supportedTail = &supportedExtendedDynamicState;
+        supportedTail = &supportedExtendedDynamicState.pNext;
+    }
+    if (hasVertexInputDynamicState) {
+        *supportedTail = &supportedVertexInputDynamicState;
+        supportedTail = &supportedVertexInputDynamicState.pNext;
+    }
+    if (hasPresentWait) {
+        *supportedTail = &supportedPresentId;
+        supportedPresentId.pNext = &supportedPresentWait;
+    }
+
+    VkPhysicalDeviceFeatures2 supported{};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported.pNext = &supported12;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+
+    gpuCullingSupported = supported.features.multiDrawIndirect == VK_TRUE &&
+        supported.features.drawIndirectFirstInstance == VK_TRUE &&
+        supported12.drawIndirectCount == VK_TRUE;
+    gpuTimestampsSupported = supported12.hostQueryReset == VK_TRUE;
+    dynamicTopologySupported = hasExtendedDynamicState &&
+        supportedExtendedDynamicState.extendedDynamicState == VK_TRUE;
+    dynamicVertexInputSupported = hasVertexInputDynamicState &&
+        supportedVertexInputDynamicState.vertexInputDynamicState == VK_TRUE;
+    presentWaitSupported = hasPresentWait &&
+        supportedPresentId.presentId == VK_TRUE && supportedPresentWait.presentWait == VK_TRUE;
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.sampleRateShading = VK_TRUE;
+    deviceFeatures.multiDrawIndirect = gpuCullingSupported ? VK_TRUE : VK_FALSE;
+    deviceFeatures.drawIndirectFirstInstance = gpuCullingSupported ? VK_TRUE : VK_FALSE;
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    const std::vector<const char*> deviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME
-    };
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{};
+    extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    extendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;
+
+    VkPhysicalDeviceVertexInputDynamicStateFeaturesEXT vertexInputDynamicStateFeatures{};
+    vertexInputDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_INPUT_DYNAMIC_STATE_FEATURES_EXT;
+    vertexInputDynamicStateFeatures.vertexInputDynamicState = VK_TRUE;
+
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.presentId = VK_TRUE;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.presentWait = VK_TRUE;
+
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.timelineSemaphore = VK_TRUE;
+    features12.bufferDeviceAddress = VK_TRUE;
+    features12.drawIndirectCount = gpuCullingSupported ? VK_TRUE : VK_FALSE;
+    features12.hostQueryReset = gpuTimestampsSupported ? VK_TRUE : VK_FALSE;
+
+    std::vector<const char*> deviceExtensions;
+    if (!headless) {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    void** featuresTail = &features12.pNext;
+    if (dynamicTopologySupported) {
+        deviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+        *featuresTail = &extendedDynamicStateFeatures;
+        featuresTail = &extendedDynamicStateFeatures.pNext;
+    }
+    if (dynamicVertexInputSupported) {
+        deviceExtensions.push_back(VK_EXT_VERTEX_INPUT_DYNAMIC_STATE_EXTENSION_NAME);
+        *featuresTail = &vertexInputDynamicStateFeatures;
+        featuresTail = &vertexInputDynamicStateFeatures.pNext;
+    }
+    if (presentWaitSupported) {
+        deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        *featuresTail = &presentIdFeatures;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+    }
+
+    VkPhysicalDeviceVulkan11Features features11{};
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    features11.shaderDrawParameters = VK_TRUE;
+    features11.pNext = &features12;
+    createInfo.pNext = &features11;
+
     createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -169,14 +340,44 @@ void VulkanRenderer::createLogicalDevice() {
         throw std::runtime_error("Failed to create logical device!");
     }
 
+    if (dynamicTopologySupported) {
+        cmdSetPrimitiveTopology = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(
+            vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveTopologyEXT"));
+        dynamicTopologySupported = cmdSetPrimitiveTopology != nullptr;
+    }
+    if (dynamicVertexInputSupported) {
+        cmdSetVertexInput = reinterpret_cast<PFN_vkCmdSetVertexInputEXT>(
+            vkGetDeviceProcAddr(device, "vkCmdSetVertexInputEXT"));
+        dynamicVertexInputSupported = cmdSetVertexInput != nullptr;
+    }
+    if (presentWaitSupported) {
+        waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+            vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+        presentWaitSupported = waitForPresent != nullptr;
+    }
+
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
 
+    graphicsQueueFamily = indices.graphicsFamily.value();
+
     if (indices.transferFamily.has_value()) {
         vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+        transferQueueFamily = indices.transferFamily.value();
     }
     else {
         transferQueue = graphicsQueue;
+        transferQueueFamily = graphicsQueueFamily;
+    }
+
+    asyncComputeSupported = indices.computeFamily.has_value();
+    if (asyncComputeSupported) {
+        vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+        computeQueueFamily = indices.computeFamily.value();
+    }
+    else {
+        computeQueue = graphicsQueue;
+        computeQueueFamily = graphicsQueueFamily;
     }
 }
 
@@ -185,13 +386,16 @@ void VulkanRenderer::createLogicalDevice() {
 // VMA gestiona pools de memoria internos, sub-asignando de bloques grandes
 // para minimizar las llamadas a vkAllocateMemory (limitadas a ~4096 por driver).
 // Esto mejora el rendimiento y evita fragmentación de memoria de GPU.
+// BUFFER_DEVICE_ADDRESS hace que VMA asigne con el flag de dirección de GPU
+// la memoria de los buffers que lo piden (las páginas de la arena).
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createAllocator() {
     VmaAllocatorCreateInfo allocatorInfo{};
+    allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
     allocatorInfo.physicalDevice = physicalDevice;
     allocatorInfo.device = device;
     allocatorInfo.instance = instance;
-    allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_0;
+    allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_2;
 
     if (vmaCreateAllocator(&allocatorInfo, &allocator) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create VMA allocator!");
@@ -215,7 +419,12 @@ void VulkanRenderer::destroyAllocator() {
 //   - graphicsFamily: familia con VK_QUEUE_GRAPHICS_BIT.
 //   - presentFamily: familia que soporte presentación en la superficie.
 //   - transferFamily: familia con VK_QUEUE_TRANSFER_BIT pero SIN GRAPHICS_BIT,
-//     para transferencias DMA en paralelo con el renderizado.
+//     para transferencias DMA en paralelo con el renderizado. Se prefiere una
+//     distinta de computeFamily, para que copias y compute no compartan cola.
+//   - computeFamily: la primera familia con VK_QUEUE_COMPUTE_BIT pero SIN
+//     GRAPHICS_BIT, para el preprocesado de geometría en paralelo.
+// En modo headless no hay superficie: la familia de presentación es la de
+// gráficos y su cola solo se usa como alias de graphicsQueue.
 // -----------------------------------------------------------------------------
 VulkanRenderer::QueueFamilyIndices VulkanRenderer::findQueueFamilies(VkPhysicalDevice device) {
     QueueFamilyIndices indices;
@@ -232,17 +441,28 @@ VulkanRenderer::QueueFamilyIndices VulkanRenderer::findQueueFamilies(VkPhysicalD
         }
 
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        if (headless) {
+            presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+        }
+        else {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        }
         if (presentSupport) {
             indices.presentFamily = i;
         }
 
-        if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
-            !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+        const bool dedicated = !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+        if (dedicated && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !indices.computeFamily.has_value()) {
+            indices.computeFamily = i;
+        }
+
+        if (dedicated && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            (!indices.transferFamily.has_value() || indices.transferFamily == indices.computeFamily)) {
             indices.transferFamily = i;
         }
 
-        if (indices.isComplete() && indices.transferFamily.has_value()) break;
+        if (indices.isComplete() && indices.transferFamily.has_value() && indices.computeFamily.has_value() &&
+            indices.transferFamily != indices.computeFamily) break;
         i++;
     }
 
@@ -342,6 +562,10 @@ void VulkanRenderer::createColorResources() {
 //
 // La dependencia de subpass asegura que los attachments de color y depth estén
 // listos antes de que el subpass comience a escribir en ellos.
+//
+// En modo headless la imagen final (color 1x o resolve) no se presenta sino
+// que se copia al readback: termina en TRANSFER_SRC_OPTIMAL y una segunda
+// dependencia ordena las escrituras de color antes de esa copia.
 // -----------------------------------------------------------------------------
 void VulkanRenderer::createRenderPass() {
     VkAttachmentDescription colorAttachment{};
@@ -354,8 +578,10 @@ void VulkanRenderer::createRenderPass() {
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    const VkImageLayout outputLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
     colorAttachment.finalLayout = (msaaSamples == VK_SAMPLE_COUNT_1_BIT)
-        ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+        ? outputLayout
         : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkAttachmentDescription depthAttachment{};
@@ -395,7 +621,7 @@ void VulkanRenderer::createRenderPass() {
         colorResolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorResolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorResolveAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorResolveAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorResolveAttachment.finalLayout = outputLayout;
 
         colorResolveRef.attachment = 2;
         colorResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -404,7 +630,8 @@ void VulkanRenderer::createRenderPass() {
         attachments.push_back(colorResolveAttachment);
     }
 
-    VkSubpassDependency dependency{};
+    VkSubpassDependency dependencies[2]{};
+    VkSubpassDependency& dependency = dependencies[0];
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
     dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
@@ -412,14 +639,22 @@ void VulkanRenderer::createRenderPass() {
     dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+    VkSubpassDependency& readbackDependency = dependencies[1];
+    readbackDependency.srcSubpass = 0;
+    readbackDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    readbackDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    readbackDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    readbackDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    readbackDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
     renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.dependencyCount = headless ? 2 : 1;
+    renderPassInfo.pDependencies = dependencies;
 
     if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create render pass!");
@@ -14,7 +14,8 @@
 // createSwapChain: crea el swapchain seleccionando el mejor formato de superficie,
 // modo de presentacin y resolucin disponibles.
 // Solicita minImageCount + 1 imgenes para permitir triple buffering cuando
-// el modo MAILBOX est disponible.
+// el modo MAILBOX est disponible, y una ms con HighThroughput para que sus
+// 3 frames en vuelo no esperen a que se libere una imagen al adquirir.
 // Si las familias de grficos y presentacin son diferentes, configura acceso
 // concurrente; si son iguales, usa acceso exclusivo (ms eficiente).
 // -----------------------------------------------------------------------------
@@ -25,7 +26,8 @@ void VulkanRenderer::createSwapChain() {
     VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
     VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    uint32_t imageCount = swapChainSupport.capabilities.minImageCount +
+        (presentPolicy == PresentPolicy::HighThroughput ? 2 : 1);
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
     }
@@ -68,6 +70,7 @@ void VulkanRenderer::createSwapChain() {
 
     swapChainImageFormat = surfaceFormat.format;
     swapChainExtent = extent;
+    swapChainPresentMode = presentMode;
 }
 
 // -----------------------------------------------------------------------------
@@ -85,19 +88,96 @@ VkSurfaceFormatKHR VulkanRenderer::chooseSwapSurfaceFormat(const std::vector<VkS
 }
 
 // -----------------------------------------------------------------------------
-// chooseSwapPresentMode: selecciona MAILBOX (triple buffering sin tearing ni
-// latencia de V-Sync) si est disponible. Si no, usa FIFO (V-Sync garantizado
-// por la especificacin de Vulkan).
+// chooseSwapPresentMode: recorre las preferencias de la poltica y devuelve
+// la primera disponible. Si ninguna lo est, usa FIFO (V-Sync garantizado por
+// la especificacin de Vulkan).
+//   - LowLatency: IMMEDIATE (sin esperar al vblank, con tearing) y, si no,
+//     FIFO_RELAXED (V-Sync salvo cuando el frame llega tarde).
+//   - Balanced: MAILBOX (triple buffering sin tearing ni latencia de V-Sync).
+//   - PowerSaving: FIFO directamente; el ritmo lo marca el monitor.
+//   - HighThroughput: MAILBOX y, si no, IMMEDIATE: nunca bloquea en el vblank.
 // -----------------------------------------------------------------------------
 VkPresentModeKHR VulkanRenderer::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-    for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return availablePresentMode;
+    std::vector<VkPresentModeKHR> preferred;
+    switch (presentPolicy) {
+    case PresentPolicy::LowLatency:
+        preferred = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+        break;
+    case PresentPolicy::Balanced:
+        preferred = { VK_PRESENT_MODE_MAILBOX_KHR };
+        break;
+    case PresentPolicy::PowerSaving:
+        break;
+    case PresentPolicy::HighThroughput:
+        preferred = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+        break;
+    }
+
+    for (VkPresentModeKHR mode : preferred) {
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), mode) != availablePresentModes.end()) {
+            return mode;
         }
     }
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+// -----------------------------------------------------------------------------
+// framesInFlightFor: 1 frame en vuelo en LowLatency (la CPU nunca prepara un
+// frame mientras la GPU dibuja otro, as que no hay cola que aada latencia),
+// 3 en HighThroughput (CPU y GPU nunca se esperan en frames normales) y 2 en
+// el resto.
+// -----------------------------------------------------------------------------
+uint32_t VulkanRenderer::framesInFlightFor(PresentPolicy policy) {
+    switch (policy) {
+    case PresentPolicy::LowLatency:     return 1;
+    case PresentPolicy::HighThroughput: return MAX_FRAMES_IN_FLIGHT;
+    default:                            return 2;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// setPresentPolicy: con la GPU ociosa ningn slot tiene trabajo pendiente, as
+// que se pueden renumerar:
+//   - Se recogen los timestamps y readbacks de todos los slots.
+//   - Los rangos retirados pasan todos a la cola del slot 0, que es el
+//     primero que se espera tras el cambio.
+//   - currentFrame vuelve a 0.
+// El swapchain solo se recrea si cambia el modo de presentacin o el nmero
+// de imgenes que pide la poltica.
+// -----------------------------------------------------------------------------
+void VulkanRenderer::setPresentPolicy(PresentPolicy policy) {
+    if (policy == presentPolicy) {
+        return;
+    }
+
+    vkDeviceWaitIdle(device);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        collectFrameTimestamps(i);
+        if (headless) {
+            completeFrameReadback(i);
+        }
+        if (i > 0) {
+            deletionQueues[0].insert(deletionQueues[0].end(), deletionQueues[i].begin(), deletionQueues[i].end());
+            deletionQueues[i].clear();
+        }
+    }
+
+    const PresentPolicy previousPolicy = presentPolicy;
+    presentPolicy = policy;
+    framesInFlight = framesInFlightFor(policy);
+    currentFrame = 0;
+
+    if (headless) {
+        return;
+    }
+
+    const bool imageCountChanged = (previousPolicy == PresentPolicy::HighThroughput) != (policy == PresentPolicy::HighThroughput);
+    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
+    if (imageCountChanged || chooseSwapPresentMode(swapChainSupport.presentModes) != swapChainPresentMode) {
+        recreateSwapChain();
+    }
+}
+
 // -----------------------------------------------------------------------------
 // chooseSwapExtent: determina la resolucin del swapchain.
 // Si el compositor ya especifica una extensin fija, la usa directamente.
@@ -109,7 +189,7 @@ VkExtent2D VulkanRenderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capa
         return capabilities.currentExtent;
     }
     else {
-        WindowCreator::WindowDimensions dims = window.getDimensions();
+        WindowCreator::WindowDimensions dims = window->getDimensions();
 
         VkExtent2D actualExtent = {
             static_cast<uint32_t>(dims.width),
@@ -90,6 +90,14 @@ void WindowCreator::pollEvents() {
     glfwPollEvents();
 }
 
+// -----------------------------------------------------------------------------
+// waitEvents: bloquea el hilo hasta el prximo evento o hasta el timeout, sin
+// consumir CPU mientras tanto. Pensada para bucles que no dibujan cada vuelta.
+// -----------------------------------------------------------------------------
+void WindowCreator::waitEvents(double timeoutSeconds) {
+    glfwWaitEventsTimeout(timeoutSeconds);
+}
+
 // -----------------------------------------------------------------------------
 // getDimensions: devuelve las dimensiones actuales almacenadas en el objeto.
 // Estas se actualizan al cambiar entre modo ventana y pantalla completa.
@@ -38,6 +38,11 @@ public:
     // ratn, redimensionamiento, etc.).
     void pollEvents();
 
+    // Como pollEvents, pero si no hay eventos pendientes espera hasta que
+    // llegue alguno o pasen timeoutSeconds. glfwPostEmptyEvent la despierta
+    // desde cualquier hilo.
+    void waitEvents(double timeoutSeconds);
+
     // Devuelve el handle nativo de GLFW para acceso directo (ej: lectura de teclas).
     GLFWwindow* getGLFWwindow() const { return window; }
 
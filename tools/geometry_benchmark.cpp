@@ -0,0 +1,578 @@
+﻿// =============================================================================
+// geometry_benchmark.cpp
+// Benchmark de las rutas de IPC y de subida: un productor y el consumidor
+// real (SharedGeometryReader + VulkanRenderer headless) en el mismo proceso,
+// conectados por memoria compartida con nombres propios para no interferir
+// con una aplicación en marcha.
+//
+// Flujo:
+//   1. El hilo productor publica, al ritmo pedido, una malla en rejilla de
+//      --vertices vértices con SharedGeometryWriter, y tras cada geometría
+//      una ráfaga de transformaciones con SharedTransformWriter.
+//   2. El hilo principal lee cada frame en modo Latest directamente en
+//      buffers de staging externos del renderer (como IngestWorker, sin su
+//      hilo), lo aplica con setMeshFromStaging / setMeshRangesFromStaging y
+//      dibuja un frame headless por vuelta.
+//   3. Al terminar se informa por consola y, con --json, en un fichero.
+//
+// Opciones:
+//   --vertices=N               vértices de la malla (rejilla cuadrada, 65536)
+//   --rate=HZ                  actualizaciones de geometría por segundo; 0 =
+//                              tan rápido como acepte el anillo (60)
+//   --seconds=S                duración de la medición (10)
+//   --layout-every=K           cada K actualizaciones alterna entre vértices
+//                              float y cuantizados; 0 = no cambia (0)
+//   --delta                    tras cada frame completo, frames parciales con
+//                              un octavo de los vértices
+//   --transforms-per-update=N  transformaciones publicadas tras cada
+//                              geometría (1)
+//   --json=PATH                exporta los resultados en JSON
+//
+// Métricas:
+//   - Actualizaciones publicadas y aplicadas por segundo.
+//   - Secuencias perdidas: frames que el escritor no pudo publicar (anillo
+//     lleno) más los que el lector saltó por llegar otro más reciente. Los
+//     frames parciales que el lector funde en una lectura no se pierden y
+//     se cuentan aparte.
+//   - MB/s entregados al renderer para subir a la GPU.
+//   - Percentiles de la llamada a setMesh*, de la latencia de extremo a
+//     extremo (publicación → presentación, la más reciente de cada frame) y
+//     del tiempo de frame, con su histograma.
+// Los percentiles cubren toda la ejecución, no la ventana del perfilador.
+// =============================================================================
+
+#include "vulkan/vulkan_renderer.hpp"
+#include "ipc/shared_geometry_writer.hpp"
+#include "ipc/shared_transforms.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Nombres de los canales del benchmark.
+constexpr char BenchmarkGeometryName[] = "VulkanBenchmarkGeometry";
+constexpr char BenchmarkGeometryEventName[] = "VulkanBenchmarkGeometryEvent";
+constexpr char BenchmarkTransformName[] = "VulkanBenchmarkTransforms";
+
+// Buffers de staging en los que el consumidor lee los frames. Como en
+// IngestWorker, cubren uno en lectura y varios esperando su copia a la GPU;
+// empiezan pequeños y crecen cuando un frame no cabe.
+constexpr uint32_t BenchmarkSlotCount = 4;
+constexpr VkDeviceSize BenchmarkInitialSlotBytes = 4 * 1024 * 1024;
+constexpr size_t BenchmarkStreamAlignment = 16;
+
+// Límites superiores (en ms) de los intervalos del histograma de tiempos de
+// frame; el último intervalo recoge todo lo que supera al mayor.
+constexpr double FrameHistogramBounds[] = { 1.0, 2.0, 4.0, 8.0, 16.0, 33.0, 66.0 };
+constexpr size_t FrameHistogramBinCount = std::size(FrameHistogramBounds) + 1;
+
+// Parámetros de una ejecución.
+struct BenchmarkConfig {
+    uint32_t vertices = 65536;
+    double rate = 60.0;
+    double seconds = 10.0;
+    uint32_t layoutEvery = 0;
+    bool delta = false;
+    uint32_t transformsPerUpdate = 1;
+    std::string jsonPath;
+};
+
+// Contadores del productor, leídos por el hilo principal al terminar.
+struct ProducerStats {
+    std::atomic<uint64_t> published{ 0 };       // Frames publicados en el anillo
+    std::atomic<uint64_t> rejected{ 0 };        // Frames no publicados por anillo lleno
+    std::atomic<uint64_t> transformWrites{ 0 }; // Escrituras del canal de transformaciones
+};
+
+// Percentiles de una serie de muestras (en ms).
+struct SampleSummary {
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+    size_t count = 0;
+};
+
+// Devuelve el valor de --name=valor, o nullptr si arg es otra opción.
+static const char* optionValue(const char* arg, const char* name) {
+    const size_t length = std::strlen(name);
+    if (std::strncmp(arg, name, length) != 0 || arg[length] != '=') {
+        return nullptr;
+    }
+    return arg + length + 1;
+}
+
+// -----------------------------------------------------------------------------
+// summarize: percentiles por rango más cercano sobre una copia ordenada.
+// -----------------------------------------------------------------------------
+static SampleSummary summarize(std::vector<double> samples) {
+    SampleSummary summary{};
+    summary.count = samples.size();
+    if (samples.empty()) {
+        return summary;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double fraction) {
+        const size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(samples.size())));
+        return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+    };
+    summary.p50 = percentile(0.50);
+    summary.p90 = percentile(0.90);
+    summary.p99 = percentile(0.99);
+    summary.max = samples.back();
+
+    double total = 0.0;
+    for (double sample : samples) {
+        total += sample;
+    }
+    summary.mean = total / static_cast<double>(samples.size());
+    return summary;
+}
+
+// -----------------------------------------------------------------------------
+// buildGrid: rejilla cuadrada en el plano z = 0 con al menos vertexCount
+// vértices, color según la posición e índices uint32 de dos triángulos por
+// celda. Con quantized, los vértices viajan como QuantizedVertex.
+// -----------------------------------------------------------------------------
+static GeometryData buildGrid(uint32_t vertexCount, bool quantized) {
+    const uint32_t side = std::max<uint32_t>(2, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(vertexCount)))));
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(static_cast<size_t>(side) * side);
+    for (uint32_t y = 0; y < side; y++) {
+        for (uint32_t x = 0; x < side; x++) {
+            const float u = static_cast<float>(x) / static_cast<float>(side - 1);
+            const float v = static_cast<float>(y) / static_cast<float>(side - 1);
+            vertices.push_back({ { u - 0.5f, v - 0.5f, 0.0f }, { u, v, 1.0f - u } });
+        }
+    }
+
+    GeometryData data{};
+    if (quantized) {
+        data = quantizeVertices(vertices);
+    }
+    else {
+        data.bindingDescription = Vertex::getBindingDescription();
+        auto attributes = Vertex::getAttributeDescriptions();
+        data.attributeDescriptions.assign(attributes.begin(), attributes.end());
+        data.vertexData.resize(vertices.size() * sizeof(Vertex));
+        std::memcpy(data.vertexData.data(), vertices.data(), data.vertexData.size());
+        data.vertexCount = static_cast<uint32_t>(vertices.size());
+        data.boundingSphere = computeBoundingSphere(data);
+    }
+
+    std::vector<uint32_t> indices;
+    indices.reserve(static_cast<size_t>(side - 1) * (side - 1) * 6);
+    for (uint32_t y = 0; y + 1 < side; y++) {
+        for (uint32_t x = 0; x + 1 < side; x++) {
+            const uint32_t corner = y * side + x;
+            indices.insert(indices.end(), { corner, corner + 1, corner + side + 1, corner, corner + side + 1, corner + side });
+        }
+    }
+    data.indexType = VK_INDEX_TYPE_UINT32;
+    data.indexData.resize(indices.size() * sizeof(uint32_t));
+    std::memcpy(data.indexData.data(), indices.data(), data.indexData.size());
+    data.indexCount = static_cast<uint32_t>(indices.size());
+    return data;
+}
+
+// -----------------------------------------------------------------------------
+// runProducer: publica una actualización por periodo hasta que se pida parar.
+//   - El layout alterna cada layoutEvery actualizaciones; el primer frame de
+//     cada layout es completo, y con --delta los siguientes son parciales
+//     sobre una ventana de un octavo de los vértices que avanza en cada uno.
+//   - Un frame rechazado por anillo lleno cuenta como perdido y no se
+//     reintenta: el siguiente periodo trae uno nuevo. Si era completo, se
+//     repite completo, porque los parciales no aplicarían sin él.
+//   - Con rate > 0, si el productor se retrasa más de un periodo no intenta
+//     recuperar los perdidos en ráfaga.
+// -----------------------------------------------------------------------------
+static void runProducer(std::stop_token stop, const BenchmarkConfig& config, SharedGeometryWriter& geometryWriter,
+    SharedTransformWriter& transformWriter, ProducerStats& stats) {
+    const GeometryData layouts[2] = { buildGrid(config.vertices, false), buildGrid(config.vertices, true) };
+
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, -1.5f, 1.5f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 10.0f);
+    proj[1][1] *= -1; // Corrección del eje Y de Vulkan
+    std::vector<glm::mat4> models(1, glm::mat4(1.0f));
+    float angle = 0.0f;
+
+    std::vector<GeometryDirtyRange> ranges(1);
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(config.rate > 0.0 ? 1.0 / config.rate : 0.0));
+    auto next = std::chrono::steady_clock::now();
+
+    uint64_t update = 0;
+    uint32_t currentLayout = 0;
+    bool needFull = true;
+    while (!stop.stop_requested()) {
+        const uint32_t layoutIndex = (config.layoutEvery > 0) ? static_cast<uint32_t>((update / config.layoutEvery) % 2) : 0;
+        if (layoutIndex != currentLayout) {
+            currentLayout = layoutIndex;
+            needFull = true;
+        }
+        const GeometryData& geometry = layouts[currentLayout];
+
+        bool written = false;
+        if (needFull || !config.delta) {
+            written = geometryWriter.write(geometry);
+            needFull = needFull && !written;
+        }
+        else {
+            const uint64_t stride = geometry.bindingDescription.stride;
+            const uint64_t window = std::max<uint64_t>(1, geometry.vertexCount / 8);
+            const uint64_t first = (update * window) % geometry.vertexCount;
+            ranges[0] = { GeometryStream::Vertex, first * stride, std::min<uint64_t>(window, geometry.vertexCount - first) * stride };
+            written = geometryWriter.writeRanges(geometry, ranges);
+        }
+        (written ? stats.published : stats.rejected).fetch_add(1, std::memory_order_relaxed);
+        geometryWriter.notify();
+
+        for (uint32_t i = 0; i < config.transformsPerUpdate; i++) {
+            angle += 0.01f;
+            models[0] = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 0.0f, 1.0f));
+            transformWriter.write(view, proj, models);
+            stats.transformWrites.fetch_add(1, std::memory_order_relaxed);
+        }
+        update++;
+
+        if (config.rate > 0.0) {
+            next += period;
+            const auto now = std::chrono::steady_clock::now();
+            if (now - next > period) {
+                next = now;
+            }
+            std::this_thread::sleep_until(next);
+        }
+        else if (!written) {
+            // Sin ritmo fijo, ceder mientras el lector libera el anillo.
+            std::this_thread::yield();
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// printSummary / writeSummaryJson: salida humana y exportación de una serie.
+// -----------------------------------------------------------------------------
+static void printSummary(const char* name, const SampleSummary& summary) {
+    std::cout << "  " << name << " (ms, " << summary.count << " samples): p50 " << summary.p50
+        << ", p90 " << summary.p90 << ", p99 " << summary.p99 << ", max " << summary.max << "\n";
+}
+
+static void writeSummaryJson(std::ostream& out, const char* name, const SampleSummary& summary) {
+    out << "    \"" << name << "\": { \"count\": " << summary.count << ", \"mean\": " << summary.mean
+        << ", \"p50\": " << summary.p50 << ", \"p90\": " << summary.p90 << ", \"p99\": " << summary.p99
+        << ", \"max\": " << summary.max << " },\n";
+}
+
+// -----------------------------------------------------------------------------
+// main: lee las opciones, abre los canales del benchmark, arranca el
+// productor y mide el consumidor durante config.seconds.
+// -----------------------------------------------------------------------------
+int main(int argc, char** argv) {
+    BenchmarkConfig config{};
+    for (int i = 1; i < argc; i++) {
+        const char* value = nullptr;
+        if ((value = optionValue(argv[i], "--vertices"))) {
+            config.vertices = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if ((value = optionValue(argv[i], "--rate"))) {
+            config.rate = std::strtod(value, nullptr);
+        }
+        else if ((value = optionValue(argv[i], "--seconds"))) {
+            config.seconds = std::strtod(value, nullptr);
+        }
+        else if ((value = optionValue(argv[i], "--layout-every"))) {
+            config.layoutEvery = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--delta") == 0) {
+            config.delta = true;
+        }
+        else if ((value = optionValue(argv[i], "--transforms-per-update"))) {
+            config.transformsPerUpdate = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if ((value = optionValue(argv[i], "--json"))) {
+            config.jsonPath = value;
+        }
+        else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (config.vertices == 0 || config.seconds <= 0.0 || config.rate < 0.0) {
+        std::cerr << "--vertices and --seconds must be positive and --rate not negative." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        // Los escritores crean los canales antes de que el lector los abra.
+        SharedGeometryWriter geometryWriter;
+        SharedTransformWriter transformWriter;
+        if (!geometryWriter.open(BenchmarkGeometryName, BenchmarkGeometryEventName) ||
+            !transformWriter.open(BenchmarkTransformName)) {
+            std::cerr << "Failed to create shared memory." << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        SharedGeometryReader geometryReader;
+        geometryReader.setReadMode(SharedGeometryReadMode::Latest);
+        SharedTransformReader transformReader;
+        if (!geometryReader.open(BenchmarkGeometryName, BenchmarkGeometryEventName) ||
+            !transformReader.open(BenchmarkTransformName)) {
+            std::cerr << "Failed to open shared memory." << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        VulkanRenderer renderer(VulkanRenderer::HeadlessConfig{});
+
+        // Slots de staging: ticket 0 = libre; si no, la subida que lo lee.
+        // Se declaran después del renderer, pero este los destruye al
+        // destruirse: no hace falta liberarlos al final.
+        struct BenchmarkSlot {
+            VulkanRenderer::StagingWriteRegion region;
+            uint64_t uploadTicket = 0;
+        };
+        BenchmarkSlot slots[BenchmarkSlotCount];
+        for (auto& slot : slots) {
+            slot.region = renderer.createExternalStagingBuffer(BenchmarkInitialSlotBytes);
+        }
+
+        // El productor se detiene y se une al salir del ámbito, también si
+        // el renderer lanza una excepción a mitad de la medición.
+        ProducerStats producerStats;
+        std::jthread producer(runProducer, std::cref(config), std::ref(geometryWriter), std::ref(transformWriter),
+            std::ref(producerStats));
+
+        std::vector<double> setMeshSamples;
+        std::vector<double> endToEndSamples;
+        std::vector<double> frameSamples;
+        uint64_t frameHistogram[FrameHistogramBinCount] = {};
+
+        SharedGeometryUpdate update{};
+        SharedTransformUpdate transformUpdate{};
+        VulkanRenderer::ReadbackFrame readback;
+        uint64_t lastSequence = 0;
+        uint64_t superseded = 0;
+        uint64_t merged = 0;
+        uint64_t applied = 0;
+        uint64_t notApplied = 0;
+        uint64_t transformReads = 0;
+        uint64_t uploadBytes = 0;
+
+        auto alignUp = [](size_t value) {
+            return (value + BenchmarkStreamAlignment - 1) & ~(BenchmarkStreamAlignment - 1);
+        };
+
+        const auto start = FrameProfiler::Clock::now();
+        const auto deadline = start + std::chrono::duration_cast<FrameProfiler::Clock::duration>(
+            std::chrono::duration<double>(config.seconds));
+        auto lastFrame = start;
+
+        while (FrameProfiler::Clock::now() < deadline) {
+            // Liberar los slots cuya copia ya terminó en la GPU.
+            for (auto& slot : slots) {
+                if (slot.uploadTicket != 0 && renderer.isUploadComplete(slot.uploadTicket)) {
+                    slot.uploadTicket = 0;
+                }
+            }
+
+            // Leer en el slot libre más grande. Si el frame no cabe, el slot
+            // crece (al menos al doble) y la lectura se repite en la vuelta
+            // siguiente: los frames no consumidos siguen en el anillo.
+            BenchmarkSlot* slot = nullptr;
+            for (auto& candidate : slots) {
+                if (candidate.uploadTicket == 0 && (!slot || candidate.region.size > slot->region.size)) {
+                    slot = &candidate;
+                }
+            }
+
+            if (slot && !renderer.isUploadBackpressured()) {
+                size_t vertexBytes = 0, indexOffset = 0, indexBytes = 0, instanceOffset = 0, instanceBytes = 0;
+                size_t requiredBytes = 0;
+                auto destination = [&](size_t vertexSize, size_t indexSize, size_t instanceSize,
+                    uint8_t*& vertexDst, uint8_t*& indexDst, uint8_t*& instanceDst) {
+                    const size_t indexStart = alignUp(vertexSize);
+                    const size_t instanceStart = alignUp(indexStart + indexSize);
+                    if (instanceStart + instanceSize > slot->region.size) {
+                        requiredBytes = instanceStart + instanceSize;
+                        return false;
+                    }
+                    vertexBytes = vertexSize;
+                    indexOffset = indexStart;
+                    indexBytes = indexSize;
+                    instanceOffset = instanceStart;
+                    instanceBytes = instanceSize;
+                    vertexDst = slot->region.data;
+                    indexDst = slot->region.data + indexStart;
+                    instanceDst = slot->region.data + instanceStart;
+                    return true;
+                };
+
+                if (geometryReader.tryRead(update, destination)) {
+                    const uint64_t readTimeNs = FrameProfiler::timestampNanoseconds();
+                    // Los parciales fundidos en esta lectura se aplicaron:
+                    // solo el resto de los frames consumidos se perdió.
+                    superseded += update.sequence - lastSequence - 1 - update.mergedFrames;
+                    merged += update.mergedFrames;
+                    lastSequence = update.sequence;
+
+                    auto subRegion = [slot](size_t offset, size_t size) {
+                        VulkanRenderer::StagingWriteRegion region{};
+                        if (size > 0) {
+                            region = slot->region;
+                            region.data += offset;
+                            region.offset += offset;
+                            region.size = size;
+                        }
+                        return region;
+                    };
+                    const auto vertexRegion = subRegion(0, vertexBytes);
+                    const auto indexRegion = subRegion(indexOffset, indexBytes);
+                    const auto instanceRegion = subRegion(instanceOffset, instanceBytes);
+
+                    const auto setMeshBegin = FrameProfiler::Clock::now();
+                    const uint64_t ticket = update.dirtyRanges.empty()
+                        ? renderer.setMeshFromStaging(update.geometry, vertexRegion, indexRegion, instanceRegion)
+                        : renderer.setMeshRangesFromStaging(update.geometry, update.dirtyRanges, vertexRegion, indexRegion, instanceRegion);
+                    setMeshSamples.push_back(FrameProfiler::elapsedMilliseconds(setMeshBegin, FrameProfiler::Clock::now()));
+
+                    if (ticket != 0) {
+                        slot->uploadTicket = ticket;
+                        renderer.traceLatency(ticket, update.sequence, update.publishTimeNs, readTimeNs);
+                        uploadBytes += vertexBytes + indexBytes + instanceBytes;
+                        applied++;
+                    }
+                    else {
+                        notApplied++;
+                    }
+                }
+                else if (requiredBytes > 0) {
+                    const VkDeviceSize newSize = std::max<VkDeviceSize>(requiredBytes, 2 * slot->region.size);
+                    renderer.destroyExternalStagingBuffer(slot->region);
+                    slot->region = renderer.createExternalStagingBuffer(newSize);
+                }
+            }
+
+            // Cada lectura consistente del canal de transformaciones cuenta;
+            // las escrituras de una ráfaga que no llega a verse, no.
+            if (transformReader.tryRead(transformUpdate)) {
+                if (!transformUpdate.models.empty()) {
+                    renderer.setTransform(SharedTransformReader::objectTransform(transformUpdate, 0));
+                }
+                transformReads++;
+            }
+
+            renderer.drawFrame();
+            while (renderer.acquireReadback(readback)) {
+                renderer.releaseReadback(readback);
+            }
+
+            const auto now = FrameProfiler::Clock::now();
+            const double frameMs = FrameProfiler::elapsedMilliseconds(lastFrame, now);
+            lastFrame = now;
+            frameSamples.push_back(frameMs);
+            const auto bound = std::lower_bound(std::begin(FrameHistogramBounds), std::end(FrameHistogramBounds), frameMs);
+            frameHistogram[bound - std::begin(FrameHistogramBounds)]++;
+
+            VulkanRenderer::LatencyTrace trace;
+            if (renderer.takePresentedLatency(trace) && trace.presentTimeNs > trace.publishTimeNs) {
+                endToEndSamples.push_back(static_cast<double>(trace.presentTimeNs - trace.publishTimeNs) / 1.0e6);
+            }
+        }
+
+        const double elapsedSeconds = FrameProfiler::elapsedMilliseconds(start, FrameProfiler::Clock::now()) / 1000.0;
+        producer.request_stop();
+        producer.join();
+        vkDeviceWaitIdle(renderer.getDevice());
+
+        const uint64_t published = producerStats.published.load();
+        const uint64_t rejected = producerStats.rejected.load();
+        const uint64_t unread = published - lastSequence;
+        const SampleSummary setMesh = summarize(std::move(setMeshSamples));
+        const SampleSummary endToEnd = summarize(std::move(endToEndSamples));
+        const SampleSummary frameTime = summarize(std::move(frameSamples));
+        const double uploadMegabytes = static_cast<double>(uploadBytes) / (1024.0 * 1024.0);
+
+        std::cout << "Geometry benchmark: " << config.vertices << " vertices, " << config.rate << " Hz, "
+            << elapsedSeconds << " s\n"
+            << "  Updates: " << published << " published (" << published / elapsedSeconds << "/s), "
+            << applied << " applied (" << applied / elapsedSeconds << "/s), " << notApplied << " not applicable\n"
+            << "  Dropped sequences: " << rejected + superseded << " (" << rejected << " ring full, "
+            << superseded << " superseded), " << merged << " partial frames merged, " << unread << " unread at exit\n"
+            << "  Transforms: " << producerStats.transformWrites.load() << " written, " << transformReads << " read\n"
+            << "  Uploads: " << uploadMegabytes << " MB (" << uploadMegabytes / elapsedSeconds << " MB/s)\n";
+        printSummary("setMesh", setMesh);
+        printSummary("End to end", endToEnd);
+        printSummary("Frame time", frameTime);
+        std::cout << "  Frame time histogram:";
+        for (size_t i = 0; i < FrameHistogramBinCount; i++) {
+            if (i < std::size(FrameHistogramBounds)) {
+                std::cout << " <=" << FrameHistogramBounds[i] << "ms:" << frameHistogram[i];
+            }
+            else {
+                std::cout << " >" << FrameHistogramBounds[i - 1] << "ms:" << frameHistogram[i];
+            }
+        }
+        std::cout << std::endl;
+
+        if (!config.jsonPath.empty()) {
+            std::ofstream out(config.jsonPath);
+            if (!out) {
+                std::cerr << "Failed to open " << config.jsonPath << std::endl;
+                return EXIT_FAILURE;
+            }
+            out << "{\n"
+                << "  \"config\": { \"vertices\": " << config.vertices << ", \"rate\": " << config.rate
+                << ", \"seconds\": " << config.seconds << ", \"layoutEvery\": " << config.layoutEvery
+                << ", \"delta\": " << (config.delta ? "true" : "false")
+                << ", \"transformsPerUpdate\": " << config.transformsPerUpdate << " },\n"
+                << "  \"results\": {\n"
+                << "    \"durationSeconds\": " << elapsedSeconds << ",\n"
+                << "    \"updatesPublished\": " << published << ",\n"
+                << "    \"updatesApplied\": " << applied << ",\n"
+                << "    \"updatesPerSecond\": " << applied / elapsedSeconds << ",\n"
+                << "    \"updatesNotApplicable\": " << notApplied << ",\n"
+                << "    \"droppedSequences\": " << rejected + superseded << ",\n"
+                << "    \"rejectedRingFull\": " << rejected << ",\n"
+                << "    \"supersededByReader\": " << superseded << ",\n"
+                << "    \"mergedPartialFrames\": " << merged << ",\n"
+                << "    \"unreadAtExit\": " << unread << ",\n"
+                << "    \"transformsWritten\": " << producerStats.transformWrites.load() << ",\n"
+                << "    \"transformsRead\": " << transformReads << ",\n"
+                << "    \"uploadMegabytes\": " << uploadMegabytes << ",\n"
+                << "    \"uploadMegabytesPerSecond\": " << uploadMegabytes / elapsedSeconds << ",\n";
+            writeSummaryJson(out, "setMeshMs", setMesh);
+            writeSummaryJson(out, "endToEndMs", endToEnd);
+            writeSummaryJson(out, "frameTimeMs", frameTime);
+            out << "    \"frameTimeHistogram\": [";
+            for (size_t i = 0; i < FrameHistogramBinCount; i++) {
+                out << (i > 0 ? ", " : "") << "{ \"upperMs\": ";
+                if (i < std::size(FrameHistogramBounds)) {
+                    out << FrameHistogramBounds[i];
+                }
+                else {
+                    out << "null";
+                }
+                out << ", \"count\": " << frameHistogram[i] << " }";
+            }
+            out << "]\n  }\n}\n";
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Fatal Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -4,130 +4,73 @@
 // para que el renderer Vulkan las consuma mediante IPC (Inter-Process Communication).
 //
 // Flujo de comunicación:
-//   1. Crea un mapeo de memoria compartida (CreateFileMappingW).
-//   2. Escribe la geometría del cubo (vértices + índices) una sola vez.
+//   1. Crea dos mapeos de memoria compartida (shared_memory.hpp): el anillo
+//      de geometría (control y cabeceras; los datos van en segmentos
+//      aparte) y el canal de transformaciones.
+//   2. Publica la geometría del cubo (vértices + índices) una sola vez.
 //   3. En un bucle infinito, actualiza la transformación (rotación animada)
-//      y la escribe en la memoria compartida.
-//   4. El renderer lee la memoria compartida cada frame con tryRead().
+//      y la escribe en el canal de transformaciones.
+//   4. Tras cada publicación señaliza el evento de notificación, para que un
+//      lector bloqueado en waitForUpdate() despierte de inmediato. El
+//      renderer lee ambos canales con tryRead().
+//   5. Lee las latencias que el renderer devuelve en el bloque de control e
+//      informa de cada frame de geometría presentado.
 //
-// Protocolo de escritura atómica:
-//   - Se usa un número de secuencia (sequence) con semántica seqlock:
-//     a. Se incrementa a un valor impar (indica escritura en curso).
-//     b. Se escribe el payload (geometría + transformación).
-//     c. Se incrementa a un valor par (indica escritura completada).
-//   - El lector solo acepta datos cuando sequence es par y ha cambiado.
-//   - MemoryBarrier() asegura el ordenamiento de las escrituras.
+// Los dos canales los escriben SharedGeometryWriter (anillo SPSC de
+// geometría, con los segmentos por slot, ver shared_geometry_writer.hpp) y
+// SharedTransformWriter (seqlock que sobrescribe el estado en su sitio).
+//   - Con --quantized los vértices viajan como QuantizedVertex (12 bytes en
+//     lugar de 24), con la escala y el offset de la posición en la cabecera.
+//   - Con --delta, tras la geometría completa se publican periódicamente
+//     frames parciales que solo llevan los bytes del vértice cuyo color
+//     cambia; la cabecera repite el layout y los conteos de la malla.
 // =============================================================================
 
-#include "ipc/shared_geometry.hpp"
+#include "ipc/shared_geometry_writer.hpp"
+#include "ipc/shared_transforms.hpp"
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <windows.h>
 #include <chrono>
 #include <thread>
 #include <vector>
 #include <cstring>
 #include <iostream>
-
-// -----------------------------------------------------------------------------
-// writeSharedGeometry: escribe una actualización completa en el buffer compartido.
-// Si writeGeometry es true, incluye los datos de vértices/índices con su
-// descripción de layout (binding, atributos, topología, tipo de índice).
-// Siempre escribe la transformación (modelo, vista, proyección).
-// Usa el protocolo seqlock para garantizar lecturas consistentes sin mutex.
-// -----------------------------------------------------------------------------
-static void writeSharedGeometry(SharedGeometryBuffer* buffer,
-    const std::vector<Vertex>& vertices,
-    const std::vector<uint16_t>& indices,
-    const TransformData& transform,
-    bool writeGeometry) {
-
-    // Marcar secuencia como impar → escritura en curso
-    const uint32_t seq = buffer->header.sequence;
-    buffer->header.sequence = seq + 1;
-    MemoryBarrier();
-
-    buffer->header.magic = SharedGeometryMagic;
-    buffer->header.version = SharedGeometryVersion;
-    buffer->header.hasGeometry = writeGeometry ? 1u : 0u;
-    buffer->header.hasTransform = 1;
-
-    if (writeGeometry) {
-        // Configurar la descripción del layout de vértices
-        buffer->header.vertexStride = sizeof(Vertex);
-        buffer->header.vertexCount = static_cast<uint32_t>(vertices.size());
-        buffer->header.indexCount = static_cast<uint32_t>(indices.size());
-        buffer->header.indexType = VK_INDEX_TYPE_UINT16;
-        buffer->header.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-
-        // Descripción del binding: un solo binding con stride de Vertex
-        buffer->header.attributeCount = 2;
-        buffer->header.bindingDescription.binding = 0;
-        buffer->header.bindingDescription.stride = sizeof(Vertex);
-        buffer->header.bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-        // Atributo 0: posición (vec3 float, offset 0)
-        buffer->header.attributes[0].location = 0;
-        buffer->header.attributes[0].binding = 0;
-        buffer->header.attributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        buffer->header.attributes[0].offset = offsetof(Vertex, pos);
-
-        // Atributo 1: color (vec3 float, offset después de pos)
-        buffer->header.attributes[1].location = 1;
-        buffer->header.attributes[1].binding = 0;
-        buffer->header.attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        buffer->header.attributes[1].offset = offsetof(Vertex, color);
-
-        // Copiar datos crudos de vértices e índices
-        std::memcpy(buffer->vertexData, vertices.data(), vertices.size() * sizeof(Vertex));
-        std::memcpy(buffer->indexData, indices.data(), indices.size() * sizeof(uint16_t));
-    }
-    else {
-        buffer->header.vertexStride = 0;
-        buffer->header.vertexCount = 0;
-        buffer->header.indexCount = 0;
-        buffer->header.attributeCount = 0;
-    }
-
-    // Copiar las matrices de transformación como arrays de 16 floats
-    std::memcpy(buffer->header.model, glm::value_ptr(transform.model), sizeof(float) * 16);
-    std::memcpy(buffer->header.view, glm::value_ptr(transform.view), sizeof(float) * 16);
-    std::memcpy(buffer->header.proj, glm::value_ptr(transform.proj), sizeof(float) * 16);
-
-    // Marcar secuencia como par → escritura completada
-    MemoryBarrier();
-    buffer->header.sequence = seq + 2;
-}
+#include <string>
 
 // -----------------------------------------------------------------------------
 // main: punto de entrada del proceso escritor.
 // Crea la memoria compartida, define un cubo con 8 vértices y 36 índices
 // (6 caras × 2 triángulos × 3 vértices), y anima una rotación continua
-// sobre el eje Y a 45°/s.
+// sobre el eje Y a 45°/s. Con --quantized publica los vértices cuantizados.
 //
-// La geometría se escribe una sola vez (hasta que el consumidor la confirme
-// via consumerSequence); después, solo se actualiza la transformación para
-// reducir el ancho de banda de la memoria compartida.
+// La geometría se escribe una sola vez: el anillo no pierde frames, así que
+// basta con que se publique. Con --delta, además, cada DeltaIntervalMs el
+// color de un vértice rota y solo se publican sus bytes. La transformación
+// viaja por su propio canal, así que actualizarla no toca la región de
+// geometría.
 // -----------------------------------------------------------------------------
-int main() {
-    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
-        sizeof(SharedGeometryBuffer), SharedGeometryMappingName);
-    if (!mapping) {
-        std::cerr << "Failed to create shared memory.\n";
-        return 1;
+int main(int argc, char** argv) {
+    bool quantized = false;
+    bool delta = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--quantized") == 0) {
+            quantized = true;
+        }
+        else if (std::strcmp(argv[i], "--delta") == 0) {
+            delta = true;
+        }
     }
 
-    auto* buffer = static_cast<SharedGeometryBuffer*>(
-        MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(SharedGeometryBuffer)));
-
-    if (!buffer) {
-        CloseHandle(mapping);
-        std::cerr << "Failed to map shared memory.\n";
+    // Ambos canales se crean o se reabren si ya existen, para que un
+    // renderer que sigue conectado vea al nuevo escritor sin reabrirlos. El
+    // escritor de geometría crea también el evento de notificación: cada
+    // notify despierta al lector que esté esperando en él.
+    SharedGeometryWriter geometryWriter;
+    SharedTransformWriter transformWriter;
+    if (!geometryWriter.open() || !transformWriter.open()) {
+        std::cerr << "Failed to create shared memory.\n";
         return 1;
     }
 
-    std::memset(buffer, 0, sizeof(SharedGeometryBuffer));
-
     // Definición del cubo: 8 vértices con posición y color
     std::vector<Vertex> vertices = {
         {{-0.5f, -0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
@@ -151,13 +94,50 @@ int main() {
         0, 1, 5, 0, 5, 4    // Cara inferior (y = -0.5, vista desde -Y)
     };
 
+    // Malla tal como viaja por el anillo: vértices float (Vertex) o
+    // cuantizados, con los índices del cubo. Se reconstruye al cambiar un
+    // color con --delta. Sin transformaciones por instancia: un solo cubo.
+    auto buildMesh = [&vertices, &indices, quantized]() {
+        GeometryData data{};
+        if (quantized) {
+            data = quantizeVertices(vertices);
+        }
+        else {
+            data.bindingDescription = Vertex::getBindingDescription();
+            auto attributes = Vertex::getAttributeDescriptions();
+            data.attributeDescriptions.assign(attributes.begin(), attributes.end());
+            data.vertexData.resize(vertices.size() * sizeof(Vertex));
+            std::memcpy(data.vertexData.data(), vertices.data(), data.vertexData.size());
+            data.vertexCount = static_cast<uint32_t>(vertices.size());
+            data.boundingSphere = computeBoundingSphere(data);
+        }
+        data.indexType = VK_INDEX_TYPE_UINT16;
+        data.indexData.resize(indices.size() * sizeof(uint16_t));
+        std::memcpy(data.indexData.data(), indices.data(), data.indexData.size());
+        data.indexCount = static_cast<uint32_t>(indices.size());
+        return data;
+    };
+    GeometryData mesh = buildMesh();
+
     auto start = std::chrono::high_resolution_clock::now();
     auto last = start;
     float angle = 0.0f;
     const float rotationSpeed = glm::radians(45.0f);
 
-    bool geometryAcked = false;
-    uint32_t lastGeometrySequence = 0;
+    bool geometryPending = true;
+
+    // --delta: vértice cuyo color rota, instante del último cambio y frame
+    // parcial a la espera de hueco en el anillo.
+    constexpr uint32_t DeltaIntervalMs = 500;
+    uint32_t deltaVertex = 0;
+    auto lastDelta = start;
+    bool deltaPending = false;
+    std::vector<GeometryDirtyRange> deltaRanges(1);
+
+    // Una matriz de modelo por objeto; el cubo es el objeto 0.
+    std::vector<glm::mat4> models(1, glm::mat4(1.0f));
+
+    SharedGeometryLatency latency{};
 
     while (true) {
         // Calcular delta time para rotación independiente del framerate
@@ -171,24 +151,46 @@ int main() {
         }
 
         // Construir la transformación: rotación sobre Y, cámara fija, perspectiva
-        TransformData transform{};
-        transform.model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
-        transform.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f),
+        models[0] = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f),
             glm::vec3(0.0f, 0.0f, 0.0f),
             glm::vec3(0.0f, 0.0f, 1.0f));
-        transform.proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 10.0f);
-        transform.proj[1][1] *= -1; // Corrección del eje Y de Vulkan
-
-        // Escribir geometría hasta que el consumidor la confirme,
-        // luego solo actualizar la transformación
-        if (!geometryAcked) {
-            writeSharedGeometry(buffer, vertices, indices, transform, true);
-            lastGeometrySequence = buffer->header.sequence;
-            MemoryBarrier();
-            geometryAcked = buffer->header.consumerSequence == lastGeometrySequence;
+        glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 10.0f);
+        proj[1][1] *= -1; // Corrección del eje Y de Vulkan
+
+        // Publicar la geometría en cuanto quepa en el anillo (normalmente en
+        // la primera iteración) y la transformación en cada iteración.
+        if (geometryPending && geometryWriter.write(mesh)) {
+            geometryPending = false;
         }
-        else {
-            writeSharedGeometry(buffer, vertices, indices, transform, false);
+
+        // Con --delta, rotar los canales del color de un vértice y publicar
+        // solo sus bytes. Si el anillo está lleno, el frame parcial se
+        // reintenta; entre tanto los cambios siguientes se acumulan en él.
+        if (delta && !geometryPending && now - lastDelta >= std::chrono::milliseconds(DeltaIntervalMs)) {
+            lastDelta = now;
+            glm::vec3& color = vertices[deltaVertex].color;
+            color = glm::vec3(color.z, color.x, color.y);
+            mesh = buildMesh();
+
+            const uint32_t stride = mesh.bindingDescription.stride;
+            deltaRanges[0] = { GeometryStream::Vertex, static_cast<uint64_t>(deltaVertex) * stride, stride };
+            deltaVertex = (deltaVertex + 1) % static_cast<uint32_t>(vertices.size());
+            deltaPending = true;
+        }
+        if (deltaPending && geometryWriter.writeRanges(mesh, deltaRanges)) {
+            deltaPending = false;
+        }
+        transformWriter.write(view, proj, models);
+        geometryWriter.notify();
+
+        // Un productor que envíe geometría continuamente puede usar estas
+        // latencias para adaptar su ritmo; aquí solo se informa de ellas.
+        if (geometryWriter.readLatency(latency)) {
+            std::cout << "Geometry frame " << latency.sequence
+                << ": read " << latency.readLatencyNs / 1.0e6
+                << " ms, uploaded " << latency.uploadLatencyNs / 1.0e6
+                << " ms, presented " << latency.presentLatencyNs / 1.0e6 << " ms after publish\n";
         }
 
         // Limitar a ~60 actualizaciones por segundo